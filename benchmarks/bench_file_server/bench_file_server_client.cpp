@@ -0,0 +1,142 @@
+#include "file_server_client.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// chunk uploads against a running file server: a new tcp connection per chunk (resolve, connect, POST, shutdown,
+// as FileServerClient did before the pool) vs pooled keep-alive connections, one request at a time and pipelined,
+// and the pool shared by several threads
+// every run uploads into new files, so the file server storage grows by chunks * chunk_size per run
+//
+// usage: bench_file_server_client <host> <port> [chunks] [threads] [pipeline_depth]
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+using tcp = boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+// chunk size of the chat client, the file server accepted no larger chunks before the limits route
+static constexpr size_t CHUNK_SIZE = 512;
+
+// 16 alphanumeric characters, see FileServer::is_valid_filename
+static std::string random_filename() {
+	static const std::string alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	static std::mt19937 generator(std::random_device{}());
+	std::string filename;
+	for (int i = 0; i < 16; ++i) {
+		filename += alphabet[generator() % alphabet.size()];
+	}
+	return filename;
+}
+
+static bool upload_on_new_connection(const std::string& host, const std::string& port, const std::string& filename, const std::string& chunk) {
+	boost::asio::io_context io_context;
+	tcp::resolver resolver(io_context);
+	beast::tcp_stream stream(io_context);
+	stream.connect(resolver.resolve(host, port));
+
+	http::request<http::string_body> req{http::verb::post, "/upload/" + filename, 11};
+	req.set(http::field::host, host);
+	req.body() = chunk;
+	req.prepare_payload();
+	http::write(stream, req);
+
+	beast::flat_buffer buffer;
+	http::response<http::string_body> res;
+	http::read(stream, buffer, res);
+
+	beast::error_code ec;
+	stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+	return res.body() == "File uploaded successfully";
+}
+
+static void report(const std::string& name, size_t chunks, clock_type::duration elapsed, size_t connections) {
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	std::cout << name << ": " << chunks / seconds << " chunks/s, " << chunks * CHUNK_SIZE / (1024.0 * 1024.0) / seconds << " MB/s, "
+	          << connections << " connections" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <host> <port> [chunks] [threads] [pipeline_depth]" << std::endl;
+		return 1;
+	}
+
+	const std::string host = argv[1];
+	const std::string port = argv[2];
+	const size_t chunks_count = argc > 3 ? std::stoul(argv[3]) : 2000;
+	const size_t threads_count = argc > 4 ? std::stoul(argv[4]) : 8;
+	const size_t pipeline_depth = argc > 5 ? std::stoul(argv[5]) : 16;
+	const std::string chunk(CHUNK_SIZE, 'x');
+
+	try {
+		{
+			std::string filename = random_filename();
+			auto start = clock_type::now();
+			for (size_t i = 0; i < chunks_count; ++i) {
+				if (!upload_on_new_connection(host, port, filename, chunk)) {
+					throw std::runtime_error("upload on a new connection failed");
+				}
+			}
+			report("connection per chunk          ", chunks_count, clock_type::now() - start, chunks_count);
+		}
+
+		{
+			file_server::FileServerClient client(host, port, {1, pipeline_depth});
+			std::string filename = random_filename();
+			auto start = clock_type::now();
+			for (size_t i = 0; i < chunks_count; ++i) {
+				if (!client.upload_chunk(filename, chunk)) {
+					throw std::runtime_error("pooled upload failed");
+				}
+			}
+			report("keep-alive, one at a time     ", chunks_count, clock_type::now() - start, client.get_connections_opened());
+		}
+
+		{
+			file_server::FileServerClient client(host, port, {1, pipeline_depth});
+			std::vector<std::string> chunks(chunks_count, chunk);
+			auto start = clock_type::now();
+			if (!client.upload_chunks(random_filename(), chunks)) {
+				throw std::runtime_error("pipelined upload failed");
+			}
+			report("keep-alive, pipelined x" + std::to_string(pipeline_depth) + "     ", chunks_count, clock_type::now() - start,
+			       client.get_connections_opened());
+		}
+
+		{
+			file_server::FileServerClient client(host, port, {threads_count, pipeline_depth});
+			std::atomic<size_t> failures {0};
+			std::vector<std::thread> threads;
+			auto start = clock_type::now();
+			for (size_t t = 0; t < threads_count; ++t) {
+				threads.emplace_back([&]() {
+						std::string filename = random_filename();
+						for (size_t i = 0; i < chunks_count / threads_count; ++i) {
+							if (!client.upload_chunk(filename, chunk)) {
+								++failures;
+							}
+						}
+					});
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			if (failures > 0) {
+				throw std::runtime_error(std::to_string(failures) + " concurrent uploads failed");
+			}
+			report("keep-alive, " + std::to_string(threads_count) + " threads shared", chunks_count / threads_count * threads_count,
+			       clock_type::now() - start, client.get_connections_opened());
+		}
+	} catch (const std::exception& e) {
+		std::cout << "bench_file_server_client failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "file_server_client.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// synthetic forwarding workload against a running file server with deduplication on (`file_server 10 8192 dedup`):
+// every original file is uploaded once and then forwarded, uploaded again under a new name, `forwards` times,
+// once with full uploads, which the server deduplicates on commit, and once hash first, where forwards only send the hash,
+// with the storage dir of the server on the same host the bytes on disk are compared to the bytes uploaded
+//
+// usage: bench_file_server_dedup <host> <port> [originals] [forwards] [file_kb] [storage_dir]
+
+using clock_type = std::chrono::steady_clock;
+
+// 16 alphanumeric characters, see FileServer::is_valid_filename
+static std::string random_filename(std::mt19937& generator) {
+	static const std::string alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	std::string filename;
+	for (int i = 0; i < 16; ++i) {
+		filename += alphabet[generator() % alphabet.size()];
+	}
+	return filename;
+}
+
+// blocks of regular files, hard links to one blob are counted once
+static uint64_t disk_usage(const std::filesystem::path& dir) {
+	std::set<ino_t> seen;
+	uint64_t bytes = 0;
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(dir, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		struct stat st;
+		if (it->is_regular_file() && ::stat(it->path().c_str(), &st) == 0 && seen.insert(st.st_ino).second) {
+			bytes += static_cast<uint64_t>(st.st_blocks) * 512;
+		}
+	}
+	return bytes;
+}
+
+static std::vector<std::filesystem::path> write_originals(size_t count, size_t size_kb, std::mt19937& generator) {
+	std::vector<std::filesystem::path> paths;
+	for (size_t i = 0; i < count; ++i) {
+		paths.push_back(std::filesystem::temp_directory_path() / ("bench_file_server_dedup_" + std::to_string(::getpid()) + "_" + std::to_string(i)));
+		std::string content(size_kb * 1024, '\0');
+		for (auto& c : content) {
+			c = static_cast<char>(generator());
+		}
+		std::ofstream(paths.back(), std::ios::binary) << content;
+	}
+	return paths;
+}
+
+struct RunResult {
+	double seconds;
+	uint64_t disk_bytes;
+	std::vector<std::string> filenames;
+};
+
+static RunResult run(file_server::FileServerClient& client, const std::vector<std::filesystem::path>& originals, size_t forwards,
+                     bool hash_first, const std::string& storage_dir, std::mt19937& generator) {
+	RunResult result {0, 0, {}};
+	uint64_t disk_before = storage_dir.empty() ? 0 : disk_usage(storage_dir);
+
+	auto start = clock_type::now();
+	for (const auto& path : originals) {
+		for (size_t i = 0; i <= forwards; ++i) {
+			result.filenames.push_back(random_filename(generator));
+			bool uploaded = hash_first ? client.upload_file_deduplicated(result.filenames.back(), path)
+			                : client.upload_file_resumable(result.filenames.back(), path);
+			if (!uploaded) {
+				throw std::runtime_error("upload of " + path.string() + " failed");
+			}
+		}
+	}
+	result.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	if (!storage_dir.empty()) {
+		result.disk_bytes = disk_usage(storage_dir) - disk_before;
+	}
+	return result;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <host> <port> [originals] [forwards] [file_kb] [storage_dir]" << std::endl;
+		return 1;
+	}
+
+	size_t originals_count = argc > 3 ? std::stoul(argv[3]) : 10;
+	size_t forwards = argc > 4 ? std::stoul(argv[4]) : 50;
+	size_t file_kb = argc > 5 ? std::stoul(argv[5]) : 1024;
+	std::string storage_dir = argc > 6 ? argv[6] : "";
+
+	file_server::FileServerClient client(argv[1], argv[2]);
+	std::mt19937 generator(std::random_device{}());
+	uint64_t uploaded_bytes = originals_count * (forwards + 1) * file_kb * 1024;
+
+	std::vector<std::string> filenames;
+	try {
+		for (bool hash_first : {false, true}) {
+			// new content for every run, the second one must not find the blobs of the first
+			auto originals = write_originals(originals_count, file_kb, generator);
+			RunResult result = run(client, originals, forwards, hash_first, storage_dir, generator);
+			filenames.insert(filenames.end(), result.filenames.begin(), result.filenames.end());
+			for (const auto& path : originals) {
+				std::filesystem::remove(path);
+			}
+
+			std::cout << (hash_first ? "hash first:   " : "full uploads: ") << result.filenames.size() << " uploads of "
+			          << file_kb << " KB in " << result.seconds << " s";
+			if (!storage_dir.empty()) {
+				std::cout << ", " << result.disk_bytes / 1024 << " KB on disk for " << uploaded_bytes / 1024 << " KB uploaded ("
+				          << 100.0 * (1.0 - static_cast<double>(result.disk_bytes) / uploaded_bytes) << "% saved)";
+			}
+			std::cout << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cout << "bench_file_server_dedup failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	for (const auto& filename : filenames) {
+		client.delete_file(filename);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "file_server_client.hpp"
+
+#include <unistd.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+// download MB/s and server CPU time per GB against a running file server: whole file downloads
+// (`Connection: close`, bytes are counted until the server closes the connection, so the same run works against
+// a file server built before the sendfile path, which answered a download with a series of 512 byte responses)
+// and the file fetched as consecutive ranges with FileServerClient::download_range
+// CPU time is read from /proc/<server_pid>/stat, run it on the file server machine
+//
+// usage: bench_file_server_download <host> <port> <server_pid> [file_mb] [repeats] [range_kb]
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+using tcp = boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+// 16 alphanumeric characters, see FileServer::is_valid_filename
+static std::string random_filename() {
+	static const std::string alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	static std::mt19937 generator(std::random_device{}());
+	std::string filename;
+	for (int i = 0; i < 16; ++i) {
+		filename += alphabet[generator() % alphabet.size()];
+	}
+	return filename;
+}
+
+// user + system time of the process in seconds
+static double cpu_seconds(int pid) {
+	std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+	std::string content((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+	// fields after the parenthesized command name, utime and stime are the 14th and 15th field
+	std::istringstream fields(content.substr(content.rfind(')') + 2));
+	std::string field;
+	unsigned long long utime = 0, stime = 0;
+	for (int i = 3; i <= 15 && fields >> field; ++i) {
+		if (i == 14) {
+			utime = std::stoull(field);
+		} else if (i == 15) {
+			stime = std::stoull(field);
+		}
+	}
+	return static_cast<double>(utime + stime) / static_cast<double>(::sysconf(_SC_CLK_TCK));
+}
+
+static size_t download_until_close(const std::string& host, const std::string& port, const std::string& filename) {
+	boost::asio::io_context io_context;
+	tcp::resolver resolver(io_context);
+	tcp::socket socket(io_context);
+	boost::asio::connect(socket, resolver.resolve(host, port));
+
+	std::string request = "GET /download/" + filename + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+	boost::asio::write(socket, boost::asio::buffer(request));
+
+	std::string buffer(1024 * 1024, '\0');
+	size_t received = 0;
+	boost::system::error_code ec;
+	while (!ec) {
+		received += socket.read_some(boost::asio::buffer(buffer), ec);
+	}
+	return received;
+}
+
+struct Result {
+	double _mb_per_second;
+	double _cpu_seconds_per_gb;
+};
+
+template<typename Download>
+static Result measure(int server_pid, size_t file_bytes, size_t repeats, Download download) {
+	double cpu_before = cpu_seconds(server_pid);
+	auto start = clock_type::now();
+	for (size_t i = 0; i < repeats; ++i) {
+		download();
+	}
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	double gigabytes = static_cast<double>(file_bytes * repeats) / (1024.0 * 1024.0 * 1024.0);
+	return {gigabytes * 1024.0 / seconds, (cpu_seconds(server_pid) - cpu_before) / gigabytes};
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 4) {
+		std::cout << "usage: " << argv[0] << " <host> <port> <server_pid> [file_mb] [repeats] [range_kb]" << std::endl;
+		return 1;
+	}
+
+	const std::string host = argv[1];
+	const std::string port = argv[2];
+	const int server_pid = std::stoi(argv[3]);
+	const size_t file_bytes = (argc > 4 ? std::stoul(argv[4]) : 100) * 1024 * 1024;
+	const size_t repeats = argc > 5 ? std::stoul(argv[5]) : 10;
+	const size_t range_bytes = (argc > 6 ? std::stoul(argv[6]) : 1024) * 1024;
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / ("bench_file_server_download_" + std::to_string(::getpid()));
+	try {
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			std::string block(1024 * 1024, 'x');
+			for (size_t written = 0; written < file_bytes; written += block.size()) {
+				file.write(block.data(), std::min(block.size(), file_bytes - written));
+			}
+		}
+
+		file_server::FileServerClient client(host, port);
+		const std::string filename = random_filename();
+		if (!client.upload_file(filename, path)) {
+			throw std::runtime_error("upload of the test file failed, is the max file size of the file server large enough?");
+		}
+		std::filesystem::remove(path);
+
+		Result whole = measure(server_pid, file_bytes, repeats, [&]() {
+				if (download_until_close(host, port, filename) < file_bytes) {
+					throw std::runtime_error("whole file download is incomplete");
+				}
+			});
+		std::cout << "whole file:        " << whole._mb_per_second << " MB/s, " << whole._cpu_seconds_per_gb << " s server CPU per GB" << std::endl;
+
+		Result ranges = measure(server_pid, file_bytes, repeats, [&]() {
+				for (size_t offset = 0; offset < file_bytes;) {
+					auto range = client.download_range(filename, offset, range_bytes);
+					if (!range || range->empty()) {
+						throw std::runtime_error("range download failed at " + std::to_string(offset));
+					}
+					offset += range->size();
+				}
+			});
+		std::cout << range_bytes / 1024 << " KB ranges:    " << ranges._mb_per_second << " MB/s, " << ranges._cpu_seconds_per_gb
+		          << " s server CPU per GB" << std::endl;
+
+		client.delete_file(filename);
+	} catch (const std::exception& e) {
+		std::cout << "bench_file_server_download failed: " << e.what() << std::endl;
+		std::filesystem::remove(path);
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
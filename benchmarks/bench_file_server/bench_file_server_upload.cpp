@@ -0,0 +1,98 @@
+#include "file_server_client.hpp"
+
+#include <unistd.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// upload throughput of whole files against a running file server, chunks of the size the server negotiates
+// (GET /limits, FileServer max_chunk_size) vs the 512 byte chunks of the old upload route,
+// 512 byte chunks are only measured for files of up to 100 MB, a 1 GB file would take over two million requests
+// start the file server with a max file size above the largest file: `file_server 2048 [max_chunk_size_kb]`
+//
+// usage: bench_file_server_upload <host> <port> [file_sizes_mb...]
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr size_t LEGACY_CHUNK_SIZE = 512;
+static constexpr size_t LEGACY_MAX_FILE_MB = 100;
+
+// 16 alphanumeric characters, see FileServer::is_valid_filename
+static std::string random_filename() {
+	static const std::string alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	static std::mt19937 generator(std::random_device{}());
+	std::string filename;
+	for (int i = 0; i < 16; ++i) {
+		filename += alphabet[generator() % alphabet.size()];
+	}
+	return filename;
+}
+
+static void write_file(const std::filesystem::path& path, size_t size_mb) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	std::string block(1024 * 1024, '\0');
+	std::mt19937 generator(42);
+	for (auto& c : block) {
+		c = static_cast<char>(generator());
+	}
+	for (size_t i = 0; i < size_mb; ++i) {
+		file.write(block.data(), block.size());
+	}
+}
+
+static double upload_mb_per_second(const std::string& host, const std::string& port, const std::filesystem::path& path,
+                                   size_t size_mb, size_t max_chunk_size, size_t& chunk_size) {
+	file_server::FileServerClientConfig config;
+	config._max_chunk_size = max_chunk_size;
+	file_server::FileServerClient client(host, port, config);
+	chunk_size = client.get_max_chunk_size();
+
+	auto start = clock_type::now();
+	if (!client.upload_file(random_filename(), path)) {
+		throw std::runtime_error("upload of " + std::to_string(size_mb) + " MB failed");
+	}
+	return size_mb / std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <host> <port> [file_sizes_mb...]" << std::endl;
+		return 1;
+	}
+
+	std::vector<size_t> sizes_mb;
+	for (int i = 3; i < argc; ++i) {
+		sizes_mb.push_back(std::stoul(argv[i]));
+	}
+	if (sizes_mb.empty()) {
+		sizes_mb = {1, 100, 1024};
+	}
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / ("bench_file_server_upload_" + std::to_string(::getpid()));
+	try {
+		for (size_t size_mb : sizes_mb) {
+			write_file(path, size_mb);
+
+			size_t chunk_size = 0;
+			double negotiated = upload_mb_per_second(argv[1], argv[2], path, size_mb, 0, chunk_size);
+			std::cout << size_mb << " MB file: " << negotiated << " MB/s in " << chunk_size / 1024 << " KB chunks";
+
+			if (size_mb <= LEGACY_MAX_FILE_MB) {
+				double legacy = upload_mb_per_second(argv[1], argv[2], path, size_mb, LEGACY_CHUNK_SIZE, chunk_size);
+				std::cout << ", " << legacy << " MB/s in " << chunk_size << " byte chunks";
+			}
+			std::cout << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cout << "bench_file_server_upload failed: " << e.what() << std::endl;
+		std::filesystem::remove(path);
+		return 1;
+	}
+
+	std::filesystem::remove(path);
+	return 0;
+}
\ No newline at end of file
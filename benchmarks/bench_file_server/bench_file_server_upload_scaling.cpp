@@ -0,0 +1,85 @@
+#include "file_server_client.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// aggregate upload throughput against a running file server with 1 to 64 concurrent uploaders,
+// every uploader appends chunks to its own file on its own connection, so the only contention left in the
+// file server is on the per file locks (FileServer _file_locks) and the disk,
+// the file server has to run at least as many threads as uploaders: `file_server` uses 16 by default
+//
+// usage: bench_file_server_upload_scaling <host> <port> [file_mb] [chunk_kb] [max_uploaders]
+
+using clock_type = std::chrono::steady_clock;
+
+// 16 alphanumeric characters, see FileServer::is_valid_filename
+static std::string random_filename(std::mt19937& generator) {
+	static const std::string alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	std::string filename;
+	for (int i = 0; i < 16; ++i) {
+		filename += alphabet[generator() % alphabet.size()];
+	}
+	return filename;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <host> <port> [file_mb] [chunk_kb] [max_uploaders]" << std::endl;
+		return 1;
+	}
+
+	std::string host = argv[1];
+	std::string port = argv[2];
+	size_t file_mb = argc > 3 ? std::stoul(argv[3]) : 4;
+	size_t chunk_kb = argc > 4 ? std::stoul(argv[4]) : 64;
+	size_t max_uploaders = argc > 5 ? std::stoul(argv[5]) : 64;
+
+	std::string chunk(chunk_kb * 1024, 'x');
+	size_t chunks_per_file = file_mb * 1024 / chunk_kb;
+	std::mt19937 generator(std::random_device{}());
+
+	for (size_t uploaders = 1; uploaders <= max_uploaders; uploaders *= 2) {
+		std::vector<std::string> filenames;
+		for (size_t i = 0; i < uploaders; ++i) {
+			filenames.push_back(random_filename(generator));
+		}
+
+		std::atomic<size_t> failures {0};
+		std::vector<std::thread> threads;
+		auto start = clock_type::now();
+		for (size_t i = 0; i < uploaders; ++i) {
+			threads.emplace_back([&, i]() {
+				file_server::FileServerClient client(host, port, {1, 1});
+				for (size_t c = 0; c < chunks_per_file; ++c) {
+					if (!client.upload_chunk(filenames[i], chunk)) {
+						++failures;
+						return;
+					}
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+		if (failures) {
+			std::cout << uploaders << " uploaders: " << failures << " uploads failed" << std::endl;
+			return 1;
+		}
+		std::cout << uploaders << " uploaders: " << uploaders * file_mb / seconds << " MB/s, "
+		          << uploaders * chunks_per_file / seconds << " chunks/s" << std::endl;
+
+		file_server::FileServerClient cleanup(host, port);
+		for (const auto& filename : filenames) {
+			cleanup.delete_file(filename);
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
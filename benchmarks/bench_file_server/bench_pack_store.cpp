@@ -0,0 +1,137 @@
+#include "pack_store.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// small object write and random read IOPS of PackStore vs the per file layout of the file server
+// (<dir>/ab/cd/<name>, a file created, written and closed per object, opened, read and closed per read),
+// without a network in between, so the numbers are the storage layouts alone,
+// run it on the disk the file server uses and with more objects than the page cache holds to see disk reads
+//
+// usage: bench_pack_store [dir] [objects] [object_kb] [reads] [threads]
+
+using clock_type = std::chrono::steady_clock;
+
+static std::string object_name(size_t i) {
+	std::string name = std::to_string(i);
+	return std::string(16 - name.size(), '0') + name;
+}
+
+static std::filesystem::path object_path(const std::filesystem::path& root, const std::string& name) {
+	return root / name.substr(12, 2) / name.substr(14, 2) / name;
+}
+
+static bool write_file(const std::filesystem::path& path, const std::string& data) {
+	int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	bool written = ::write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+	return ::close(fd) == 0 && written;
+}
+
+static bool read_file(const std::filesystem::path& path, std::string& data) {
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	bool read = ::pread(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size());
+	::close(fd);
+	return read;
+}
+
+// `threads` readers of `reads` random objects altogether, reads per second
+template <typename Read>
+static double random_reads(size_t objects, size_t reads, size_t threads, Read read) {
+	std::atomic<size_t> failures {0};
+	std::vector<std::thread> readers;
+	auto start = clock_type::now();
+	for (size_t t = 0; t < threads; ++t) {
+		readers.emplace_back([&, t]() {
+			std::mt19937 generator(static_cast<unsigned int>(t));
+			for (size_t i = 0; i < reads / threads; ++i) {
+				if (!read(object_name(generator() % objects))) {
+					++failures;
+				}
+			}
+		});
+	}
+	for (auto& reader : readers) {
+		reader.join();
+	}
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+	if (failures) {
+		std::cout << failures << " reads failed" << std::endl;
+	}
+	return reads / threads * threads / seconds;
+}
+
+int main(int argc, char* argv[]) {
+	std::filesystem::path dir = argc > 1 ? argv[1] : std::filesystem::temp_directory_path() / "bench_pack_store";
+	size_t objects = argc > 2 ? std::stoul(argv[2]) : 100000;
+	size_t object_kb = argc > 3 ? std::stoul(argv[3]) : 4;
+	size_t reads = argc > 4 ? std::stoul(argv[4]) : 200000;
+	size_t threads = argc > 5 ? std::stoul(argv[5]) : 8;
+
+	std::string data(object_kb * 1024, 'x');
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+
+	std::filesystem::path files_dir = dir / "files";
+	auto start = clock_type::now();
+	for (size_t i = 0; i < objects; ++i) {
+		auto path = object_path(files_dir, object_name(i));
+		std::filesystem::create_directories(path.parent_path());
+		if (!write_file(path, data)) {
+			std::cout << "failed to write " << path << std::endl;
+			return 1;
+		}
+	}
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	std::cout << "per file writes: " << objects / seconds << " objects/s" << std::endl;
+
+	double file_reads = random_reads(objects, reads, threads, [&](const std::string& name) {
+			std::string read(data.size(), '\0');
+			return read_file(object_path(files_dir, name), read);
+		});
+	std::cout << "per file random reads: " << file_reads << " objects/s, " << threads << " threads" << std::endl;
+
+	file_server::PackStoreConfig config;
+	config._max_object_size = std::max(config._max_object_size, data.size());
+	config._compaction_interval = std::chrono::milliseconds(0);
+	{
+		file_server::PackStore store(dir / "packs", config);
+		start = clock_type::now();
+		for (size_t i = 0; i < objects; ++i) {
+			if (!store.put(object_name(i), data)) {
+				std::cout << "failed to pack " << object_name(i) << std::endl;
+				return 1;
+			}
+		}
+		seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+		std::cout << "pack writes: " << objects / seconds << " objects/s, " << store.get_stats()._segments << " segments" << std::endl;
+
+		double pack_reads = random_reads(objects, reads, threads, [&](const std::string& name) {
+				return store.get(name).has_value();
+			});
+		std::cout << "pack random reads: " << pack_reads << " objects/s, " << threads << " threads" << std::endl;
+	}
+
+	// the index of a reopened store comes from the segment footers
+	start = clock_type::now();
+	file_server::PackStore store(dir / "packs", config);
+	seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	std::cout << "pack index of " << store.get_stats()._objects << " objects rebuilt in " << seconds * 1000 << " ms" << std::endl;
+
+	std::filesystem::remove_all(dir);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "debug.hpp"
+
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+// opens N connections to a running chat server and keeps them idle,
+// then sends one request on every connection and counts how many of them are served
+// before the deadline, run it against the server with the same _thread_pool_size to compare layouts
+//
+// usage: bench_concurrent_connections <host> <port> <connections> [timeout_ms]
+// note: raise the fd limit first (ulimit -n) for tens of thousands of connections
+
+using tcp = boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+struct Probe {
+	explicit Probe(boost::asio::io_context& io_context) : socket(io_context) {
+	}
+
+	tcp::socket socket;
+	boost::asio::streambuf buffer;
+	std::string request;
+	clock_type::time_point sent;
+	bool connected = false;
+	bool served = false;
+	double latency_ms = 0.0;
+};
+
+int main(int argc, char* argv[]) {
+	if (argc < 4) {
+		std::cout << "usage: " << argv[0] << " <host> <port> <connections> [timeout_ms]" << std::endl;
+		return 1;
+	}
+
+	const std::string host = argv[1];
+	const std::string port = argv[2];
+	const size_t connections_count = std::stoul(argv[3]);
+	const auto timeout = std::chrono::milliseconds(argc > 4 ? std::stoul(argv[4]) : 5000);
+
+	boost::asio::io_context io_context;
+	tcp::resolver resolver(io_context);
+	auto endpoints = resolver.resolve(host, port);
+
+	std::vector<std::unique_ptr<Probe> > probes;
+	probes.reserve(connections_count);
+
+	auto connect_start = clock_type::now();
+	for (size_t i = 0; i < connections_count; ++i) {
+		auto probe = std::make_unique<Probe>(io_context);
+		Probe* raw = probe.get();
+		boost::asio::async_connect(raw->socket, endpoints,
+		                           [raw](const boost::system::error_code& ec, const tcp::endpoint&) {
+				raw->connected = !ec;
+			});
+		probes.push_back(std::move(probe));
+	}
+	io_context.run();
+	io_context.restart();
+	double connect_s = std::chrono::duration<double>(clock_type::now() - connect_start).count();
+
+	size_t connected = std::count_if(probes.begin(), probes.end(), [](const auto& p) {
+			return p->connected;
+		});
+	INFO_MSG("[bench_concurrent_connections] Connected " + std::to_string(connected) + "/" + std::to_string(connections_count)
+	         + " in " + std::to_string(connect_s) + " s");
+
+	// unknown request type is answered by every server version without touching the databases
+	nlohmann::json request = {{"type", "ping"}};
+
+	for (auto& probe : probes) {
+		if (!probe->connected) {
+			continue;
+		}
+
+		Probe* raw = probe.get();
+		raw->request = request.dump() + "\r\n\r\n";
+		raw->sent = clock_type::now();
+		boost::asio::async_write(raw->socket, boost::asio::buffer(raw->request),
+		                         [raw](const boost::system::error_code& ec, size_t) {
+				if (ec) {
+					return;
+				}
+				boost::asio::async_read_until(raw->socket, raw->buffer, "\r\n\r\n",
+				                              [raw](const boost::system::error_code& ec, size_t) {
+					if (!ec) {
+						raw->served = true;
+						raw->latency_ms = std::chrono::duration<double, std::milli>(clock_type::now() - raw->sent).count();
+					}
+				});
+			});
+	}
+
+	io_context.run_for(timeout);
+
+	std::vector<double> latencies;
+	for (const auto& probe : probes) {
+		if (probe->served) {
+			latencies.push_back(probe->latency_ms);
+		}
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&latencies](double p) {
+		if (latencies.empty()) {
+			return 0.0;
+		}
+		return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+	};
+
+	std::cout << "connections: " << connections_count
+	          << ", connected: " << connected
+	          << ", served: " << latencies.size()
+	          << ", starved: " << connected - latencies.size() << std::endl;
+	std::cout << "latency ms p50: " << percentile(0.50)
+	          << ", p99: " << percentile(0.99)
+	          << ", max: " << (latencies.empty() ? 0.0 : latencies.back()) << std::endl;
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "connected_clients_manager.hpp"
+
+#include <boost/make_shared.hpp>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// mixed lookup/insert/remove workload on the connected clients registry,
+// compares the sharded manager with a single mutex map (layout of the previous implementation)
+//
+// usage: bench_connected_clients_manager [operations_per_thread] [users_count]
+// mix: 90% get_client_session, 5% add_client, 5% remove_client_by_session
+
+using clock_type = std::chrono::steady_clock;
+
+struct BenchConnection {
+	int _id;
+};
+
+using ConnectionPtr = boost::shared_ptr<BenchConnection>;
+
+class SingleLockClientsManager {
+public:
+	void add_client(int user_id, ConnectionPtr connection) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_clients[user_id] = connection;
+	}
+
+	void remove_client_by_session(ConnectionPtr connection) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (auto it = _clients.begin(); it != _clients.end(); ++it) {
+			if (it->second == connection) {
+				_clients.erase(it);
+				return;
+			}
+		}
+	}
+
+	ConnectionPtr get_client_session(int user_id) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _clients.find(user_id);
+		return it != _clients.end() ? it->second : nullptr;
+	}
+
+private:
+	std::mutex _mutex;
+	std::unordered_map<int, ConnectionPtr> _clients;
+};
+
+template<typename Manager>
+double run(Manager& manager, const std::vector<ConnectionPtr>& connections, size_t threads_count, size_t operations_per_thread) {
+	std::vector<std::thread> threads;
+	auto start = clock_type::now();
+
+	for (size_t t = 0; t < threads_count; ++t) {
+		threads.emplace_back([&manager, &connections, operations_per_thread, t]() {
+			std::mt19937 rng(static_cast<uint32_t>(t + 1));
+			std::uniform_int_distribution<size_t> user_distribution(0, connections.size() - 1);
+			std::uniform_int_distribution<int> operation_distribution(0, 99);
+
+			for (size_t i = 0; i < operations_per_thread; ++i) {
+				size_t index = user_distribution(rng);
+				int operation = operation_distribution(rng);
+				if (operation < 90) {
+					manager.get_client_session(static_cast<int>(index) + 1);
+				} else if (operation < 95) {
+					manager.add_client(static_cast<int>(index) + 1, connections[index]);
+				} else {
+					manager.remove_client_by_session(connections[index]);
+				}
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	return threads_count * operations_per_thread / seconds / 1e6;
+}
+
+template<typename Manager>
+void fill(Manager& manager, const std::vector<ConnectionPtr>& connections) {
+	for (size_t i = 0; i < connections.size(); ++i) {
+		manager.add_client(static_cast<int>(i) + 1, connections[i]);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const size_t operations_per_thread = argc > 1 ? std::stoul(argv[1]) : 200000;
+	const size_t users_count = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+	std::vector<ConnectionPtr> connections;
+	connections.reserve(users_count);
+	for (size_t i = 0; i < users_count; ++i) {
+		connections.push_back(boost::make_shared<BenchConnection>(BenchConnection{static_cast<int>(i) + 1}));
+	}
+
+	std::cout << "users: " << users_count << ", operations per thread: " << operations_per_thread << std::endl;
+	for (size_t threads_count : {8, 32, 64}) {
+		SingleLockClientsManager single_lock;
+		fill(single_lock, connections);
+		double single_lock_mops = run(single_lock, connections, threads_count, operations_per_thread);
+
+		server::BasicConnectedClientsManager<BenchConnection> sharded;
+		fill(sharded, connections);
+		double sharded_mops = run(sharded, connections, threads_count, operations_per_thread);
+
+		std::cout << "threads: " << threads_count
+		          << ", single lock Mops/s: " << single_lock_mops
+		          << ", sharded Mops/s: " << sharded_mops << std::endl;
+	}
+
+	return 0;
+}
\ No newline at end of file
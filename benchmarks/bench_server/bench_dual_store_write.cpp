@@ -0,0 +1,83 @@
+#include "latency_histogram.hpp"
+#include "message.hpp"
+#include "message_metadata_repository.hpp"
+#include "message_text_repository.hpp"
+#include "snowflake_id_generator.hpp"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// send path latency of a message write into both stores: metadata insert and then text SET (the sum of both)
+// vs both writes in flight at once as in RepositoryManager::create_message_async (the max of both)
+// postgres needs the messages table of tests/test_server/database/test_message_metadata.sql, redis an empty db
+//
+// usage: bench_dual_store_write <postgres_connection_string> <redis_connection_string> [messages_per_sender] [senders]
+
+using clock_type = std::chrono::steady_clock;
+
+static server::LatencyStats run_senders(size_t senders, size_t messages_per_sender, const std::function<void()>& write) {
+	server::LatencyHistogram histogram("bench", std::chrono::hours(1));
+
+	std::vector<std::thread> threads;
+	for (size_t s = 0; s < senders; ++s) {
+		threads.emplace_back([&histogram, &write, messages_per_sender]() {
+				for (size_t i = 0; i < messages_per_sender; ++i) {
+					auto started = clock_type::now();
+					write();
+					histogram.record(clock_type::now() - started);
+				}
+			});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	return histogram.get_stats();
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <postgres_connection_string> <redis_connection_string> [messages_per_sender] [senders]" << std::endl;
+		return 1;
+	}
+
+	const size_t messages_per_sender = argc > 3 ? std::stoul(argv[3]) : 2000;
+	const size_t senders = argc > 4 ? std::stoul(argv[4]) : 1;
+
+	try {
+		server::PostgresDBManager postgres_db_manager;
+		postgres_db_manager.add_connection("bench", argv[1], server::MessageMetadataRepository::PREPARED_STATEMENTS);
+		server::MessageMetadataRepository metadata_repository(postgres_db_manager, "bench");
+		server::MessageTextRepository text_repository(argv[2]);
+		server::SnowflakeIdGenerator id_generator(0);
+		const std::string text(256, 'x');
+
+		auto sequential = run_senders(senders, messages_per_sender, [&]() {
+				common::Message message(1, 2, text);
+				message.set_id(id_generator.next_id());
+				metadata_repository.create(message.get_metadata());
+				text_repository.create(message.get_text());
+			});
+
+		auto parallel = run_senders(senders, messages_per_sender, [&]() {
+				common::Message message(1, 2, text);
+				message.set_id(id_generator.next_id());
+				auto metadata_future = metadata_repository.create_async(message.get_metadata());
+				auto text_future = text_repository.create_async(message.get_text());
+				metadata_future.get();
+				text_future.get();
+			});
+
+		std::cout << "senders: " << senders << ", messages per sender: " << messages_per_sender << std::endl;
+		std::cout << "sequential: " << sequential.to_string() << std::endl;
+		std::cout << "parallel:   " << parallel.to_string() << std::endl;
+	} catch (const std::exception& e) {
+		std::cout << "bench_dual_store_write failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
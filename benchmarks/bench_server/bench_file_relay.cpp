@@ -0,0 +1,185 @@
+#include "debug.hpp"
+#include "frame.hpp"
+
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// file transfer between two users through a running chat server and file server: time-to-first-byte of the
+// receiver (first chunk sent -> first chunk received), total transfer time and peak RSS of the server process,
+// start the server once with FileRelayMode::STORE_AND_FORWARD and once with FileRelayMode::STREAMING and compare
+// the two runs, peak RSS is read from /proc/<server_pid>/status, so run it on the server machine and restart
+// the server between runs
+//
+// usage: bench_file_relay <host> <port> <server_pid> [file_mb] [chunk_kb]
+
+using tcp = boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+class Connection {
+public:
+	Connection(boost::asio::io_context& io_context, const tcp::resolver::results_type& endpoints)
+		: _socket(io_context) {
+		boost::asio::connect(_socket, endpoints);
+		_socket.set_option(tcp::no_delay(true));
+
+		// the handshake response still comes in the json mode
+		std::string handshake = nlohmann::json({{"type", "handshake"}, {"framing", "binary"}}).dump() + common::JSON_DELIMITER;
+		boost::asio::write(_socket, boost::asio::buffer(handshake));
+		boost::asio::streambuf buffer;
+		size_t bytes = boost::asio::read_until(_socket, buffer, common::JSON_DELIMITER);
+		if (bytes != buffer.size()) {
+			throw std::runtime_error("unexpected data after the handshake response");
+		}
+	}
+
+	void send(const nlohmann::json& request, const std::string& binary = "") {
+		common::FrameType type = binary.empty() ? common::FrameType::MESSAGE : common::FrameType::FILE_CHUNK;
+		std::string frame = common::encode_frame(type, ++_request_id, request.dump(), binary);
+		boost::asio::write(_socket, boost::asio::buffer(frame));
+	}
+
+	// json part of the next frame, raw bytes go to binary
+	nlohmann::json receive(std::string* binary = nullptr) {
+		char header_bytes[common::FRAME_HEADER_SIZE];
+		boost::asio::read(_socket, boost::asio::buffer(header_bytes));
+		common::FrameHeader header = common::decode_frame_header(header_bytes);
+
+		std::string payload(header.payload_length, '\0');
+		boost::asio::read(_socket, boost::asio::buffer(payload));
+		if (binary) {
+			binary->assign(payload, header.json_length, std::string::npos);
+		}
+		return nlohmann::json::parse(payload.substr(0, header.json_length));
+	}
+
+	// skips pushes until a frame of the given type arrives
+	nlohmann::json receive_type(const std::string& type) {
+		while (true) {
+			nlohmann::json frame = receive();
+			if (frame.value("type", "") == type || (type.empty() && !frame.contains("type"))) {
+				return frame;
+			}
+		}
+	}
+
+	int login(const std::string& nickname) {
+		const std::string password = "bench_password";
+		send({{"type", "register"}, {"nickname", nickname}, {"password", password},
+		      {"el_gamal_public_key", "0"}, {"dsa_public_key", "0"}});
+		int user_id = receive().value("user_id", 0);
+		if (user_id == 0) {
+			throw std::runtime_error("failed to register " + nickname);
+		}
+
+		send({{"type", "authorize"}, {"nickname", nickname}, {"password", password}, {"user_id", user_id}});
+		if (receive().value("status", "") != "success") {
+			throw std::runtime_error("failed to authorize " + nickname);
+		}
+		return user_id;
+	}
+
+private:
+	tcp::socket _socket;
+	uint32_t _request_id = 0;
+};
+
+static long read_status_kb(int pid, const std::string& field) {
+	std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.rfind(field + ":", 0) == 0) {
+			return std::stol(line.substr(field.size() + 1));
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 4) {
+		std::cout << "usage: " << argv[0] << " <host> <port> <server_pid> [file_mb] [chunk_kb]" << std::endl;
+		return 1;
+	}
+
+	const int server_pid = std::stoi(argv[3]);
+	const size_t file_bytes = (argc > 4 ? std::stoul(argv[4]) : 1024) * 1024 * 1024;
+	const size_t chunk_bytes = (argc > 5 ? std::stoul(argv[5]) : 256) * 1024;
+
+	try {
+		boost::asio::io_context io_context;
+		auto endpoints = tcp::resolver(io_context).resolve(argv[1], argv[2]);
+
+		// unique names, so the benchmark can be rerun against the same database
+		std::string suffix = std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+		Connection sender(io_context, endpoints);
+		Connection receiver(io_context, endpoints);
+		int sender_id = sender.login("bench_sender_" + suffix);
+		receiver.login("bench_receiver_" + suffix);
+
+		const std::string filename = "bench_relay_" + suffix + ".bin";
+		long rss_before_kb = read_status_kb(server_pid, "VmRSS");
+
+		clock_type::time_point first_chunk_sent;
+		clock_type::time_point first_chunk_received;
+		clock_type::time_point last_chunk_received;
+		size_t received_bytes = 0;
+
+		std::thread receiving([&]() {
+				std::string chunk;
+				while (true) {
+					nlohmann::json frame = receiver.receive(&chunk);
+					if (frame.value("type", "") != "file_chunk") {
+						continue;
+					}
+					if (received_bytes == 0) {
+						first_chunk_received = clock_type::now();
+					}
+					received_bytes += chunk.size();
+					if (frame.value("is_last", false)) {
+						last_chunk_received = clock_type::now();
+						return;
+					}
+				}
+			});
+
+		sender.send({{"type", "send_message"}, {"sender_id", sender_id}, {"receiver_nickname", "bench_receiver_" + suffix},
+		             {"message_text", "file"}, {"file_name", filename}});
+		sender.receive_type("");
+
+		// one chunk in flight as in Client::send_file_chunks, the next one goes after the acknowledgment
+		const std::string chunk(chunk_bytes, 'x');
+		size_t chunks_count = (file_bytes + chunk_bytes - 1) / chunk_bytes;
+		first_chunk_sent = clock_type::now();
+		for (size_t i = 1; i <= chunks_count; ++i) {
+			sender.send({{"type", "file_chunk"}, {"filename", filename}, {"chunk_number", i}, {"is_last", i == chunks_count}}, chunk);
+			nlohmann::json ack = sender.receive_type("chunk_acknowledgment");
+			if (ack.value("status", "") != "success") {
+				throw std::runtime_error("chunk " + std::to_string(i) + " failed: " + ack.dump());
+			}
+		}
+		clock_type::time_point upload_done = clock_type::now();
+
+		receiving.join();
+
+		auto ms = [](clock_type::duration duration) {
+				return std::chrono::duration<double, std::milli>(duration).count();
+			};
+		double total_ms = ms(last_chunk_received - first_chunk_sent);
+
+		std::cout << file_bytes / (1024 * 1024) << " MB in " << chunks_count << " chunks of " << chunk_bytes / 1024 << " KB" << std::endl;
+		std::cout << "receiver time-to-first-byte: " << ms(first_chunk_received - first_chunk_sent) << " ms" << std::endl;
+		std::cout << "upload: " << ms(upload_done - first_chunk_sent) << " ms, last byte at receiver: " << total_ms << " ms, "
+		          << received_bytes / (1024.0 * 1024.0) / (total_ms / 1000.0) << " MB/s" << std::endl;
+		std::cout << "server RSS before: " << rss_before_kb / 1024 << " MB, peak (VmHWM): "
+		          << read_status_kb(server_pid, "VmHWM") / 1024 << " MB" << std::endl;
+	} catch (const std::exception& e) {
+		std::cout << "bench_file_relay failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
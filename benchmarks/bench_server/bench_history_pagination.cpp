@@ -0,0 +1,128 @@
+#include "debug.hpp"
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// latency of history pages in chats of different sizes: keyset pagination as in
+// MessageMetadataRepository::get_history_page vs LIMIT/OFFSET, for the newest page and a page deep in the chat
+// runs on its own bench_history table with the (chat_id, created_timestamp DESC, id DESC) index of the messages table,
+// chat i of the given sizes gets sizes[i] messages, 10 million rows take a few minutes to generate
+//
+// usage: bench_history_pagination <connection_string> [page_size] [repeats] [chat_sizes...]
+
+using clock_type = std::chrono::steady_clock;
+
+static const std::string KEYSET_SQL =
+	"SELECT id, created_timestamp FROM bench_history WHERE chat_id = $1 AND (created_timestamp, id) < ($2::timestamptz, $3::bigint) "
+	"ORDER BY created_timestamp DESC, id DESC LIMIT $4";
+static const std::string OFFSET_SQL =
+	"SELECT id, created_timestamp FROM bench_history WHERE chat_id = $1 "
+	"ORDER BY created_timestamp DESC, id DESC LIMIT $2 OFFSET $3";
+
+static double median_ms(std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	return samples.empty() ? 0.0 : samples[samples.size() / 2];
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <connection_string> [page_size] [repeats] [chat_sizes...]" << std::endl;
+		return 1;
+	}
+
+	const long long page_size = argc > 2 ? std::stoll(argv[2]) : 50;
+	const size_t repeats = argc > 3 ? std::stoul(argv[3]) : 50;
+	std::vector<long long> chat_sizes;
+	for (int i = 4; i < argc; ++i) {
+		chat_sizes.push_back(std::stoll(argv[i]));
+	}
+	if (chat_sizes.empty()) {
+		chat_sizes = {100, 10000, 1000000, 10000000};
+	}
+
+	try {
+		pqxx::connection connection(argv[1]);
+		{
+			pqxx::work txn(connection);
+			txn.exec0("DROP TABLE IF EXISTS bench_history");
+			txn.exec0("CREATE TABLE bench_history (id BIGINT PRIMARY KEY, chat_id INT NOT NULL, "
+			          "created_timestamp TIMESTAMP WITH TIME ZONE NOT NULL)");
+			long long next_id = 1;
+			for (size_t chat = 0; chat < chat_sizes.size(); ++chat) {
+				// one message per millisecond, ids grow with time as snowflake ids do
+				txn.exec_params0("INSERT INTO bench_history (id, chat_id, created_timestamp) "
+				                 "SELECT $1::bigint + n, $2::int, TIMESTAMPTZ '2024-01-01' + n * INTERVAL '1 millisecond' "
+				                 "FROM generate_series(0, $3::bigint - 1) AS n",
+				                 next_id, static_cast<int>(chat + 1), chat_sizes[chat]);
+				next_id += chat_sizes[chat];
+			}
+			txn.exec0("CREATE INDEX idx_bench_history_chat ON bench_history (chat_id, created_timestamp DESC, id DESC)");
+			txn.exec0("ANALYZE bench_history");
+			txn.commit();
+		}
+		connection.prepare("keyset", KEYSET_SQL);
+		connection.prepare("offset", OFFSET_SQL);
+
+		std::cout << "page size: " << page_size << ", median of " << repeats << " runs" << std::endl;
+
+		for (size_t chat = 0; chat < chat_sizes.size(); ++chat) {
+			int chat_id = static_cast<int>(chat + 1);
+			// page that starts at 90% of the chat, as reached by scrolling back
+			long long deep_offset = std::max(0LL, chat_sizes[chat] * 9 / 10 - page_size);
+
+			std::string deep_timestamp;
+			long long deep_id = 0;
+			{
+				pqxx::work txn(connection);
+				pqxx::result r = txn.exec_prepared("offset", chat_id, 1LL, std::max(0LL, deep_offset - 1));
+				if (!r.empty()) {
+					deep_id = r[0][0].as<long long>();
+					deep_timestamp = r[0][1].c_str();
+				}
+				txn.commit();
+			}
+
+			std::vector<double> keyset_first, keyset_deep, offset_first, offset_deep;
+			for (size_t i = 0; i < repeats; ++i) {
+				auto measure = [&connection](std::vector<double>& samples, auto run) {
+						pqxx::work txn(connection);
+						auto start = clock_type::now();
+						run(txn);
+						samples.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - start).count());
+						txn.commit();
+					};
+
+				measure(keyset_first, [&](pqxx::work& txn) {
+						txn.exec_prepared("keyset", chat_id, std::string("infinity"), std::numeric_limits<long long>::max(), page_size);
+					});
+				measure(keyset_deep, [&](pqxx::work& txn) {
+						txn.exec_prepared("keyset", chat_id, deep_timestamp, deep_id, page_size);
+					});
+				measure(offset_first, [&](pqxx::work& txn) {
+						txn.exec_prepared("offset", chat_id, page_size, 0LL);
+					});
+				measure(offset_deep, [&](pqxx::work& txn) {
+						txn.exec_prepared("offset", chat_id, page_size, deep_offset);
+					});
+			}
+
+			std::cout << "chat of " << chat_sizes[chat] << " messages: "
+			          << "keyset newest " << median_ms(keyset_first) << " ms, deep " << median_ms(keyset_deep) << " ms | "
+			          << "offset newest " << median_ms(offset_first) << " ms, deep " << median_ms(offset_deep) << " ms" << std::endl;
+		}
+
+		pqxx::work txn(connection);
+		txn.exec0("DROP TABLE IF EXISTS bench_history");
+		txn.commit();
+	} catch (const std::exception& e) {
+		std::cout << "bench_history_pagination failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
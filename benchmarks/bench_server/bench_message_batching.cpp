@@ -0,0 +1,192 @@
+#include "write_batcher.hpp"
+#include "debug.hpp"
+
+#include <pqxx/pqxx>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// messages/sec of message inserts at 1, 8 and 64 concurrent senders:
+// one transaction per message (every sender on its own connection) vs group commit through WriteBatcher
+// (multi-row insert of the batch in one transaction), runs on its own bench_messages table
+// `simulate` instead of a connection string replaces postgres with a model of it:
+// every commit is one WAL flush of SIMULATED_COMMIT_LATENCY and flushes are serialized, rows cost SIMULATED_ROW_COST
+//
+// usage: bench_message_batching <connection_string|simulate> [messages_per_sender] [window_us] [max_size]
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr auto SIMULATED_COMMIT_LATENCY = std::chrono::microseconds(1000);
+static constexpr auto SIMULATED_ROW_COST = std::chrono::microseconds(2);
+
+struct Message {
+	int _sender_id;
+	int _receiver_id;
+};
+
+class Database {
+public:
+	explicit Database(const std::string& connection_string) : _connection_string(connection_string) {
+		if (simulated()) {
+			return;
+		}
+
+		pqxx::connection connection(_connection_string);
+		pqxx::work txn(connection);
+		txn.exec0("CREATE TABLE IF NOT EXISTS bench_messages ("
+		          "id SERIAL PRIMARY KEY, sender_id INT NOT NULL, receiver_id INT NOT NULL, "
+		          "created_timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP)");
+		txn.commit();
+	}
+
+	~Database() {
+		if (simulated()) {
+			return;
+		}
+
+		try {
+			pqxx::connection connection(_connection_string);
+			pqxx::work txn(connection);
+			txn.exec0("DROP TABLE IF EXISTS bench_messages");
+			txn.commit();
+		} catch (const std::exception& e) {
+			ERROR_MSG("[bench_message_batching] " + std::string(e.what()));
+		}
+	}
+
+	bool simulated() const {
+		return _connection_string == "simulate";
+	}
+
+	std::unique_ptr<pqxx::connection> connect() const {
+		if (simulated()) {
+			return nullptr;
+		}
+
+		auto connection = std::make_unique<pqxx::connection>(_connection_string);
+		connection->prepare("insert_one", "INSERT INTO bench_messages (sender_id, receiver_id) VALUES ($1, $2) RETURNING id");
+		connection->prepare("reserve_ids", "SELECT nextval('bench_messages_id_seq')::int FROM generate_series(1, $1)");
+		connection->prepare("insert_batch", "INSERT INTO bench_messages (id, sender_id, receiver_id) "
+		                    "SELECT * FROM unnest($1::int[], $2::int[], $3::int[])");
+		return connection;
+	}
+
+	int insert_one(pqxx::connection* connection, const Message& message) {
+		if (simulated()) {
+			simulate_commit(1);
+			return ++_simulated_id;
+		}
+
+		pqxx::work txn(*connection);
+		pqxx::result r = txn.exec_prepared("insert_one", message._sender_id, message._receiver_id);
+		txn.commit();
+		return r[0][0].as<int>();
+	}
+
+	std::vector<int> insert_batch(pqxx::connection* connection, const std::vector<Message>& messages) {
+		std::vector<int> ids;
+		if (simulated()) {
+			simulate_commit(messages.size());
+			for (size_t i = 0; i < messages.size(); ++i) {
+				ids.push_back(++_simulated_id);
+			}
+			return ids;
+		}
+
+		pqxx::work txn(*connection);
+		pqxx::result reserved = txn.exec_prepared("reserve_ids", static_cast<int>(messages.size()));
+		std::vector<int> sender_ids;
+		std::vector<int> receiver_ids;
+		for (size_t i = 0; i < messages.size(); ++i) {
+			ids.push_back(reserved[i][0].as<int>());
+			sender_ids.push_back(messages[i]._sender_id);
+			receiver_ids.push_back(messages[i]._receiver_id);
+		}
+		txn.exec_prepared0("insert_batch", ids, sender_ids, receiver_ids);
+		txn.commit();
+		return ids;
+	}
+
+private:
+	void simulate_commit(size_t rows) {
+		std::this_thread::sleep_for(SIMULATED_ROW_COST * rows);
+		std::lock_guard<std::mutex> lock(_wal_mutex);
+		std::this_thread::sleep_for(SIMULATED_COMMIT_LATENCY);
+	}
+
+	std::string _connection_string;
+	std::mutex _wal_mutex;
+	std::atomic<int> _simulated_id {0};
+};
+
+template<typename Send>
+double run_senders(size_t senders_count, size_t messages_per_sender, Send send) {
+	std::vector<std::thread> senders;
+	auto start = clock_type::now();
+
+	for (size_t s = 0; s < senders_count; ++s) {
+		senders.emplace_back([&send, s, messages_per_sender]() {
+			send(s, messages_per_sender);
+		});
+	}
+	for (auto& sender : senders) {
+		sender.join();
+	}
+
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	return senders_count * messages_per_sender / seconds;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <connection_string|simulate> [messages_per_sender] [window_us] [max_size]" << std::endl;
+		return 1;
+	}
+
+	const size_t messages_per_sender = argc > 2 ? std::stoul(argv[2]) : 500;
+	const auto window = std::chrono::microseconds(argc > 3 ? std::stoul(argv[3]) : 300);
+	const size_t max_size = argc > 4 ? std::stoul(argv[4]) : 128;
+
+	try {
+		Database database(argv[1]);
+		INFO_MSG("[bench_message_batching] " + std::to_string(messages_per_sender) + " messages per sender, window "
+		         + std::to_string(window.count()) + " us, max batch " + std::to_string(max_size));
+
+		for (size_t senders_count : {1, 8, 64}) {
+			double unbatched = run_senders(senders_count, messages_per_sender, [&database](size_t s, size_t count) {
+					auto connection = database.connect();
+					for (size_t i = 0; i < count; ++i) {
+						database.insert_one(connection.get(), {static_cast<int>(s), static_cast<int>(i)});
+					}
+				});
+
+			auto batch_connection = database.connect();
+			double batched = 0.0;
+			{
+				server::WriteBatcher<Message, int> batcher("bench", window, max_size, [&](const std::vector<Message>& messages) {
+						return database.insert_batch(batch_connection.get(), messages);
+					});
+
+				batched = run_senders(senders_count, messages_per_sender, [&batcher](size_t s, size_t count) {
+						for (size_t i = 0; i < count; ++i) {
+							batcher.submit({static_cast<int>(s), static_cast<int>(i)}).get();
+						}
+					});
+			}
+
+			std::cout << "senders: " << senders_count
+			          << ", one transaction per message: " << unbatched << " msg/s"
+			          << ", group commit: " << batched << " msg/s" << std::endl;
+		}
+	} catch (const std::exception& e) {
+		ERROR_MSG("[bench_message_batching] " + std::string(e.what()));
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "debug.hpp"
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// latency on the monthly partitioned messages table loaded by database/generate_messages.sql (100M rows by default):
+// single message insert, history pages with and without the created_timestamp bound that prunes partitions,
+// lookups by id with and without the time window taken from the snowflake id
+// inserts are rolled back, the loaded data stays as it is
+//
+// usage: bench_message_partitions <connection_string> [repeats] [page_size]
+
+using clock_type = std::chrono::steady_clock;
+
+// SnowflakeIdGenerator layout: milliseconds since 2024-01-01 in the upper bits, 22 bits of node id and sequence
+static constexpr long long EPOCH_MS = 1704067200000LL;
+static constexpr int TIMESTAMP_SHIFT = 22;
+
+static const std::string HISTORY_PRUNED_SQL =
+	"SELECT id, created_timestamp FROM messages WHERE chat_id = $1 AND created_timestamp <= $2::timestamptz "
+	"AND (created_timestamp, id) < ($2::timestamptz, $3::bigint) ORDER BY created_timestamp DESC, id DESC LIMIT $4";
+static const std::string HISTORY_UNBOUNDED_SQL =
+	"SELECT id, created_timestamp FROM messages WHERE chat_id = $1 "
+	"AND (created_timestamp, id) < ($2::timestamptz, $3::bigint) ORDER BY created_timestamp DESC, id DESC LIMIT $4";
+static const std::string BY_ID_PRUNED_SQL =
+	"SELECT id, sender_id, receiver_id FROM messages WHERE id = $1 "
+	"AND created_timestamp >= $2::timestamptz AND created_timestamp < $3::timestamptz";
+static const std::string BY_ID_UNBOUNDED_SQL =
+	"SELECT id, sender_id, receiver_id FROM messages WHERE id = $1";
+static const std::string INSERT_SQL =
+	"INSERT INTO messages (id, chat_id, sender_id, receiver_id, created_timestamp) VALUES ($1, $2, $3, $4, $5::timestamptz)";
+
+static double median_ms(std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	return samples.empty() ? 0.0 : samples[samples.size() / 2];
+}
+
+static double p99_ms(std::vector<double> samples) {
+	std::sort(samples.begin(), samples.end());
+	return samples.empty() ? 0.0 : samples[samples.size() * 99 / 100];
+}
+
+static std::string format_utc(long long epoch_ms) {
+	std::time_t seconds = static_cast<std::time_t>(epoch_ms / 1000);
+	char buffer[32];
+	std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::gmtime(&seconds));
+	return std::string(buffer) + "." + std::to_string(1000 + epoch_ms % 1000).substr(1) + "+00";
+}
+
+static long long id_epoch_ms(long long id) {
+	return (id >> TIMESTAMP_SHIFT) + EPOCH_MS;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <connection_string> [repeats] [page_size]" << std::endl;
+		return 1;
+	}
+
+	const size_t repeats = argc > 2 ? std::stoul(argv[2]) : 200;
+	const long long page_size = argc > 3 ? std::stoll(argv[3]) : 50;
+
+	try {
+		pqxx::connection connection(argv[1]);
+		connection.prepare("history_pruned", HISTORY_PRUNED_SQL);
+		connection.prepare("history_unbounded", HISTORY_UNBOUNDED_SQL);
+		connection.prepare("by_id_pruned", BY_ID_PRUNED_SQL);
+		connection.prepare("by_id_unbounded", BY_ID_UNBOUNDED_SQL);
+		connection.prepare("insert", INSERT_SQL);
+
+		int chat_id = 0;
+		long long partitions = 0;
+		std::vector<long long> sample_ids;
+		std::string deep_timestamp;
+		long long deep_id = 0;
+		{
+			pqxx::work txn(connection);
+			partitions = txn.exec("SELECT count(*) FROM pg_inherits WHERE inhparent = 'messages'::regclass")[0][0].as<long long>();
+			pqxx::result chat = txn.exec("SELECT id FROM chats WHERE user1_id = 1 AND user2_id = 2");
+			if (!chat.empty()) {
+				chat_id = chat[0][0].as<int>();
+			}
+			for (const auto& row : txn.exec_params("SELECT id FROM messages TABLESAMPLE SYSTEM (0.01) LIMIT $1", static_cast<long long>(repeats))) {
+				sample_ids.push_back(row[0].as<long long>());
+			}
+			// cursor half a year back, as reached by scrolling the history
+			pqxx::result r = txn.exec_params("SELECT created_timestamp, id FROM messages WHERE chat_id = $1 "
+			                                 "AND created_timestamp < now() - INTERVAL '6 months' "
+			                                 "ORDER BY created_timestamp DESC, id DESC LIMIT 1", chat_id);
+			if (!r.empty()) {
+				deep_timestamp = r[0][0].c_str();
+				deep_id = r[0][1].as<long long>();
+			}
+			txn.commit();
+		}
+		if (chat_id == 0 || sample_ids.empty() || deep_timestamp.empty()) {
+			std::cout << "messages table is empty or too short, load it with database/generate_messages.sql first" << std::endl;
+			return 1;
+		}
+
+		std::vector<double> insert, newest_pruned, newest_unbounded, deep_pruned, deep_unbounded, by_id_pruned, by_id_unbounded;
+		auto measure = [&connection](std::vector<double>& samples, auto run, bool commit = true) {
+				pqxx::work txn(connection);
+				auto start = clock_type::now();
+				run(txn);
+				samples.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - start).count());
+				if (commit) {
+					txn.commit();
+				}
+			};
+
+		for (size_t i = 0; i < repeats; ++i) {
+			long long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			long long new_id = (now_ms - EPOCH_MS) << TIMESTAMP_SHIFT | static_cast<long long>(i & 4095);
+			measure(insert, [&](pqxx::work& txn) {
+					txn.exec_prepared0("insert", new_id, chat_id, 1, 2, format_utc(now_ms));
+				}, false);
+
+			measure(newest_pruned, [&](pqxx::work& txn) {
+					txn.exec_prepared("history_pruned", chat_id, std::string("infinity"), std::numeric_limits<long long>::max(), page_size);
+				});
+			measure(newest_unbounded, [&](pqxx::work& txn) {
+					txn.exec_prepared("history_unbounded", chat_id, std::string("infinity"), std::numeric_limits<long long>::max(), page_size);
+				});
+			measure(deep_pruned, [&](pqxx::work& txn) {
+					txn.exec_prepared("history_pruned", chat_id, deep_timestamp, deep_id, page_size);
+				});
+			measure(deep_unbounded, [&](pqxx::work& txn) {
+					txn.exec_prepared("history_unbounded", chat_id, deep_timestamp, deep_id, page_size);
+				});
+
+			long long id = sample_ids[i % sample_ids.size()];
+			long long id_ms = id_epoch_ms(id);
+			measure(by_id_pruned, [&](pqxx::work& txn) {
+					txn.exec_prepared("by_id_pruned", id, format_utc(id_ms - 86400000LL), format_utc(id_ms + 86400000LL));
+				});
+			measure(by_id_unbounded, [&](pqxx::work& txn) {
+					txn.exec_prepared("by_id_unbounded", id);
+				});
+		}
+
+		auto report = [](const std::string& name, const std::vector<double>& samples) {
+				std::cout << name << ": median " << median_ms(samples) << " ms, p99 " << p99_ms(samples) << " ms" << std::endl;
+			};
+
+		std::cout << partitions << " partitions, chat " << chat_id << ", page size " << page_size << ", " << repeats << " runs" << std::endl;
+		report("insert (rolled back)            ", insert);
+		report("history newest, pruned          ", newest_pruned);
+		report("history newest, all partitions  ", newest_unbounded);
+		report("history 6 months back, pruned   ", deep_pruned);
+		report("history 6 months back, all      ", deep_unbounded);
+		report("by id, time window from the id  ", by_id_pruned);
+		report("by id, all partitions           ", by_id_unbounded);
+	} catch (const std::exception& e) {
+		std::cout << "bench_message_partitions failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
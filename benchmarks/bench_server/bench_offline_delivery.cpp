@@ -0,0 +1,96 @@
+#include "message.hpp"
+#include "message_text_repository.hpp"
+#include "snowflake_id_generator.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// time-to-inbox of an offline user with N queued messages: everything the server does after authorize
+// (reading the queue from redis, assembling the pushes and trimming what was sent), one message per read and frame
+// vs batched reads coalesced into receive_msgs pushes as in RequestHandler::deliver_offline_messages
+// use an empty redis db, the queue of user BENCH_USER_ID is overwritten
+//
+// usage: bench_offline_delivery <connection_string> [queued_messages] [batch_size]
+
+using clock_type = std::chrono::steady_clock;
+
+static constexpr int BENCH_USER_ID = 1000000;
+// server::OfflineQueueConfig::_delivery_batch_max_bytes default
+static constexpr size_t MAX_BATCH_BYTES = 1024 * 1024;
+
+struct Delivery {
+	double _ms = 0.0;
+	size_t _messages = 0;
+	size_t _frames = 0;
+	size_t _bytes = 0;
+};
+
+static void fill_queue(server::MessageTextRepository& repository, size_t count) {
+	server::SnowflakeIdGenerator id_generator(0);
+	for (size_t i = 0; i < count; ++i) {
+		common::Message message(1, BENCH_USER_ID, "queued message number " + std::to_string(i));
+		message.set_id(id_generator.next_id());
+		repository.push_pending(BENCH_USER_ID, message.to_json().dump());
+	}
+}
+
+static Delivery deliver(server::MessageTextRepository& repository, size_t batch_size) {
+	Delivery delivery;
+	auto start = clock_type::now();
+
+	while (true) {
+		std::vector<std::string> messages = repository.peek_pending(BENCH_USER_ID, batch_size, MAX_BATCH_BYTES);
+		if (messages.empty()) {
+			break;
+		}
+
+		std::string push = R"({"type":"receive_msgs","messages":[)";
+		for (size_t i = 0; i < messages.size(); ++i) {
+			if (i > 0) {
+				push += ',';
+			}
+			push += messages[i];
+		}
+		push += "]}";
+
+		if (!repository.remove_pending(BENCH_USER_ID, messages.size())) {
+			break;
+		}
+		delivery._messages += messages.size();
+		delivery._frames += 1;
+		delivery._bytes += push.size();
+	}
+
+	delivery._ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+	return delivery;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <connection_string> [queued_messages] [batch_size]" << std::endl;
+		return 1;
+	}
+
+	const size_t queued_messages = argc > 2 ? std::stoul(argv[2]) : 10000;
+	const size_t batch_size = argc > 3 ? std::stoul(argv[3]) : 1000;
+
+	try {
+		server::MessageTextRepository repository(argv[1]);
+		std::cout << "queued messages: " << queued_messages << std::endl;
+
+		for (size_t size : {size_t(1), batch_size}) {
+			fill_queue(repository, queued_messages);
+			Delivery delivery = deliver(repository, size);
+			std::cout << "batch " << size << ": " << delivery._ms << " ms, "
+			          << delivery._messages << " messages in " << delivery._frames << " frames, "
+			          << delivery._bytes / 1024 << " KiB" << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cout << "bench_offline_delivery failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
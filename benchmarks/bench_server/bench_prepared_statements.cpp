@@ -0,0 +1,106 @@
+#include "debug.hpp"
+
+#include <pqxx/pqxx>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// latency of the hot repository lookups with sql text (exec_params, SELECT *) vs named prepared statements
+// (exec_prepared, explicit columns), runs against a local postgres on a temporary copy of the users table
+//
+// usage: bench_prepared_statements <connection_string> [iterations] [users_count]
+
+using clock_type = std::chrono::steady_clock;
+
+static void report(const std::string& name, std::vector<double>& latencies) {
+	std::sort(latencies.begin(), latencies.end());
+	double sum = 0.0;
+	for (double latency : latencies) {
+		sum += latency;
+	}
+
+	auto percentile = [&latencies](double p) {
+		return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+	};
+
+	std::cout << name << " us mean: " << sum / latencies.size()
+	          << ", p50: " << percentile(0.50)
+	          << ", p99: " << percentile(0.99) << std::endl;
+}
+
+static std::vector<double> measure(size_t iterations, const std::function<void(size_t)>& query) {
+	std::vector<double> latencies;
+	latencies.reserve(iterations);
+	for (size_t i = 0; i < iterations; ++i) {
+		auto start = clock_type::now();
+		query(i);
+		latencies.push_back(std::chrono::duration<double, std::micro>(clock_type::now() - start).count());
+	}
+	return latencies;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::cout << "usage: " << argv[0] << " <connection_string> [iterations] [users_count]" << std::endl;
+		return 1;
+	}
+
+	const size_t iterations = argc > 2 ? std::stoul(argv[2]) : 20000;
+	const size_t users_count = argc > 3 ? std::stoul(argv[3]) : 10000;
+
+	try {
+		pqxx::connection connection(argv[1]);
+
+		{
+			pqxx::work txn(connection);
+			txn.exec0("CREATE TEMP TABLE bench_users (LIKE users INCLUDING ALL)");
+			txn.exec_params0("INSERT INTO bench_users (nickname, password) "
+			                 "SELECT 'user_' || i, 'pass_' || i FROM generate_series(1, $1) AS i", static_cast<long>(users_count));
+			txn.exec0("ANALYZE bench_users");
+			txn.commit();
+		}
+
+		connection.prepare("bench_select_id_by_nickname", "SELECT id FROM bench_users WHERE nickname = $1");
+		connection.prepare("bench_select_by_id",
+		                   "SELECT id, nickname, password, registered_timestamp, last_online_timestamp, is_online FROM bench_users WHERE id = $1");
+
+		auto nickname = [users_count](size_t i) {
+				return "user_" + std::to_string(i % users_count + 1);
+			};
+		auto id = [users_count](size_t i) {
+				return static_cast<int>(i % users_count + 1);
+			};
+
+		INFO_MSG("[bench_prepared_statements] " + std::to_string(iterations) + " iterations over " + std::to_string(users_count) + " users");
+
+		auto get_id_text = measure(iterations, [&](size_t i) {
+				pqxx::work txn(connection);
+				txn.exec_params("SELECT * FROM bench_users WHERE nickname = $1", nickname(i));
+			});
+		auto get_id_prepared = measure(iterations, [&](size_t i) {
+				pqxx::work txn(connection);
+				txn.exec_prepared("bench_select_id_by_nickname", nickname(i));
+			});
+		auto read_text = measure(iterations, [&](size_t i) {
+				pqxx::work txn(connection);
+				txn.exec_params("SELECT * FROM bench_users WHERE id = $1", id(i));
+			});
+		auto read_prepared = measure(iterations, [&](size_t i) {
+				pqxx::work txn(connection);
+				txn.exec_prepared("bench_select_by_id", id(i));
+			});
+
+		report("get_id exec_params  ", get_id_text);
+		report("get_id exec_prepared", get_id_prepared);
+		report("read exec_params    ", read_text);
+		report("read exec_prepared  ", read_prepared);
+	} catch (const std::exception& e) {
+		ERROR_MSG("[bench_prepared_statements] " + std::string(e.what()));
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "user_metadata_repository.hpp"
+#include "lru_cache.hpp"
+#include "crypto_utils.hpp"
+
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// get_user_keys throughput after the database row is read: the previous path parses both hex keys into cpp_int
+// and encodes them back to hex for every fetch, the cached path is one lookup of the already encoded keys
+// the database query itself is not included, without the cache every fetch also paid it
+//
+// usage: bench_public_keys_cache [fetches_per_thread] [users_count] [key_bits]
+
+using clock_type = std::chrono::steady_clock;
+
+struct KeysRow {
+	std::string _dsa_public_key;
+	std::string _el_gamal_public_key;
+};
+
+static std::string random_hex(std::mt19937_64& rng, size_t bits) {
+	static const char digits[] = "0123456789abcdef";
+	std::string hex(bits / 4, '0');
+	for (auto& digit : hex) {
+		digit = digits[rng() % 16];
+	}
+	hex[0] = digits[1 + rng() % 15];
+	return hex;
+}
+
+template<typename Fetch>
+double run(size_t threads_count, size_t fetches_per_thread, Fetch fetch) {
+	std::vector<std::thread> threads;
+	auto start = clock_type::now();
+
+	for (size_t t = 0; t < threads_count; ++t) {
+		threads.emplace_back([&fetch, fetches_per_thread, t]() {
+			size_t bytes = 0;
+			for (size_t i = 0; i < fetches_per_thread; ++i) {
+				bytes += fetch(t * 7919 + i).size();
+			}
+			if (bytes == 0) {
+				std::cout << "empty responses" << std::endl;
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+	return threads_count * fetches_per_thread / seconds;
+}
+
+int main(int argc, char* argv[]) {
+	const size_t fetches_per_thread = argc > 1 ? std::stoul(argv[1]) : 20000;
+	const size_t users_count = argc > 2 ? std::stoul(argv[2]) : 1000;
+	const size_t key_bits = argc > 3 ? std::stoul(argv[3]) : 2048;
+
+	std::mt19937_64 rng(42);
+	std::vector<KeysRow> rows;
+	for (size_t i = 0; i < users_count; ++i) {
+		rows.push_back({random_hex(rng, key_bits), random_hex(rng, key_bits)});
+	}
+
+	server::LruCache<int, server::EncodedPublicKeysPtr> cache(users_count * 2);
+	for (size_t i = 0; i < users_count; ++i) {
+		crypto::UserCryptoKeys keys(crypto::hex_to_cpp_int(rows[i]._dsa_public_key), crypto::hex_to_cpp_int(rows[i]._el_gamal_public_key), crypto::cpp_int(-1));
+		auto encoded_keys = std::make_shared<server::EncodedPublicKeys>();
+		encoded_keys->_keys = keys;
+		encoded_keys->_dsa_public_key_hex = crypto::cpp_int_to_hex(keys.get_dsa_public_key());
+		encoded_keys->_el_gamal_public_key_hex = crypto::cpp_int_to_hex(keys.get_el_gamal_public_key());
+		cache.put(static_cast<int>(i), encoded_keys);
+	}
+
+	auto uncached_fetch = [&rows, users_count](size_t i) {
+			const KeysRow& row = rows[i % users_count];
+			nlohmann::json json;
+			json["dsa_public_key"] = row._dsa_public_key;
+			json["el_gamal_public_key"] = row._el_gamal_public_key;
+
+			crypto::UserCryptoKeys keys(crypto::hex_to_cpp_int(json["dsa_public_key"].get<std::string>()),
+			                            crypto::hex_to_cpp_int(json["el_gamal_public_key"].get<std::string>()),
+			                            crypto::cpp_int(-1));
+
+			nlohmann::json response;
+			response["status"] = "success";
+			response["user_id"] = static_cast<int>(i % users_count);
+			response["dsa_public_key"] = crypto::cpp_int_to_hex(keys.get_dsa_public_key());
+			response["el_gamal_public_key"] = crypto::cpp_int_to_hex(keys.get_el_gamal_public_key());
+			return response.dump();
+		};
+
+	auto cached_fetch = [&cache, users_count](size_t i) {
+			int user_id = static_cast<int>(i % users_count);
+			auto encoded_keys = *cache.get(user_id);
+
+			nlohmann::json response;
+			response["status"] = "success";
+			response["user_id"] = user_id;
+			response["dsa_public_key"] = encoded_keys->_dsa_public_key_hex;
+			response["el_gamal_public_key"] = encoded_keys->_el_gamal_public_key_hex;
+			return response.dump();
+		};
+
+	std::cout << "users: " << users_count << ", key bits: " << key_bits << std::endl;
+	size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t threads_count : {size_t(1), max_threads}) {
+		double uncached = run(threads_count, fetches_per_thread, uncached_fetch);
+		double cached = run(threads_count, fetches_per_thread, cached_fetch);
+		std::cout << "threads: " << threads_count
+		          << ", parse and encode: " << uncached << " fetches/s"
+		          << ", cache: " << cached << " fetches/s" << std::endl;
+		if (max_threads == 1) {
+			break;
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
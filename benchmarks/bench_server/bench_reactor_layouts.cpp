@@ -0,0 +1,143 @@
+#include "debug.hpp"
+
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// connections/sec and messages/sec against a running chat server,
+// start the server once with ReactorMode::SHARED and once with ReactorMode::PER_CORE
+// (same _thread_pool_size) and compare the two runs
+//
+// connections/sec: connect, one request, one response, close, `parallel` of them in flight
+// messages/sec: `parallel` persistent connections send a request and wait for its response for `seconds`
+//
+// usage: bench_reactor_layouts <host> <port> [parallel] [seconds] [client_threads]
+
+using tcp = boost::asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+static const std::string DELIMITER = "\r\n\r\n";
+
+class Worker : public std::enable_shared_from_this<Worker> {
+public:
+	Worker(boost::asio::io_context& io_context, const tcp::resolver::results_type& endpoints, bool reconnect,
+	       const clock_type::time_point& deadline, std::atomic<size_t>& completed)
+		: _socket(io_context),
+		_endpoints(endpoints),
+		_reconnect(reconnect),
+		_deadline(deadline),
+		_completed(completed),
+		_request(nlohmann::json({{"type", "ping"}}).dump() + DELIMITER) {
+	}
+
+	void start() {
+		boost::asio::async_connect(_socket, _endpoints,
+		                           [self = shared_from_this()](const boost::system::error_code& ec, const tcp::endpoint&) {
+				if (!ec) {
+					self->round_trip();
+				}
+			});
+	}
+
+private:
+	void round_trip() {
+		boost::asio::async_write(_socket, boost::asio::buffer(_request),
+		                         [self = shared_from_this()](const boost::system::error_code& ec, size_t) {
+				if (ec) {
+					return;
+				}
+				boost::asio::async_read_until(self->_socket, self->_buffer, DELIMITER,
+				                              [self](const boost::system::error_code& ec, size_t bytes_transferred) {
+					if (ec) {
+						return;
+					}
+					self->_buffer.consume(bytes_transferred);
+					++self->_completed;
+					self->next();
+				});
+			});
+	}
+
+	void next() {
+		if (clock_type::now() >= _deadline) {
+			return;
+		}
+
+		if (_reconnect) {
+			boost::system::error_code ec;
+			_socket.close(ec);
+			_buffer.consume(_buffer.size());
+			start();
+		} else {
+			round_trip();
+		}
+	}
+
+	tcp::socket _socket;
+	tcp::resolver::results_type _endpoints;
+	bool _reconnect;
+	clock_type::time_point _deadline;
+	std::atomic<size_t>& _completed;
+	boost::asio::streambuf _buffer;
+	std::string _request;
+};
+
+double run_phase(const std::string& host, const std::string& port, bool reconnect, size_t parallel, size_t seconds, size_t client_threads) {
+	std::vector<std::unique_ptr<boost::asio::io_context> > io_contexts;
+	std::atomic<size_t> completed(0);
+	auto deadline = clock_type::now() + std::chrono::seconds(seconds);
+
+	for (size_t i = 0; i < client_threads; ++i) {
+		io_contexts.push_back(std::make_unique<boost::asio::io_context>());
+	}
+
+	tcp::resolver resolver(*io_contexts.front());
+	auto endpoints = resolver.resolve(host, port);
+
+	for (size_t i = 0; i < parallel; ++i) {
+		std::make_shared<Worker>(*io_contexts[i % client_threads], endpoints, reconnect, deadline, completed)->start();
+	}
+
+	auto start = clock_type::now();
+	std::vector<std::thread> threads;
+	for (auto& io_context : io_contexts) {
+		threads.emplace_back([&io_context, deadline]() {
+			io_context->run_until(deadline);
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+	return completed / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::cout << "usage: " << argv[0] << " <host> <port> [parallel] [seconds] [client_threads]" << std::endl;
+		return 1;
+	}
+
+	const std::string host = argv[1];
+	const std::string port = argv[2];
+	const size_t parallel = argc > 3 ? std::stoul(argv[3]) : 64;
+	const size_t seconds = argc > 4 ? std::stoul(argv[4]) : 5;
+	const size_t client_threads = std::max<size_t>(1, argc > 5 ? std::stoul(argv[5]) : std::thread::hardware_concurrency());
+
+	INFO_MSG("[bench_reactor_layouts] " + std::to_string(parallel) + " in flight, " + std::to_string(seconds) + " s per phase, "
+	         + std::to_string(client_threads) + " client threads");
+
+	double connections_per_second = run_phase(host, port, true, parallel, seconds, client_threads);
+	std::cout << "connections/sec: " << connections_per_second << std::endl;
+
+	double messages_per_second = run_phase(host, port, false, parallel, seconds, client_threads);
+	std::cout << "messages/sec: " << messages_per_second << std::endl;
+
+	return 0;
+}
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "hybrid_crypto_system.hpp"
 #include "user_crypto_keys.hpp"
 #include "sha256.hpp"
+#include "frame.hpp"
 
 #include <iostream>
 #include <string>
@@ -19,6 +20,8 @@
 #include <nlohmann/json.hpp>
 #include <filesystem>
 #include <random>
+#include <atomic>
+#include <array>
 
 namespace client {
 
@@ -39,6 +42,8 @@ private:
 	void inline show_actions();
 	std::string read_user_text() const noexcept;
 	std::string receive_response();
+	std::string frame_request(const std::string& message, const std::string& binary_payload = "");
+	void negotiate_framing(common::FramingMode framing);
 	std::string get_user_data_filename() const noexcept;
 	void send_file_chunks(const std::string& filepath);
 	void send_next_chunk(std::shared_ptr<FileTransferState> state);
@@ -46,9 +51,10 @@ private:
 
 	void handle_chunk_acknowledgment(const nlohmann::json& response);
 	void handle_incoming_file(const nlohmann::json& notification);
-	void handle_incoming_file_chunk(const nlohmann::json& chunk_message);
+	void handle_incoming_file_chunk(const nlohmann::json& chunk_message, const std::string& binary_payload);
 	void handle_receive_user_public_keys(const nlohmann::json& request);
 	void handle_receive_aes_key(const nlohmann::json& request);
+	void handle_receive_message(const nlohmann::json& message);
 
 	bool is_registered() const noexcept;
 	bool is_connected();
@@ -61,10 +67,12 @@ private:
 
 	void async_read();
 	void handle_async_read(const boost::system::error_code& error, size_t bytes_transferred);
-	void async_write(const std::string& message);
+	void handle_async_frame_header_read(const boost::system::error_code& error);
+	void handle_async_frame_payload_read(const boost::system::error_code& error, const common::FrameHeader& header);
+	void async_write(const std::string& message, const std::string& binary_payload = "");
 	void handle_async_write(const boost::system::error_code& error);
 	void do_write();
-	void process_server_message(const std::string& message);
+	void process_server_message(const std::string& message, const std::string& binary_payload = "");
 
 private:
 	struct FileTransferState {
@@ -94,6 +102,8 @@ private:
 	unsigned short _server_port;
 	common::User _user;
 	bool _is_authorized;
+	common::FramingMode _framing = common::FramingMode::JSON;
+	std::atomic<uint32_t> _next_request_id{1};
 	std::string _user_files_dir = std::string(SOURCE_DIR) + "/client/user_files";
 	std::map<std::string, std::ofstream> _incoming_files;
 	crypto::HybridCryptoSystem _hybrid_crypto_system;
@@ -44,6 +44,7 @@ void Client::run() {
 		boost::asio::ip::tcp::resolver::query query(_server_address, std::to_string(_server_port));
 		boost::asio::ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
 		boost::asio::connect(_socket, endpoint_iterator);
+		negotiate_framing(common::FramingMode::BINARY);
 
 		unsigned int thread_count = std::thread::hardware_concurrency();
 		for (unsigned int i = 0; i < thread_count; ++i) {
@@ -252,7 +253,7 @@ void Client::register_user() {
 	request["el_gamal_public_key"] = crypto::cpp_int_to_hex(_hybrid_crypto_system.get_el_gamal_public_key());
 	request["dsa_public_key"] = crypto::cpp_int_to_hex(_hybrid_crypto_system.get_dsa_public_key());
 
-	boost::asio::write(_socket, boost::asio::buffer(request.dump() + "\r\n\r\n"));
+	boost::asio::write(_socket, boost::asio::buffer(frame_request(request.dump())));
 	DEBUG_MSG("[Client::register_user] Sending request: " + request.dump());
 	nlohmann::json response = nlohmann::json::parse(receive_response());
 	DEBUG_MSG("[Client::register_user] Received response: " + response.dump());
@@ -295,7 +296,7 @@ void Client::authorize_user() {
 	DEBUG_MSG("[Client::authorize_user()] Sending request:" + request.dump());
 
 	try {
-		boost::asio::write(_socket, boost::asio::buffer(request.dump() + "\r\n\r\n"));
+		boost::asio::write(_socket, boost::asio::buffer(frame_request(request.dump())));
 		INFO_MSG("[Client::authorize_user()] Authorization request sent successfully");
 
 		nlohmann::json response = nlohmann::json::parse(receive_response());
@@ -353,7 +354,7 @@ void Client::send_aes_key(const std::string& receiver_nickname, const std::strin
 	DEBUG_MSG("[Client::send_aes_key] Sending request: " + request.dump());
 
 	try {
-		boost::asio::write(_socket, boost::asio::buffer(request.dump() + "\r\n\r\n"));
+		boost::asio::write(_socket, boost::asio::buffer(frame_request(request.dump())));
 	} catch (const std::exception& e) {
 		ERROR_MSG("[Client::send_aes_key] Exception caught: " + std::string(e.what()));
 	}
@@ -367,7 +368,7 @@ void Client::get_receiver_public_keys(const std::string& receiver_nickname) {
 	DEBUG_MSG("[Client::get_receiver_public_keys()] Sending request: " + request.dump());
 
 	try {
-		boost::asio::write(_socket, boost::asio::buffer(request.dump() + "\r\n\r\n"));
+		boost::asio::write(_socket, boost::asio::buffer(frame_request(request.dump())));
 	} catch (const std::exception& e) {
 		ERROR_MSG("[Client::get_receiver_public_keys()] Exception caught: " + std::string(e.what()));
 	}
@@ -375,7 +376,7 @@ void Client::get_receiver_public_keys(const std::string& receiver_nickname) {
 
 void Client::send_message(const std::string& message) {
 	DEBUG_MSG("send_message" + common::get_socket_info(_socket));
-	boost::asio::write(_socket, boost::asio::buffer(message + "\r\n\r\n"));
+	boost::asio::write(_socket, boost::asio::buffer(frame_request(message)));
 }
 
 void Client::send_file_chunks(const std::string& filepath) {
@@ -387,6 +388,8 @@ void Client::send_file_chunks(const std::string& filepath) {
 
 	const size_t chunk_size = 512;
 	std::vector<char> buffer(chunk_size);
+	std::error_code ec;
+	uint64_t file_size = std::filesystem::file_size(filepath, ec);
 	// get file size -> calculate the amount of chunk mark the chunk as the last when chunk_number is 0???
 	size_t chunk_number = 1;
 	size_t total_bytes_sent = 0;
@@ -407,15 +410,26 @@ void Client::send_file_chunks(const std::string& filepath) {
 		nlohmann::json file_chunk_request;
 		file_chunk_request["type"] = "file_chunk";
 		file_chunk_request["filename"] = std::filesystem::path(filepath).filename().string();
-		file_chunk_request["chunk_data"] = std::string(buffer.data(), bytes_read);
 		file_chunk_request["chunk_number"] = chunk_number;
 		file_chunk_request["is_last"] = is_last;
+		// chunks at their offsets are accepted in any order by the server
+		if (!ec) {
+			file_chunk_request["offset"] = total_bytes_sent - bytes_read;
+			file_chunk_request["file_size"] = file_size;
+		}
+
+		std::string binary_payload;
+		if (_framing == common::FramingMode::BINARY) {
+			binary_payload.assign(buffer.data(), bytes_read);
+		} else {
+			file_chunk_request["chunk_data"] = std::string(buffer.data(), bytes_read);
+		}
 
 		DEBUG_MSG("[Client::send_file_chunks] Sending chunk " + std::to_string(chunk_number) +
 		          " (bytes: " + std::to_string(bytes_read) +
 		          ", is_last: " + (is_last ? "true" : "false") + ")");
 
-		async_write(file_chunk_request.dump());
+		async_write(file_chunk_request.dump(), binary_payload);
 
 		{
 			std::unique_lock<std::mutex> lock(_mutex);
@@ -456,13 +470,19 @@ void Client::send_next_chunk(std::shared_ptr<FileTransferState> state) {
 	nlohmann::json chunk_request;
 	chunk_request["type"] = "file_chunk";
 	chunk_request["filename"] = state->filename;
-	chunk_request["chunk_data"] = std::string(state->buffer.data(), bytes_read);
 	chunk_request["chunk_number"] = state->chunk_number + 1;
 	chunk_request["is_last"] = state->file.eof();
 
+	std::string binary_payload;
+	if (_framing == common::FramingMode::BINARY) {
+		binary_payload.assign(state->buffer.data(), bytes_read);
+	} else {
+		chunk_request["chunk_data"] = std::string(state->buffer.data(), bytes_read);
+	}
+
 	DEBUG_MSG("[Client::send_next_chunk] Sending chunk " + std::to_string(state->chunk_number + 1));
 
-	async_write(chunk_request.dump());
+	async_write(chunk_request.dump(), binary_payload);
 	wait_for_chunk_ack(state);
 }
 
@@ -486,6 +506,16 @@ void Client::wait_for_chunk_ack(std::shared_ptr<FileTransferState> state) {
 void Client::async_read() {
 	DEBUG_MSG("[Client::async_read] Async read has been started");
 
+	if (_framing == common::FramingMode::BINARY) {
+		_io_service.post([this]() {
+				boost::asio::async_read(_socket, _read_buffer,
+				                        boost::asio::transfer_exactly(common::FRAME_HEADER_SIZE - _read_buffer.size()),
+				                        boost::bind(&Client::handle_async_frame_header_read, this,
+				                                    boost::asio::placeholders::error));
+			});
+		return;
+	}
+
 	_io_service.post([this]() {
 			boost::asio::async_read_until(_socket, _read_buffer, "\r\n\r\n",
 			                              boost::bind(&Client::handle_async_read, this,
@@ -513,7 +543,46 @@ void Client::handle_async_read(const boost::system::error_code& error, size_t by
 	}
 }
 
-void Client::async_write(const std::string& message) {
+void Client::handle_async_frame_header_read(const boost::system::error_code& error) {
+	if (error) {
+		ERROR_MSG("[Client::handle_async_frame_header_read] " + error.message());
+		return;
+	}
+
+	std::string raw_header(boost::asio::buffers_begin(_read_buffer.data()),
+	                       boost::asio::buffers_begin(_read_buffer.data()) + common::FRAME_HEADER_SIZE);
+	_read_buffer.consume(common::FRAME_HEADER_SIZE);
+
+	try {
+		common::FrameHeader header = common::decode_frame_header(raw_header.data());
+		boost::asio::async_read(_socket, _read_buffer,
+		                        boost::asio::transfer_exactly(header.payload_length - _read_buffer.size()),
+		                        [this, header](const boost::system::error_code& error, size_t) {
+				handle_async_frame_payload_read(error, header);
+			});
+	} catch (const std::exception& e) {
+		ERROR_MSG("[Client::handle_async_frame_header_read] " + std::string(e.what()));
+	}
+}
+
+void Client::handle_async_frame_payload_read(const boost::system::error_code& error, const common::FrameHeader& header) {
+	if (error) {
+		ERROR_MSG("[Client::handle_async_frame_payload_read] " + error.message());
+		return;
+	}
+
+	auto payload_begin = boost::asio::buffers_begin(_read_buffer.data());
+	std::string message(payload_begin, payload_begin + header.json_length);
+	std::string binary_payload(payload_begin + header.json_length, payload_begin + header.payload_length);
+	_read_buffer.consume(header.payload_length);
+	DEBUG_MSG("[Client::handle_async_frame_payload_read] Read: " + message);
+
+	process_server_message(message, binary_payload);
+
+	async_read();
+}
+
+void Client::async_write(const std::string& message, const std::string& binary_payload) {
 	DEBUG_MSG("[Client::async_write] Tryign to write request: " + message);
 
 	if (!is_connected()) {
@@ -521,9 +590,10 @@ void Client::async_write(const std::string& message) {
 		return;
 	}
 
-	_io_service.post([this, message]() {
+	std::string data = frame_request(message, binary_payload);
+	_io_service.post([this, data]() {
 			bool write_in_progress = !_write_queue.empty();
-			_write_queue.push(message + "\r\n\r\n");
+			_write_queue.push(data);
 
 			if (!write_in_progress) {
 				do_write();
@@ -552,6 +622,21 @@ void Client::handle_async_write(const boost::system::error_code& error) {
 }
 
 std::string Client::receive_response() {
+	if (_framing == common::FramingMode::BINARY) {
+		try {
+			std::array<char, common::FRAME_HEADER_SIZE> raw_header;
+			boost::asio::read(_socket, boost::asio::buffer(raw_header));
+			common::FrameHeader header = common::decode_frame_header(raw_header.data());
+
+			std::string payload(header.payload_length, '\0');
+			boost::asio::read(_socket, boost::asio::buffer(payload));
+			return payload.substr(0, header.json_length);
+		} catch (const std::exception& e) {
+			ERROR_MSG("[Client::receive_response()] While receiving response: " + std::string(e.what()));
+			return "";
+		}
+	}
+
 	boost::asio::streambuf response_buf;
 	boost::system::error_code error;
 
@@ -570,7 +655,36 @@ std::string Client::receive_response() {
 	return response;
 }
 
-void Client::process_server_message(const std::string& message) {
+std::string Client::frame_request(const std::string& message, const std::string& binary_payload) {
+	if (_framing == common::FramingMode::BINARY) {
+		common::FrameType type = binary_payload.empty() ? common::FrameType::MESSAGE : common::FrameType::FILE_CHUNK;
+		return common::encode_frame(type, _next_request_id++, message, binary_payload);
+	}
+
+	return message + "\r\n\r\n";
+}
+
+void Client::negotiate_framing(common::FramingMode framing) {
+	nlohmann::json request;
+	request["type"] = "handshake";
+	request["framing"] = common::framing_mode_to_string(framing);
+
+	try {
+		boost::asio::write(_socket, boost::asio::buffer(request.dump() + "\r\n\r\n"));
+		nlohmann::json response = nlohmann::json::parse(receive_response());
+
+		// older servers answer with "Unknown request type" and keep using json mode
+		if (response["status"] == "success" && response.contains("framing")) {
+			_framing = common::framing_mode_from_string(response["framing"]);
+		}
+	} catch (const std::exception& e) {
+		ERROR_MSG("[Client::negotiate_framing] Handshake failed, using json framing: " + std::string(e.what()));
+	}
+
+	INFO_MSG("[Client::negotiate_framing] Framing mode: " + common::framing_mode_to_string(_framing));
+}
+
+void Client::process_server_message(const std::string& message, const std::string& binary_payload) {
 	try {
 		nlohmann::json json_message = nlohmann::json::parse(message);
 		DEBUG_MSG("[Client::process_server_message] Parsed response: " + json_message.dump());
@@ -582,17 +696,29 @@ void Client::process_server_message(const std::string& message) {
 			handle_incoming_file(json_message);
 		}
 		else if (json_message["type"] == "file_chunk") {
-			handle_incoming_file_chunk(json_message);
+			handle_incoming_file_chunk(json_message, binary_payload);
 		} else if (json_message["type"] == "receive_user_public_keys") {
 			handle_receive_user_public_keys(json_message);
 		} else if (json_message["type"] == "receive_aes_key") {
 			handle_receive_aes_key(json_message);
+		} else if (json_message["type"] == "receive_msg") {
+			handle_receive_message(json_message);
+		} else if (json_message["type"] == "receive_msgs") {
+			// messages queued while this user was offline
+			for (const auto& queued_message : json_message["messages"]) {
+				handle_receive_message(queued_message);
+			}
 		}
 	} catch (const nlohmann::json::parse_error& e) {
 		ERROR_MSG("[Client::process_server_message] Failed to parse message: " + std::string(e.what()));
 	}
 }
 
+void Client::handle_receive_message(const nlohmann::json& message) {
+	INFO_MSG("[Client::handle_receive_message] Message " + std::to_string(message["id"].get<common::MessageId>())
+	         + " from " + std::to_string(message["sender_id"].get<int>()) + ": " + message["text"].get<std::string>());
+}
+
 void Client::handle_chunk_acknowledgment(const nlohmann::json& response) {
 	if (response["status"] == "success") {
 		std::lock_guard<std::mutex> lock(_mutex);
@@ -617,9 +743,9 @@ void Client::handle_incoming_file(const nlohmann::json& notification) {
 		);
 }
 
-void Client::handle_incoming_file_chunk(const nlohmann::json& chunk_message) {
+void Client::handle_incoming_file_chunk(const nlohmann::json& chunk_message, const std::string& binary_payload) {
 	std::string filename = chunk_message["filename"];
-	std::string chunk_data = chunk_message["chunk_data"];
+	std::string chunk_data = chunk_message.contains("chunk_data") ? chunk_message["chunk_data"].get<std::string>() : binary_payload;
 	size_t chunk_number = chunk_message["chunk_number"];
 	bool is_last = chunk_message["is_last"];
 
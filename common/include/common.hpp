@@ -1,9 +1,12 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 
 namespace common {
 
 using Timestamp = std::chrono::time_point<std::chrono::system_clock>;
+// 64-bit time ordered id assigned by the server before the message is stored, see server::SnowflakeIdGenerator
+using MessageId = int64_t;
 
 }
\ No newline at end of file
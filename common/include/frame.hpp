@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace common {
+
+// binary framing, negotiated per connection with a json "handshake" request,
+// connections that never send a handshake stay in the legacy "\r\n\r\n" json mode
+//
+// header layout (network byte order):
+// | payload_length u32 | type u16 | flags u16 | request_id u32 | json_length u32 |
+// payload = json_length bytes of json, followed by payload_length - json_length raw bytes
+constexpr size_t FRAME_HEADER_SIZE = 16;
+constexpr uint32_t MAX_FRAME_PAYLOAD_BYTES = 16 * 1024 * 1024;
+constexpr char JSON_DELIMITER[] = "\r\n\r\n";
+
+enum class FramingMode {
+	JSON,
+	BINARY
+};
+
+enum class FrameType : uint16_t {
+	MESSAGE = 1,   // json request, response or push
+	FILE_CHUNK = 2 // json metadata + raw chunk bytes
+};
+
+enum FrameFlags : uint16_t {
+	FRAME_FLAG_NONE = 0,
+	FRAME_FLAG_HAS_BINARY = 1 << 0
+};
+
+struct FrameHeader {
+	uint32_t payload_length;
+	FrameType type;
+	uint16_t flags;
+	uint32_t request_id;
+	uint32_t json_length;
+};
+
+std::string encode_frame(FrameType type, uint32_t request_id, const std::string& json, const std::string& binary = "");
+// throws std::invalid_argument on unknown frame type or sizes out of bounds
+FrameHeader decode_frame_header(const char* data);
+
+std::string framing_mode_to_string(FramingMode mode);
+FramingMode framing_mode_from_string(const std::string& mode);
+
+} // namespace common
\ No newline at end of file
@@ -10,14 +10,16 @@ class Message {
 public:
 	Message() = default;
 	Message(const int& sender_id, const int& receiver_id, const std::string& text);
+	Message(const MessageMetadata& metadata, const MessageText& text);
 
 	nlohmann::json to_json() const;
 	Message from_json(const nlohmann::json& j);
-	int get_id() const;
+	MessageId get_id() const;
 	MessageText get_text() const;
 	MessageMetadata get_metadata() const;
 
-	void set_id(const int& id);
+	void set_id(const MessageId& id);
+	void set_chat_id(const int& chat_id);
 
 private:
 	MessageMetadata _metadata;
@@ -13,14 +13,14 @@ class MessageMetadata {
 public:
 	MessageMetadata() = default;
 	MessageMetadata(
-		const int& id,
+		const MessageId& id,
 		const int& sender_id,
 		const int& receiver_id,
 		const int& chat_id
 		);
 
 	bool is_deleted() const noexcept;
-	int get_id() const noexcept;
+	MessageId get_id() const noexcept;
 	int get_sender_id() const noexcept;
 	int get_receiver_id() const noexcept;
 	int get_chat_id() const noexcept;
@@ -28,7 +28,7 @@ public:
 	std::optional<Timestamp>get_deleted_timestamp() const noexcept;
 	std::optional<Timestamp>get_last_edited_timestamp() const noexcept;
 
-	void set_id(const int& msg_id) noexcept;
+	void set_id(const MessageId& msg_id) noexcept;
 	void set_sender_id(const int& t) noexcept;
 	void set_chat_id(const int& chat_if) noexcept;
 	void set_created_timestamp(const Timestamp& timestamp) noexcept;
@@ -40,7 +40,7 @@ public:
 	MessageMetadata from_json(const nlohmann::json& j);
 
 private:
-	int _id;
+	MessageId _id;
 	int _sender_id;
 	int _receiver_id;
 	int _chat_id;
@@ -8,7 +8,8 @@ enum RequstType {
 	SEND_MESSAGE,
 	GET_CHATS,
 	GET_MESSAGE,
-	GET_MESSAGES_OFFLINE // rename
+	GET_MESSAGES_OFFLINE, // rename
+	GET_HISTORY
 };
 
 } //namespace common
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "frame.hpp"
+
+#include <stdexcept>
+
+namespace common {
+
+static void write_u16(std::string& out, uint16_t value) {
+	out.push_back(static_cast<char>((value >> 8) & 0xFF));
+	out.push_back(static_cast<char>(value & 0xFF));
+}
+
+static void write_u32(std::string& out, uint32_t value) {
+	out.push_back(static_cast<char>((value >> 24) & 0xFF));
+	out.push_back(static_cast<char>((value >> 16) & 0xFF));
+	out.push_back(static_cast<char>((value >> 8) & 0xFF));
+	out.push_back(static_cast<char>(value & 0xFF));
+}
+
+static uint16_t read_u16(const char* data) {
+	const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+	return static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+}
+
+static uint32_t read_u32(const char* data) {
+	const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+	return (static_cast<uint32_t>(bytes[0]) << 24)
+	       | (static_cast<uint32_t>(bytes[1]) << 16)
+	       | (static_cast<uint32_t>(bytes[2]) << 8)
+	       | static_cast<uint32_t>(bytes[3]);
+}
+
+std::string encode_frame(FrameType type, uint32_t request_id, const std::string& json, const std::string& binary) {
+	size_t payload_length = json.size() + binary.size();
+	if (payload_length > MAX_FRAME_PAYLOAD_BYTES) {
+		throw std::invalid_argument("[common::encode_frame] Frame payload is too big: " + std::to_string(payload_length));
+	}
+
+	std::string frame;
+	frame.reserve(FRAME_HEADER_SIZE + payload_length);
+
+	write_u32(frame, static_cast<uint32_t>(payload_length));
+	write_u16(frame, static_cast<uint16_t>(type));
+	write_u16(frame, binary.empty() ? FRAME_FLAG_NONE : FRAME_FLAG_HAS_BINARY);
+	write_u32(frame, request_id);
+	write_u32(frame, static_cast<uint32_t>(json.size()));
+
+	frame.append(json);
+	frame.append(binary);
+
+	return frame;
+}
+
+FrameHeader decode_frame_header(const char* data) {
+	FrameHeader header;
+	header.payload_length = read_u32(data);
+	header.type = static_cast<FrameType>(read_u16(data + 4));
+	header.flags = read_u16(data + 6);
+	header.request_id = read_u32(data + 8);
+	header.json_length = read_u32(data + 12);
+
+	if (header.type != FrameType::MESSAGE && header.type != FrameType::FILE_CHUNK) {
+		throw std::invalid_argument("[common::decode_frame_header] Unknown frame type: " + std::to_string(static_cast<uint16_t>(header.type)));
+	}
+
+	if (header.payload_length > MAX_FRAME_PAYLOAD_BYTES || header.json_length > header.payload_length) {
+		throw std::invalid_argument("[common::decode_frame_header] Invalid frame lengths, payload: " + std::to_string(header.payload_length)
+		                            + ", json: " + std::to_string(header.json_length));
+	}
+
+	return header;
+}
+
+std::string framing_mode_to_string(FramingMode mode) {
+	return mode == FramingMode::BINARY ? "binary" : "json";
+}
+
+FramingMode framing_mode_from_string(const std::string& mode) {
+	return mode == "binary" ? FramingMode::BINARY : FramingMode::JSON;
+}
+
+} // namespace common
\ No newline at end of file
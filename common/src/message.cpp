@@ -7,6 +7,11 @@ Message::Message(const int& sender_id, const int& receiver_id, const std::string
 {
 }
 
+Message::Message(const MessageMetadata& metadata, const MessageText& text) :
+	_metadata(metadata), _text(text)
+{
+}
+
 nlohmann::json Message::to_json() const {
 	nlohmann::json j;
 	j.update(_metadata.to_json());
@@ -15,7 +20,7 @@ nlohmann::json Message::to_json() const {
 	return j;
 }
 
-int Message::get_id() const {
+MessageId Message::get_id() const {
 	return _metadata.get_id();
 }
 
@@ -27,9 +32,13 @@ MessageMetadata Message::get_metadata() const {
 	return _metadata;
 }
 
-void Message::set_id(const int& id) {
+void Message::set_id(const MessageId& id) {
 	_metadata.set_id(id);
 	_text.set_id(id);
 }
 
+void Message::set_chat_id(const int& chat_id) {
+	_metadata.set_chat_id(chat_id);
+}
+
 }
\ No newline at end of file
@@ -3,7 +3,7 @@
 namespace common {
 
 MessageMetadata::MessageMetadata(
-	const int& id,
+	const MessageId& id,
 	const int& sender_id,
 	const int& receiver_id,
 	const int& chat_id
@@ -16,7 +16,7 @@ MessageMetadata::MessageMetadata(
 {
 }
 
-int MessageMetadata::get_id() const noexcept {
+MessageId MessageMetadata::get_id() const noexcept {
 	return _id;
 }
 
@@ -56,7 +56,7 @@ std::optional<Timestamp>MessageMetadata::get_last_edited_timestamp() const noexc
 	return std::nullopt;
 }
 
-void MessageMetadata::set_id(const int& msg_id) noexcept {
+void MessageMetadata::set_id(const MessageId& msg_id) noexcept {
 	_id = msg_id;
 }
 
@@ -102,7 +102,7 @@ nlohmann::json MessageMetadata::to_json() const {
 }
 
 MessageMetadata MessageMetadata::from_json(const nlohmann::json& j) {
-	MessageMetadata msg(j["id"], j["sender_id"], j["receiver_id"], j["chat_id"]);
+	MessageMetadata msg(j["id"].get<MessageId>(), j["sender_id"], j["receiver_id"], j["chat_id"]);
 	msg._id = j["id"];
 	msg._deleted = j["deleted"];
 	msg._created_timestamp = Timestamp(std::chrono::nanoseconds(j["created_timestamp"]));
@@ -2,12 +2,12 @@
 
 namespace common {
 
-MessageText::MessageText(const int& id, const std::string& text) :
+MessageText::MessageText(const MessageId& id, const std::string& text) :
 	_id(id), _text(text)
 {
 }
 
-int MessageText::get_id() const noexcept {
+MessageId MessageText::get_id() const noexcept {
 	return _id;
 }
 
@@ -15,7 +15,7 @@ std::string MessageText::get_text() const noexcept {
 	return _text;
 }
 
-void MessageText::set_id(const int& msg_id) noexcept {
+void MessageText::set_id(const MessageId& msg_id) noexcept {
 	_id = msg_id;
 }
 
@@ -31,7 +31,7 @@ nlohmann::json MessageText::to_json() const {
 }
 
 MessageText MessageText::from_json(const nlohmann::json& j) {
-	MessageText msg(j["id"], j["text"]);
+	MessageText msg(j["id"].get<MessageId>(), j["text"]);
 	msg._id = j["id"];
 	msg._text = j["text"];
 	return msg;
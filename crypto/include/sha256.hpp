@@ -3,6 +3,8 @@
 #include <string>
 #include <array>
 #include <cstdint>
+#include <filesystem>
+#include <optional>
 #include <vector>
 
 namespace crypto {
@@ -13,6 +15,9 @@ public:
 	void update(const std::string& data);
 	std::string digest();
 
+	// hex digest of a file content, std::nullopt when it can't be read
+	static std::optional<std::string> hash_file(const std::filesystem::path& path);
+
 private:
 	static inline uint32_t rotr(uint32_t word, unsigned bits) {
 		return (word >> bits) | (word << (32 - bits));
@@ -1,29 +1,42 @@
 #include "sha256.hpp"
+#include <algorithm>
 #include <cstring>
+#include <fstream>
 #include <sstream>
 #include <iomanip>
 
 namespace crypto {
 
+static constexpr size_t FILE_READ_SIZE_BYTES = 1024 * 1024;
+
 SHA256::SHA256()
 	: _state{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
 	         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
 	, _total_length(0) {
 }
 
+// whole blocks are transformed straight from the input, only a partial block is kept in _buffer
 void SHA256::update(const std::string& data) {
-	const uint8_t* input = reinterpret_cast<const uint8_t*>(data.c_str());
+	const uint8_t* input = reinterpret_cast<const uint8_t*>(data.data());
 	size_t length = data.length();
+	size_t offset = 0;
 
 	_total_length += length * 8;
 
-	for (size_t i = 0; i < length; ++i) {
-		_buffer.push_back(input[i]);
-		if (_buffer.size() == 64) {
-			transform(_buffer.data());
-			_buffer.clear();
+	if (!_buffer.empty()) {
+		offset = std::min(length, 64 - _buffer.size());
+		_buffer.insert(_buffer.end(), input, input + offset);
+		if (_buffer.size() < 64) {
+			return;
 		}
+		transform(_buffer.data());
+		_buffer.clear();
+	}
+
+	for (; offset + 64 <= length; offset += 64) {
+		transform(input + offset);
 	}
+	_buffer.insert(_buffer.end(), input + offset, input + length);
 }
 
 void SHA256::transform(const uint8_t* data) {
@@ -74,13 +87,16 @@ void SHA256::transform(const uint8_t* data) {
 }
 
 void SHA256::pad() {
-	uint64_t i = _buffer.size();
 	uint64_t final_length = _total_length;
 
 	_buffer.push_back(0x80);
-	while (_buffer.size() < 56) {
-		_buffer.push_back(0x00);
+	// no room for the length after 55 bytes of the last block, it goes into one more block
+	if (_buffer.size() > 56) {
+		_buffer.resize(64, 0x00);
+		transform(_buffer.data());
+		_buffer.clear();
 	}
+	_buffer.resize(56, 0x00);
 
 	for (int i = 7; i >= 0; i--) {
 		_buffer.push_back(static_cast<uint8_t>((final_length >> (i * 8)) & 0xFF));
@@ -105,4 +121,28 @@ std::string SHA256::digest() {
 	return ss.str();
 }
 
+std::optional<std::string> SHA256::hash_file(const std::filesystem::path& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return std::nullopt;
+	}
+
+	SHA256 sha256;
+	std::string block(FILE_READ_SIZE_BYTES, '\0');
+	while (file) {
+		file.read(block.data(), block.size());
+		size_t bytes_read = static_cast<size_t>(file.gcount());
+		if (bytes_read == 0) {
+			break;
+		}
+		block.resize(bytes_read);
+		sha256.update(block);
+	}
+
+	if (file.bad()) {
+		return std::nullopt;
+	}
+	return sha256.digest();
+}
+
 } // namespace crypto
@@ -0,0 +1,54 @@
+-- synthetic load for the partitioned messages table, used by bench_message_partitions
+-- psql -d message_metadata -v rows=100000000 -v chats=100000 -v months=12 -f generate_messages.sql
+-- rows are spread evenly over the last :months months, ids have the SnowflakeIdGenerator layout
+-- (milliseconds since 2024-01-01 << 22 | sequence) so that lookups by id prune partitions like on real data
+
+\set ON_ERROR_STOP on
+\timing on
+
+SELECT set_config('gen.rows', :'rows', FALSE),
+       set_config('gen.chats', :'chats', FALSE),
+       set_config('gen.months', :'months', FALSE);
+
+-- chat n is the pair of users (2n - 1, 2n)
+INSERT INTO chats (user1_id, user2_id)
+SELECT 2 * n - 1, 2 * n FROM generate_series(1, :chats) AS n
+ON CONFLICT (user1_id, user2_id) DO NOTHING;
+
+SELECT create_messages_partition((date_trunc('month', CURRENT_DATE) - make_interval(months => m))::date)
+FROM generate_series(0, :months) AS m;
+
+-- chunks are committed one by one, a single 100M rows transaction would keep everything in WAL until the end
+DO $$
+DECLARE
+    total BIGINT := current_setting('gen.rows')::bigint;
+    chat_count INT := current_setting('gen.chats')::int;
+    first_chat INT := (SELECT min(id) FROM chats WHERE user1_id = 1 AND user2_id = 2);
+    range_end TIMESTAMPTZ := date_trunc('second', now());
+    range_start TIMESTAMPTZ := date_trunc('month', now()) - make_interval(months => current_setting('gen.months')::int);
+    step_us DOUBLE PRECISION;
+    chunk BIGINT := 1000000;
+    done BIGINT := 0;
+    started TIMESTAMPTZ := clock_timestamp();
+BEGIN
+    step_us := extract(epoch FROM range_end - range_start) * 1000000 / total;
+    WHILE done < total LOOP
+        INSERT INTO messages (id, chat_id, sender_id, receiver_id, created_timestamp)
+        SELECT ((extract(epoch FROM ts) * 1000)::bigint - 1704067200000) << 22 | (n & 4095),
+               first_chat + c,
+               2 * c + 1 + (n & 1),
+               2 * c + 2 - (n & 1),
+               ts
+        FROM (
+            SELECT n, (n % chat_count)::int AS c, range_start + make_interval(secs => n * step_us / 1000000) AS ts
+            FROM generate_series(done, least(done + chunk, total) - 1) AS n
+        ) AS g;
+        COMMIT;
+        done := least(done + chunk, total);
+        RAISE NOTICE '% rows, % rows/s', done,
+            round(done / greatest(extract(epoch FROM clock_timestamp() - started), 0.001));
+    END LOOP;
+END;
+$$;
+
+ANALYZE messages;
\ No newline at end of file
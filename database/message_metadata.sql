@@ -16,42 +16,61 @@ CREATE TABLE chats (
     deleted BOOLEAN DEFAULT FALSE,
     deleted_timestamp TIMESTAMP WITH TIME ZONE,
     created_timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,
-    last_message_timestamp TIMESTAMP WITH TIME ZONE,
-    CONSTRAINT unique_chat UNIQUE (user1_id, user2_id)
+    last_message_timestamp TIMESTAMP WITH TIME ZONE, -- updated in batches, may lag behind by ChatCacheConfig::_last_message_flush_interval
+    CONSTRAINT unique_chat UNIQUE (user1_id, user2_id),
+    -- one row per unordered pair of users, the server always stores the smaller id first
+    CONSTRAINT ordered_chat_users CHECK (user1_id <= user2_id)
 );
 
+-- ids are snowflake ids generated by the server (SnowflakeIdGenerator), the same key is used for the text in redis
+-- monthly range partitions, queries always bound created_timestamp so that the planner prunes partitions:
+-- lookups by id use the time encoded in the id, the history uses its cursor
 CREATE TABLE messages (
-    id SERIAL PRIMARY KEY,
+    id BIGINT NOT NULL,
     chat_id INT NOT NULL REFERENCES chats(id),
     sender_id INT NOT NULL,
     receiver_id INT NOT NULL,
     deleted BOOLEAN DEFAULT FALSE,
-    created_timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,
+    created_timestamp TIMESTAMP WITH TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
     deleted_timestamp TIMESTAMP WITH TIME ZONE,
     last_edited_timestamp TIMESTAMP WITH TIME ZONE,
+    -- the partition key has to be part of the primary key, ids are unique on their own anyway
+    PRIMARY KEY (id, created_timestamp)
+    -- chat_id always comes from MessageMetadataRepository::resolve_chat_id of sender and receiver,
+    -- postgres doesn't allow the subquery a check of the participants would need
+) PARTITION BY RANGE (created_timestamp);
 
-    CONSTRAINT valid_chat_participants CHECK (
-        EXISTS (
-            SELECT 1 FROM chats 
-            WHERE chats.id = chat_id 
-            AND (
-                (chats.user1_id = sender_id AND chats.user2_id = receiver_id)
-                OR 
-                (chats.user1_id = receiver_id AND chats.user2_id = sender_id)
-            )
-        )
-    )
-);
+-- messages_YYYY_MM for the month starting at month_start (UTC), does nothing if it already exists,
+-- the server calls it at startup and every ServerConfig::_message_partitions_check_interval
+-- for the current and ServerConfig::_message_partitions_ahead next months,
+-- SECURITY DEFINER runs it as the owner of messages, a fixed search_path keeps callers from
+-- substituting objects of their own schemas
+CREATE FUNCTION create_messages_partition(month_start DATE) RETURNS VOID
+LANGUAGE plpgsql SECURITY DEFINER SET search_path = public, pg_temp AS $$
+DECLARE
+    first_day DATE := date_trunc('month', month_start)::date;
+BEGIN
+    EXECUTE format('CREATE TABLE IF NOT EXISTS %I PARTITION OF messages FOR VALUES FROM (%L) TO (%L)',
+                   'messages_' || to_char(first_day, 'YYYY_MM'),
+                   first_day::timestamp AT TIME ZONE 'UTC',
+                   (first_day + INTERVAL '1 month')::timestamp AT TIME ZONE 'UTC');
+END;
+$$;
+
+-- catches rows outside of the created months, keep it empty: a new partition has to scan it on creation
+CREATE TABLE messages_default PARTITION OF messages DEFAULT;
+SELECT create_messages_partition(CURRENT_DATE);
 
 CREATE INDEX idx_chat_users ON chats(user1_id, user2_id);
 CREATE INDEX idx_chat_last_message ON chats(last_message_timestamp DESC);
-CREATE INDEX idx_messages_chat ON messages(chat_id);
-CREATE INDEX idx_messages_timestamp ON messages(created_timestamp);
+-- keyset pagination of the chat history, see MessageMetadataRepository::get_history_page,
+-- created on the partitioned table it exists in every partition
+CREATE INDEX idx_messages_chat_history ON messages(chat_id, created_timestamp DESC, id DESC);
 
 GRANT ALL PRIVILEGES ON TABLE messages TO :new_user;
 GRANT ALL PRIVILEGES ON TABLE chats TO :new_user;
-GRANT USAGE, SELECT ON SEQUENCE messages_id_seq TO :new_user;
 GRANT USAGE, SELECT ON SEQUENCE chats_id_seq TO :new_user;
+GRANT EXECUTE ON FUNCTION create_messages_partition(DATE) TO :new_user;
 
 DROP ROLE IF EXISTS logi;
 CREATE ROLE logi WITH LOGIN PASSWORD 'logi';
\ No newline at end of file
@@ -1,11 +1,24 @@
 #include "file_server.hpp"
 
-int main() {
+// usage: file_server [max_file_size_mb] [max_chunk_size_kb] [dedup] [pack]
+int main(int argc, char* argv[]) {
+	size_t max_file_size = (argc > 1 ? std::stoul(argv[1]) : 10) * 1024 * 1024; // 10mb
+	size_t max_chunk_size = argc > 2 ? std::stoul(argv[2]) * 1024 : file_server::DEFAULT_MAX_CHUNK_SIZE_BYTES;
+	bool deduplicate = false;
+	bool pack_small_files = false;
+	for (int i = 3; i < argc; ++i) {
+		deduplicate |= std::string(argv[i]) == "dedup";
+		pack_small_files |= std::string(argv[i]) == "pack";
+	}
+
 	file_server::FileServer server(
 		9080,
 		16,
 		std::string(SOURCE_DIR) + "/file_server/media_file_system/",
-		1024 * 1024 * 10 // 10mb
+		max_file_size,
+		max_chunk_size,
+		deduplicate,
+		pack_small_files
 		);
 
 	server.start();
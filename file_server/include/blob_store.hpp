@@ -0,0 +1,53 @@
+#pragma once
+
+#include "debug.hpp"
+
+#include <sys/types.h>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace file_server {
+
+// content addressed storage of file bodies: one blob per distinct content under <root>/ab/cd/<sha256>,
+// the files of the storage are hard links to their blobs, so downloads don't know about it
+// and the link count of a blob is its reference count + 1
+class BlobStore {
+public:
+	// blobs left without references by a crash are removed
+	explicit BlobStore(const std::filesystem::path& root);
+	BlobStore(const BlobStore&) = delete;
+	BlobStore& operator=(const BlobStore&) = delete;
+
+	// lowercase hex sha256, see crypto::SHA256::hash_file
+	static bool is_valid_hash(const std::string& hash);
+
+	// moves the file at source into the store, or drops it when the store has its content already, and makes target a reference to the blob
+	bool store(const std::filesystem::path& source, const std::filesystem::path& target);
+	// makes target a reference to the blob of hash, false when there's no such blob
+	bool link(const std::string& hash, const std::filesystem::path& target);
+	// removes target and its blob when it was the last reference, false when target doesn't exist
+	bool remove(const std::filesystem::path& target);
+	// gives target its own copy of the content, so it can be appended to without changing other references
+	bool detach(const std::filesystem::path& target);
+
+	// references to the blob of hash, 0 when there's no such blob
+	size_t get_references(const std::string& hash) const;
+	size_t get_blob_count() const;
+
+private:
+	std::filesystem::path get_blob_path(const std::string& hash) const;
+	// renames a new link or copy of a content over target
+	bool replace(const std::filesystem::path& source, const std::filesystem::path& target);
+	// target had links_before links and has been unlinked, its blob goes away when only the blob itself is left
+	void release(ino_t inode, nlink_t links_before);
+
+private:
+	std::filesystem::path _root;
+	mutable std::mutex _mutex;
+	// blobs by inode, references only know their inode
+	std::unordered_map<ino_t, std::string> _hashes_by_inode;
+};
+
+}
\ No newline at end of file
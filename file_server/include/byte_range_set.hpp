@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace file_server {
+
+using ByteRange = std::pair<uint64_t, uint64_t>; // [first, end)
+
+// bytes of a file received so far as disjoint ranges, overlapping and touching ranges are merged on insert,
+// not thread safe
+class ByteRangeSet {
+public:
+	void insert(uint64_t first, uint64_t end) {
+		if (first >= end) {
+			return;
+		}
+
+		auto it = _ranges.upper_bound(first);
+		if (it != _ranges.begin()) {
+			auto previous = std::prev(it);
+			if (previous->second >= first) {
+				first = previous->first;
+				end = std::max(end, previous->second);
+				_covered -= previous->second - previous->first;
+				it = _ranges.erase(previous);
+			}
+		}
+		while (it != _ranges.end() && it->first <= end) {
+			end = std::max(end, it->second);
+			_covered -= it->second - it->first;
+			it = _ranges.erase(it);
+		}
+
+		_ranges.emplace(first, end);
+		_covered += end - first;
+	}
+
+	bool contains(uint64_t first, uint64_t end) const {
+		if (first >= end) {
+			return true;
+		}
+		auto it = _ranges.upper_bound(first);
+		return it != _ranges.begin() && std::prev(it)->second >= end;
+	}
+
+	// bytes in all ranges
+	uint64_t covered() const noexcept {
+		return _covered;
+	}
+
+	std::vector<ByteRange> ranges() const {
+		return {_ranges.begin(), _ranges.end()};
+	}
+
+	// gaps between the ranges within [0, size)
+	std::vector<ByteRange> missing(uint64_t size) const {
+		std::vector<ByteRange> gaps;
+		uint64_t position = 0;
+		for (const auto& [first, end] : _ranges) {
+			if (first >= size) {
+				break;
+			}
+			if (first > position) {
+				gaps.emplace_back(position, first);
+			}
+			position = std::max(position, end);
+		}
+		if (position < size) {
+			gaps.emplace_back(position, size);
+		}
+		return gaps;
+	}
+
+private:
+	std::map<uint64_t, uint64_t> _ranges; // first -> end
+	uint64_t _covered = 0;
+};
+
+}
\ No newline at end of file
@@ -1,23 +1,39 @@
 #pragma once
 
 #include "debug.hpp"
+#include "striped_lock.hpp"
+#include "byte_range_set.hpp"
+#include "blob_store.hpp"
+#include "pack_store.hpp"
 
 #include <pistache/endpoint.h>
 #include <pistache/http.h>
 #include <pistache/router.h>
 #include <pistache/mime.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <vector>
 #include <filesystem>
 #include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace file_server {
 
 // make them inline?
 // move to cpp ?
-constexpr size_t CHUNK_SIZE_BYTES = 512;
+// largest upload body by default, clients ask for the actual limit with GET /limits
+constexpr size_t DEFAULT_MAX_CHUNK_SIZE_BYTES = 8 * 1024 * 1024;
+// room for the request line and headers on top of the body in the pistache request size limit
+constexpr size_t MAX_REQUEST_HEADERS_BYTES = 16 * 1024;
 constexpr uint8_t FILENAME_LEN = 16;
+// upload sessions without a chunk, status or resume request for this long are aborted and their part file removed
+constexpr std::chrono::seconds DEFAULT_UPLOAD_SESSION_IDLE_TIMEOUT {24 * 3600};
+// locks shared by all files of the storage, two files collide on one of them with probability 1 / FILE_LOCK_STRIPES
+constexpr size_t FILE_LOCK_STRIPES = 1024;
 
 constexpr std::array<char, 62> ALPHABET = {
 	'0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
@@ -35,7 +51,13 @@ public:
 		uint16_t port = 9080,
 		unsigned int threads = 16,
 		const std::string& storage_dir = std::string(SOURCE_DIR) + "/file_server/media_file_system/",
-		size_t max_file_size = 1024 * 1024 * 10
+		size_t max_file_size = 1024 * 1024 * 10,
+		size_t max_chunk_size = DEFAULT_MAX_CHUNK_SIZE_BYTES,
+		// committed upload sessions are stored once per distinct content, see BlobStore
+		bool deduplicate = false,
+		// files of up to PackStoreConfig::_max_object_size bytes uploaded with upload_file are kept in pack segments
+		bool pack_small_files = false,
+		std::chrono::seconds upload_session_idle_timeout = DEFAULT_UPLOAD_SESSION_IDLE_TIMEOUT
 		);
 	FileServer(const FileServer&) = delete;
 	FileServer& operator=(const FileServer&) = delete;
@@ -50,27 +72,91 @@ public:
 	static const std::string DOWNLOAD_ROUTE;
 	static const std::string DELETE_ROUTE;
 	static const std::string LIST_ROUTE;
+	static const std::string LIMITS_ROUTE;
+	static const std::string SESSION_ROUTE;
+	static const std::string SESSION_CREATE_ROUTE;
+	static const std::string SESSION_CHUNK_ROUTE;
+	static const std::string SESSION_COMMIT_ROUTE;
+	static const std::string DEDUP_ROUTE;
 
 private:
+	// file uploaded in chunks at their offsets, in any order and over any number of connections, into a preallocated
+	// "<file>.part" next to the final file, which is renamed into place on commit
+	struct UploadSession {
+		uint64_t _size = 0;
+		std::filesystem::path _part_path;
+		int _fd = -1;
+		// chunk writes hold it shared, commit and abort exclusively as they close _fd
+		std::shared_mutex _io_mutex;
+		bool _closed = false;
+		std::mutex _received_mutex;
+		ByteRangeSet _received;
+		// steady clock time of the last request of the session
+		std::atomic<std::chrono::steady_clock::rep> _last_active {0};
+
+		void touch();
+		~UploadSession();
+	};
+
+	enum class DownloadAnswer {
+		SENT,  // 304 or 416
+		RANGE,
+		WHOLE
+	};
+
 	void setup_routes();
 	void upload_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
 	void download_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
 	void delete_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	DownloadAnswer answer_download(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter& response,
+	                               const std::string& etag, uint64_t file_size, uint64_t& first, uint64_t& last);
+	void send_range(Pistache::Http::ResponseWriter& response, const std::filesystem::path& filepath, uint64_t file_size, uint64_t first, uint64_t last);
+	void send_partial_content(Pistache::Http::ResponseWriter& response, const std::string& body, uint64_t first, uint64_t last, uint64_t file_size);
+	void get_limits(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	void create_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	void write_upload_session_chunk(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	void get_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	void commit_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	void abort_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+	void link_by_hash(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response);
+
+	std::shared_ptr<UploadSession> find_upload_session(const std::string& filename);
+	// closes the part file and forgets the session, the caller holds session._io_mutex exclusively
+	void close_upload_session(const std::string& filename, UploadSession& session);
+	std::string get_upload_session_status(UploadSession& session);
+	// aborts sessions idle for longer than _upload_session_idle_timeout, runs on _session_expiry_thread
+	void expire_upload_sessions();
+	void session_expiry_loop();
+	// sessions don't survive a restart, their part files are left over from the previous run,
+	// as are the link and copy files of BlobStore writes cut by a crash, those would hold a reference to their blob
+	void remove_stray_temp_files();
 
 	std::filesystem::path get_filepath_by_name(const std::string& filename) const;
+	// creates missing level directories of the file, safe to race with other uploads of the same directories
+	bool create_file_directories(const std::filesystem::path& filepath) const;
 
 private:
 	std::shared_ptr<Pistache::Http::Endpoint> _http_endpoint;
 	std::shared_ptr<Pistache::Rest::Router> _router;
-	std::shared_mutex _file_system_mutex;
-	std::unordered_map<std::string, std::unique_ptr<std::shared_mutex> > _file_mutexes;
-	std::mutex _file_mutexes_map_mutex;
+	// per file reader/writer locks: uploads and deletes are exclusive, downloads are shared
+	StripedLock _file_locks {FILE_LOCK_STRIPES};
+	std::unordered_map<std::string, std::shared_ptr<UploadSession> > _upload_sessions;
+	std::mutex _upload_sessions_mutex;
 	bool _running = false;
 	std::mutex _init_mutex;
 	unsigned int _thread_count;
 	unsigned short _server_port;
 	std::string _storage_dir;
 	size_t _max_file_size;
+	size_t _max_chunk_size;
+	std::unique_ptr<BlobStore> _blob_store; // null without deduplication
+	std::unique_ptr<PackStore> _pack_store; // null without packing
+	std::chrono::seconds _upload_session_idle_timeout;
+	std::mutex _session_expiry_mutex;
+	std::condition_variable _session_expiry_cv;
+	bool _stopped = false;
+	// last member, it uses the sessions until it is joined
+	std::thread _session_expiry_thread;
 };
 
 }
\ No newline at end of file
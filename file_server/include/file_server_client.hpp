@@ -1,6 +1,7 @@
 #pragma once
 
 #include "debug.hpp"
+#include "byte_range_set.hpp"
 
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
@@ -11,32 +12,112 @@
 #include <filesystem>
 #include <fstream>
 #include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace file_server {
 
+struct FileServerClientConfig {
+	size_t _max_connections = 8;  // persistent connections, idle and busy, callers wait when all of them are busy
+	size_t _pipeline_depth = 16;  // upload requests in flight on one connection in upload_chunks
+	size_t _max_chunk_size = 0;   // upper bound for upload_file chunks, 0 - as large as the server accepts
+};
+
+// state of an upload session on the file server
+struct UploadSessionStatus {
+	uint64_t _size = 0;
+	uint64_t _received = 0;
+	std::vector<ByteRange> _ranges; // bytes already written
+
+	bool is_complete() const noexcept {
+		return _received == _size;
+	}
+};
+
+// http/1.1 client of the file server, safe to use from many threads at once:
+// every call checks a keep-alive connection out of a small pool, the host is resolved once
 class FileServerClient {
 public:
-	FileServerClient(const std::string& host, const std::string& port);
+	FileServerClient(const std::string& host, const std::string& port, const FileServerClientConfig& config = {});
 
 	// adjust all methods to return bool where possible
 	// put server response messages into enum
-	// legacy :)
-	// std::string upload_file(const std::string& filename, const std::string& filepath);
+	// local file in chunks of get_max_chunk_size() bytes
+	bool upload_file(const std::string& filename, const std::filesystem::path& filepath);
 	bool upload_chunk(const std::string& filename, const std::string& chunk_data);
+	// chunks are appended in order, up to _pipeline_depth requests are written before their responses are read
+	bool upload_chunks(const std::string& filename, const std::vector<std::string>& chunks);
+	// whole file, empty on failure
 	std::string download_file(const std::string& filename);
 	std::string delete_file(const std::string& filename);
 	std::vector<std::string> download_file_chunks(const std::string& filename);
+	// bytes [offset, offset + length) of the file, less of them at the end of the file or when the server caps the range,
+	// with an etag of an earlier response the range is only taken from the same version of the file (If-Range),
+	// nullopt on failure or when the file changed
+	std::optional<std::string> download_range(const std::string& filename, uint64_t offset, uint64_t length, const std::string& etag = "");
+
+	// upload sessions: chunks are written at their offsets in any order, the file appears under its name only on commit,
+	// nullopt on failure, creating a session that already exists with the same size returns its status
+	std::optional<UploadSessionStatus> create_upload_session(const std::string& filename, uint64_t size);
+	std::optional<UploadSessionStatus> upload_session_chunk(const std::string& filename, uint64_t offset, const std::string& chunk_data);
+	std::optional<UploadSessionStatus> get_upload_session(const std::string& filename);
+	bool commit_upload_session(const std::string& filename);
+	bool abort_upload_session(const std::string& filename);
+	// local file through an upload session, the chunks the server doesn't have yet are sent by up to `parallelism`
+	// threads on pooled connections, calling it again after a failure only sends what is still missing
+	bool upload_file_resumable(const std::string& filename, const std::filesystem::path& filepath, size_t parallelism = 4);
+	// hash first: a file whose content the server has is only linked to it and not sent,
+	// other files go through upload_file_resumable, the hash is always taken from the local bytes, see link_by_hash
+	bool upload_file_deduplicated(const std::string& filename, const std::filesystem::path& filepath, size_t parallelism = 4);
+
+	size_t get_connections_opened() const;
+	// largest upload body, asked from the server once and capped by _max_chunk_size
+	size_t get_max_chunk_size();
 
 private:
+	struct Connection {
+		boost::beast::tcp_stream _stream;
+		boost::beast::flat_buffer _buffer; // bytes read past the previous response stay here
+		bool _reused = false;
+
+		explicit Connection(boost::asio::io_context& io_context) : _stream(io_context) {
+		}
+	};
+
+	std::unique_ptr<Connection> acquire();
+	void release(std::unique_ptr<Connection> connection, bool keep_alive);
+	std::unique_ptr<Connection> connect();
+	boost::beast::http::request<boost::beast::http::string_body> make_request(
+		boost::beast::http::verb method, const std::string& target, const std::string& body) const;
+	// one request and its response on a pooled connection, a request that failed on a reused connection
+	// is sent once more on a new one, the server may have closed the idle connection in the meantime,
+	// a non idempotent one only if it couldn't even be written
+	boost::beast::http::response<boost::beast::http::string_body> perform(
+		const boost::beast::http::request<boost::beast::http::string_body>& request);
 	std::string send_request(const std::string& target, boost::beast::http::verb method, const std::string& body = "");
+	// reference to content the server has stored under its sha256 already, false when it doesn't have it
+	// or doesn't deduplicate; private, a hash that doesn't come from bytes the caller holds would let it read any stored content
+	bool link_by_hash(const std::string& filename, const std::string& hash);
+	std::optional<UploadSessionStatus> send_session_request(boost::beast::http::verb method, const std::string& target, const std::string& body = "");
 
 private:
 	std::string _host;
 	std::string _port;
 	const int _version = 11;
+	FileServerClientConfig _config;
+	// only used for blocking calls, which don't need a running io_context
 	boost::asio::io_context _io_context;
-	boost::asio::ip::tcp::resolver _resolver;
-	boost::beast::tcp_stream _stream;
+	boost::asio::ip::tcp::resolver::results_type _endpoints;
+	std::vector<std::unique_ptr<Connection> > _idle_connections;
+	size_t _open_connections = 0;
+	size_t _connections_opened = 0;
+	std::atomic<size_t> _negotiated_chunk_size {0};
+	mutable std::mutex _mutex;
+	std::condition_variable _connection_released;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "debug.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace file_server {
+
+struct PackStoreConfig {
+	uint64_t _segment_size = 64 * 1024 * 1024; // a segment is sealed once the next record doesn't fit
+	size_t _max_object_size = 64 * 1024;       // larger objects aren't accepted, they are stored as files
+	double _compaction_threshold = 0.5;        // share of dead bytes in a sealed segment that gets it compacted
+	std::chrono::milliseconds _compaction_interval {10000}; // 0 - no background compaction, only compact() calls
+	bool _sync_writes = false;                 // fdatasync after every record
+};
+
+// a record is never changed once written, so its segment and offset identify the version of the object
+struct PackedObject {
+	std::string _data;
+	uint32_t _segment_id = 0;
+	uint64_t _offset = 0;
+};
+
+struct PackStoreStats {
+	size_t _objects = 0;
+	size_t _segments = 0;
+	uint64_t _live_bytes = 0;
+	uint64_t _dead_bytes = 0;
+};
+
+// Haystack-like storage of small objects: objects are appended as records to large segment files <root>/<id>.pack,
+// a sealed segment ends with a footer listing its records, so the in-memory index (name -> segment, offset, size)
+// is rebuilt at startup from the footers without reading the objects, only the active segment is scanned,
+// a read is a single pread, replaced and removed objects stay in their segment as dead bytes until it's compacted
+class PackStore {
+public:
+	explicit PackStore(const std::filesystem::path& root, const PackStoreConfig& config = {});
+	PackStore(const PackStore&) = delete;
+	PackStore& operator=(const PackStore&) = delete;
+	~PackStore();
+
+	// replaces an object of the same name, false when the object is too large or the write failed
+	bool put(const std::string& name, const std::string& data);
+	std::optional<std::string> get(const std::string& name) const;
+	// like get, with where the object is stored
+	std::optional<PackedObject> read(const std::string& name) const;
+	bool contains(const std::string& name) const;
+	// false when there's no such object
+	bool remove(const std::string& name);
+
+	// moves the live objects of sealed segments over the compaction threshold to the active segment
+	// and removes those segments, returns how many were compacted
+	size_t compact();
+
+	PackStoreStats get_stats() const;
+	size_t get_max_object_size() const noexcept;
+
+private:
+	struct Record {
+		uint64_t _offset; // of the record header in its segment
+		uint32_t _data_size;
+		std::string _name;
+		bool _tombstone;
+	};
+
+	// open segments are shared with the readers, the file is closed after the last read of a compacted segment
+	struct Segment {
+		uint32_t _id = 0;
+		int _fd = -1;
+		std::filesystem::path _path;
+		uint64_t _size = 0;
+		uint64_t _dead_bytes = 0;
+		uint64_t _footer_size = 0; // of the footer the records written so far need
+		bool _sealed = false;
+		std::vector<Record> _records;
+
+		~Segment();
+	};
+
+	struct Location {
+		std::shared_ptr<Segment> _segment;
+		uint64_t _offset;
+		uint32_t _data_size;
+		uint16_t _name_size;
+	};
+
+	bool open_segments();
+	std::shared_ptr<Segment> create_segment(uint32_t id);
+	bool load_footer(Segment& segment);
+	// records up to the first torn or corrupt one, the file is cut there
+	void scan_records(Segment& segment);
+	bool seal(Segment& segment);
+	// appends a record to the active segment, _write_mutex is held
+	std::optional<Location> append_record(const std::string& name, const std::string& data, bool tombstone);
+	// index update for a record that has been written or loaded, _index_mutex is held exclusively
+	void apply(const Location& location, const std::string& name, bool tombstone);
+	bool compact_segment(const std::shared_ptr<Segment>& segment);
+	void compaction_loop();
+
+private:
+	std::filesystem::path _root;
+	PackStoreConfig _config;
+
+	// appends, the active segment and sealing, taken before _index_mutex
+	mutable std::mutex _write_mutex;
+	std::shared_ptr<Segment> _active;
+
+	mutable std::shared_mutex _index_mutex;
+	std::unordered_map<std::string, Location> _index;
+	std::map<uint32_t, std::shared_ptr<Segment> > _segments;
+
+	std::mutex _compaction_mutex;
+	std::condition_variable _compaction_cv;
+	bool _stopped = false;
+	std::thread _compaction_thread;
+};
+
+}
\ No newline at end of file
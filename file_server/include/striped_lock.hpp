@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace file_server {
+
+// fixed table of reader/writer locks, a key always maps to the same stripe, so operations on one file
+// exclude each other while unrelated files almost never share a lock, and the table never grows
+class StripedLock {
+public:
+	// rounded up to a power of two
+	explicit StripedLock(size_t stripes = 1024)
+		: _stripes(round_up_to_power_of_two(stripes)), _mask(_stripes.size() - 1) {
+	}
+
+	StripedLock(const StripedLock&) = delete;
+	StripedLock& operator=(const StripedLock&) = delete;
+
+	std::shared_mutex& get(const std::string& key) {
+		return _stripes[get_stripe(key)];
+	}
+
+	size_t get_stripe(const std::string& key) const {
+		// spread the bits of the hash, std::hash of strings is fine but the low bits are all the mask keeps
+		size_t hash = std::hash<std::string>{}(key);
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		return hash & _mask;
+	}
+
+	size_t size() const noexcept {
+		return _stripes.size();
+	}
+
+private:
+	static size_t round_up_to_power_of_two(size_t value) {
+		size_t result = 1;
+		while (result < value) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+private:
+	std::vector<std::shared_mutex> _stripes;
+	size_t _mask;
+};
+
+}
\ No newline at end of file
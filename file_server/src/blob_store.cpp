@@ -0,0 +1,170 @@
+#include "blob_store.hpp"
+#include "sha256.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace file_server {
+
+static constexpr size_t HASH_LEN = 64;
+
+BlobStore::BlobStore(const std::filesystem::path& root)
+	: _root(root) {
+	std::error_code ec;
+	std::filesystem::create_directories(_root, ec);
+
+	size_t orphans = 0;
+	for (auto it = std::filesystem::recursive_directory_iterator(_root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+		std::string hash = it->path().filename().string();
+		struct stat st;
+		if (!it->is_regular_file() || !is_valid_hash(hash) || ::stat(it->path().c_str(), &st) != 0) {
+			continue;
+		}
+
+		if (st.st_nlink == 1) {
+			std::filesystem::remove(it->path(), ec);
+			++orphans;
+			continue;
+		}
+		_hashes_by_inode[st.st_ino] = hash;
+	}
+
+	INFO_MSG("[BlobStore::BlobStore] " + std::to_string(_hashes_by_inode.size()) + " blobs in " + _root.string()
+	         + ", " + std::to_string(orphans) + " unreferenced blobs removed");
+}
+
+bool BlobStore::is_valid_hash(const std::string& hash) {
+	return hash.size() == HASH_LEN && hash.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+std::filesystem::path BlobStore::get_blob_path(const std::string& hash) const {
+	return _root / hash.substr(0, 2) / hash.substr(2, 2) / hash;
+}
+
+// the content is hashed before taking the lock, uploads of distinct files only serialize on the renames
+bool BlobStore::store(const std::filesystem::path& source, const std::filesystem::path& target) {
+	auto hash = crypto::SHA256::hash_file(source);
+	if (!hash) {
+		ERROR_MSG("[BlobStore::store] Failed to read " + source.string());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::filesystem::path blob_path = get_blob_path(*hash);
+	std::error_code ec;
+	struct stat st;
+	if (::stat(blob_path.c_str(), &st) == 0) {
+		std::filesystem::remove(source, ec);
+		DEBUG_MSG("[BlobStore::store] Content of " + target.string() + " is stored already, blob " + *hash);
+	} else {
+		std::filesystem::create_directories(blob_path.parent_path(), ec);
+		std::filesystem::rename(source, blob_path, ec);
+		if (ec || ::stat(blob_path.c_str(), &st) != 0) {
+			ERROR_MSG("[BlobStore::store] Failed to move " + source.string() + " to " + blob_path.string() + ": " + ec.message());
+			return false;
+		}
+		_hashes_by_inode[st.st_ino] = *hash;
+	}
+
+	std::filesystem::path link_path = target.string() + ".link";
+	std::filesystem::remove(link_path, ec);
+	if (::link(blob_path.c_str(), link_path.c_str()) != 0) {
+		ERROR_MSG("[BlobStore::store] Failed to link " + target.string() + " to blob " + *hash);
+		// as if the failed link had been made and removed, a blob created just now goes away again
+		release(st.st_ino, st.st_nlink + 1);
+		return false;
+	}
+	return replace(link_path, target);
+}
+
+bool BlobStore::link(const std::string& hash, const std::filesystem::path& target) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::filesystem::path blob_path = get_blob_path(hash);
+	std::filesystem::path link_path = target.string() + ".link";
+	std::error_code ec;
+	std::filesystem::remove(link_path, ec);
+	if (::link(blob_path.c_str(), link_path.c_str()) != 0) {
+		return false;
+	}
+	return replace(link_path, target);
+}
+
+bool BlobStore::remove(const std::filesystem::path& target) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	struct stat st;
+	if (::stat(target.c_str(), &st) != 0 || ::unlink(target.c_str()) != 0) {
+		return false;
+	}
+	release(st.st_ino, st.st_nlink);
+	return true;
+}
+
+bool BlobStore::detach(const std::filesystem::path& target) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	struct stat st;
+	if (::stat(target.c_str(), &st) != 0 || st.st_nlink == 1) {
+		return true;
+	}
+
+	std::filesystem::path copy_path = target.string() + ".copy";
+	std::error_code ec;
+	std::filesystem::copy_file(target, copy_path, std::filesystem::copy_options::overwrite_existing, ec);
+	if (ec) {
+		ERROR_MSG("[BlobStore::detach] Failed to copy " + target.string() + ": " + ec.message());
+		return false;
+	}
+	return replace(copy_path, target);
+}
+
+bool BlobStore::replace(const std::filesystem::path& source, const std::filesystem::path& target) {
+	struct stat st;
+	bool replaced = ::stat(target.c_str(), &st) == 0;
+
+	std::error_code ec;
+	// rename between two links of one file does nothing, target references the content already
+	struct stat source_st;
+	if (replaced && ::stat(source.c_str(), &source_st) == 0 && source_st.st_ino == st.st_ino) {
+		std::filesystem::remove(source, ec);
+		return true;
+	}
+
+	std::filesystem::rename(source, target, ec);
+	if (ec) {
+		ERROR_MSG("[BlobStore::replace] Failed to rename " + source.string() + " to " + target.string() + ": " + ec.message());
+		std::filesystem::remove(source, ec);
+		return false;
+	}
+
+	if (replaced) {
+		release(st.st_ino, st.st_nlink);
+	}
+	return true;
+}
+
+void BlobStore::release(ino_t inode, nlink_t links_before) {
+	auto it = _hashes_by_inode.find(inode);
+	if (it == _hashes_by_inode.end() || links_before > 2) {
+		return;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(get_blob_path(it->second), ec);
+	DEBUG_MSG("[BlobStore::release] Last reference to blob " + it->second + " removed");
+	_hashes_by_inode.erase(it);
+}
+
+size_t BlobStore::get_references(const std::string& hash) const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	struct stat st;
+	if (::stat(get_blob_path(hash).c_str(), &st) != 0) {
+		return 0;
+	}
+	return st.st_nlink - 1;
+}
+
+size_t BlobStore::get_blob_count() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _hashes_by_inode.size();
+}
+
+}
\ No newline at end of file
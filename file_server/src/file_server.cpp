@@ -1,24 +1,194 @@
 #include "file_server.hpp"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <sstream>
+
 namespace file_server {
 
 inline const std::string FileServer::UPLOAD_ROUTE = "/upload/:filename";
 inline const std::string FileServer::DOWNLOAD_ROUTE = "/download/:filename";
 inline const std::string FileServer::DELETE_ROUTE = "/delete/:filename";
+inline const std::string FileServer::LIMITS_ROUTE = "/limits";
+inline const std::string FileServer::SESSION_ROUTE = "/session/:filename";
+inline const std::string FileServer::SESSION_CREATE_ROUTE = "/session/:filename/:size";
+inline const std::string FileServer::SESSION_CHUNK_ROUTE = "/session/:filename/:offset";
+inline const std::string FileServer::SESSION_COMMIT_ROUTE = "/commit/:filename";
+inline const std::string FileServer::DEDUP_ROUTE = "/dedup/:filename/:hash";
+
+// upload session part files and the link and copy files BlobStore writes next to their targets
+static bool is_temp_extension(const std::string& extension) {
+	return extension == ".part" || extension == ".link" || extension == ".copy";
+}
+
+// the whole body goes to disk in one sequential write, the file is only opened for the duration of it
+static bool append_to_file(const std::filesystem::path& filepath, const std::string& data) {
+	int fd = ::open(filepath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+
+	size_t written = 0;
+	while (written < data.size()) {
+		ssize_t bytes = ::write(fd, data.data() + written, data.size() - written);
+		if (bytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			::close(fd);
+			return false;
+		}
+		written += static_cast<size_t>(bytes);
+	}
+
+	return ::close(fd) == 0;
+}
+
+static bool write_at(int fd, const std::string& data, uint64_t offset) {
+	size_t written = 0;
+	while (written < data.size()) {
+		ssize_t bytes = ::pwrite(fd, data.data() + written, data.size() - written, static_cast<off_t>(offset + written));
+		if (bytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		written += static_cast<size_t>(bytes);
+	}
+	return true;
+}
+
+static bool parse_uint64(const std::string& value, uint64_t& result) {
+	if (value.empty() || value.size() > 19 || value.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+	result = std::stoull(value);
+	return true;
+}
+
+enum class RangeResult {
+	IGNORED,       // no usable Range header, the whole file is sent
+	SATISFIABLE,
+	UNSATISFIABLE  // 416
+};
+
+// strong validator of the current file content: a file is replaced as a whole by the rename of a committed session
+// or a link to a deduplicated blob, both give it another inode, otherwise it only grows by appends,
+// so inode, size and the nanosecond mtime identify a version
+static std::string make_etag(const std::filesystem::path& filepath, uint64_t file_size) {
+	struct stat st {};
+	if (::stat(filepath.c_str(), &st) != 0) {
+		st.st_ino = 0;
+	}
+	std::ostringstream etag;
+	etag << '"' << std::hex << st.st_ino << '-' << file_size << '-' << st.st_mtim.tv_sec << '.' << st.st_mtim.tv_nsec << '"';
+	return etag.str();
+}
+
+// pistache has no typed Range and ETag related headers, they are kept as raw ones
+static std::optional<std::string> find_raw_header(const Pistache::Http::Request& request, const std::string& name) {
+	auto headers = request.headers().rawList();
+	auto it = headers.find(name);
+	if (it == headers.end()) {
+		return std::nullopt;
+	}
+	return it->second.value();
+}
+
+// one range of a "bytes=first-last", "bytes=first-" or "bytes=-suffix_length" header, multiple ranges
+// and malformed headers are ignored, the whole file is sent for them
+static RangeResult parse_range(const std::string& value, uint64_t file_size, uint64_t& first, uint64_t& last) {
+	const std::string prefix = "bytes=";
+	if (value.compare(0, prefix.size(), prefix) != 0 || value.find(',') != std::string::npos) {
+		return RangeResult::IGNORED;
+	}
+
+	std::string spec = value.substr(prefix.size());
+	size_t dash = spec.find('-');
+	if (dash == std::string::npos) {
+		return RangeResult::IGNORED;
+	}
+	std::string first_part = spec.substr(0, dash);
+	std::string last_part = spec.substr(dash + 1);
+	auto is_number = [](const std::string& part) {
+			return !part.empty() && part.find_first_not_of("0123456789") == std::string::npos;
+		};
+
+	try {
+		if (first_part.empty()) {
+			if (!is_number(last_part)) {
+				return RangeResult::IGNORED;
+			}
+			uint64_t suffix_length = std::stoull(last_part);
+			if (suffix_length == 0 || file_size == 0) {
+				return RangeResult::UNSATISFIABLE;
+			}
+			first = file_size - std::min<uint64_t>(suffix_length, file_size);
+			last = file_size - 1;
+			return RangeResult::SATISFIABLE;
+		}
 
-FileServer::FileServer(uint16_t port, unsigned int thread_count, const std::string& storage_dir, size_t max_file_size)
+		if (!is_number(first_part) || (!last_part.empty() && !is_number(last_part))) {
+			return RangeResult::IGNORED;
+		}
+		first = std::stoull(first_part);
+		uint64_t requested_last = last_part.empty() ? std::numeric_limits<uint64_t>::max() : std::stoull(last_part);
+		if (requested_last < first) {
+			return RangeResult::IGNORED;
+		}
+		if (first >= file_size) {
+			return RangeResult::UNSATISFIABLE;
+		}
+		last = std::min<uint64_t>(requested_last, file_size - 1);
+		return RangeResult::SATISFIABLE;
+	} catch (const std::out_of_range&) {
+		return RangeResult::IGNORED;
+	}
+}
+
+FileServer::FileServer(uint16_t port, unsigned int thread_count, const std::string& storage_dir, size_t max_file_size, size_t max_chunk_size,
+                       bool deduplicate, bool pack_small_files, std::chrono::seconds upload_session_idle_timeout)
 	: _thread_count(thread_count)
 	, _server_port(port)
 	, _storage_dir(storage_dir)
 	, _max_file_size(max_file_size)
+	, _max_chunk_size(std::min(max_chunk_size, max_file_size))
+	, _upload_session_idle_timeout(upload_session_idle_timeout)
 {
 	std::filesystem::create_directory(_storage_dir);
+	remove_stray_temp_files();
+	if (deduplicate) {
+		_blob_store = std::make_unique<BlobStore>(std::filesystem::path(_storage_dir) / "blobs");
+	}
+	if (pack_small_files) {
+		_pack_store = std::make_unique<PackStore>(std::filesystem::path(_storage_dir) / "packs");
+	}
 	INFO_MSG("[FileServer::FileServer] File server created. Port: " + std::to_string(port) + ", with " + std::to_string(thread_count) + " threads");
-	INFO_MSG("[FileServer::FileServer] Storage dir: " + _storage_dir + ", with max file size of: " + std::to_string(_max_file_size) + " bytes");
+	INFO_MSG("[FileServer::FileServer] Storage dir: " + _storage_dir + ", with max file size of: " + std::to_string(_max_file_size) + " bytes, max chunk size: " + std::to_string(_max_chunk_size) + " bytes");
+
+	_session_expiry_thread = std::thread([this]() {
+			session_expiry_loop();
+		});
 }
 
 FileServer::~FileServer() {
 	stop();
+
+	{
+		std::lock_guard<std::mutex> lock(_session_expiry_mutex);
+		_stopped = true;
+	}
+	_session_expiry_cv.notify_all();
+	if (_session_expiry_thread.joinable()) {
+		_session_expiry_thread.join();
+	}
 }
 
 void FileServer::start() {
@@ -32,7 +202,9 @@ void FileServer::start() {
 	try {
 		auto opts = Pistache::Http::Endpoint::options()
 		            .threads(_thread_count)
-		            .flags(Pistache::Tcp::Options::ReuseAddr);
+		            .flags(Pistache::Tcp::Options::ReuseAddr)
+		            // pistache buffers a request body fully, bodies up to the max chunk size are accepted
+		            .maxRequestSize(_max_chunk_size + MAX_REQUEST_HEADERS_BYTES);
 
 		_http_endpoint = std::make_unique<Pistache::Http::Endpoint>(
 			Pistache::Address("*:" + std::to_string(_server_port))
@@ -64,10 +236,6 @@ void FileServer::stop() {
 			_router = std::make_shared<Pistache::Rest::Router>();
 		}
 
-		{
-			std::lock_guard<std::mutex> lock(_file_mutexes_map_mutex);
-			_file_mutexes.clear();
-		}
 		_running = false;
 		_http_endpoint.reset();
 		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
@@ -86,17 +254,35 @@ void FileServer::setup_routes() {
 	Routes::Post(*_router, UPLOAD_ROUTE, Routes::bind(&FileServer::upload_file, this));
 	Routes::Get(*_router, DOWNLOAD_ROUTE, Routes::bind(&FileServer::download_file, this));
 	Routes::Delete(*_router, DELETE_ROUTE, Routes::bind(&FileServer::delete_file, this));
-
-	INFO_MSG("[FileServer::setup_routes] Routes created:\n" + UPLOAD_ROUTE + "\n" + DOWNLOAD_ROUTE + "\n" + DELETE_ROUTE);
+	Routes::Get(*_router, LIMITS_ROUTE, Routes::bind(&FileServer::get_limits, this));
+	Routes::Post(*_router, SESSION_CREATE_ROUTE, Routes::bind(&FileServer::create_upload_session, this));
+	Routes::Put(*_router, SESSION_CHUNK_ROUTE, Routes::bind(&FileServer::write_upload_session_chunk, this));
+	Routes::Get(*_router, SESSION_ROUTE, Routes::bind(&FileServer::get_upload_session, this));
+	Routes::Delete(*_router, SESSION_ROUTE, Routes::bind(&FileServer::abort_upload_session, this));
+	Routes::Post(*_router, SESSION_COMMIT_ROUTE, Routes::bind(&FileServer::commit_upload_session, this));
+	Routes::Post(*_router, DEDUP_ROUTE, Routes::bind(&FileServer::link_by_hash, this));
+
+	INFO_MSG("[FileServer::setup_routes] Routes created:\n" + UPLOAD_ROUTE + "\n" + DOWNLOAD_ROUTE + "\n" + DELETE_ROUTE + "\n" + LIMITS_ROUTE
+	         + "\n" + SESSION_CREATE_ROUTE + "\n" + SESSION_CHUNK_ROUTE + "\n" + SESSION_COMMIT_ROUTE + "\n" + DEDUP_ROUTE);
 }
 
 std::filesystem::path FileServer::get_filepath_by_name(const std::string& filename) const {
 	std::string lvl1_dir = filename.substr(0, 2);
 	std::string lvl2_dir = filename.substr(2, 2);
 
-	std::filesystem::path directories_path = std::filesystem::path(_storage_dir) / lvl1_dir / lvl2_dir;
-	std::filesystem::create_directories(directories_path);
-	return directories_path / filename;
+	return std::filesystem::path(_storage_dir) / lvl1_dir / lvl2_dir / filename;
+}
+
+bool FileServer::create_file_directories(const std::filesystem::path& filepath) const {
+	// no lock needed, an existing directory isn't an error and concurrent creation of the same one is resolved by the file system
+	std::error_code ec;
+	std::filesystem::create_directories(filepath.parent_path(), ec);
+	if (ec) {
+		ERROR_MSG("[FileServer::create_file_directories] Failed to create " + filepath.parent_path().string() + ": " + ec.message());
+		return false;
+	}
+
+	return true;
 }
 
 void FileServer::upload_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
@@ -108,27 +294,21 @@ void FileServer::upload_file(const Pistache::Rest::Request& request, Pistache::H
 		return;
 	}
 
-	std::unique_lock<std::shared_mutex> fs_lock(_file_system_mutex); // exclusive write lock for file system acces
 	std::filesystem::path filepath = get_filepath_by_name(filename);
-	// get or create mutex for specific file
-	std::shared_mutex& file_mutex = [&]() -> std::shared_mutex& {
-										std::lock_guard<std::mutex> map_lock(_file_mutexes_map_mutex);
-										auto& mutex_ptr = _file_mutexes[filepath.string()];
-										if (!mutex_ptr) {
-											mutex_ptr = std::make_unique<std::shared_mutex>();
-										}
+	std::unique_lock<std::shared_mutex> file_lock(_file_locks.get(filepath.string())); // exclusive write lock for specific file
 
-										return *mutex_ptr;
-									}();
-
-	std::unique_lock<std::shared_mutex> file_lock(file_mutex); // exclusive write lock for specific file
+	// a file that shares its blob with others gets its own copy before it's appended to
+	if (_blob_store && !_blob_store->detach(filepath)) {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to write file");
+		return;
+	}
 
 	DEBUG_MSG("[FileServer::upload_file] Filepath is " + filepath.string());
 
 	const std::string& body = request.body();
 
 	size_t raw_data_bytes = body.size();
-	if (raw_data_bytes > CHUNK_SIZE_BYTES) {
+	if (raw_data_bytes > _max_chunk_size) {
 		response.send(Pistache::Http::Code::Bad_Request, "Received raw data size is bigger than acceptable chunk size!");
 		WARN_MSG("[FileServer::upload_file] Received raw data size is bigger than acceptable chunk size. Removing it!");
 		std::filesystem::remove(filepath);
@@ -145,17 +325,44 @@ void FileServer::upload_file(const Pistache::Rest::Request& request, Pistache::H
 
 	DEBUG_MSG("[FileServer::upload_file] Upload file called, filepath:" + filepath.string() + ", body size: " + std::to_string(raw_data_bytes) + " bytes");
 
-	std::ofstream file(filepath, std::ios::binary | std::ios::app);
-	if (!file) {
-		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to create file");
-		WARN_MSG("[FileServer::upload_file] Failed to create file: " + filepath.string());
-		return;
+	// a file whose first chunk is small goes to the pack, any further chunk moves it to its own file,
+	// so a packed object is written once and appends never rewrite it into the segment again
+	std::string data = body;
+	bool unpack = false;
+	if (_pack_store && !std::filesystem::exists(filepath)) {
+		auto packed = _pack_store->get(filename);
+		if (packed && packed->size() > _max_file_size - raw_data_bytes) {
+			response.send(Pistache::Http::Code::Bad_Request, "Size of " + filename + " is more than system limit, removing it");
+			WARN_MSG("[FileServer::upload_file] Size of packed " + filename + " is more than system limit, removing it");
+			_pack_store->remove(filename);
+			return;
+		}
+		if (packed) {
+			data = *packed + body;
+			unpack = true;
+		} else if (data.size() <= _pack_store->get_max_object_size()) {
+			if (_pack_store->put(filename, data)) {
+				response.send(Pistache::Http::Code::Ok, "File uploaded successfully");
+				DEBUG_MSG("[FileServer::upload_file] File " + filename + " packed, " + std::to_string(data.size()) + " bytes");
+			} else {
+				_pack_store->remove(filename);
+				response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to write file");
+				WARN_MSG("[FileServer::upload_file] Failed to pack file: " + filename);
+			}
+			return;
+		}
 	}
 
-	file.write(body.c_str(), raw_data_bytes);
-	file.close();
+	// shard directories only for files that get their own file, packed ones don't need them
+	if (!create_file_directories(filepath)) {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to write file");
+		return;
+	}
 
-	if (file.good()) {
+	if (append_to_file(filepath, data)) {
+		if (unpack) {
+			_pack_store->remove(filename);
+		}
 		response.send(Pistache::Http::Code::Ok, "File uploaded successfully");
 		INFO_MSG("[FileServer::upload_file] File " + filepath.string() +  " uploaded successfully");
 	} else {
@@ -165,97 +372,541 @@ void FileServer::upload_file(const Pistache::Rest::Request& request, Pistache::H
 	}
 }
 
-// sends incorrect amount of chunks and bytes
-void FileServer::download_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
-	auto filename = request.param(":filename").as<std::string>();
+// ETag and Accept-Ranges of the response and the answer to the conditional and range headers of the request:
+// 304 and 416 are sent right away, otherwise the caller sends the range [first, last] or the whole file
+FileServer::DownloadAnswer FileServer::answer_download(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter& response,
+                                                       const std::string& etag, uint64_t file_size, uint64_t& first, uint64_t& last) {
+	response.headers().addRaw(Pistache::Http::Header::Raw("ETag", etag));
+	response.headers().addRaw(Pistache::Http::Header::Raw("Accept-Ranges", "bytes"));
+
+	auto if_none_match = find_raw_header(request, "If-None-Match");
+	if (if_none_match && *if_none_match == etag) {
+		response.send(Pistache::Http::Code::Not_Modified);
+		return DownloadAnswer::SENT;
+	}
 
-	std::shared_lock<std::shared_mutex> fs_lock(_file_system_mutex);
-	auto filepath = get_filepath_by_name(filename);
+	// a range of a file that changed since the client got its first part would be mixed up with the old one
+	auto range_header = find_raw_header(request, "Range");
+	auto if_range = find_raw_header(request, "If-Range");
+	if (!range_header || (if_range && *if_range != etag)) {
+		return DownloadAnswer::WHOLE;
+	}
 
-	// get or create mutex for specific file
-	std::shared_mutex& file_mutex = [&]() -> std::shared_mutex& {
-										std::lock_guard<std::mutex> map_lock(_file_mutexes_map_mutex);
-										auto it = _file_mutexes.find(filepath.string());
-										if (it == _file_mutexes.end()) {
-											_file_mutexes[filepath.string()] = std::make_unique<std::shared_mutex>();
-										}
+	RangeResult range = parse_range(*range_header, file_size, first, last);
+	if (range == RangeResult::UNSATISFIABLE) {
+		response.headers().addRaw(Pistache::Http::Header::Raw("Content-Range", "bytes */" + std::to_string(file_size)));
+		response.send(Pistache::Http::Code::Requested_Range_Not_Satisfiable);
+		return DownloadAnswer::SENT;
+	}
+	if (range == RangeResult::IGNORED) {
+		return DownloadAnswer::WHOLE;
+	}
+	// a range longer than max_chunk_size is cut short, Content-Range tells the client where the body ends
+	// and it asks for the rest with the next request
+	last = std::min<uint64_t>(last, first + _max_chunk_size - 1);
+	return DownloadAnswer::RANGE;
+}
 
-										return *_file_mutexes[filepath.string()];
-									}();
+// whole file in one response streamed by sendfile, or a single byte range of it (206) when the request has a Range header,
+// ETag lets clients resume a download with If-Range and skip an unchanged file with If-None-Match
+void FileServer::download_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
 
-	std::shared_lock<std::shared_mutex> file_lock(file_mutex); // shared read lock for specific file
+	auto filepath = get_filepath_by_name(filename);
+	std::shared_lock<std::shared_mutex> file_lock(_file_locks.get(filepath.string())); // shared read lock for specific file
 
 	DEBUG_MSG("[FileServer::download_file] Download file called, filepath:" + filepath.string());
 
-	if (!std::filesystem::exists(filepath)) {
+	uint64_t first = 0;
+	uint64_t last = 0;
+
+	// a packed file is read with a single pread, ranges are cut from that buffer
+	if (_pack_store) {
+		auto packed = _pack_store->read(filename);
+		if (packed) {
+			std::ostringstream etag;
+			etag << "\"p" << std::hex << packed->_segment_id << '-' << packed->_offset << '-' << packed->_data.size() << '"';
+			uint64_t size = packed->_data.size();
+			switch (answer_download(request, response, etag.str(), size, first, last)) {
+			case DownloadAnswer::SENT:
+				break;
+			case DownloadAnswer::RANGE:
+				send_partial_content(response, packed->_data.substr(first, last - first + 1), first, last, size);
+				break;
+			case DownloadAnswer::WHOLE:
+				response.send(Pistache::Http::Code::Ok, packed->_data, Pistache::Http::Mime::MediaType::fromString("application/octet-stream"));
+				break;
+			}
+			return;
+		}
+	}
+
+	std::error_code ec;
+	uint64_t file_size = std::filesystem::file_size(filepath, ec);
+	if (ec) {
 		response.send(Pistache::Http::Code::Not_Found, "File not found");
 		WARN_MSG("[FileServer::download_file] File " + filepath.string() +  " not found");
 		return;
 	}
 
-	std::ifstream file(filepath, std::ios::binary);
-	if (!file) {
+	switch (answer_download(request, response, make_etag(filepath, file_size), file_size, first, last)) {
+	case DownloadAnswer::SENT:
+		return;
+	case DownloadAnswer::RANGE:
+		send_range(response, filepath, file_size, first, last);
+		return;
+	case DownloadAnswer::WHOLE:
+		break;
+	}
+
+	try {
+		Pistache::Http::serveFile(response, filepath.string(), Pistache::Http::Mime::MediaType::fromString("application/octet-stream"));
+	} catch (const std::exception& e) {
 		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to open file");
-		WARN_MSG("[FileServer::download_file] Failed to open file: " + filepath.string());
+		WARN_MSG("[FileServer::download_file] Failed to serve file " + filepath.string() + ": " + std::string(e.what()));
+	}
+}
+
+// range bodies are read with pread and sent from memory
+void FileServer::send_range(Pistache::Http::ResponseWriter& response, const std::filesystem::path& filepath, uint64_t file_size, uint64_t first, uint64_t last) {
+	int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to open file");
+		WARN_MSG("[FileServer::send_range] Failed to open file: " + filepath.string());
 		return;
 	}
 
-	response.setMime(Pistache::Http::Mime::MediaType::fromString("application/octet-stream"));
-	std::vector<char> buffer(CHUNK_SIZE_BYTES);
+	std::string body(last - first + 1, '\0');
+	size_t read = 0;
+	while (read < body.size()) {
+		ssize_t bytes = ::pread(fd, body.data() + read, body.size() - read, static_cast<off_t>(first + read));
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes <= 0) {
+			break;
+		}
+		read += static_cast<size_t>(bytes);
+	}
+	::close(fd);
 
-	while (file) {
-		file.read(buffer.data(), CHUNK_SIZE_BYTES);
-		auto bytes_read = file.gcount();
-		response.send(Pistache::Http::Code::Ok, std::string(buffer.data(), bytes_read));
+	if (read != body.size()) {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to read file");
+		WARN_MSG("[FileServer::send_range] Failed to read bytes " + std::to_string(first) + "-" + std::to_string(last) + " of " + filepath.string());
+		return;
 	}
+
+	send_partial_content(response, body, first, last, file_size);
+}
+
+void FileServer::send_partial_content(Pistache::Http::ResponseWriter& response, const std::string& body, uint64_t first, uint64_t last, uint64_t file_size) {
+	response.headers().addRaw(Pistache::Http::Header::Raw("Content-Range",
+	                                                      "bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(file_size)));
+	response.send(Pistache::Http::Code::Partial_Content, body, Pistache::Http::Mime::MediaType::fromString("application/octet-stream"));
 }
 
 void FileServer::delete_file(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
 	auto filename = request.param(":filename").as<std::string>();
 
-	std::unique_lock<std::shared_mutex> fs_lock(_file_system_mutex);
-	auto filepath = std::filesystem::path(_storage_dir) / filename;
+	if (!is_valid_filename(filename)) {
+		response.send(Pistache::Http::Code::Bad_Request, "Invalid filename " + filename);
+		WARN_MSG("[FileServer::delete_file] Invalid filename " + filename);
+		return;
+	}
+
+	auto filepath = get_filepath_by_name(filename);
+	std::unique_lock<std::shared_mutex> file_lock(_file_locks.get(filepath.string()));
+
+	DEBUG_MSG("[FileServer::delete_file] Delete file called, filepath:" + filepath.string());
 
-	try {
-		std::shared_mutex& file_mutex = [&]() -> std::shared_mutex& {
-											std::lock_guard<std::mutex> map_lock(_file_mutexes_map_mutex);
-											auto it = _file_mutexes.find(filepath.string());
-											if (it == _file_mutexes.end()) {
-												throw std::runtime_error("File not found");
-											}
+	std::error_code ec;
+	if ((_pack_store && _pack_store->remove(filename)) || (_blob_store ? _blob_store->remove(filepath) : std::filesystem::remove(filepath, ec))) {
+		response.send(Pistache::Http::Code::Ok, "File deleted successfully");
+		DEBUG_MSG("[FileServer::delete_file] File " + filepath.string() + " deleted successfully");
+	} else if (!ec) {
+		response.send(Pistache::Http::Code::Not_Found, "File not found");
+		WARN_MSG("[FileServer::delete_file] File " + filepath.string() + " not found");
+	} else {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to delete file");
+		WARN_MSG("[FileServer::delete_file] Failed to delete file " + filepath.string() + ": " + ec.message());
+	}
+}
+
+// upload limits for clients to size their chunks by, bodies of up to max_chunk_size bytes are accepted
+void FileServer::get_limits(const Pistache::Rest::Request&, Pistache::Http::ResponseWriter response) {
+	response.setMime(Pistache::Http::Mime::MediaType::fromString("application/json"));
+	response.send(Pistache::Http::Code::Ok, "{\"max_chunk_size\":" + std::to_string(_max_chunk_size)
+	              + ",\"max_file_size\":" + std::to_string(_max_file_size)
+	              + ",\"deduplicate\":" + (_blob_store ? "true" : "false")
+	              + ",\"pack_small_files\":" + (_pack_store ? "true" : "false") + "}");
+}
 
-											return *(it->second);
-										}();
+void FileServer::UploadSession::touch() {
+	_last_active = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+FileServer::UploadSession::~UploadSession() {
+	if (!_closed && _fd >= 0) {
+		::close(_fd);
+	}
+}
+
+std::shared_ptr<FileServer::UploadSession> FileServer::find_upload_session(const std::string& filename) {
+	std::lock_guard<std::mutex> lock(_upload_sessions_mutex);
+	auto it = _upload_sessions.find(filename);
+	return it == _upload_sessions.end() ? nullptr : it->second;
+}
+
+void FileServer::close_upload_session(const std::string& filename, UploadSession& session) {
+	::close(session._fd);
+	session._closed = true;
+
+	std::lock_guard<std::mutex> lock(_upload_sessions_mutex);
+	auto it = _upload_sessions.find(filename);
+	if (it != _upload_sessions.end() && it->second.get() == &session) {
+		_upload_sessions.erase(it);
+	}
+}
+
+// {"size": N, "received": M, "ranges": [[first, end], ...]}, ranges are the bytes [first, end) already written
+std::string FileServer::get_upload_session_status(UploadSession& session) {
+	std::lock_guard<std::mutex> lock(session._received_mutex);
+	std::string ranges;
+	for (const auto& [first, end] : session._received.ranges()) {
+		ranges += (ranges.empty() ? "[" : ",[") + std::to_string(first) + "," + std::to_string(end) + "]";
+	}
+	return "{\"size\":" + std::to_string(session._size) + ",\"received\":" + std::to_string(session._received.covered())
+	       + ",\"ranges\":[" + ranges + "]}";
+}
+
+void FileServer::expire_upload_sessions() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+	auto timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(_upload_session_idle_timeout).count();
+	auto is_idle = [now, timeout](const UploadSession& session) {
+			return now - session._last_active > timeout;
+		};
+
+	std::vector<std::pair<std::string, std::shared_ptr<UploadSession> > > idle_sessions;
+	{
+		std::lock_guard<std::mutex> lock(_upload_sessions_mutex);
+		for (const auto& [filename, session] : _upload_sessions) {
+			if (is_idle(*session)) {
+				idle_sessions.emplace_back(filename, session);
+			}
+		}
+	}
+
+	for (auto& [filename, session] : idle_sessions) {
+		std::unique_lock<std::shared_mutex> io_lock(session->_io_mutex);
+		// a chunk may have come in since the scan
+		if (session->_closed || !is_idle(*session)) {
+			continue;
+		}
+		close_upload_session(filename, *session);
+		std::error_code ec;
+		std::filesystem::remove(session->_part_path, ec);
+		INFO_MSG("[FileServer::expire_upload_sessions] Upload session for " + filename + " was idle for more than "
+		         + std::to_string(_upload_session_idle_timeout.count()) + " s, aborted");
+	}
+}
+
+void FileServer::session_expiry_loop() {
+	// a session is removed at most a minute after its timeout
+	auto interval = std::clamp<std::chrono::seconds>(_upload_session_idle_timeout, std::chrono::seconds(1), std::chrono::seconds(60));
+	std::unique_lock<std::mutex> lock(_session_expiry_mutex);
+	while (!_session_expiry_cv.wait_for(lock, interval, [this]() {
+			return _stopped;
+		})) {
+		lock.unlock();
+		expire_upload_sessions();
+		lock.lock();
+	}
+}
+
+// files are at <storage>/ab/cd/<name>, blobs/ and packs/ aren't looked into
+void FileServer::remove_stray_temp_files() {
+	std::error_code ec;
+	size_t removed = 0;
+	for (auto it = std::filesystem::recursive_directory_iterator(_storage_dir, ec); !ec && it != std::filesystem::recursive_directory_iterator();
+	     it.increment(ec)) {
+		std::error_code status_ec;
+		bool is_directory = it->is_directory(status_ec);
+		if (is_directory && (it.depth() > 1 || it->path().filename().string().size() != 2)) {
+			it.disable_recursion_pending();
+		} else if (!is_directory && it.depth() == 2 && is_temp_extension(it->path().extension().string())) {
+			std::error_code remove_ec;
+			removed += std::filesystem::remove(it->path(), remove_ec);
+		}
+	}
+	if (removed > 0) {
+		INFO_MSG("[FileServer::remove_stray_temp_files] Removed " + std::to_string(removed) + " temporary files of the previous run");
+	}
+}
+
+// creating a session that exists with the same size returns its status, a client resumes an interrupted upload that way
+void FileServer::create_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
+	uint64_t size = 0;
 
-		DEBUG_MSG("[FileServer::delete_file] Delete file called, filepath:" + filepath.string());
+	if (!is_valid_filename(filename) || !parse_uint64(request.param(":size").as<std::string>(), size)) {
+		response.send(Pistache::Http::Code::Bad_Request, "Invalid filename or size");
+		WARN_MSG("[FileServer::create_upload_session] Invalid filename or size for " + filename);
+		return;
+	}
+	if (size > _max_file_size) {
+		response.send(Pistache::Http::Code::Bad_Request, "File size " + std::to_string(size) + " is more than system limit");
+		WARN_MSG("[FileServer::create_upload_session] File size " + std::to_string(size) + " of " + filename + " is more than system limit");
+		return;
+	}
+
+	std::filesystem::path filepath = get_filepath_by_name(filename);
+	if (!create_file_directories(filepath)) {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to create upload session");
+		return;
+	}
 
-		std::unique_lock<std::shared_mutex> file_lock(file_mutex);
+	std::shared_ptr<UploadSession> session;
+	{
+		std::lock_guard<std::mutex> lock(_upload_sessions_mutex);
+		auto it = _upload_sessions.find(filename);
+		if (it != _upload_sessions.end()) {
+			session = it->second;
+		} else {
+			if (std::filesystem::exists(filepath) || (_pack_store && _pack_store->contains(filename))) {
+				response.send(Pistache::Http::Code::Conflict, "File " + filename + " already exists");
+				WARN_MSG("[FileServer::create_upload_session] File " + filepath.string() + " already exists");
+				return;
+			}
+
+			session = std::make_shared<UploadSession>();
+			session->_size = size;
+			session->touch();
+			session->_part_path = filepath.string() + ".part";
+			// a part file left by a previous run has unknown content, it's written from scratch
+			session->_fd = ::open(session->_part_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			if (session->_fd < 0) {
+				session->_closed = true;
+				response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to create upload session");
+				ERROR_MSG("[FileServer::create_upload_session] Failed to open " + session->_part_path.string());
+				return;
+			}
 
-		if (!std::filesystem::exists(filepath)) {
-			response.send(Pistache::Http::Code::Not_Found, "File not found");
-			WARN_MSG("[FileServer::delete_file] File " + filepath.string() + " not found");
+			// blocks are reserved up front, chunk writes can't run out of space and the file isn't fragmented
+			// by chunks written out of order, file systems without fallocate get a sparse file of the right size
+			int result = size == 0 ? 0 : ::fallocate(session->_fd, 0, 0, static_cast<off_t>(size));
+			if (result != 0 && errno == EOPNOTSUPP) {
+				result = ::ftruncate(session->_fd, static_cast<off_t>(size));
+			}
+			if (result != 0) {
+				response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to allocate " + std::to_string(size) + " bytes");
+				ERROR_MSG("[FileServer::create_upload_session] Failed to allocate " + std::to_string(size) + " bytes for "
+				          + session->_part_path.string() + ": " + std::strerror(errno));
+				::close(session->_fd);
+				session->_closed = true;
+				std::filesystem::remove(session->_part_path);
+				return;
+			}
+
+			_upload_sessions[filename] = session;
+			DEBUG_MSG("[FileServer::create_upload_session] Upload session for " + filepath.string() + " of " + std::to_string(size) + " bytes created");
+		}
+	}
+
+	session->touch();
+	if (session->_size != size) {
+		response.send(Pistache::Http::Code::Conflict, "Upload session for " + filename + " exists with size " + std::to_string(session->_size));
+		WARN_MSG("[FileServer::create_upload_session] Upload session for " + filename + " exists with another size");
+		return;
+	}
+
+	response.setMime(Pistache::Http::Mime::MediaType::fromString("application/json"));
+	response.send(Pistache::Http::Code::Ok, get_upload_session_status(*session));
+}
+
+// chunks of one session are written concurrently, pwrite doesn't share a file position between them
+void FileServer::write_upload_session_chunk(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
+	uint64_t offset = 0;
+	if (!parse_uint64(request.param(":offset").as<std::string>(), offset)) {
+		response.send(Pistache::Http::Code::Bad_Request, "Invalid offset");
+		return;
+	}
+
+	auto session = find_upload_session(filename);
+	if (!session) {
+		response.send(Pistache::Http::Code::Not_Found, "Upload session not found");
+		WARN_MSG("[FileServer::write_upload_session_chunk] Upload session for " + filename + " not found");
+		return;
+	}
+
+	const std::string& body = request.body();
+	if (offset > session->_size || body.size() > session->_size - offset) {
+		response.send(Pistache::Http::Code::Bad_Request, "Chunk is out of the file bounds");
+		WARN_MSG("[FileServer::write_upload_session_chunk] Chunk of " + std::to_string(body.size()) + " bytes at " + std::to_string(offset)
+		         + " is out of the " + std::to_string(session->_size) + " bytes of " + filename);
+		return;
+	}
+
+	{
+		std::shared_lock<std::shared_mutex> io_lock(session->_io_mutex);
+		if (session->_closed) {
+			response.send(Pistache::Http::Code::Not_Found, "Upload session not found");
+			return;
+		}
+		session->touch();
+		if (!write_at(session->_fd, body, offset)) {
+			response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to write chunk");
+			WARN_MSG("[FileServer::write_upload_session_chunk] Failed to write " + std::to_string(body.size()) + " bytes at "
+			         + std::to_string(offset) + " of " + session->_part_path.string());
 			return;
 		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(session->_received_mutex);
+		session->_received.insert(offset, offset + body.size());
+	}
+
+	response.setMime(Pistache::Http::Mime::MediaType::fromString("application/json"));
+	response.send(Pistache::Http::Code::Ok, get_upload_session_status(*session));
+}
+
+void FileServer::get_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
+	auto session = find_upload_session(filename);
+	if (!session) {
+		response.send(Pistache::Http::Code::Not_Found, "Upload session not found");
+		return;
+	}
+
+	session->touch();
+	response.setMime(Pistache::Http::Mime::MediaType::fromString("application/json"));
+	response.send(Pistache::Http::Code::Ok, get_upload_session_status(*session));
+}
 
-		if (std::filesystem::remove(filepath)) {
-			std::lock_guard<std::mutex> map_lock(_file_mutexes_map_mutex);
-			_file_mutexes.erase(filepath.string());
-			response.send(Pistache::Http::Code::Ok, "File deleted successfully");
-			DEBUG_MSG("[FileServer::delete_file] File " + filepath.string() + " deleted successfully");
+// the part file is synced and renamed over the final name, downloads see either no file or the whole of it,
+// the session stays registered until then, so a create of the same name meanwhile finds it and doesn't truncate the part file
+void FileServer::commit_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
+	auto session = find_upload_session(filename);
+	if (!session) {
+		response.send(Pistache::Http::Code::Not_Found, "Upload session not found");
+		WARN_MSG("[FileServer::commit_upload_session] Upload session for " + filename + " not found");
+		return;
+	}
+
+	std::unique_lock<std::shared_mutex> io_lock(session->_io_mutex);
+	if (session->_closed) {
+		response.send(Pistache::Http::Code::Not_Found, "Upload session not found");
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(session->_received_mutex);
+		if (session->_received.covered() != session->_size) {
+			response.setMime(Pistache::Http::Mime::MediaType::fromString("application/json"));
+			response.send(Pistache::Http::Code::Conflict, "{\"error\":\"incomplete\",\"missing\":"
+			              + std::to_string(session->_size - session->_received.covered()) + "}");
+			WARN_MSG("[FileServer::commit_upload_session] Upload of " + filename + " is incomplete");
+			return;
+		}
+	}
+
+	bool synced = ::fsync(session->_fd) == 0;
+
+	std::filesystem::path filepath = get_filepath_by_name(filename);
+	std::error_code ec;
+	bool committed = false;
+	if (synced) {
+		std::unique_lock<std::shared_mutex> file_lock(_file_locks.get(filepath.string()));
+		if (_blob_store) {
+			committed = _blob_store->store(session->_part_path, filepath);
 		} else {
-			response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to delete file");
-			WARN_MSG("[FileServer::delete_file] Failed to delete file: " + filepath.string());
+			std::filesystem::rename(session->_part_path, filepath, ec);
+			committed = !ec;
 		}
-	} catch (const std::runtime_error& re) {
-		WARN_MSG("[FileServer::delete_file] File not found");
-		response.send(Pistache::Http::Code::Not_Found, "File not found");
-		WARN_MSG("[FileServer::delete_file] File " + filepath.string() + " not found");
+		// a packed file of the same name uploaded while the session was open is replaced
+		if (committed && _pack_store) {
+			_pack_store->remove(filename);
+		}
+	}
+	close_upload_session(filename, *session);
+	if (!committed) {
+		std::filesystem::remove(session->_part_path);
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to commit file");
+		ERROR_MSG("[FileServer::commit_upload_session] Failed to commit " + session->_part_path.string()
+		          + (!synced ? ": fsync failed" : ec ? ": " + ec.message() : ""));
+		return;
+	}
+
+	response.send(Pistache::Http::Code::Ok, "File committed successfully");
+	INFO_MSG("[FileServer::commit_upload_session] File " + filepath.string() + " committed, " + std::to_string(session->_size) + " bytes");
+}
+
+void FileServer::abort_upload_session(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
+	auto session = find_upload_session(filename);
+	if (!session) {
+		response.send(Pistache::Http::Code::Not_Found, "Upload session not found");
+		return;
+	}
+
+	std::unique_lock<std::shared_mutex> io_lock(session->_io_mutex);
+	if (!session->_closed) {
+		close_upload_session(filename, *session);
+		std::filesystem::remove(session->_part_path);
+	}
+
+	response.send(Pistache::Http::Code::Ok, "Upload session aborted");
+	DEBUG_MSG("[FileServer::abort_upload_session] Upload session for " + filename + " aborted");
+}
+
+// hash first upload: a client that knows the sha256 of its file asks for a reference to stored content
+// before sending any of it, 404 means the content has to be uploaded.
+// the hash is taken as proof of having the content, so anyone who learns a hash can link and then download it,
+// and the 200/404 tells whether some content is stored at all; the route is meant for the chat server only,
+// which hashes bytes it received itself (FileServerClient::upload_file_deduplicated), the file server
+// has to stay unreachable for end users when deduplication is on
+void FileServer::link_by_hash(const Pistache::Rest::Request& request, Pistache::Http::ResponseWriter response) {
+	auto filename = request.param(":filename").as<std::string>();
+	auto hash = request.param(":hash").as<std::string>();
+
+	if (!_blob_store) {
+		response.send(Pistache::Http::Code::Not_Found, "Deduplication is off");
+		return;
+	}
+	if (!is_valid_filename(filename) || !BlobStore::is_valid_hash(hash)) {
+		response.send(Pistache::Http::Code::Bad_Request, "Invalid filename or hash");
+		WARN_MSG("[FileServer::link_by_hash] Invalid filename " + filename + " or hash " + hash);
+		return;
+	}
+
+	std::filesystem::path filepath = get_filepath_by_name(filename);
+	if (!create_file_directories(filepath)) {
+		response.send(Pistache::Http::Code::Internal_Server_Error, "Failed to link file");
 		return;
 	}
+
+	std::unique_lock<std::shared_mutex> file_lock(_file_locks.get(filepath.string()));
+	if (!_blob_store->link(hash, filepath)) {
+		response.send(Pistache::Http::Code::Not_Found, "Content not found");
+		DEBUG_MSG("[FileServer::link_by_hash] No blob " + hash + " for " + filename);
+		return;
+	}
+	if (_pack_store) {
+		_pack_store->remove(filename);
+	}
+
+	response.send(Pistache::Http::Code::Ok, "File linked successfully");
+	DEBUG_MSG("[FileServer::link_by_hash] File " + filepath.string() + " linked to blob " + hash);
 }
 
 bool FileServer::is_valid_filename(const std::string& filename) const {
 	std::filesystem::path file_path(filename);
+	// reserved for the part files of upload sessions and the temporary files of BlobStore
+	if (is_temp_extension(file_path.extension().string())) {
+		return false;
+	}
 	std::string str = file_path.stem().string();
 
 	if (str.size() != FILENAME_LEN) {
@@ -1,5 +1,12 @@
 #include "file_server_client.hpp"
+#include "sha256.hpp"
+
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
+#include <thread>
 
 namespace file_server {
 
@@ -7,42 +14,153 @@ namespace beast = boost::beast;
 namespace http = beast::http;
 using tcp = boost::asio::ip::tcp;
 
-FileServerClient::FileServerClient(const std::string& host, const std::string& port)
-	: _host(host), _port(port), _resolver(_io_context), _stream(_io_context) {
+// what file servers without the limits route accept
+static constexpr size_t LEGACY_CHUNK_SIZE_BYTES = 512;
+// file_chunk pieces of a downloaded file
+static constexpr size_t DOWNLOAD_CHUNK_SIZE_BYTES = 64 * 1024;
+
+FileServerClient::FileServerClient(const std::string& host, const std::string& port, const FileServerClientConfig& config)
+	: _host(host), _port(port), _config(config) {
+	_config._max_connections = std::max<size_t>(1, _config._max_connections);
+	_config._pipeline_depth = std::max<size_t>(1, _config._pipeline_depth);
 }
 
-std::string FileServerClient::send_request(const std::string& target, http::verb method, const std::string& body) {
+// an idle connection the server has closed reads as eof right away, nothing else may arrive on it between requests
+static bool is_closed_by_peer(tcp::socket& socket) {
+	char byte;
+	ssize_t peeked = ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	return peeked >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+std::unique_ptr<FileServerClient::Connection> FileServerClient::acquire() {
+	while (true) {
+		std::unique_ptr<Connection> connection;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_connection_released.wait(lock, [this]() {
+					return !_idle_connections.empty() || _open_connections < _config._max_connections;
+				});
+
+			if (_idle_connections.empty()) {
+				++_open_connections;
+				break;
+			}
+			connection = std::move(_idle_connections.back());
+			_idle_connections.pop_back();
+		}
+
+		// found before the request is written, so even a request that can't be retried gets a live connection
+		if (!is_closed_by_peer(connection->_stream.socket())) {
+			connection->_reused = true;
+			return connection;
+		}
+		DEBUG_MSG("[FileServerClient::acquire] Idle connection was closed by the server, dropping it");
+		release(nullptr, false);
+	}
+
 	try {
-		auto const results = _resolver.resolve(_host, _port);
-		_stream.connect(results);
+		return connect();
+	} catch (...) {
+		release(nullptr, false);
+		throw;
+	}
+}
 
-		http::request<http::string_body> req{method, target, _version};
-		req.set(http::field::host, _host);
-		req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+// connections the server is going to close or that failed mid-request are dropped, a new one is opened on demand
+void FileServerClient::release(std::unique_ptr<Connection> connection, bool keep_alive) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (connection && keep_alive) {
+			_idle_connections.push_back(std::move(connection));
+		} else {
+			--_open_connections;
+		}
+	}
+	_connection_released.notify_one();
+}
 
-		if (!body.empty()) {
-			req.body() = body;
-			req.prepare_payload();
+std::unique_ptr<FileServerClient::Connection> FileServerClient::connect() {
+	tcp::resolver::results_type endpoints;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_endpoints.empty()) {
+			tcp::resolver resolver(_io_context);
+			_endpoints = resolver.resolve(_host, _port);
 		}
+		endpoints = _endpoints;
+	}
 
-		// too big
-		// DEBUG_MSG("[FileServerClient::send_request] Sending request: " + req.body());
-		http::write(_stream, req);
+	auto connection = std::make_unique<Connection>(_io_context);
+	beast::error_code ec;
+	connection->_stream.connect(endpoints, ec);
+	if (ec) {
+		// the address may have changed, resolve again on the next connect
+		std::lock_guard<std::mutex> lock(_mutex);
+		_endpoints = {};
+		throw beast::system_error{ec};
+	}
+	connection->_stream.socket().set_option(tcp::no_delay(true));
 
-		beast::flat_buffer buffer;
-		http::response<http::dynamic_body> res;
-		http::read(_stream, buffer, res);
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_connections_opened;
+	DEBUG_MSG("[FileServerClient::connect] Connected to " + _host + ":" + _port + ", connections opened so far: " + std::to_string(_connections_opened));
+	return connection;
+}
 
-		std::string response_body = beast::buffers_to_string(res.body().data());
+http::request<http::string_body> FileServerClient::make_request(http::verb method, const std::string& target, const std::string& body) const {
+	http::request<http::string_body> req{method, target, _version};
+	req.set(http::field::host, _host);
+	req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+	req.keep_alive(true);
 
-		beast::error_code ec;
-		_stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+	if (!body.empty()) {
+		req.set(http::field::content_type, "application/octet-stream");
+		req.body() = body;
+	}
+	req.prepare_payload();
+	return req;
+}
+
+// GET, PUT of a session chunk and DELETE leave the server in the same state when they are done twice,
+// an append with POST "/upload" doesn't
+static bool is_idempotent(http::verb method) {
+	return method == http::verb::get || method == http::verb::head || method == http::verb::put || method == http::verb::delete_;
+}
 
-		if(ec && ec != beast::errc::not_connected) {
-			throw beast::system_error{ec};
+http::response<http::string_body> FileServerClient::perform(const http::request<http::string_body>& request) {
+	for (int attempt = 0;; ++attempt) {
+		auto connection = acquire();
+		bool written = false;
+		try {
+			http::write(connection->_stream, request);
+			written = true;
+
+			// downloads are whole files in one response, the parser default limit of 8 MB is too low for them
+			http::response_parser<http::string_body> parser;
+			parser.body_limit(boost::none);
+			http::read(connection->_stream, connection->_buffer, parser);
+
+			http::response<http::string_body> res = parser.release();
+			bool keep_alive = res.keep_alive();
+			release(std::move(connection), keep_alive);
+			return res;
+		} catch (const std::exception& e) {
+			// once the request is written the server may have handled it before the connection broke
+			bool retry = connection->_reused && attempt == 0 && (!written || is_idempotent(request.method()));
+			release(nullptr, false);
+			if (!retry) {
+				throw;
+			}
+			DEBUG_MSG("[FileServerClient::perform] Reused connection failed (" + std::string(e.what()) + "), reconnecting");
 		}
+	}
+}
 
-		return response_body;
+std::string FileServerClient::send_request(const std::string& target, http::verb method, const std::string& body) {
+	try {
+		// too big
+		// DEBUG_MSG("[FileServerClient::send_request] Sending request: " + req.body());
+		return perform(make_request(method, target, body)).body();
 	}
 	catch(std::exception const& e) {
 		ERROR_MSG("[FileServerClient::send_request] " + std::string(e.what()));
@@ -50,172 +168,332 @@ std::string FileServerClient::send_request(const std::string& target, http::verb
 	}
 }
 
+size_t FileServerClient::get_connections_opened() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _connections_opened;
+}
 
-// std::string FileServerClient::upload_file(const std::string& filename, const std::string& filepath) {
-// 	auto start_time = std::chrono::high_resolution_clock::now();
 
-// 	std::filesystem::path full_path = std::filesystem::path(filepath) / filename;
-// 	std::ifstream file(full_path, std::ios::binary);
-// 	if (!file) {
-// 		ERROR_MSG("[FileServerClient::upload_file] Unable to open file: " + full_path.string());
-// 		return "Error: Unable to open file: " + full_path.string();
-// 	}
+size_t FileServerClient::get_max_chunk_size() {
+	size_t chunk_size = _negotiated_chunk_size;
+	if (chunk_size != 0) {
+		return chunk_size;
+	}
 
-// 	const size_t chunk_size = 512;
-// 	std::vector<char> buffer(chunk_size);
-// 	std::string response;
+	chunk_size = LEGACY_CHUNK_SIZE_BYTES;
+	try {
+		auto res = perform(make_request(http::verb::get, "/limits", ""));
+		if (res.result() == http::status::ok) {
+			chunk_size = nlohmann::json::parse(res.body()).at("max_chunk_size").get<size_t>();
+		} else {
+			WARN_MSG("[FileServerClient::get_max_chunk_size] File server has no limits route, using " + std::to_string(chunk_size) + " byte chunks");
+		}
+	}
+	catch(std::exception const& e) {
+		// not cached, asked again next time
+		ERROR_MSG("[FileServerClient::get_max_chunk_size] " + std::string(e.what()));
+		return _config._max_chunk_size != 0 ? std::min(_config._max_chunk_size, LEGACY_CHUNK_SIZE_BYTES) : LEGACY_CHUNK_SIZE_BYTES;
+	}
 
-// 	try {
-// 		auto const results = _resolver.resolve(_host, _port);
-// 		_stream.connect(results);
+	if (_config._max_chunk_size != 0) {
+		chunk_size = std::min(chunk_size, _config._max_chunk_size);
+	}
+	chunk_size = std::max<size_t>(1, chunk_size);
+	_negotiated_chunk_size = chunk_size;
+	DEBUG_MSG("[FileServerClient::get_max_chunk_size] Upload chunk size: " + std::to_string(chunk_size) + " bytes");
+	return chunk_size;
+}
 
-// 		size_t total_bytes_sent = 0;
-// 		while (!file.eof()) {
-// 			file.read(buffer.data(), chunk_size);
-// 			std::streamsize bytes_read = file.gcount();
+bool FileServerClient::upload_file(const std::string& filename, const std::filesystem::path& filepath) {
+	std::ifstream file(filepath, std::ios::binary);
+	if (!file) {
+		ERROR_MSG("[FileServerClient::upload_file] Unable to open file: " + filepath.string());
+		return false;
+	}
 
-// 			if (bytes_read == 0) {
-// 				break;
-// 			}
+	std::string chunk(get_max_chunk_size(), '\0');
+	size_t total_bytes_sent = 0;
+	while (file) {
+		file.read(chunk.data(), chunk.size());
+		size_t bytes_read = static_cast<size_t>(file.gcount());
+		if (bytes_read == 0) {
+			break;
+		}
 
-// 			http::request<http::string_body> req{http::verb::post, "/upload/" + filename, _version};
-// 			req.set(http::field::host, _host);
-// 			req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-// 			req.set(http::field::content_type, "application/octet-stream");
-// 			req.body().assign(buffer.data(), bytes_read);
-// 			req.prepare_payload();
+		chunk.resize(bytes_read);
+		if (!upload_chunk(filename, chunk)) {
+			ERROR_MSG("[FileServerClient::upload_file] Upload of " + filepath.string() + " failed after " + std::to_string(total_bytes_sent) + " bytes");
+			return false;
+		}
+		total_bytes_sent += bytes_read;
+	}
 
-// 			// too big
-// 			// DEBUG_MSG("[FileServerClient::send_request] Sending request: " + req.body());
+	DEBUG_MSG("[FileServerClient::upload_file] Uploaded " + filepath.string() + ", " + std::to_string(total_bytes_sent) + " bytes");
+	return true;
+}
 
-// 			http::write(_stream, req);
+bool FileServerClient::upload_chunk(const std::string& filename, const std::string& chunk_data) {
+	try {
+		auto res = perform(make_request(http::verb::post, "/upload/" + filename, chunk_data));
+		DEBUG_MSG("[FileServerClient::upload_chunk] Response body: " + res.body());
 
-// 			beast::flat_buffer buffer;
-// 			http::response<http::dynamic_body> res;
-// 			http::read(_stream, buffer, res);
+		return res.body() == "File uploaded successfully";
+	}
+	catch(std::exception const& e) {
+		ERROR_MSG("[FileServerClient::upload_chunk] Exception: " + std::string(e.what()));
+		return false;
+	}
+}
 
-// 			response = beast::buffers_to_string(res.body().data());
-// 			total_bytes_sent += bytes_read;
-// 			DEBUG_MSG("[FileServerClient::upload_file] Chunk sent. Total bytes sent: " +  std::to_string(total_bytes_sent));
-// 		}
+// the server handles requests of one connection in order, so the chunks are appended in order as well,
+// a failure in the middle leaves it unknown which of the chunks in flight were stored, there is no retry then
+bool FileServerClient::upload_chunks(const std::string& filename, const std::vector<std::string>& chunks) {
+	if (chunks.empty()) {
+		return true;
+	}
 
-// 		beast::error_code ec;
-// 		_stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+	std::unique_ptr<Connection> connection;
+	try {
+		connection = acquire();
+
+		size_t written = 0;
+		bool uploaded = true;
+		bool keep_alive = true;
+		for (size_t read = 0; read < chunks.size(); ++read) {
+			for (; written < chunks.size() && written < read + _config._pipeline_depth; ++written) {
+				http::write(connection->_stream, make_request(http::verb::post, "/upload/" + filename, chunks[written]));
+			}
 
-// 		if(ec && ec != beast::errc::not_connected) {
-// 			throw beast::system_error{ec};
-// 		}
-// 	}
-// 	catch(std::exception const& e) {
-// 		ERROR_MSG("[FileServerClient::upload_file] " +  std::string(e.what()));
-// 		return "Error during upload: " + std::string(e.what());
-// 	}
-// 	auto end_time = std::chrono::high_resolution_clock::now();
-// 	std::chrono::duration<double, std::milli> total_time_ms = end_time - start_time;
+			http::response<http::string_body> res;
+			http::read(connection->_stream, connection->_buffer, res);
+			keep_alive = keep_alive && res.keep_alive();
+			if (res.body() != "File uploaded successfully") {
+				ERROR_MSG("[FileServerClient::upload_chunks] Chunk " + std::to_string(read) + " of " + filename + " failed: " + res.body());
+				uploaded = false;
+			}
+			if (!keep_alive && read + 1 < chunks.size()) {
+				ERROR_MSG("[FileServerClient::upload_chunks] Server closed the connection after chunk " + std::to_string(read) + " of " + filename);
+				release(std::move(connection), false);
+				return false;
+			}
+		}
 
-// 	DEBUG_MSG("[FileServerClient::upload_file] Chunk uploaded successfully. Execution time: " + std::to_string(total_time_ms.count())
-// 	          + " ms. Server response: " + response);
-// 	return "File uploaded successfully. Server response: " + response;
-// }
+		release(std::move(connection), keep_alive);
+		return uploaded;
+	}
+	catch(std::exception const& e) {
+		ERROR_MSG("[FileServerClient::upload_chunks] Exception: " + std::string(e.what()));
+		if (connection) {
+			release(nullptr, false);
+		}
+		return false;
+	}
+}
 
-bool FileServerClient::upload_chunk(const std::string& filename, const std::string& chunk_data) {
-	try {
-		auto const results = _resolver.resolve(_host, _port);
-		_stream.connect(results);
-		DEBUG_MSG("[FileServerClient::upload_chunk] Connected to host");
+// the file server answers with one response of the whole file, it's split into chunks for the chat server to relay
+std::vector<std::string> FileServerClient::download_file_chunks(const std::string& filename) {
+	std::vector<std::string> chunks;
+	std::string file = download_file(filename);
 
-		http::request<http::string_body> req{http::verb::post, "/upload/" + filename, _version};
-		req.set(http::field::host, _host);
-		req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-		req.set(http::field::content_type, "application/octet-stream");
-		req.body() = chunk_data;
-		req.prepare_payload();
+	for (size_t offset = 0; offset < file.size(); offset += DOWNLOAD_CHUNK_SIZE_BYTES) {
+		chunks.push_back(file.substr(offset, DOWNLOAD_CHUNK_SIZE_BYTES));
+	}
+	DEBUG_MSG("[FileServerClient::download_file_chunks] Downloaded " + filename + ", " + std::to_string(file.size())
+	          + " bytes in " + std::to_string(chunks.size()) + " chunks");
 
-		DEBUG_MSG("[FileServerClient::upload_chunk] Sending reques body: " + req.body());
+	return chunks;
+}
 
-		http::write(_stream, req);
+std::string FileServerClient::download_file(const std::string& filename) {
+	try {
+		auto res = perform(make_request(http::verb::get, "/download/" + filename, ""));
+		if (res.result() != http::status::ok) {
+			ERROR_MSG("[FileServerClient::download_file] Download of " + filename + " failed: " + res.body());
+			return "";
+		}
+		return std::move(res.body());
+	}
+	catch(std::exception const& e) {
+		ERROR_MSG("[FileServerClient::download_file] " + std::string(e.what()));
+		return "";
+	}
+}
 
-		beast::flat_buffer buffer;
-		http::response<http::dynamic_body> res;
-		http::read(_stream, buffer, res);
+std::optional<std::string> FileServerClient::download_range(const std::string& filename, uint64_t offset, uint64_t length, const std::string& etag) {
+	if (length == 0) {
+		return std::string();
+	}
 
-		std::string response_body = beast::buffers_to_string(res.body().data());
-		DEBUG_MSG("[FileServerClient::upload_chunk] Response body: " + response_body);
+	try {
+		auto req = make_request(http::verb::get, "/download/" + filename, "");
+		req.set(http::field::range, "bytes=" + std::to_string(offset) + "-" + std::to_string(offset + length - 1));
+		if (!etag.empty()) {
+			req.set(http::field::if_range, etag);
+		}
 
-		beast::error_code ec;
-		_stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+		auto res = perform(req);
+		if (res.result() == http::status::partial_content) {
+			return std::move(res.body());
+		}
+		if (res.result() == http::status::range_not_satisfiable) {
+			return std::string();
+		}
+		// whole file: the server doesn't do ranges or the file changed since etag
+		if (res.result() == http::status::ok && etag.empty()) {
+			return offset < res.body().size() ? res.body().substr(offset, length) : std::string();
+		}
 
-		if(ec && ec != beast::errc::not_connected) {
-			FATAL_MSG("[FileServerClient::upload_chunk] Socket shutdown error: " + ec.message());
-			return false;
+		ERROR_MSG("[FileServerClient::download_range] Range " + std::to_string(offset) + "+" + std::to_string(length) + " of " + filename
+		          + " failed with status " + std::to_string(res.result_int()));
+		return std::nullopt;
+	}
+	catch(std::exception const& e) {
+		ERROR_MSG("[FileServerClient::download_range] " + std::string(e.what()));
+		return std::nullopt;
+	}
+}
+
+std::optional<UploadSessionStatus> FileServerClient::send_session_request(http::verb method, const std::string& target, const std::string& body) {
+	try {
+		auto res = perform(make_request(method, target, body));
+		if (res.result() != http::status::ok) {
+			ERROR_MSG("[FileServerClient::send_session_request] " + target + " failed with status " + std::to_string(res.result_int()) + ": " + res.body());
+			return std::nullopt;
 		}
 
-		return response_body == "File uploaded successfully";
+		auto json = nlohmann::json::parse(res.body());
+		UploadSessionStatus status;
+		status._size = json.at("size").get<uint64_t>();
+		status._received = json.at("received").get<uint64_t>();
+		for (const auto& range : json.at("ranges")) {
+			status._ranges.emplace_back(range.at(0).get<uint64_t>(), range.at(1).get<uint64_t>());
+		}
+		return status;
 	}
 	catch(std::exception const& e) {
-		ERROR_MSG("[FileServerClient::upload_chunk] Exception: " + std::string(e.what()));
-		return false;
+		ERROR_MSG("[FileServerClient::send_session_request] " + target + ": " + std::string(e.what()));
+		return std::nullopt;
 	}
 }
 
-std::vector<std::string> FileServerClient::download_file_chunks(const std::string& filename) {
-	std::vector<std::string> chunks;
+std::optional<UploadSessionStatus> FileServerClient::create_upload_session(const std::string& filename, uint64_t size) {
+	return send_session_request(http::verb::post, "/session/" + filename + "/" + std::to_string(size));
+}
 
-	try {
-		auto const results = _resolver.resolve(_host, _port);
-		_stream.connect(results);
+std::optional<UploadSessionStatus> FileServerClient::upload_session_chunk(const std::string& filename, uint64_t offset, const std::string& chunk_data) {
+	return send_session_request(http::verb::put, "/session/" + filename + "/" + std::to_string(offset), chunk_data);
+}
 
-		http::request<http::string_body> req{http::verb::get, "/download/" + filename, _version};
-		req.set(http::field::host, _host);
-		req.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+std::optional<UploadSessionStatus> FileServerClient::get_upload_session(const std::string& filename) {
+	return send_session_request(http::verb::get, "/session/" + filename);
+}
 
-		http::write(_stream, req);
+bool FileServerClient::commit_upload_session(const std::string& filename) {
+	try {
+		auto res = perform(make_request(http::verb::post, "/commit/" + filename, ""));
+		if (res.result() != http::status::ok) {
+			ERROR_MSG("[FileServerClient::commit_upload_session] Commit of " + filename + " failed: " + res.body());
+			return false;
+		}
+		return true;
+	}
+	catch(std::exception const& e) {
+		ERROR_MSG("[FileServerClient::commit_upload_session] " + std::string(e.what()));
+		return false;
+	}
+}
 
-		beast::flat_buffer buffer;
-		http::response<http::dynamic_body> res;
+bool FileServerClient::abort_upload_session(const std::string& filename) {
+	try {
+		return perform(make_request(http::verb::delete_, "/session/" + filename, "")).result() == http::status::ok;
+	}
+	catch(std::exception const& e) {
+		ERROR_MSG("[FileServerClient::abort_upload_session] " + std::string(e.what()));
+		return false;
+	}
+}
 
-		while(true) {
-			buffer.clear();
-			res.clear();
+bool FileServerClient::upload_file_resumable(const std::string& filename, const std::filesystem::path& filepath, size_t parallelism) {
+	std::error_code ec;
+	uint64_t size = std::filesystem::file_size(filepath, ec);
+	if (ec) {
+		ERROR_MSG("[FileServerClient::upload_file_resumable] Unable to open file: " + filepath.string());
+		return false;
+	}
 
-			boost::system::error_code ec;
-			http::read(_stream, buffer, res, ec);
+	auto status = create_upload_session(filename, size);
+	if (!status) {
+		return false;
+	}
 
-			if (ec == http::error::end_of_stream) {
-				break;
-			}
+	ByteRangeSet received;
+	for (const auto& [first, end] : status->_ranges) {
+		received.insert(first, end);
+	}
+	std::vector<ByteRange> chunks;
+	size_t chunk_size = get_max_chunk_size();
+	for (const auto& [first, end] : received.missing(size)) {
+		for (uint64_t offset = first; offset < end; offset += chunk_size) {
+			chunks.emplace_back(offset, std::min<uint64_t>(end, offset + chunk_size));
+		}
+	}
 
-			if (ec) {
-				throw beast::system_error{ec};
+	std::atomic<size_t> next_chunk {0};
+	std::atomic<bool> failed {false};
+	auto upload = [&]() {
+			std::ifstream file(filepath, std::ios::binary);
+			std::string data;
+			for (size_t i = next_chunk++; i < chunks.size() && !failed; i = next_chunk++) {
+				data.resize(chunks[i].second - chunks[i].first);
+				file.seekg(static_cast<std::streamoff>(chunks[i].first));
+				if (!file.read(data.data(), data.size()) || !upload_session_chunk(filename, chunks[i].first, data)) {
+					failed = true;
+				}
 			}
+		};
 
-			std::string chunk_data = beast::buffers_to_string(res.body().data());
-			if (chunk_data.empty()) {
-				break;
-			}
+	std::vector<std::thread> threads;
+	size_t thread_count = std::min(std::max<size_t>(1, parallelism), chunks.size());
+	for (size_t i = 1; i < thread_count; ++i) {
+		threads.emplace_back(upload);
+	}
+	upload();
+	for (auto& thread : threads) {
+		thread.join();
+	}
 
-			chunks.push_back(chunk_data);
-			DEBUG_MSG("[FileServerClient::download_file_chunks] Received chunk "
-			          + std::to_string(chunks.size()) + " size: "
-			          + std::to_string(chunk_data.size()));
-		}
+	if (failed) {
+		ERROR_MSG("[FileServerClient::upload_file_resumable] Upload of " + filepath.string() + " interrupted, the session is kept to resume it");
+		return false;
+	}
 
-		beast::error_code ec;
-		_stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+	DEBUG_MSG("[FileServerClient::upload_file_resumable] Uploaded " + std::to_string(chunks.size()) + " chunks of " + filepath.string()
+	          + ", " + std::to_string(size - received.covered()) + " of " + std::to_string(size) + " bytes");
+	return commit_upload_session(filename);
+}
 
-		if(ec && ec != beast::errc::not_connected) {
-			throw beast::system_error{ec};
-		}
+bool FileServerClient::link_by_hash(const std::string& filename, const std::string& hash) {
+	try {
+		return perform(make_request(http::verb::post, "/dedup/" + filename + "/" + hash, "")).result() == http::status::ok;
 	}
 	catch(std::exception const& e) {
-		ERROR_MSG("[FileServerClient::download_file_chunks] " + std::string(e.what()));
+		ERROR_MSG("[FileServerClient::link_by_hash] " + std::string(e.what()));
+		return false;
 	}
-
-	return chunks;
 }
 
-std::string FileServerClient::download_file(const std::string& filename) {
-	return send_request("/download/" + filename, http::verb::get);
+bool FileServerClient::upload_file_deduplicated(const std::string& filename, const std::filesystem::path& filepath, size_t parallelism) {
+	auto hash = crypto::SHA256::hash_file(filepath);
+	if (!hash) {
+		ERROR_MSG("[FileServerClient::upload_file_deduplicated] Unable to read file: " + filepath.string());
+		return false;
+	}
+
+	if (link_by_hash(filename, *hash)) {
+		DEBUG_MSG("[FileServerClient::upload_file_deduplicated] File server has the content of " + filepath.string() + " already");
+		return true;
+	}
+	return upload_file_resumable(filename, filepath, parallelism);
 }
 
 std::string FileServerClient::delete_file(const std::string& filename) {
@@ -0,0 +1,509 @@
+#include "pack_store.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace file_server {
+
+// segment: record* [footer: footer_entry* trailer], records and footer entries are in the host byte order
+static constexpr uint32_t RECORD_MAGIC = 0x4b434150; // "PACK"
+static constexpr uint32_t FOOTER_MAGIC = 0x544f4f46; // "FOOT"
+static constexpr uint8_t RECORD_PUT = 1;
+static constexpr uint8_t RECORD_TOMBSTONE = 2;
+
+struct RecordHeader {
+	uint32_t _magic;
+	uint32_t _data_size;
+	uint16_t _name_size;
+	uint8_t _type;
+	uint8_t _reserved;
+	uint32_t _checksum; // of name and data
+};
+
+struct FooterEntry {
+	uint64_t _offset;
+	uint32_t _data_size;
+	uint16_t _name_size;
+	uint8_t _type;
+	uint8_t _reserved;
+};
+
+struct FooterTrailer {
+	uint64_t _footer_offset;
+	uint32_t _entry_count;
+	uint32_t _magic;
+};
+
+static_assert(sizeof(RecordHeader) == 16 && sizeof(FooterEntry) == 16 && sizeof(FooterTrailer) == 16);
+
+// fnv-1a, catches records torn by a crash, not tampering
+static uint32_t checksum(const char* data, size_t size, uint32_t hash = 2166136261u) {
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static bool read_at(int fd, char* data, size_t size, uint64_t offset) {
+	size_t read = 0;
+	while (read < size) {
+		ssize_t bytes = ::pread(fd, data + read, size - read, static_cast<off_t>(offset + read));
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes <= 0) {
+			return false;
+		}
+		read += static_cast<size_t>(bytes);
+	}
+	return true;
+}
+
+static bool write_at(int fd, const char* data, size_t size, uint64_t offset) {
+	size_t written = 0;
+	while (written < size) {
+		ssize_t bytes = ::pwrite(fd, data + written, size - written, static_cast<off_t>(offset + written));
+		if (bytes < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytes < 0) {
+			return false;
+		}
+		written += static_cast<size_t>(bytes);
+	}
+	return true;
+}
+
+static uint64_t record_size(uint16_t name_size, uint32_t data_size) {
+	return sizeof(RecordHeader) + name_size + data_size;
+}
+
+PackStore::Segment::~Segment() {
+	if (_fd >= 0) {
+		::close(_fd);
+	}
+}
+
+PackStore::PackStore(const std::filesystem::path& root, const PackStoreConfig& config)
+	: _root(root), _config(config) {
+	std::error_code ec;
+	std::filesystem::create_directories(_root, ec);
+	if (ec || !open_segments()) {
+		throw std::runtime_error("Failed to open pack segments in " + _root.string());
+	}
+
+	if (_config._compaction_interval.count() > 0) {
+		_compaction_thread = std::thread([this]() {
+				compaction_loop();
+			});
+	}
+
+	INFO_MSG("[PackStore::PackStore] " + std::to_string(_index.size()) + " objects in " + std::to_string(_segments.size())
+	         + " segments of " + _root.string());
+}
+
+PackStore::~PackStore() {
+	{
+		std::lock_guard<std::mutex> lock(_compaction_mutex);
+		_stopped = true;
+	}
+	_compaction_cv.notify_all();
+	if (_compaction_thread.joinable()) {
+		_compaction_thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	if (_active && _config._sync_writes) {
+		::fdatasync(_active->_fd);
+	}
+}
+
+bool PackStore::open_segments() {
+	std::vector<uint32_t> ids;
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(_root, ec)) {
+		std::string stem = entry.path().stem().string();
+		if (entry.path().extension() == ".pack" && !stem.empty() && stem.find_first_not_of("0123456789") == std::string::npos) {
+			ids.push_back(static_cast<uint32_t>(std::stoul(stem)));
+		}
+	}
+	std::sort(ids.begin(), ids.end());
+
+	// segments are replayed oldest first, a later record of a name wins over an earlier one
+	for (size_t i = 0; i < ids.size(); ++i) {
+		auto segment = std::make_shared<Segment>();
+		segment->_id = ids[i];
+		std::ostringstream name;
+		name << std::setw(8) << std::setfill('0') << ids[i] << ".pack";
+		segment->_path = _root / name.str();
+		segment->_fd = ::open(segment->_path.c_str(), O_RDWR | O_CLOEXEC);
+		struct stat st;
+		if (segment->_fd < 0 || ::fstat(segment->_fd, &st) != 0) {
+			ERROR_MSG("[PackStore::open_segments] Failed to open " + segment->_path.string());
+			return false;
+		}
+		segment->_size = static_cast<uint64_t>(st.st_size);
+
+		segment->_sealed = load_footer(*segment);
+		if (!segment->_sealed) {
+			scan_records(*segment);
+		}
+
+		for (const auto& record : segment->_records) {
+			apply({segment, record._offset, record._data_size, static_cast<uint16_t>(record._name.size())}, record._name, record._tombstone);
+		}
+		_segments[segment->_id] = segment;
+
+		// a crash while sealing leaves an older segment without footer
+		if (!segment->_sealed && i + 1 < ids.size() && !seal(*segment)) {
+			return false;
+		}
+		if (!segment->_sealed) {
+			_active = segment;
+		}
+	}
+
+	if (!_active) {
+		_active = create_segment(ids.empty() ? 1 : ids.back() + 1);
+	}
+	return _active != nullptr;
+}
+
+std::shared_ptr<PackStore::Segment> PackStore::create_segment(uint32_t id) {
+	auto segment = std::make_shared<Segment>();
+	segment->_id = id;
+	std::ostringstream name;
+	name << std::setw(8) << std::setfill('0') << id << ".pack";
+	segment->_path = _root / name.str();
+	segment->_fd = ::open(segment->_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (segment->_fd < 0) {
+		ERROR_MSG("[PackStore::create_segment] Failed to create " + segment->_path.string() + ": " + std::strerror(errno));
+		return nullptr;
+	}
+	segment->_footer_size = sizeof(FooterTrailer);
+
+	std::unique_lock<std::shared_mutex> lock(_index_mutex);
+	_segments[id] = segment;
+	return segment;
+}
+
+bool PackStore::load_footer(Segment& segment) {
+	FooterTrailer trailer;
+	if (segment._size < sizeof(FooterTrailer)
+	    || !read_at(segment._fd, reinterpret_cast<char*>(&trailer), sizeof(trailer), segment._size - sizeof(trailer))
+	    || trailer._magic != FOOTER_MAGIC || trailer._footer_offset > segment._size - sizeof(trailer)) {
+		return false;
+	}
+
+	std::string footer(segment._size - sizeof(trailer) - trailer._footer_offset, '\0');
+	if (!read_at(segment._fd, footer.data(), footer.size(), trailer._footer_offset)) {
+		return false;
+	}
+
+	std::vector<Record> records;
+	size_t position = 0;
+	for (uint32_t i = 0; i < trailer._entry_count; ++i) {
+		FooterEntry entry;
+		if (position + sizeof(entry) > footer.size()) {
+			return false;
+		}
+		std::memcpy(&entry, footer.data() + position, sizeof(entry));
+		position += sizeof(entry);
+		if (position + entry._name_size > footer.size()
+		    || entry._offset + record_size(entry._name_size, entry._data_size) > trailer._footer_offset) {
+			return false;
+		}
+		records.push_back({entry._offset, entry._data_size, footer.substr(position, entry._name_size), entry._type == RECORD_TOMBSTONE});
+		position += entry._name_size;
+	}
+
+	segment._records = std::move(records);
+	segment._footer_size = sizeof(FooterTrailer) + footer.size();
+	return true;
+}
+
+void PackStore::scan_records(Segment& segment) {
+	uint64_t offset = 0;
+	segment._footer_size = sizeof(FooterTrailer);
+	while (offset + sizeof(RecordHeader) <= segment._size) {
+		RecordHeader header;
+		if (!read_at(segment._fd, reinterpret_cast<char*>(&header), sizeof(header), offset) || header._magic != RECORD_MAGIC
+		    || offset + record_size(header._name_size, header._data_size) > segment._size) {
+			break;
+		}
+
+		std::string body(header._name_size + header._data_size, '\0');
+		if (!read_at(segment._fd, body.data(), body.size(), offset + sizeof(header)) || checksum(body.data(), body.size()) != header._checksum) {
+			break;
+		}
+
+		segment._records.push_back({offset, header._data_size, body.substr(0, header._name_size), header._type == RECORD_TOMBSTONE});
+		segment._footer_size += sizeof(FooterEntry) + header._name_size;
+		offset += record_size(header._name_size, header._data_size);
+	}
+
+	if (offset != segment._size) {
+		WARN_MSG("[PackStore::scan_records] " + std::to_string(segment._size - offset) + " bytes after the last whole record of "
+		         + segment._path.string() + " are cut off");
+		if (::ftruncate(segment._fd, static_cast<off_t>(offset)) == 0) {
+			segment._size = offset;
+		}
+	}
+}
+
+bool PackStore::seal(Segment& segment) {
+	std::string footer;
+	footer.reserve(segment._footer_size);
+	for (const auto& record : segment._records) {
+		FooterEntry entry {record._offset, record._data_size, static_cast<uint16_t>(record._name.size()),
+		                   record._tombstone ? RECORD_TOMBSTONE : RECORD_PUT, 0};
+		footer.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+		footer += record._name;
+	}
+	FooterTrailer trailer {segment._size, static_cast<uint32_t>(segment._records.size()), FOOTER_MAGIC};
+	footer.append(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+
+	// the footer is only found once all of it is on disk, a torn one leaves the segment to be scanned
+	if (!write_at(segment._fd, footer.data(), footer.size(), segment._size) || ::fdatasync(segment._fd) != 0) {
+		ERROR_MSG("[PackStore::seal] Failed to write footer of " + segment._path.string());
+		return false;
+	}
+
+	segment._size += footer.size();
+	segment._sealed = true;
+	DEBUG_MSG("[PackStore::seal] Segment " + segment._path.string() + " sealed, " + std::to_string(segment._records.size()) + " records");
+	return true;
+}
+
+std::optional<PackStore::Location> PackStore::append_record(const std::string& name, const std::string& data, bool tombstone) {
+	uint64_t size = record_size(static_cast<uint16_t>(name.size()), static_cast<uint32_t>(data.size()));
+	uint64_t footer_growth = sizeof(FooterEntry) + name.size();
+	if (!_active->_records.empty() && _active->_size + size + _active->_footer_size + footer_growth > _config._segment_size) {
+		auto next = seal(*_active) ? create_segment(_active->_id + 1) : nullptr;
+		if (!next) {
+			return std::nullopt;
+		}
+		_active = next;
+	}
+
+	RecordHeader header {RECORD_MAGIC, static_cast<uint32_t>(data.size()), static_cast<uint16_t>(name.size()),
+	                     tombstone ? RECORD_TOMBSTONE : RECORD_PUT, 0, checksum(data.data(), data.size(), checksum(name.data(), name.size()))};
+	std::string record;
+	record.reserve(size);
+	record.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	record += name;
+	record += data;
+
+	if (!write_at(_active->_fd, record.data(), record.size(), _active->_size) || (_config._sync_writes && ::fdatasync(_active->_fd) != 0)) {
+		ERROR_MSG("[PackStore::append_record] Failed to write " + name + " to " + _active->_path.string());
+		return std::nullopt;
+	}
+
+	Location location {_active, _active->_size, static_cast<uint32_t>(data.size()), static_cast<uint16_t>(name.size())};
+	_active->_records.push_back({_active->_size, static_cast<uint32_t>(data.size()), name, tombstone});
+	_active->_size += size;
+	_active->_footer_size += footer_growth;
+	return location;
+}
+
+void PackStore::apply(const Location& location, const std::string& name, bool tombstone) {
+	auto it = _index.find(name);
+	if (it != _index.end()) {
+		it->second._segment->_dead_bytes += record_size(it->second._name_size, it->second._data_size);
+	}
+
+	if (tombstone) {
+		location._segment->_dead_bytes += record_size(location._name_size, 0);
+		if (it != _index.end()) {
+			_index.erase(it);
+		}
+	} else if (it != _index.end()) {
+		it->second = location;
+	} else {
+		_index.emplace(name, location);
+	}
+}
+
+bool PackStore::put(const std::string& name, const std::string& data) {
+	if (data.size() > _config._max_object_size || name.empty() || name.size() > UINT16_MAX) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	auto location = append_record(name, data, false);
+	if (!location) {
+		return false;
+	}
+
+	std::unique_lock<std::shared_mutex> index_lock(_index_mutex);
+	apply(*location, name, false);
+	return true;
+}
+
+std::optional<std::string> PackStore::get(const std::string& name) const {
+	auto object = read(name);
+	if (!object) {
+		return std::nullopt;
+	}
+	return std::move(object->_data);
+}
+
+std::optional<PackedObject> PackStore::read(const std::string& name) const {
+	Location location;
+	{
+		std::shared_lock<std::shared_mutex> lock(_index_mutex);
+		auto it = _index.find(name);
+		if (it == _index.end()) {
+			return std::nullopt;
+		}
+		location = it->second;
+	}
+
+	PackedObject object;
+	object._data.resize(location._data_size);
+	object._segment_id = location._segment->_id;
+	object._offset = location._offset;
+	if (!read_at(location._segment->_fd, object._data.data(), object._data.size(), location._offset + sizeof(RecordHeader) + location._name_size)) {
+		ERROR_MSG("[PackStore::read] Failed to read " + name + " from " + location._segment->_path.string());
+		return std::nullopt;
+	}
+	return object;
+}
+
+bool PackStore::contains(const std::string& name) const {
+	std::shared_lock<std::shared_mutex> lock(_index_mutex);
+	return _index.find(name) != _index.end();
+}
+
+bool PackStore::remove(const std::string& name) {
+	std::lock_guard<std::mutex> lock(_write_mutex);
+	if (!contains(name)) {
+		return false;
+	}
+
+	// the tombstone keeps the object removed when the segments are replayed at the next start
+	auto location = append_record(name, "", true);
+	if (!location) {
+		return false;
+	}
+
+	std::unique_lock<std::shared_mutex> index_lock(_index_mutex);
+	apply(*location, name, true);
+	return true;
+}
+
+size_t PackStore::compact() {
+	std::vector<std::shared_ptr<Segment> > candidates;
+	{
+		std::lock_guard<std::mutex> lock(_write_mutex);
+		std::shared_lock<std::shared_mutex> index_lock(_index_mutex);
+		for (const auto& [id, segment] : _segments) {
+			if (segment->_sealed && segment->_dead_bytes > _config._compaction_threshold * segment->_size) {
+				candidates.push_back(segment);
+			}
+		}
+	}
+
+	size_t compacted = 0;
+	for (const auto& segment : candidates) {
+		if (compact_segment(segment)) {
+			++compacted;
+		}
+	}
+	return compacted;
+}
+
+// live records are read without locks, the segment is sealed and doesn't change, each one is moved under _write_mutex
+// only if the index still points at it, so puts and removes go on while a segment is compacted
+bool PackStore::compact_segment(const std::shared_ptr<Segment>& segment) {
+	uint64_t moved_bytes = 0;
+	for (const auto& record : segment->_records) {
+		std::string data;
+		if (!record._tombstone) {
+			data.resize(record._data_size);
+			if (!read_at(segment->_fd, data.data(), data.size(), record._offset + sizeof(RecordHeader) + record._name.size())) {
+				ERROR_MSG("[PackStore::compact_segment] Failed to read " + record._name + " from " + segment->_path.string());
+				return false;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(_write_mutex);
+		bool move = false;
+		{
+			std::shared_lock<std::shared_mutex> index_lock(_index_mutex);
+			auto it = _index.find(record._name);
+			if (record._tombstone) {
+				// only needed while an older segment may still have a put of the name
+				move = it == _index.end() && _segments.begin()->first < segment->_id;
+			} else {
+				move = it != _index.end() && it->second._segment == segment && it->second._offset == record._offset;
+			}
+		}
+		if (!move) {
+			continue;
+		}
+
+		auto location = append_record(record._name, data, record._tombstone);
+		if (!location) {
+			return false;
+		}
+		std::unique_lock<std::shared_mutex> index_lock(_index_mutex);
+		apply(*location, record._name, record._tombstone);
+		moved_bytes += record_size(static_cast<uint16_t>(record._name.size()), record._data_size);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_write_mutex);
+		// moved records are on disk before the segment that held them goes away
+		if (_config._sync_writes || moved_bytes == 0 || ::fdatasync(_active->_fd) == 0) {
+			std::unique_lock<std::shared_mutex> index_lock(_index_mutex);
+			_segments.erase(segment->_id);
+		} else {
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::remove(segment->_path, ec);
+	INFO_MSG("[PackStore::compact_segment] Segment " + segment->_path.string() + " compacted, " + std::to_string(moved_bytes) + " of "
+	         + std::to_string(segment->_size) + " bytes moved");
+	return true;
+}
+
+void PackStore::compaction_loop() {
+	std::unique_lock<std::mutex> lock(_compaction_mutex);
+	while (!_compaction_cv.wait_for(lock, _config._compaction_interval, [this]() {
+			return _stopped;
+		})) {
+		lock.unlock();
+		compact();
+		lock.lock();
+	}
+}
+
+// the size of the active segment changes under _write_mutex alone
+PackStoreStats PackStore::get_stats() const {
+	std::lock_guard<std::mutex> write_lock(_write_mutex);
+	std::shared_lock<std::shared_mutex> lock(_index_mutex);
+	PackStoreStats stats;
+	stats._objects = _index.size();
+	stats._segments = _segments.size();
+	for (const auto& [id, segment] : _segments) {
+		stats._dead_bytes += segment->_dead_bytes;
+		stats._live_bytes += segment->_size - std::min(segment->_size, segment->_dead_bytes);
+	}
+	return stats;
+}
+
+size_t PackStore::get_max_object_size() const noexcept {
+	return _config._max_object_size;
+}
+
+}
\ No newline at end of file
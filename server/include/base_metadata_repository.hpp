@@ -5,7 +5,8 @@
 
 namespace server {
 
-template<typename T>
+// Id is the key type of the table, int for users, common::MessageId for messages
+template<typename T, typename Id = int>
 class BaseRepository {
 public:
 	BaseRepository(PostgresDBManager& postgres_db_manager) : _postgres_db_manager(postgres_db_manager) {
@@ -13,10 +14,10 @@ public:
 	BaseRepository() = default;
 	virtual ~BaseRepository() = default;
 
-	virtual int create(const T& entity) = 0;
-	virtual std::optional<T> read(int id) = 0;
+	virtual Id create(const T& entity) = 0;
+	virtual std::optional<T> read(Id id) = 0;
 	virtual bool update(const T& entity) = 0;
-	virtual bool remove(int id) = 0;
+	virtual bool remove(Id id) = 0;
 
 protected:
 	PostgresDBManager& _postgres_db_manager;
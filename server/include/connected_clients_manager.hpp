@@ -1,42 +1,189 @@
 #pragma once
 
-#include <map>
-#include <memory>
-#include <string>
-#include <boost/asio.hpp>
+#include "session.hpp"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 namespace server {
 
-class ConnectedClientsManager {
-	using tcp = boost::asio::ip::tcp;
-
+// registry of authorized connections, shared by all io threads
+// lock striped: user ids and connection handles are hashed into SHARDS_COUNT independent shards,
+// so lookups by user id (forward index) and by connection (reverse index) take one shard lock each
+// and never hold two locks at once
+template<typename Connection>
+class BasicConnectedClientsManager {
 public:
-	ConnectedClientsManager() = default;
-	~ConnectedClientsManager() = default;
+	using ConnectionPtr = boost::shared_ptr<Connection>;
+	static constexpr size_t SHARDS_COUNT = 64;
+
+	BasicConnectedClientsManager() : _connected_count(0) {
+	}
+	~BasicConnectedClientsManager() = default;
+
+	void add_client(int user_id, ConnectionPtr connection) {
+		ConnectionPtr replaced;
+		{
+			auto& shard = get_user_shard(user_id);
+			std::unique_lock<std::shared_mutex> lock(shard._mutex);
+			auto [it, inserted] = shard._map.try_emplace(user_id, connection);
+			if (inserted) {
+				++_connected_count;
+			} else {
+				replaced = std::move(it->second);
+				it->second = connection;
+			}
+		}
+
+		// same user logged in on another connection, forget the old one
+		if (replaced && replaced != connection) {
+			erase_reverse_if(replaced.get(), user_id);
+		}
+
+		int previous_user_id = 0;
+		{
+			auto& shard = get_connection_shard(connection.get());
+			std::unique_lock<std::shared_mutex> lock(shard._mutex);
+			auto [it, inserted] = shard._map.try_emplace(connection.get(), user_id);
+			if (!inserted) {
+				previous_user_id = it->second;
+				it->second = user_id;
+			}
+		}
+
+		// connection was authorized as another user before
+		if (previous_user_id != 0 && previous_user_id != user_id) {
+			erase_forward_if(previous_user_id, connection.get());
+		}
+	}
+
+	void remove_client(int user_id) {
+		ConnectionPtr removed;
+		{
+			auto& shard = get_user_shard(user_id);
+			std::unique_lock<std::shared_mutex> lock(shard._mutex);
+			auto it = shard._map.find(user_id);
+			if (it == shard._map.end()) {
+				return;
+			}
+			removed = std::move(it->second);
+			shard._map.erase(it);
+			--_connected_count;
+		}
+
+		erase_reverse_if(removed.get(), user_id);
+	}
+
+	void remove_client_by_session(const ConnectionPtr& connection) {
+		int user_id = 0;
+		{
+			auto& shard = get_connection_shard(connection.get());
+			std::unique_lock<std::shared_mutex> lock(shard._mutex);
+			auto it = shard._map.find(connection.get());
+			if (it == shard._map.end()) {
+				return;
+			}
+			user_id = it->second;
+			shard._map.erase(it);
+		}
+
+		erase_forward_if(user_id, connection.get());
+	}
+
+	ConnectionPtr get_client_session(int user_id) const {
+		const auto& shard = get_user_shard(user_id);
+		std::shared_lock<std::shared_mutex> lock(shard._mutex);
+		auto it = shard._map.find(user_id);
+		if (it != shard._map.end()) {
+			return it->second;
+		}
+		return nullptr;
+	}
+
+	// returns 0 if connection is not authorized
+	int get_user_id(const ConnectionPtr& connection) const {
+		const auto& shard = get_connection_shard(connection.get());
+		std::shared_lock<std::shared_mutex> lock(shard._mutex);
+		auto it = shard._map.find(connection.get());
+		return it != shard._map.end() ? it->second : 0;
+	}
+
+	bool is_client_connected(int user_id) const {
+		const auto& shard = get_user_shard(user_id);
+		std::shared_lock<std::shared_mutex> lock(shard._mutex);
+		return shard._map.find(user_id) != shard._map.end();
+	}
+
+	size_t get_connected_count() const {
+		return _connected_count;
+	}
+
+	// copy of all connected clients for broadcasts, shards are locked one by one
+	// so the snapshot is not atomic across shards, but never blocks writers for long
+	std::vector<std::pair<int, ConnectionPtr> > snapshot() const {
+		std::vector<std::pair<int, ConnectionPtr> > clients;
+		clients.reserve(_connected_count);
+		for (const auto& shard : _user_shards) {
+			std::shared_lock<std::shared_mutex> lock(shard._mutex);
+			clients.insert(clients.end(), shard._map.begin(), shard._map.end());
+		}
+		return clients;
+	}
+
+private:
+	template<typename Key, typename Value>
+	struct alignas(64) Shard {
+		mutable std::shared_mutex _mutex;
+		std::unordered_map<Key, Value> _map;
+	};
 
-	void add_client(int user_id, boost::shared_ptr<tcp::socket> socket);
-	void remove_client(int user_id);
-	void remove_client_by_socket(boost::shared_ptr<tcp::socket> socket);
-	boost::shared_ptr<tcp::socket> get_client_socket(int user_id);
-	bool is_client_connected(int user_id) const;
-	size_t get_connected_count() const;
+	using UserShard = Shard<int, ConnectionPtr>;
+	using ConnectionShard = Shard<const Connection*, int>;
 
-	std::map<int, boost::shared_ptr<tcp::socket> >::iterator begin() {
-		return _connected_clients.begin();
+	UserShard& get_user_shard(int user_id) {
+		return _user_shards[static_cast<size_t>(user_id) % SHARDS_COUNT];
+	}
+	const UserShard& get_user_shard(int user_id) const {
+		return _user_shards[static_cast<size_t>(user_id) % SHARDS_COUNT];
 	}
-	std::map<int, boost::shared_ptr<tcp::socket> >::iterator end() {
-		return _connected_clients.end();
+	ConnectionShard& get_connection_shard(const Connection* connection) {
+		return _connection_shards[std::hash<const Connection*>{}(connection) / alignof(Connection) % SHARDS_COUNT];
 	}
-	std::map<int, boost::shared_ptr<tcp::socket> >::const_iterator begin() const {
-		return _connected_clients.begin();
+	const ConnectionShard& get_connection_shard(const Connection* connection) const {
+		return _connection_shards[std::hash<const Connection*>{}(connection) / alignof(Connection) % SHARDS_COUNT];
 	}
-	std::map<int, boost::shared_ptr<tcp::socket> >::const_iterator end() const {
-		return _connected_clients.end();
+
+	void erase_forward_if(int user_id, const Connection* connection) {
+		auto& shard = get_user_shard(user_id);
+		std::unique_lock<std::shared_mutex> lock(shard._mutex);
+		auto it = shard._map.find(user_id);
+		if (it != shard._map.end() && it->second.get() == connection) {
+			shard._map.erase(it);
+			--_connected_count;
+		}
+	}
+
+	void erase_reverse_if(const Connection* connection, int user_id) {
+		auto& shard = get_connection_shard(connection);
+		std::unique_lock<std::shared_mutex> lock(shard._mutex);
+		auto it = shard._map.find(connection);
+		if (it != shard._map.end() && it->second == user_id) {
+			shard._map.erase(it);
+		}
 	}
 
 private:
-	std::map<int, boost::shared_ptr<tcp::socket> > _connected_clients;
+	std::array<UserShard, SHARDS_COUNT> _user_shards;
+	std::array<ConnectionShard, SHARDS_COUNT> _connection_shards;
+	std::atomic<size_t> _connected_count;
 };
 
+using ConnectedClientsManager = BasicConnectedClientsManager<Session>;
+
 }
\ No newline at end of file
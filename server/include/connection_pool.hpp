@@ -0,0 +1,267 @@
+#pragma once
+
+#include "debug.hpp"
+#include "server_config.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace server {
+
+struct ConnectionPoolStats {
+	size_t _size = 0;        // open connections, idle and checked out
+	size_t _in_use = 0;
+	size_t _peak_in_use = 0;
+	size_t _max_size = 0;
+	uint64_t _checkouts = 0;
+	uint64_t _timeouts = 0;
+	uint64_t _discarded = 0; // broken or failed health check
+	double _avg_wait_ms = 0.0;
+	double _max_wait_ms = 0.0;
+	double _utilization = 0.0; // connection-time checked out / (max size * pool lifetime)
+
+	std::string to_string() const {
+		return "size " + std::to_string(_size) + "/" + std::to_string(_max_size)
+		       + ", in use " + std::to_string(_in_use) + " (peak " + std::to_string(_peak_in_use) + ")"
+		       + ", checkouts " + std::to_string(_checkouts) + ", timeouts " + std::to_string(_timeouts)
+		       + ", discarded " + std::to_string(_discarded)
+		       + ", wait avg " + std::to_string(_avg_wait_ms) + " ms, max " + std::to_string(_max_wait_ms) + " ms"
+		       + ", utilization " + std::to_string(_utilization * 100.0) + "%";
+	}
+};
+
+// bounded pool of connections to one database, every operation checks a connection out
+// and gets it back when the handle goes out of scope, so a connection is never used by two threads at once
+// Connection has to provide is_open(), closed connections are dropped on return and reopened on demand
+template<typename Connection>
+class ConnectionPool {
+	using clock_type = std::chrono::steady_clock;
+
+public:
+	using Factory = std::function<std::unique_ptr<Connection>()>;
+	using HealthCheck = std::function<bool(Connection&)>;
+
+	class Handle {
+	public:
+		Handle(ConnectionPool* pool, std::unique_ptr<Connection> connection)
+			: _pool(pool), _connection(std::move(connection)), _checked_out(clock_type::now()), _invalidated(false) {
+		}
+		Handle(Handle&& other) noexcept
+			: _pool(other._pool), _connection(std::move(other._connection)), _checked_out(other._checked_out), _invalidated(other._invalidated) {
+			other._pool = nullptr;
+		}
+		Handle(const Handle&) = delete;
+		Handle& operator=(const Handle&) = delete;
+		Handle& operator=(Handle&&) = delete;
+
+		~Handle() {
+			if (_pool && _connection) {
+				_pool->release(std::move(_connection), _checked_out, _invalidated);
+			}
+		}
+
+		Connection& operator*() const {
+			return *_connection;
+		}
+		Connection* operator->() const {
+			return _connection.get();
+		}
+		// connection is closed instead of being returned to the pool
+		void invalidate() noexcept {
+			_invalidated = true;
+		}
+
+	private:
+		ConnectionPool* _pool;
+		std::unique_ptr<Connection> _connection;
+		clock_type::time_point _checked_out;
+		bool _invalidated;
+	};
+
+	// first _min_size connections are opened right away, failure to open them is thrown to the caller
+	ConnectionPool(const std::string& name, const ConnectionPoolConfig& config, Factory factory, HealthCheck health_check)
+		: _name(name),
+		_config(config),
+		_factory(std::move(factory)),
+		_health_check(std::move(health_check)),
+		_size(0),
+		_in_use(0),
+		_peak_in_use(0),
+		_checkouts(0),
+		_timeouts(0),
+		_discarded(0),
+		_total_wait(0),
+		_max_wait(0),
+		_busy_time(0),
+		_created(clock_type::now()),
+		_last_report(_created) {
+		if (_config._max_size == 0) {
+			_config._max_size = 1;
+		}
+
+		for (size_t i = 0; i < std::min(_config._min_size, _config._max_size); ++i) {
+			_idle.push_back({_factory(), clock_type::now()});
+			++_size;
+		}
+		DEBUG_MSG("[ConnectionPool] Pool " + _name + " opened " + std::to_string(_size) + " connections");
+	}
+
+	~ConnectionPool() = default;
+
+	// blocks until a connection is free or a new one can be opened,
+	// throws std::runtime_error after _checkout_timeout or if the database is unreachable
+	Handle checkout() {
+		auto start = clock_type::now();
+		auto deadline = start + _config._checkout_timeout;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true) {
+			if (!_idle.empty()) {
+				// most recently used first, rarely used connections age at the front and get health checked
+				IdleConnection idle = std::move(_idle.back());
+				_idle.pop_back();
+				record_checkout(start);
+				lock.unlock();
+
+				if (clock_type::now() - idle._idle_since < _config._health_check_idle || _health_check(*idle._connection)) {
+					return Handle(this, std::move(idle._connection));
+				}
+
+				WARN_MSG("[ConnectionPool::checkout] Connection of pool " + _name + " failed health check, reconnecting");
+				{
+					std::lock_guard<std::mutex> guard(_mutex);
+					++_discarded;
+				}
+				return Handle(this, open_or_release_slot());
+			}
+
+			if (_size < _config._max_size) {
+				++_size;
+				record_checkout(start);
+				lock.unlock();
+				return Handle(this, open_or_release_slot());
+			}
+
+			if (_available.wait_until(lock, deadline) == std::cv_status::timeout && _idle.empty() && _size >= _config._max_size) {
+				++_timeouts;
+				throw std::runtime_error("[ConnectionPool::checkout] Timed out waiting for a connection of pool " + _name
+				                         + " (" + std::to_string(_config._max_size) + " in use)");
+			}
+		}
+	}
+
+	ConnectionPoolStats get_stats() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return make_stats(clock_type::now());
+	}
+
+private:
+	struct IdleConnection {
+		std::unique_ptr<Connection> _connection;
+		clock_type::time_point _idle_since;
+	};
+
+	// slot is already accounted in _size and _in_use, it is given back if connecting fails
+	std::unique_ptr<Connection> open_or_release_slot() {
+		try {
+			return _factory();
+		} catch (const std::exception& e) {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				--_size;
+				--_in_use;
+			}
+			_available.notify_one();
+			throw std::runtime_error("[ConnectionPool::checkout] Failed to connect pool " + _name + ": " + e.what());
+		}
+	}
+
+	void record_checkout(clock_type::time_point start) {
+		auto wait = clock_type::now() - start;
+		++_in_use;
+		++_checkouts;
+		_peak_in_use = std::max(_peak_in_use, _in_use);
+		_total_wait += wait;
+		_max_wait = std::max(_max_wait, wait);
+	}
+
+	void release(std::unique_ptr<Connection> connection, clock_type::time_point checked_out, bool invalidated) {
+		auto now = clock_type::now();
+		bool report = false;
+		ConnectionPoolStats stats;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			--_in_use;
+			_busy_time += now - checked_out;
+
+			if (invalidated || !connection->is_open()) {
+				--_size;
+				++_discarded;
+			} else {
+				_idle.push_back({std::move(connection), now});
+			}
+
+			if (now - _last_report >= _config._stats_report_interval) {
+				_last_report = now;
+				report = true;
+				stats = make_stats(now);
+			}
+		}
+		_available.notify_one();
+
+		if (report) {
+			INFO_MSG("[ConnectionPool] Pool " + _name + ": " + stats.to_string());
+		}
+	}
+
+	ConnectionPoolStats make_stats(clock_type::time_point now) const {
+		using ms = std::chrono::duration<double, std::milli>;
+
+		ConnectionPoolStats stats;
+		stats._size = _size;
+		stats._in_use = _in_use;
+		stats._peak_in_use = _peak_in_use;
+		stats._max_size = _config._max_size;
+		stats._checkouts = _checkouts;
+		stats._timeouts = _timeouts;
+		stats._discarded = _discarded;
+		stats._avg_wait_ms = _checkouts ? ms(_total_wait).count() / _checkouts : 0.0;
+		stats._max_wait_ms = ms(_max_wait).count();
+
+		double lifetime = ms(now - _created).count() * _config._max_size;
+		stats._utilization = lifetime > 0.0 ? ms(_busy_time).count() / lifetime : 0.0;
+		return stats;
+	}
+
+private:
+	std::string _name;
+	ConnectionPoolConfig _config;
+	Factory _factory;
+	HealthCheck _health_check;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _available;
+	std::deque<IdleConnection> _idle;
+	size_t _size;
+	size_t _in_use;
+
+	size_t _peak_in_use;
+	uint64_t _checkouts;
+	uint64_t _timeouts;
+	uint64_t _discarded;
+	clock_type::duration _total_wait;
+	clock_type::duration _max_wait;
+	clock_type::duration _busy_time;
+	clock_type::time_point _created;
+	clock_type::time_point _last_report;
+};
+
+}
\ No newline at end of file
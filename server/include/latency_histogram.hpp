@@ -0,0 +1,133 @@
+#pragma once
+
+#include "debug.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace server {
+
+struct LatencyStats {
+	uint64_t _count = 0;
+	double _avg_us = 0.0;
+	// percentiles are upper bounds of their histogram buckets
+	uint64_t _p50_us = 0;
+	uint64_t _p90_us = 0;
+	uint64_t _p99_us = 0;
+	uint64_t _max_us = 0;
+
+	std::string to_string() const {
+		return "count " + std::to_string(_count) + ", avg " + std::to_string(_avg_us) + " us"
+		       + ", p50 <= " + std::to_string(_p50_us) + " us, p90 <= " + std::to_string(_p90_us) + " us"
+		       + ", p99 <= " + std::to_string(_p99_us) + " us, max " + std::to_string(_max_us) + " us";
+	}
+};
+
+// lock free log2 histogram of latencies, bucket i counts samples below 2^i microseconds,
+// recording is a few relaxed atomic increments, so it can stay on hot paths
+// stats are logged by the recording thread once per report interval
+class LatencyHistogram {
+	using clock_type = std::chrono::steady_clock;
+
+public:
+	static constexpr size_t BUCKETS_COUNT = 32; // last bucket holds everything above ~18 minutes
+
+	explicit LatencyHistogram(const std::string& name, std::chrono::seconds report_interval = std::chrono::seconds(60))
+		: _name(name),
+		_report_interval(report_interval),
+		_buckets{},
+		_sum_us(0),
+		_max_us(0),
+		_next_report((clock_type::now() + report_interval).time_since_epoch().count()) {
+	}
+
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	void record(std::chrono::nanoseconds latency) {
+		uint64_t us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+		_buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+		_sum_us.fetch_add(us, std::memory_order_relaxed);
+
+		uint64_t max = _max_us.load(std::memory_order_relaxed);
+		while (us > max && !_max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+		}
+
+		maybe_report();
+	}
+
+	LatencyStats get_stats() const {
+		std::array<uint64_t, BUCKETS_COUNT> buckets;
+		uint64_t count = 0;
+		for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+			buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+			count += buckets[i];
+		}
+
+		LatencyStats stats;
+		stats._count = count;
+		if (count == 0) {
+			return stats;
+		}
+
+		stats._max_us = _max_us.load(std::memory_order_relaxed);
+		stats._avg_us = static_cast<double>(_sum_us.load(std::memory_order_relaxed)) / count;
+		stats._p50_us = percentile(buckets, count, 0.50, stats._max_us);
+		stats._p90_us = percentile(buckets, count, 0.90, stats._max_us);
+		stats._p99_us = percentile(buckets, count, 0.99, stats._max_us);
+		return stats;
+	}
+
+	const std::string& get_name() const noexcept {
+		return _name;
+	}
+
+private:
+	static size_t bucket_index(uint64_t us) noexcept {
+		size_t index = 0;
+		while (us > 0 && index < BUCKETS_COUNT - 1) {
+			us >>= 1;
+			++index;
+		}
+		return index;
+	}
+
+	static uint64_t percentile(const std::array<uint64_t, BUCKETS_COUNT>& buckets, uint64_t count, double p, uint64_t max_us) {
+		uint64_t rank = static_cast<uint64_t>(p * count);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+			seen += buckets[i];
+			if (seen > rank) {
+				return std::min<uint64_t>(uint64_t(1) << i, max_us);
+			}
+		}
+		return max_us;
+	}
+
+	void maybe_report() {
+		int64_t now = clock_type::now().time_since_epoch().count();
+		int64_t next_report = _next_report.load(std::memory_order_relaxed);
+		if (now < next_report) {
+			return;
+		}
+
+		int64_t following = now + clock_type::duration(_report_interval).count();
+		if (_next_report.compare_exchange_strong(next_report, following, std::memory_order_relaxed)) {
+			INFO_MSG("[LatencyHistogram] " + _name + ": " + get_stats().to_string());
+		}
+	}
+
+private:
+	std::string _name;
+	std::chrono::seconds _report_interval;
+	std::array<std::atomic<uint64_t>, BUCKETS_COUNT> _buckets;
+	std::atomic<uint64_t> _sum_us;
+	std::atomic<uint64_t> _max_us;
+	std::atomic<int64_t> _next_report; // steady clock ticks
+};
+
+}
\ No newline at end of file
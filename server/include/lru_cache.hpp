@@ -0,0 +1,232 @@
+#pragma once
+
+#include "debug.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace server {
+
+struct CacheStats {
+	size_t _size = 0;
+	size_t _capacity = 0;
+	uint64_t _hits = 0;
+	uint64_t _misses = 0;
+
+	double hit_ratio() const {
+		uint64_t lookups = _hits + _misses;
+		return lookups ? static_cast<double>(_hits) / lookups : 0.0;
+	}
+
+	std::string to_string() const {
+		return "size " + std::to_string(_size) + "/" + std::to_string(_capacity)
+		       + ", hits " + std::to_string(_hits) + ", misses " + std::to_string(_misses)
+		       + ", hit ratio " + std::to_string(hit_ratio() * 100.0) + "%";
+	}
+};
+
+// bounded LRU cache safe to use from any thread, keys are hashed into SHARDS_COUNT shards
+// with their own lock and their own LRU list, capacity is split evenly between the shards
+// entries can have a time to live, expired entries are dropped on lookup
+// a named cache with a report interval logs its stats from a lookup once per interval, like LatencyHistogram
+// every invalidation bumps the generation of the shards it touches, a value loaded from the database is put with
+// put_if_unchanged and the generation read before the load, so a stale load doesn't outlive an invalidation that raced with it
+template<typename Key, typename Value, typename Hash = std::hash<Key> >
+class LruCache {
+	using clock_type = std::chrono::steady_clock;
+
+public:
+	static constexpr size_t SHARDS_COUNT = 16;
+
+	explicit LruCache(size_t capacity, const std::string& name = "", std::chrono::seconds report_interval = std::chrono::seconds(0))
+		: _capacity(std::max(capacity, SHARDS_COUNT)),
+		_shard_capacity(_capacity / SHARDS_COUNT),
+		_hits(0),
+		_misses(0),
+		_name(name),
+		_report_interval(report_interval),
+		_next_report((clock_type::now() + report_interval).time_since_epoch().count()) {
+	}
+
+	std::optional<Value> get(const Key& key) {
+		maybe_report();
+
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+
+		auto it = shard._index.find(key);
+		if (it == shard._index.end()) {
+			++_misses;
+			return std::nullopt;
+		}
+
+		if (it->second->_expires <= clock_type::now()) {
+			shard._entries.erase(it->second);
+			shard._index.erase(it);
+			++_misses;
+			return std::nullopt;
+		}
+
+		shard._entries.splice(shard._entries.begin(), shard._entries, it->second);
+		++_hits;
+		return it->second->_value;
+	}
+
+	// ttl of zero means the entry lives until it is evicted or invalidated
+	void put(const Key& key, const Value& value, std::chrono::milliseconds ttl = std::chrono::milliseconds(0)) {
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+		insert(shard, key, value, ttl);
+	}
+
+	uint64_t get_generation(const Key& key) {
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+		return shard._generation;
+	}
+
+	// false and nothing cached if the shard of the key was invalidated since get_generation returned generation
+	bool put_if_unchanged(const Key& key, const Value& value, uint64_t generation, std::chrono::milliseconds ttl = std::chrono::milliseconds(0)) {
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+		if (shard._generation != generation) {
+			return false;
+		}
+		insert(shard, key, value, ttl);
+		return true;
+	}
+
+	void erase(const Key& key) {
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard._mutex);
+		++shard._generation;
+
+		auto it = shard._index.find(key);
+		if (it != shard._index.end()) {
+			shard._entries.erase(it->second);
+			shard._index.erase(it);
+		}
+	}
+
+	// walks the whole cache, for invalidations that only know the value
+	void erase_if(const std::function<bool(const Key&, const Value&)>& predicate) {
+		for (auto& shard : _shards) {
+			std::lock_guard<std::mutex> lock(shard._mutex);
+			++shard._generation;
+			for (auto it = shard._entries.begin(); it != shard._entries.end();) {
+				if (predicate(it->_key, it->_value)) {
+					shard._index.erase(it->_key);
+					it = shard._entries.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
+	}
+
+	void clear() {
+		for (auto& shard : _shards) {
+			std::lock_guard<std::mutex> lock(shard._mutex);
+			++shard._generation;
+			shard._index.clear();
+			shard._entries.clear();
+		}
+	}
+
+	size_t size() const {
+		size_t size = 0;
+		for (const auto& shard : _shards) {
+			std::lock_guard<std::mutex> lock(shard._mutex);
+			size += shard._entries.size();
+		}
+		return size;
+	}
+
+	CacheStats get_stats() const {
+		CacheStats stats;
+		stats._size = size();
+		stats._capacity = _shard_capacity * SHARDS_COUNT;
+		stats._hits = _hits;
+		stats._misses = _misses;
+		return stats;
+	}
+
+private:
+	struct Entry {
+		Key _key;
+		Value _value;
+		clock_type::time_point _expires;
+	};
+
+	struct alignas(64) Shard {
+		mutable std::mutex _mutex;
+		std::list<Entry> _entries; // most recently used first
+		std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> _index;
+		uint64_t _generation = 0;
+	};
+
+	// shard._mutex is held
+	void insert(Shard& shard, const Key& key, const Value& value, std::chrono::milliseconds ttl) {
+		auto expires = ttl.count() > 0 ? clock_type::now() + ttl : clock_type::time_point::max();
+
+		auto it = shard._index.find(key);
+		if (it != shard._index.end()) {
+			it->second->_value = value;
+			it->second->_expires = expires;
+			shard._entries.splice(shard._entries.begin(), shard._entries, it->second);
+			return;
+		}
+
+		shard._entries.push_front({key, value, expires});
+		shard._index.emplace(key, shard._entries.begin());
+
+		if (shard._entries.size() > _shard_capacity) {
+			shard._index.erase(shard._entries.back()._key);
+			shard._entries.pop_back();
+		}
+	}
+
+	Shard& get_shard(const Key& key) {
+		return _shards[Hash{}(key) % SHARDS_COUNT];
+	}
+
+	void maybe_report() {
+		if (_report_interval.count() <= 0) {
+			return;
+		}
+
+		int64_t now = clock_type::now().time_since_epoch().count();
+		int64_t next_report = _next_report.load(std::memory_order_relaxed);
+		if (now < next_report) {
+			return;
+		}
+
+		int64_t following = now + clock_type::duration(_report_interval).count();
+		if (_next_report.compare_exchange_strong(next_report, following, std::memory_order_relaxed)) {
+			INFO_MSG("[LruCache] " + _name + ": " + get_stats().to_string());
+		}
+	}
+
+private:
+	size_t _capacity;
+	size_t _shard_capacity;
+	std::array<Shard, SHARDS_COUNT> _shards;
+	std::atomic<uint64_t> _hits;
+	std::atomic<uint64_t> _misses;
+	std::string _name;
+	std::chrono::seconds _report_interval;
+	std::atomic<int64_t> _next_report; // steady clock ticks
+};
+
+}
\ No newline at end of file
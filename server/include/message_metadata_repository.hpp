@@ -1,29 +1,76 @@
 #pragma once
 
 #include "base_metadata_repository.hpp"
+#include "lru_cache.hpp"
 #include "message_metadata.hpp"
 #include "postgres_db_manager.hpp"
+#include "server_config.hpp"
+#include "write_batcher.hpp"
+
+#include <future>
 #include <vector>
 #include <optional>
 
 namespace server {
 
-class MessageMetadataRepository : public BaseRepository<common::MessageMetadata> {
+// one page of a chat history, newest message first
+struct MessageHistoryPage {
+	std::vector<common::MessageMetadata> _messages;
+	std::string _next_cursor; // position after the last message of the page, empty on the last page
+};
+
+// newest message of a chat, chats.last_message_timestamp is updated from these in batches
+struct ChatActivity {
+	int _chat_id;
+	common::Timestamp _last_message_timestamp;
+};
+
+class MessageMetadataRepository : public BaseRepository<common::MessageMetadata, common::MessageId> {
 public:
-	MessageMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name);
+	// prepared on every pooled connection of the repository database, see PostgresDBManager::add_connection
+	static const PreparedStatements PREPARED_STATEMENTS;
+
+	MessageMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name,
+	                          const MessageBatchConfig& batch_config = {}, const ChatCacheConfig& chat_cache_config = {});
 	virtual ~MessageMetadataRepository() override;
 
-	int create(const common::MessageMetadata& message) override;
-	std::optional<common::MessageMetadata> read(int id) override;
+	// message must already carry its id from SnowflakeIdGenerator,
+	// blocks until the batch with this message is committed, returns the id or 0 on failure
+	common::MessageId create(const common::MessageMetadata& message) override;
+	// message is inserted together with messages of concurrent senders in one transaction,
+	// chat id 0 is resolved from sender and receiver first,
+	// future holds the message id or the exception of the failed batch
+	std::future<common::MessageId> create_async(const common::MessageMetadata& message);
+	std::optional<common::MessageMetadata> read(common::MessageId id) override;
 	bool update(const common::MessageMetadata& message) override;
-	bool remove(int id) override;
+	bool remove(common::MessageId id) override;
+
+	// id of the chat of two users in any order, created on first use, 0 on failure
+	// a cache hit in the steady state, a miss is one upsert round trip
+	int resolve_chat_id(int user1_id, int user2_id);
+	// like resolve_chat_id but never creates a chat, 0 if the users have none
+	int get_chat_id(int user1_id, int user2_id);
+	CacheStats get_chat_cache_stats() const;
 
-	std::vector<common::MessageMetadata> getMessagesBetweenUsers(int user1_id, int user2_id);
+	// monthly partitions of the messages table from the current month on, existing ones are kept,
+	// does nothing for a not partitioned table
+	bool create_partitions(size_t months_ahead);
+	// keyset pagination on (chat_id, created_timestamp, id): every page is one index range scan of `limit` rows
+	// starting right after the cursor, so its cost doesn't depend on the chat size or page number,
+	// empty cursor starts from the newest message, std::nullopt on failure
+	std::optional<MessageHistoryPage> get_history_page(int chat_id, const std::string& cursor, size_t limit);
 
 private:
 	common::MessageMetadata construct_message(const pqxx::row& row);
+	std::vector<common::MessageId> insert_batch(const std::vector<common::MessageMetadata>& messages);
+	std::vector<bool> update_last_message_timestamps(const std::vector<ChatActivity>& activities);
 	// move inside base repo
 	std::string _connection_name;
+	LruCache<uint64_t, int> _chat_cache;
+	// fed by the insert batcher, so it has to outlive it
+	WriteBatcher<ChatActivity, bool> _last_message_batcher;
+	// last member, its thread uses the rest of the repository until it is joined
+	WriteBatcher<common::MessageMetadata, common::MessageId> _insert_batcher;
 };
 
 }
\ No newline at end of file
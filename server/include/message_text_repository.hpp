@@ -2,28 +2,54 @@
 
 #include "debug.hpp"
 #include "message_text.hpp"
+#include "server_config.hpp"
+#include "write_batcher.hpp"
 #include <redis++.h>
 
+#include <future>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace server {
 
+// texts are keyed by the message id generated by the server, every call is a single round trip to redis:
+// update is SET XX, batches go through MSET and MGET, creates of concurrent senders are grouped into one MSET
 class MessageTextRepository {
 public:
-	MessageTextRepository(const std::string& connection_string);
-
-	int create(const common::MessageText& message);
-	std::optional<common::MessageText> read(int id);
+	MessageTextRepository(const std::string& connection_string, const MessageBatchConfig& batch_config = {});
+
+	// message must already carry its id, blocks until the batch with this message is written,
+	// returns the id or 0 on failure
+	common::MessageId create(const common::MessageText& message);
+	// future holds the message id or the exception of the failed batch
+	std::future<common::MessageId> create_async(const common::MessageText& message);
+	std::optional<common::MessageText> read(common::MessageId id);
 	bool update(const common::MessageText& message);
-	bool remove(int id);
+	bool remove(common::MessageId id);
+
+	// all messages are written with one MSET
+	bool create_many(const std::vector<common::MessageText>& messages);
+	// std::nullopt for ids that don't exist
+	std::vector<std::optional<common::MessageText> > read_many(const std::vector<common::MessageId>& ids);
+
+	// per receiver list of serialized messages that couldn't be delivered at send time
+	bool push_pending(int receiver_id, const std::string& message);
+	// up to max_count oldest messages, cut to max_bytes but at least one, they stay queued until remove_pending,
+	// RPUSH only appends, so the peeked messages are still the first ones as long as there is a single reader per receiver
+	std::vector<std::string> peek_pending(int receiver_id, size_t max_count, size_t max_bytes);
+	// drops the count oldest messages (LTRIM), called once the peeked ones are written to the receiver
+	bool remove_pending(int receiver_id, size_t count);
 
 private:
 	sw::redis::ConnectionOptions parse_config_string(const std::string& connection_string);
-	int get_next_id();
+	std::vector<common::MessageId> insert_batch(const std::vector<common::MessageText>& messages);
 
 private:
 	std::unique_ptr<sw::redis::Redis> _redis;
+	// last member, its thread uses the rest of the repository until it is joined
+	WriteBatcher<common::MessageText, common::MessageId> _insert_batcher;
 };
 
 }
\ No newline at end of file
@@ -1,25 +1,46 @@
 #pragma once
 
 #include "debug.hpp"
+#include "connection_pool.hpp"
+#include "server_config.hpp"
 
 #include <pqxx/pqxx>
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace server {
 
-// rename to postgre db manager
+struct PreparedStatement {
+	std::string _name;
+	std::string _sql;
+};
+
+using PreparedStatements = std::vector<PreparedStatement>;
+
+using PostgresConnectionPool = ConnectionPool<pqxx::connection>;
+using PostgresConnection = PostgresConnectionPool::Handle;
+
+// one connection pool per logical database name, pools are added at startup and looked up concurrently afterwards
 class PostgresDBManager {
 public:
 	PostgresDBManager() = default;
 	~PostgresDBManager() = default;
 
-	void add_connection(const std::string& name, const std::string& connection_string);
-	pqxx::connection& get_connection(const std::string& name);
+	// statements are prepared on every connection of the pool when it is opened,
+	// repositories run them with exec_prepared and don't pay parse/plan cost per call
+	void add_connection(const std::string& name, const std::string& connection_string,
+	                    const PreparedStatements& statements = {}, const ConnectionPoolConfig& pool_config = {});
+	// connection is returned to the pool when the handle is destroyed, keep it alive longer than the transaction
+	PostgresConnection get_connection(const std::string& name);
+	ConnectionPoolStats get_pool_stats(const std::string& name);
+
+private:
+	PostgresConnectionPool& get_pool(const std::string& name);
 
 private:
-	std::unordered_map<std::string, std::unique_ptr<pqxx::connection> > _connections;
+	std::unordered_map<std::string, std::unique_ptr<PostgresConnectionPool> > _pools;
 };
 
 }
\ No newline at end of file
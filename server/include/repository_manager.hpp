@@ -4,18 +4,27 @@
 #include "message_metadata_repository.hpp"
 #include "message_text_repository.hpp"
 #include "file_server_client.hpp"
+#include "latency_histogram.hpp"
 #include "postgres_db_manager.hpp"
 #include "server_config.hpp"
+#include "snowflake_id_generator.hpp"
 #include "user.hpp"
 #include "message.hpp"
 #include "user_crypto_keys.hpp"
 
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace server {
 
+// page of a conversation with message texts, newest first
+struct ConversationPage {
+	std::vector<common::Message> _messages;
+	std::string _next_cursor; // empty on the last page
+};
+
 class RepositoryManager {
 public:
 	explicit RepositoryManager(const ServerConfig& config);
@@ -26,20 +35,55 @@ public:
 	// bool mark_aes_key_as_initialized();
 	bool authorize_user(int user_id, const std::string& nickname, const std::string& password);
 	int get_user_id(const std::string& nickname);
+	CacheStats get_nickname_cache_stats() const;
 	std::optional<crypto::UserCryptoKeys> get_public_keys(const int user_id);
+	EncodedPublicKeysPtr get_encoded_public_keys(const int user_id);
+	CacheStats get_public_keys_cache_stats() const;
+
+	// assigns a new id to the message and writes metadata and text concurrently,
+	// future completes with the id when both stores have it or holds the exception of the first failed write
+	std::future<common::MessageId> create_message_async(common::Message& message);
+	// blocking create_message_async, returns the id or 0 on failure
+	common::MessageId create_message(common::Message& message);
+	LatencyStats get_message_write_latency() const;
+	CacheStats get_chat_cache_stats() const;
+	// metadata and text of one message, std::nullopt when either of them is missing
+	std::optional<common::Message> get_message(common::MessageId message_id);
+
+	// page of messages between two users after cursor (empty for the newest), texts are read with one MGET,
+	// std::nullopt on failure
+	std::optional<ConversationPage> get_history(int user_id, int peer_id, const std::string& cursor, size_t limit);
+
+	// messages partitions of the current and ServerConfig::_message_partitions_ahead next months,
+	// called at startup and then on a timer of the server, so a long running server doesn't outlive them
+	bool create_message_partitions();
 
-	int create_message(const common::Message& message);
-	common::Message get_message(int message_id);
+	// serialized message for a receiver that is offline, delivered after its next authorize
+	bool queue_offline_message(int receiver_id, const std::string& message);
+	// oldest queued messages within OfflineQueueConfig::_delivery_batch_size and _delivery_batch_max_bytes,
+	// they stay queued until remove_offline_messages
+	std::vector<std::string> peek_offline_messages(int receiver_id);
+	bool remove_offline_messages(int receiver_id, size_t count);
 
 	bool upload_file_chunk(const std::string& filename, const std::string& chunk_data);
+	// chunks of an upload session are written at their offsets and may come in any order,
+	// upload_file_chunk_at returns true once the file server has every byte of the file, std::nullopt on failure
+	bool create_upload_session(const std::string& filename, uint64_t file_size);
+	std::optional<bool> upload_file_chunk_at(const std::string& filename, uint64_t offset, const std::string& chunk_data);
+	bool commit_upload(const std::string& filename);
 	std::vector<std::string> download_file_chunks(const std::string& filename);
 
 private:
+	SnowflakeIdGenerator _message_id_generator;
 	PostgresDBManager _postgres_db_manager;
 	std::unique_ptr<UserMetadataRepository> _user_metadata_repo;
 	std::unique_ptr<MessageMetadataRepository> _msg_metadata_repo;
 	std::unique_ptr<MessageTextRepository> _msg_text_repo;
 	std::unique_ptr<file_server::FileServerClient> _file_server_client;
+	OfflineQueueConfig _offline_queue_config;
+	size_t _message_partitions_ahead;
+	// id assignment -> metadata and text durable
+	std::shared_ptr<LatencyHistogram> _message_write_latency;
 };
 
 }
\ No newline at end of file
@@ -5,13 +5,16 @@
 #include "message.hpp"
 #include "repository_manager.hpp"
 #include "connected_clients_manager.hpp"
+#include "session.hpp"
 #include "server_config.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
 #include <nlohmann/json.hpp>
 #include <mutex>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 namespace server {
@@ -21,38 +24,63 @@ class RequestHandler {
 
 public:
 	RequestHandler(RepositoryManager& repo_manager,
-	               ConnectedClientsManager& connected_clients_manager);
+	               ConnectedClientsManager& connected_clients_manager,
+	               FileRelayMode file_relay_mode = FileRelayMode::STREAMING,
+	               const OfflineQueueConfig& offline_queue_config = {});
 
-	void handle_request(boost::shared_ptr<tcp::socket> socket);
+	void handle_request(boost::shared_ptr<Session> session, const std::string& request_line, const std::string& binary_payload = "");
+	void handle_disconnect(boost::shared_ptr<Session> session);
 
 private:
+	// removed once the upload completes
 	struct UploadState {
-		size_t last_chunk_received;
-		bool completed;
+		size_t last_chunk_received = 0;
+		bool session_created = false;
 	};
 
 	struct PendingFileTransfer {
 		std::string filename;
 		int sender_id;
 		int receiver_id;
+		// receiver connection the chunks are streamed to, see relay_file_chunk
+		boost::weak_ptr<Session> relay_session;
+		size_t relayed_chunks;
+		// chunks are relayed strictly in order from the first one, so the relayed last chunk means the receiver has the whole file
+		bool relayed_last = false;
 	};
 
-	void handle_register(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
-	void handle_authorize(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
-	void handle_send_message(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
-	void handle_file_chunk(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
+	void handle_handshake(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_register(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_authorize(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_send_message(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_get_history(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_file_chunk(boost::shared_ptr<Session> session, const nlohmann::json& request, const std::string& binary_payload);
 	// check_comments in .cpp
-	void handle_get_user_keys(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
-	void handle_send_public_keys(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
-	void handle_send_aes_key(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request);
-	void send_file_to_client(boost::shared_ptr<tcp::socket> client_socket, const std::string& filename);
+	void handle_get_user_keys(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_send_public_keys(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void handle_send_aes_key(boost::shared_ptr<Session> session, const nlohmann::json& request);
+	void send_file_to_client(boost::shared_ptr<Session> client_session, const std::string& filename);
+	bool relay_file_chunk(PendingFileTransfer& transfer, size_t chunk_number, bool is_last, const std::string& chunk_data);
+	void send_file_chunk(boost::shared_ptr<Session> client_session, const std::string& filename, size_t chunk_index, bool is_last,
+	                     const std::string& chunk_data);
+	void send_incoming_file_notification(boost::shared_ptr<Session> receiver_session, const PendingFileTransfer& transfer);
+	void deliver_offline_messages(int user_id);
+	// false if the push wasn't written within OfflineQueueConfig::_delivery_write_timeout
+	bool send_offline_batch(boost::shared_ptr<Session> session, const std::vector<std::string>& messages);
 
 private:
 	RepositoryManager& _repo_manager;
 	ConnectedClientsManager& _connected_clients_manager;
+	FileRelayMode _file_relay_mode;
 	std::vector<PendingFileTransfer> _pending_file_transfers;
 	std::mutex _pending_transfers_mutex;
 	std::map<std::string, UploadState> _file_uploads;
+	// chunks of different connections are handled concurrently, the state is copied out and written back under this lock
+	std::mutex _file_uploads_mutex;
+	OfflineQueueConfig _offline_queue_config;
+	// users whose queue is being delivered, true - messages were queued meanwhile, so the queue is read once more
+	std::unordered_map<int, bool> _offline_deliveries;
+	std::mutex _offline_deliveries_mutex;
 };
 
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "repository_manager.hpp"
 #include "connected_clients_manager.hpp"
 #include "request_handler.hpp"
+#include "session.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/shared_ptr.hpp>
@@ -15,6 +16,18 @@
 
 namespace server {
 
+// io_service with its own acceptor, sessions accepted here are served by the threads of this reactor only,
+// their requests are handled by the worker threads of this reactor
+struct Reactor {
+	Reactor();
+
+	boost::asio::io_service _io_service;
+	boost::asio::ip::tcp::acceptor _acceptor;
+	boost::shared_ptr<boost::asio::io_service::work> _work;
+	boost::asio::io_service _workers;
+	boost::shared_ptr<boost::asio::io_service::work> _workers_work;
+};
+
 class Server : public boost::enable_shared_from_this<Server> {
 	using tcp = boost::asio::ip::tcp;
 
@@ -25,15 +38,21 @@ public:
 	void start();
 
 private:
-	void start_request_handling();
-	void handle_accept(boost::shared_ptr<tcp::socket> socket,
+	void open_acceptor(Reactor& reactor);
+	void run_reactor(size_t reactor_index);
+	void run_workers(size_t reactor_index);
+	void pin_current_thread(size_t reactor_index);
+	void start_request_handling(Reactor& reactor);
+	void schedule_partitions_check();
+	void handle_accept(Reactor& reactor, boost::shared_ptr<Session> session,
 	                   const boost::system::error_code& error);
 
 private:
-	boost::asio::io_service _io_service;
-	tcp::acceptor _acceptor;
-	boost::shared_ptr<boost::asio::io_service::work> _work;
+	std::vector<std::unique_ptr<Reactor> > _reactors;
 	std::vector<boost::shared_ptr<boost::thread> > _thread_pool;
+	std::vector<boost::shared_ptr<boost::thread> > _worker_threads;
+	// runs on reactor 0, the partitions themselves are created on a worker
+	std::unique_ptr<boost::asio::steady_timer> _partitions_timer;
 	ServerConfig _config;
 	RepositoryManager _repo_manager;
 	ConnectedClientsManager _connected_clients_manager;
@@ -1,17 +1,105 @@
 #pragma once
 
 #include <string>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 namespace server {
 
+// what to do with a connection whose outbound queue is full
+enum class SlowConsumerPolicy {
+	DROP_NEWEST, // new pushes are dropped until the queue drains
+	DISCONNECT   // connection is closed, the client has to reconnect
+};
+
+// how io threads are laid out
+enum class ReactorMode {
+	SHARED,  // one io_service run by _thread_pool_size threads, one acceptor
+	PER_CORE // _thread_pool_size io_services with one pinned thread and one SO_REUSEPORT acceptor each,
+	         // a connection lives on the reactor that accepted it, its requests run on the workers of that reactor,
+	         // pinned to the same core
+};
+
+// how file chunks reach an online receiver
+enum class FileRelayMode {
+	STORE_AND_FORWARD, // the whole file is downloaded back from the file server after the last chunk
+	STREAMING          // each chunk acknowledged by the file server is forwarded right away,
+	                   // the stored file is only used for receivers that weren't online from the first chunk on
+};
+
+// sizing of a database connection pool, max size of all pools together should stay below postgres max_connections
+struct ConnectionPoolConfig {
+	size_t _min_size = 2;                                        // opened eagerly at startup
+	size_t _max_size = 16;
+	std::chrono::milliseconds _checkout_timeout {5000};
+	std::chrono::milliseconds _health_check_idle {30000};        // connections idle longer are pinged before reuse
+	std::chrono::seconds _stats_report_interval {60};
+};
+
+// group commit of message inserts, see WriteBatcher
+struct MessageBatchConfig {
+	std::chrono::microseconds _window {300};
+	size_t _max_size = 128;
+};
+
+// messages for users that are offline at send time, kept in redis until their next authorize
+struct OfflineQueueConfig {
+	size_t _delivery_batch_size = 1000; // messages read from redis and sent in one receive_msgs push
+	size_t _delivery_batch_max_bytes = 1024 * 1024; // and their size, well below common::MAX_FRAME_PAYLOAD_BYTES
+	// a push is removed from redis only after it is written, the delivery stops if the write takes longer
+	std::chrono::milliseconds _delivery_write_timeout {30000};
+};
+
+// (user1_id, user2_id) -> chat id cache of MessageMetadataRepository
+// and the deferred chats.last_message_timestamp updates
+struct ChatCacheConfig {
+	size_t _capacity = 100000;
+	std::chrono::milliseconds _last_message_flush_interval {1000}; // chats touched in this window share one UPDATE
+	size_t _last_message_flush_max_size = 4096;
+};
+
+// nickname -> user id cache of UserMetadataRepository
+struct NicknameCacheConfig {
+	size_t _capacity = 100000;
+	std::chrono::milliseconds _negative_ttl {5000}; // unknown nicknames are cached this long
+	std::chrono::seconds _stats_report_interval {60}; // hit ratio is logged this often, 0 - never
+};
+
+// user id -> public keys cache of UserMetadataRepository
+struct PublicKeysCacheConfig {
+	size_t _capacity = 100000;
+	std::chrono::seconds _stats_report_interval {60}; // hit ratio is logged this often, 0 - never
+};
+
 struct ServerConfig {
 	unsigned short _port;
-	unsigned int _thread_pool_size;
+	unsigned int _thread_pool_size; // io threads, they only read, write and dispatch requests
+	// request handlers block on postgres, redis and the file server, they run on this pool and not on the io threads,
+	// so a few slow calls don't stall the reads and writes of every other connection,
+	// in PER_CORE mode every reactor gets its share of the pool
+	unsigned int _worker_pool_size = 256;
 	std::string _user_metadata_db_connection_string;
 	std::string _msg_metadata_db_connection_string;
 	std::string _msg_text_db_connection_string;
 	std::string _file_server_host;
 	std::string _file_server_port;
+	size_t _file_server_connections = 8; // keep-alive connections of FileServerClient
+	uint16_t _node_id = 0; // unique per server instance, 0..SnowflakeIdGenerator::MAX_NODE_ID
+	size_t _outbound_queue_max_messages = 1024;
+	SlowConsumerPolicy _slow_consumer_policy = SlowConsumerPolicy::DISCONNECT;
+	ReactorMode _reactor_mode = ReactorMode::SHARED;
+	bool _pin_reactor_threads = true;
+	FileRelayMode _file_relay_mode = FileRelayMode::STREAMING;
+	ConnectionPoolConfig _postgres_pool_config = {};
+	MessageBatchConfig _message_batch_config = {};
+	ChatCacheConfig _chat_cache_config = {};
+	size_t _message_partitions_ahead = 3; // monthly messages partitions kept ahead of the current one
+	std::chrono::seconds _message_partitions_check_interval {6 * 3600}; // partitions ahead are created again this often
+	NicknameCacheConfig _nickname_cache_config = {};
+	PublicKeysCacheConfig _public_keys_cache_config = {};
+	OfflineQueueConfig _offline_queue_config = {};
+	std::chrono::seconds _latency_report_interval {60}; // how often latency histograms are logged
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "debug.hpp"
+#include "frame.hpp"
+#include "server_config.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+
+namespace server {
+
+class RequestHandler;
+
+// one session per accepted connection, reads are driven by async completion handlers,
+// so an idle connection doesn't occupy any io_service thread
+class Session : public boost::enable_shared_from_this<Session> {
+	using tcp = boost::asio::ip::tcp;
+
+public:
+	Session(boost::asio::io_service& io_service, boost::asio::io_service& workers, RequestHandler& request_handler, const ServerConfig& config);
+	~Session();
+
+	void start();
+	// push to this connection, can be called from any thread,
+	// data is queued and written by a single async writer on the session strand,
+	// on_written is called on the strand with true once the data is written and with false if it never will be
+	void send(const std::string& message, const std::string& binary_payload = "", uint32_t request_id = 0,
+	          std::function<void(bool)> on_written = nullptr);
+	// response to the request that is currently handled, only valid inside of RequestHandler::handle_request
+	void reply(const std::string& message, const std::string& binary_payload = "");
+	void close();
+
+	tcp::socket& get_socket();
+	int get_user_id() const noexcept;
+	void set_user_id(int user_id) noexcept;
+	common::FramingMode get_framing() const noexcept;
+	void set_framing(common::FramingMode framing) noexcept;
+
+private:
+	struct PendingWrite {
+		std::string data;
+		std::function<void(bool)> on_written;
+	};
+
+	void do_read();
+	void do_read_json();
+	void do_read_frame();
+	void read_exactly(size_t bytes, std::function<void(const boost::system::error_code&)> handler);
+	void handle_json_read(const boost::system::error_code& error, size_t bytes_transferred);
+	void handle_frame_header_read(const boost::system::error_code& error);
+	void handle_frame_payload_read(const boost::system::error_code& error, const common::FrameHeader& header);
+	void handle_read_error(const boost::system::error_code& error);
+	void dispatch_request(std::string request, std::string binary_payload, uint32_t request_id);
+	void enqueue(std::string data, std::function<void(bool)> on_written);
+	void do_write();
+	void handle_write(const boost::system::error_code& error);
+	void fail_pending_writes();
+
+private:
+	tcp::socket _socket;
+	boost::asio::io_service::strand _strand;
+	boost::asio::io_service& _workers;
+	boost::asio::streambuf _read_buffer;
+	RequestHandler& _request_handler;
+	std::deque<PendingWrite> _write_queue;
+	size_t _writing_count;
+	size_t _dropped_count;
+	size_t _outbound_queue_max_messages;
+	SlowConsumerPolicy _slow_consumer_policy;
+	std::atomic<int> _user_id;
+	std::atomic<common::FramingMode> _framing;
+	uint32_t _current_request_id;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace server {
+
+// snowflake style 64-bit ids, generated in process before any I/O and used as the message key in every store
+// | 1 bit unused | 41 bits milliseconds since EPOCH_MS | 10 bits node id | 12 bits sequence |
+// ids of one node are strictly increasing, ids of all nodes are ordered by time up to clock skew between them
+class SnowflakeIdGenerator {
+public:
+	static constexpr int TIMESTAMP_BITS = 41;
+	static constexpr int NODE_ID_BITS = 10;
+	static constexpr int SEQUENCE_BITS = 12;
+	static constexpr uint16_t MAX_NODE_ID = (1 << NODE_ID_BITS) - 1;
+	static constexpr int64_t EPOCH_MS = 1704067200000; // 2024-01-01 00:00:00 UTC
+
+	// throws std::invalid_argument if node_id doesn't fit into NODE_ID_BITS
+	explicit SnowflakeIdGenerator(uint16_t node_id);
+
+	// lock free, safe to call from any thread
+	common::MessageId next_id() noexcept;
+
+	static common::Timestamp get_timestamp(common::MessageId id) noexcept;
+	static uint16_t get_node_id(common::MessageId id) noexcept;
+	// smallest id any node can generate at timestamp, bounds id ranges by time
+	static common::MessageId min_id_at(common::Timestamp timestamp) noexcept;
+
+private:
+	uint16_t _node_id;
+	// (milliseconds since EPOCH_MS << SEQUENCE_BITS) | sequence of the last generated id
+	std::atomic<uint64_t> _last;
+};
+
+}
\ No newline at end of file
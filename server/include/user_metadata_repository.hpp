@@ -4,15 +4,32 @@
 #include "user.hpp"
 #include "postgres_db_manager.hpp"
 #include "user_crypto_keys.hpp"
+#include "lru_cache.hpp"
+#include "server_config.hpp"
 
+#include <memory>
 #include <optional>
 #include <nlohmann/json.hpp>
 
 namespace server {
 
+// public keys of a user together with their hex encoding sent to clients, built once per user
+struct EncodedPublicKeys {
+	crypto::UserCryptoKeys _keys;
+	std::string _dsa_public_key_hex;
+	std::string _el_gamal_public_key_hex;
+};
+
+using EncodedPublicKeysPtr = std::shared_ptr<const EncodedPublicKeys>;
+
 class UserMetadataRepository : public BaseRepository<common::User> {
 public:
-	UserMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name);
+	// prepared on every pooled connection of the repository database, see PostgresDBManager::add_connection
+	static const PreparedStatements PREPARED_STATEMENTS;
+
+	UserMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name,
+	                       const NicknameCacheConfig& nickname_cache_config = {},
+	                       const PublicKeysCacheConfig& public_keys_cache_config = {});
 	virtual ~UserMetadataRepository() override;
 
 	int create(const common::User& user) override;
@@ -21,19 +38,31 @@ public:
 	bool remove(int id) override;
 
 	bool authorize(int user_id, const std::string& nickname, const std::string& password);
+	// served from the nickname cache, unknown nicknames are cached for _negative_ttl
 	int get_id(const std::string& nickname);
+	CacheStats get_nickname_cache_stats() const;
 	bool set_public_keys(const int user_id, const std::string& el_gamal_public_key, const std::string& dsa_public_key);
 	std::optional<crypto::UserCryptoKeys> get_public_keys(const int user_id);
+	// served from the public keys cache, filled by set_public_keys and on miss, nullptr if there are no keys
+	EncodedPublicKeysPtr get_encoded_public_keys(const int user_id);
+	CacheStats get_public_keys_cache_stats() const;
 
 private:
+	// update and remove know only the id, so the binding is looked up by value
+	void invalidate_nickname_cache(int user_id);
 	common::User construct_user(const nlohmann::json& user_json);
 	crypto::UserCryptoKeys construct_user_crypto_keys(const nlohmann::json& user_crypto_keys_json);
+	EncodedPublicKeysPtr encode_public_keys(const crypto::UserCryptoKeys& keys) const;
 	nlohmann::json pqxx_users_result_to_json(const pqxx::result& r) const;
 	nlohmann::json pqxx_crypto_keys_result_to_json(const pqxx::result& r) const;
 
 
 private:
 	std::string _connection_name; // move inside base repo
+	// 0 is cached for unknown nicknames
+	LruCache<std::string, int> _nickname_cache;
+	std::chrono::milliseconds _nickname_negative_ttl;
+	LruCache<int, EncodedPublicKeysPtr> _public_keys_cache;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "debug.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace server {
+
+// group commit: requests submitted from any thread are collected for up to `window` after the first one
+// (or until `max_size` are pending) and handed to `flush` as one batch on the batcher thread,
+// flush returns one result per request in the same order, every caller gets its result through a future
+template<typename Request, typename Result>
+class WriteBatcher {
+public:
+	using Flush = std::function<std::vector<Result>(const std::vector<Request>&)>;
+
+	WriteBatcher(const std::string& name, std::chrono::microseconds window, size_t max_size, Flush flush)
+		: _name(name),
+		_window(window),
+		_max_size(std::max<size_t>(1, max_size)),
+		_flush(std::move(flush)),
+		_stopped(false),
+		_thread(&WriteBatcher::run, this) {
+	}
+
+	// pending requests are still flushed
+	~WriteBatcher() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stopped = true;
+		}
+		_cv.notify_one();
+		_thread.join();
+	}
+
+	WriteBatcher(const WriteBatcher&) = delete;
+	WriteBatcher& operator=(const WriteBatcher&) = delete;
+
+	std::future<Result> submit(Request request) {
+		std::promise<Result> promise;
+		std::future<Result> future = promise.get_future();
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_stopped) {
+			promise.set_exception(std::make_exception_ptr(std::runtime_error("[WriteBatcher::submit] Batcher " + _name + " is stopped")));
+			return future;
+		}
+
+		_pending.push_back({std::move(request), std::move(promise)});
+		size_t pending_count = _pending.size();
+		lock.unlock();
+
+		// first request starts the window, a full batch ends it early
+		if (pending_count == 1 || pending_count == _max_size) {
+			_cv.notify_one();
+		}
+		return future;
+	}
+
+private:
+	struct Pending {
+		Request _request;
+		std::promise<Result> _promise;
+	};
+
+	void run() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true) {
+			_cv.wait(lock, [this]() {
+					return _stopped || !_pending.empty();
+				});
+			if (_pending.empty()) {
+				return;
+			}
+
+			auto deadline = std::chrono::steady_clock::now() + _window;
+			_cv.wait_until(lock, deadline, [this]() {
+					return _stopped || _pending.size() >= _max_size;
+				});
+
+			size_t batch_size = std::min(_pending.size(), _max_size);
+			std::vector<Pending> batch;
+			batch.reserve(batch_size);
+			for (size_t i = 0; i < batch_size; ++i) {
+				batch.push_back(std::move(_pending.front()));
+				_pending.pop_front();
+			}
+
+			lock.unlock();
+			flush_batch(batch);
+			lock.lock();
+		}
+	}
+
+	void flush_batch(std::vector<Pending>& batch) {
+		std::vector<Request> requests;
+		requests.reserve(batch.size());
+		for (const auto& pending : batch) {
+			requests.push_back(pending._request);
+		}
+
+		try {
+			std::vector<Result> results = _flush(requests);
+			if (results.size() != batch.size()) {
+				throw std::runtime_error("[WriteBatcher::flush_batch] Batcher " + _name + " got " + std::to_string(results.size())
+				                         + " results for " + std::to_string(batch.size()) + " requests");
+			}
+
+			for (size_t i = 0; i < batch.size(); ++i) {
+				batch[i]._promise.set_value(std::move(results[i]));
+			}
+		} catch (...) {
+			for (auto& pending : batch) {
+				pending._promise.set_exception(std::current_exception());
+			}
+		}
+	}
+
+private:
+	std::string _name;
+	std::chrono::microseconds _window;
+	size_t _max_size;
+	Flush _flush;
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::deque<Pending> _pending;
+	bool _stopped;
+	std::thread _thread;
+};
+
+}
\ No newline at end of file
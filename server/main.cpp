@@ -1,11 +1,14 @@
 #include <iostream>
+#include <thread>
+#include <algorithm>
 
 #include "server.hpp"
 
 int main() {
 	server::ServerConfig config {
 		._port = 55555,
-		._thread_pool_size = 256,
+		._thread_pool_size = std::max(1u, std::thread::hardware_concurrency()),
+		._worker_pool_size = 256,
 		._user_metadata_db_connection_string = "host=localhost port=5432 dbname=user_metadata user=postgres password=pass",
 		._msg_metadata_db_connection_string = "host=localhost port=5432 dbname=message_metadata user=postgres password=pass",
 		._msg_text_db_connection_string = "redis://spraga@127.0.0.1:6379",
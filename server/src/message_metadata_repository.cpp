@@ -1,50 +1,193 @@
 #include "message_metadata_repository.hpp"
+#include "snowflake_id_generator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+#include <unordered_map>
 
 namespace server {
 
-MessageMetadataRepository::MessageMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name) : BaseRepository(postgres_db_manager), _connection_name(connection_name) {
+// messages is range partitioned by created_timestamp, lookups by id also bound created_timestamp
+// to the window around the time encoded in the snowflake id, so the planner prunes all other partitions
+static constexpr auto ID_TIMESTAMP_SLACK = std::chrono::hours(24);
+
+// column lists are explicit, rows are decoded by position in construct_message
+const PreparedStatements MessageMetadataRepository::PREPARED_STATEMENTS = {
+	// ids are generated by the server before the insert, the database doesn't assign them
+	{"messages_insert",
+	 "INSERT INTO messages (id, chat_id, sender_id, receiver_id, created_timestamp) "
+	 "VALUES ($1, $2, $3, $4, $5)"},
+	{"messages_insert_batch",
+	 "INSERT INTO messages (id, chat_id, sender_id, receiver_id, created_timestamp) "
+	 "SELECT * FROM unnest($1::bigint[], $2::int[], $3::int[], $4::int[], $5::timestamptz[])"},
+	{"messages_select_by_id",
+	 "SELECT id, sender_id, receiver_id, chat_id, deleted, created_timestamp, deleted_timestamp, last_edited_timestamp "
+	 "FROM messages WHERE id = $1 AND created_timestamp >= $2::timestamptz AND created_timestamp < $3::timestamptz"},
+	// (created_timestamp, id) row comparison is matched to the idx_messages_chat_history range scan,
+	// the separate bound on created_timestamp prunes the partitions newer than the cursor
+	{"messages_select_history_page",
+	 "SELECT id, sender_id, receiver_id, chat_id, deleted, created_timestamp, deleted_timestamp, last_edited_timestamp "
+	 "FROM messages WHERE chat_id = $1 AND created_timestamp <= $2::timestamptz AND (created_timestamp, id) < ($2::timestamptz, $3::bigint) "
+	 "ORDER BY created_timestamp DESC, id DESC LIMIT $4"},
+	// chats store the smaller user id as user1_id
+	{"chats_select_id",
+	 "SELECT id FROM chats WHERE user1_id = LEAST($1::int, $2::int) AND user2_id = GREATEST($1::int, $2::int)"},
+	// get-or-create in one round trip, the select part finds the chat if it already existed
+	{"chats_get_or_create",
+	 "WITH inserted AS ("
+	 "INSERT INTO chats (user1_id, user2_id) VALUES (LEAST($1::int, $2::int), GREATEST($1::int, $2::int)) "
+	 "ON CONFLICT (user1_id, user2_id) DO NOTHING RETURNING id) "
+	 "SELECT id FROM inserted "
+	 "UNION ALL SELECT id FROM chats WHERE user1_id = LEAST($1::int, $2::int) AND user2_id = GREATEST($1::int, $2::int) "
+	 "LIMIT 1"},
+	{"chats_update_last_message",
+	 "UPDATE chats SET last_message_timestamp = activity.last_message_timestamp "
+	 "FROM unnest($1::int[], $2::timestamptz[]) AS activity(chat_id, last_message_timestamp) "
+	 "WHERE chats.id = activity.chat_id "
+	 "AND (chats.last_message_timestamp IS NULL OR chats.last_message_timestamp < activity.last_message_timestamp)"},
+	{"messages_update_edited",
+	 "UPDATE messages SET last_edited_timestamp = $1 "
+	 "WHERE id = $2 AND created_timestamp >= $3::timestamptz AND created_timestamp < $4::timestamptz"},
+	{"messages_mark_deleted",
+	 "UPDATE messages SET deleted = TRUE, deleted_timestamp = $1 "
+	 "WHERE id = $2 AND created_timestamp >= $3::timestamptz AND created_timestamp < $4::timestamptz"},
+	{"messages_is_partitioned",
+	 "SELECT relkind = 'p' FROM pg_class WHERE oid = 'messages'::regclass"},
+	// create_messages_partition is defined in database/message_metadata.sql
+	{"messages_create_partition",
+	 "SELECT create_messages_partition($1::date)"}
+};
+
+static std::string format_timestamp(const common::Timestamp& timestamp) {
+	auto time_t = std::chrono::system_clock::to_time_t(timestamp);
+	std::stringstream ss;
+	ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%d %H:%M:%S");
+	return ss.str();
+}
+
+// [id time - slack, id time + slack), created_timestamp is taken on the server right before the id
+static std::pair<std::string, std::string> id_timestamp_bounds(common::MessageId id) {
+	common::Timestamp id_timestamp = SnowflakeIdGenerator::get_timestamp(id);
+	return {format_timestamp(id_timestamp - ID_TIMESTAMP_SLACK), format_timestamp(id_timestamp + ID_TIMESTAMP_SLACK)};
+}
+
+static uint64_t chat_key(int user1_id, int user2_id) {
+	auto [low, high] = std::minmax(user1_id, user2_id);
+	return (static_cast<uint64_t>(static_cast<uint32_t>(low)) << 32) | static_cast<uint32_t>(high);
+}
+
+MessageMetadataRepository::MessageMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name,
+                                                     const MessageBatchConfig& batch_config, const ChatCacheConfig& chat_cache_config)
+	: BaseRepository(postgres_db_manager),
+	_connection_name(connection_name),
+	_chat_cache(chat_cache_config._capacity),
+	_last_message_batcher("chats_last_message", chat_cache_config._last_message_flush_interval, chat_cache_config._last_message_flush_max_size,
+	                      [this](const std::vector<ChatActivity>& activities) {
+			return update_last_message_timestamps(activities);
+		}),
+	_insert_batcher("messages_insert", batch_config._window, batch_config._max_size,
+	                [this](const std::vector<common::MessageMetadata>& messages) {
+			return insert_batch(messages);
+		}) {
 	DEBUG_MSG("MessageMetadataRepository created");
 }
 
 MessageMetadataRepository::~MessageMetadataRepository() = default;
 
-int MessageMetadataRepository::create(const common::MessageMetadata& message) {
+common::MessageId MessageMetadataRepository::create(const common::MessageMetadata& message) {
+	if (message.get_id() == 0) {
+		ERROR_MSG("[MessageMetadataRepository::create] Message has no id");
+		return 0;
+	}
+
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
+		common::MessageId inserted_id = create_async(message).get();
+		INFO_MSG("[MessageMetadataRepository::create] MessageMetadata inserted successfully with id: " + std::to_string(inserted_id));
+		return inserted_id;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageMetadataRepository::create] Exception caught: " + std::string(e.what()));
+		return 0;
+	}
+}
 
-		std::stringstream ss;
-		auto time_point = message.get_created_timestamp();
-		auto time_t = std::chrono::system_clock::to_time_t(time_point);
-		ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%d %H:%M:%S");
-		std::string formatted_time = ss.str();
+// chat is resolved here if the caller didn't do it
+std::future<common::MessageId> MessageMetadataRepository::create_async(const common::MessageMetadata& message) {
+	if (message.get_chat_id() != 0) {
+		return _insert_batcher.submit(message);
+	}
+
+	common::MessageMetadata resolved = message;
+	resolved.set_chat_id(resolve_chat_id(message.get_sender_id(), message.get_receiver_id()));
+	if (resolved.get_chat_id() == 0) {
+		std::promise<common::MessageId> failed;
+		failed.set_exception(std::make_exception_ptr(std::runtime_error("Failed to resolve chat of message " + std::to_string(message.get_id()))));
+		return failed.get_future();
+	}
+	return _insert_batcher.submit(resolved);
+}
+
+// runs on the batcher thread, exceptions fail every message of the batch
+std::vector<common::MessageId> MessageMetadataRepository::insert_batch(const std::vector<common::MessageMetadata>& messages) {
+	auto connection = _postgres_db_manager.get_connection(_connection_name);
+	pqxx::work txn(*connection);
 
-		pqxx::result r = txn.exec_params(
-			"INSERT INTO messages (sender_id, receiver_id, created_timestamp) "
-			"VALUES ($1, $2, $3) RETURNING id",
+	if (messages.size() == 1) {
+		const auto& message = messages.front();
+		pqxx::result r = txn.exec_prepared(
+			"messages_insert",
+			message.get_id(),
+			message.get_chat_id(),
 			message.get_sender_id(),
 			message.get_receiver_id(),
-			formatted_time
+			format_timestamp(message.get_created_timestamp())
 			);
 		txn.commit();
 
-		if (r.empty()) {
-			ERROR_MSG("[MessageMetadataRepository::create] Failed to insert message");
-			return 0;
+		if (r.affected_rows() == 0) {
+			throw std::runtime_error("Failed to insert message");
 		}
+		_last_message_batcher.submit({message.get_chat_id(), message.get_created_timestamp()});
+		return {message.get_id()};
+	}
 
-		int inserted_id = r[0][0].as<int>();
-		INFO_MSG("[MessageMetadataRepository::create] MessageMetadata inserted successfully with id: " + std::to_string(inserted_id));
-		return inserted_id;
-	} catch (const std::exception& e) {
-		ERROR_MSG("[MessageMetadataRepository::create] Exception caught: " + std::string(e.what()));
-		return 0;
+	std::vector<common::MessageId> ids;
+	std::vector<int> chat_ids;
+	std::vector<int> sender_ids;
+	std::vector<int> receiver_ids;
+	std::vector<std::string> created_timestamps;
+	ids.reserve(messages.size());
+	chat_ids.reserve(messages.size());
+	sender_ids.reserve(messages.size());
+	receiver_ids.reserve(messages.size());
+	created_timestamps.reserve(messages.size());
+
+	for (size_t i = 0; i < messages.size(); ++i) {
+		ids.push_back(messages[i].get_id());
+		chat_ids.push_back(messages[i].get_chat_id());
+		sender_ids.push_back(messages[i].get_sender_id());
+		receiver_ids.push_back(messages[i].get_receiver_id());
+		created_timestamps.push_back(format_timestamp(messages[i].get_created_timestamp()));
 	}
+
+	txn.exec_prepared("messages_insert_batch", ids, chat_ids, sender_ids, receiver_ids, created_timestamps);
+	txn.commit();
+
+	for (const auto& message : messages) {
+		_last_message_batcher.submit({message.get_chat_id(), message.get_created_timestamp()});
+	}
+
+	DEBUG_MSG("[MessageMetadataRepository::insert_batch] Inserted " + std::to_string(messages.size()) + " messages in one transaction");
+	return ids;
 }
 
-std::optional<common::MessageMetadata> MessageMetadataRepository::read(int id) {
+std::optional<common::MessageMetadata> MessageMetadataRepository::read(common::MessageId id) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
-		pqxx::result r = txn.exec_params("SELECT * FROM messages WHERE id = $1", id);
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		auto [from, to] = id_timestamp_bounds(id);
+		pqxx::result r = txn.exec_prepared("messages_select_by_id", id, from, to);
 		if (r.empty()) {
 			WARN_MSG("[MessageMetadataRepository::read] No message found with id: " + std::to_string(id));
 			return std::nullopt;
@@ -59,7 +202,8 @@ std::optional<common::MessageMetadata> MessageMetadataRepository::read(int id) {
 
 bool MessageMetadataRepository::update(const common::MessageMetadata& message) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
 
 		std::stringstream ss;
 		auto time_point = message.get_last_edited_timestamp().value_or(std::chrono::system_clock::now());
@@ -67,11 +211,13 @@ bool MessageMetadataRepository::update(const common::MessageMetadata& message) {
 		ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%d %H:%M:%S");
 		std::string formatted_time = ss.str();
 
-		pqxx::result r = txn.exec_params(
-			"UPDATE messages SET last_edited_timestamp = $1 "
-			"WHERE id = $2",
+		auto [from, to] = id_timestamp_bounds(message.get_id());
+		pqxx::result r = txn.exec_prepared(
+			"messages_update_edited",
 			formatted_time,
-			message.get_id()
+			message.get_id(),
+			from,
+			to
 			);
 		txn.commit();
 
@@ -89,9 +235,10 @@ bool MessageMetadataRepository::update(const common::MessageMetadata& message) {
 	DEBUG_MSG("[MessageMetadataRepository::update] DUMMY");
 }
 
-bool MessageMetadataRepository::remove(int id) {
+bool MessageMetadataRepository::remove(common::MessageId id) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
 
 		std::stringstream ss;
 		auto time_point = std::chrono::system_clock::now();
@@ -99,11 +246,13 @@ bool MessageMetadataRepository::remove(int id) {
 		ss << std::put_time(std::gmtime(&time_t), "%Y-%m-%d %H:%M:%S");
 		std::string formatted_time = ss.str();
 
-		pqxx::result r = txn.exec_params(
-			"UPDATE messages SET deleted = TRUE, deleted_timestamp = $1 "
-			"WHERE id = $2",
+		auto [from, to] = id_timestamp_bounds(id);
+		pqxx::result r = txn.exec_prepared(
+			"messages_mark_deleted",
 			formatted_time,
-			id
+			id,
+			from,
+			to
 			);
 		txn.commit();
 
@@ -120,6 +269,175 @@ bool MessageMetadataRepository::remove(int id) {
 	}
 }
 
+int MessageMetadataRepository::resolve_chat_id(int user1_id, int user2_id) {
+	uint64_t key = chat_key(user1_id, user2_id);
+	if (auto cached_id = _chat_cache.get(key)) {
+		return *cached_id;
+	}
+
+	try {
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		// a chat inserted by a concurrent transaction after the statement snapshot is invisible to the select part
+		// while the insert part conflicts with it, the next statement sees it
+		for (int attempt = 0; attempt < 2; ++attempt) {
+			pqxx::work txn(*connection);
+			pqxx::result r = txn.exec_prepared("chats_get_or_create", user1_id, user2_id);
+			txn.commit();
+
+			if (!r.empty()) {
+				int chat_id = r[0][0].as<int>();
+				_chat_cache.put(key, chat_id);
+				return chat_id;
+			}
+		}
+		ERROR_MSG("[MessageMetadataRepository::resolve_chat_id] No chat of users " + std::to_string(user1_id) + " and " + std::to_string(user2_id) + " after upsert");
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageMetadataRepository::resolve_chat_id] Exception caught: " + std::string(e.what()));
+	}
+	return 0;
+}
+
+int MessageMetadataRepository::get_chat_id(int user1_id, int user2_id) {
+	uint64_t key = chat_key(user1_id, user2_id);
+	if (auto cached_id = _chat_cache.get(key)) {
+		return *cached_id;
+	}
+
+	try {
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		pqxx::result r = txn.exec_prepared("chats_select_id", user1_id, user2_id);
+		txn.commit();
+
+		if (r.empty()) {
+			DEBUG_MSG("[MessageMetadataRepository::get_chat_id] No chat of users " + std::to_string(user1_id) + " and " + std::to_string(user2_id));
+			return 0;
+		}
+		int chat_id = r[0][0].as<int>();
+		_chat_cache.put(key, chat_id);
+		return chat_id;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageMetadataRepository::get_chat_id] Exception caught: " + std::string(e.what()));
+		return 0;
+	}
+}
+
+CacheStats MessageMetadataRepository::get_chat_cache_stats() const {
+	return _chat_cache.get_stats();
+}
+
+// runs on the last message batcher thread once per flush interval, only the newest message of every chat is written
+// nobody waits for these results, failures are only logged and fixed by the next message of the chat
+std::vector<bool> MessageMetadataRepository::update_last_message_timestamps(const std::vector<ChatActivity>& activities) {
+	std::unordered_map<int, common::Timestamp> newest;
+	for (const auto& activity : activities) {
+		auto [it, inserted] = newest.emplace(activity._chat_id, activity._last_message_timestamp);
+		if (!inserted && it->second < activity._last_message_timestamp) {
+			it->second = activity._last_message_timestamp;
+		}
+	}
+
+	std::vector<int> chat_ids;
+	std::vector<std::string> timestamps;
+	chat_ids.reserve(newest.size());
+	timestamps.reserve(newest.size());
+	for (const auto& [chat_id, timestamp] : newest) {
+		chat_ids.push_back(chat_id);
+		timestamps.push_back(format_timestamp(timestamp));
+	}
+
+	try {
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		txn.exec_prepared("chats_update_last_message", chat_ids, timestamps);
+		txn.commit();
+
+		DEBUG_MSG("[MessageMetadataRepository::update_last_message_timestamps] Updated " + std::to_string(chat_ids.size())
+		          + " chats for " + std::to_string(activities.size()) + " messages");
+		return std::vector<bool>(activities.size(), true);
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageMetadataRepository::update_last_message_timestamps] Exception caught: " + std::string(e.what()));
+		return std::vector<bool>(activities.size(), false);
+	}
+}
+
+// cursor is "<created_timestamp as postgres prints it>|<id>" of the last message of the previous page,
+// the timestamp text is passed back verbatim, so the comparison is exact
+std::optional<MessageHistoryPage> MessageMetadataRepository::get_history_page(int chat_id, const std::string& cursor, size_t limit) {
+	std::string before_timestamp = "infinity";
+	common::MessageId before_id = std::numeric_limits<common::MessageId>::max();
+
+	if (!cursor.empty()) {
+		size_t separator = cursor.rfind('|');
+		if (separator == std::string::npos) {
+			WARN_MSG("[MessageMetadataRepository::get_history_page] Invalid cursor: " + cursor);
+			return std::nullopt;
+		}
+		try {
+			before_timestamp = cursor.substr(0, separator);
+			before_id = std::stoll(cursor.substr(separator + 1));
+		} catch (const std::exception& e) {
+			WARN_MSG("[MessageMetadataRepository::get_history_page] Invalid cursor: " + cursor);
+			return std::nullopt;
+		}
+	}
+
+	try {
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		// one row more than the page tells whether there is a next page
+		pqxx::result r = txn.exec_prepared("messages_select_history_page", chat_id, before_timestamp, before_id, static_cast<long long>(limit + 1));
+		txn.commit();
+
+		MessageHistoryPage page;
+		size_t page_size = std::min(r.size(), limit);
+		page._messages.reserve(page_size);
+		for (size_t i = 0; i < page_size; ++i) {
+			page._messages.push_back(construct_message(r[i]));
+		}
+		if (r.size() > limit && page_size > 0) {
+			const auto& last = r[page_size - 1];
+			page._next_cursor = std::string(last[5].c_str()) + "|" + last[0].c_str();
+		}
+
+		DEBUG_MSG("[MessageMetadataRepository::get_history_page] Read " + std::to_string(page_size) + " messages of chat " + std::to_string(chat_id));
+		return page;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageMetadataRepository::get_history_page] Exception caught: " + std::string(e.what()));
+		return std::nullopt;
+	}
+}
+
+// partitions of the current month and `months_ahead` following months, existing ones are left as they are
+bool MessageMetadataRepository::create_partitions(size_t months_ahead) {
+	try {
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+
+		pqxx::result r = txn.exec_prepared("messages_is_partitioned");
+		if (r.empty() || !r[0][0].as<bool>()) {
+			INFO_MSG("[MessageMetadataRepository::create_partitions] messages table is not partitioned, nothing to create");
+			return true;
+		}
+
+		auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		std::tm today = *std::gmtime(&now);
+		for (size_t i = 0; i <= months_ahead; ++i) {
+			int months = today.tm_year * 12 + today.tm_mon + static_cast<int>(i);
+			char month_start[16];
+			std::snprintf(month_start, sizeof(month_start), "%04d-%02d-01", 1900 + months / 12, months % 12 + 1);
+			txn.exec_prepared("messages_create_partition", std::string(month_start));
+		}
+		txn.commit();
+
+		INFO_MSG("[MessageMetadataRepository::create_partitions] Partitions up to " + std::to_string(months_ahead) + " months ahead are in place");
+		return true;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageMetadataRepository::create_partitions] Exception caught: " + std::string(e.what()));
+		return false;
+	}
+}
+
 std::chrono::system_clock::time_point parse_timestamp(const std::string& timestamp_str) {
 	std::tm tm = {};
 	std::stringstream ss(timestamp_str);
@@ -128,18 +446,19 @@ std::chrono::system_clock::time_point parse_timestamp(const std::string& timesta
 }
 
 common::MessageMetadata MessageMetadataRepository::construct_message(const pqxx::row& row) {
+	// column order of messages_select_by_id
 	common::MessageMetadata msg(
-		row["id"].as<int>(),
-		row["sender_id"].as<int>(),
-		row["receiver_id"].as<int>(),
-		row["chat_id"].as<int>()
+		row[0].as<common::MessageId>(),
+		row[1].as<int>(),
+		row[2].as<int>(),
+		row[3].is_null() ? 0 : row[3].as<int>()
 		);
-	msg.set_deleted(row["deleted"].as<bool>());
-	msg.set_created_timestamp(parse_timestamp(row["created_timestamp"].as<std::string>()));
-	if (!row["deleted_timestamp"].is_null())
-		msg.set_deleted_timestamp(parse_timestamp(row["deleted_timestamp"].as<std::string>()));
-	if (!row["last_edited_timestamp"].is_null())
-		msg.set_last_edited_timestamp(parse_timestamp(row["last_edited_timestamp"].as<std::string>()));
+	msg.set_deleted(row[4].as<bool>());
+	msg.set_created_timestamp(parse_timestamp(row[5].as<std::string>()));
+	if (!row[6].is_null())
+		msg.set_deleted_timestamp(parse_timestamp(row[6].as<std::string>()));
+	if (!row[7].is_null())
+		msg.set_last_edited_timestamp(parse_timestamp(row[7].as<std::string>()));
 	return msg;
 }
 
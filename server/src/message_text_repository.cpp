@@ -1,9 +1,17 @@
 #include "message_text_repository.hpp"
+#include <chrono>
+#include <iterator>
 #include <regex>
 
 namespace server {
 
-MessageTextRepository::MessageTextRepository(const std::string& connection_string) {
+static const std::string PENDING_KEY_PREFIX = "pending:";
+
+MessageTextRepository::MessageTextRepository(const std::string& connection_string, const MessageBatchConfig& batch_config)
+	: _insert_batcher("message_texts_insert", batch_config._window, batch_config._max_size,
+	                  [this](const std::vector<common::MessageText>& messages) {
+			return insert_batch(messages);
+		}) {
 	try {
 		DEBUG_MSG("[MessageTextRepository::MessageTextRepository] Parsing message_text database connection string: " + connection_string);
 		auto connection_options = parse_config_string(connection_string);
@@ -48,23 +56,16 @@ sw::redis::ConnectionOptions MessageTextRepository::parse_config_string(const st
 	return options;
 }
 
-int MessageTextRepository::create(const common::MessageText& msg) {
-	try {
-		std::string value = msg.get_text();
-		INFO_MSG("[MessageTextRepository::create] Attempting to insert value: " + value);
-
-		long long new_id = _redis->incr("message_id_counter");
-		std::string key = std::to_string(new_id);
-
-		_redis->set(key, value);
-		auto result = _redis->get(key);
-		if (!result) {
-			ERROR_MSG("[MessageTextRepository::create] Verification failed. Unable to retrieve set value");
-			return 0;
-		}
+common::MessageId MessageTextRepository::create(const common::MessageText& msg) {
+	if (msg.get_id() == 0) {
+		ERROR_MSG("[MessageTextRepository::create] Message has no id");
+		return 0;
+	}
 
-		DEBUG_MSG("[MessageTextRepository::create] MessageText created successfully: " + value + " with id: " + key);
-		return static_cast<int>(new_id);
+	try {
+		common::MessageId id = create_async(msg).get();
+		DEBUG_MSG("[MessageTextRepository::create] MessageText created successfully with id: " + std::to_string(id));
+		return id;
 	} catch(const sw::redis::Error& e) {
 		ERROR_MSG("[MessageTextRepository::create] " + std::string(e.what()));
 		return 0;
@@ -74,7 +75,34 @@ int MessageTextRepository::create(const common::MessageText& msg) {
 	}
 }
 
-std::optional<common::MessageText> MessageTextRepository::read(int id) {
+std::future<common::MessageId> MessageTextRepository::create_async(const common::MessageText& message) {
+	return _insert_batcher.submit(message);
+}
+
+// runs on the batcher thread, exceptions fail every message of the batch
+std::vector<common::MessageId> MessageTextRepository::insert_batch(const std::vector<common::MessageText>& messages) {
+	std::vector<common::MessageId> ids;
+	ids.reserve(messages.size());
+
+	if (messages.size() == 1) {
+		_redis->set(std::to_string(messages.front().get_id()), messages.front().get_text());
+		ids.push_back(messages.front().get_id());
+		return ids;
+	}
+
+	std::vector<std::pair<std::string, std::string> > items;
+	items.reserve(messages.size());
+	for (const auto& message : messages) {
+		items.emplace_back(std::to_string(message.get_id()), message.get_text());
+		ids.push_back(message.get_id());
+	}
+	_redis->mset(items.begin(), items.end());
+
+	DEBUG_MSG("[MessageTextRepository::insert_batch] Wrote " + std::to_string(messages.size()) + " messages with one MSET");
+	return ids;
+}
+
+std::optional<common::MessageText> MessageTextRepository::read(common::MessageId id) {
 	try {
 		auto result = _redis->get(std::to_string(id));
 		if (result) {
@@ -96,9 +124,9 @@ std::optional<common::MessageText> MessageTextRepository::read(int id) {
 bool MessageTextRepository::update(const common::MessageText& message) {
 	try {
 		auto key = std::to_string(message.get_id());
-		auto exists = _redis->exists(key);
-		if (exists) {
-			_redis->set(key, message.get_text());
+		// XX: written only if the key already exists
+		bool updated = _redis->set(key, message.get_text(), std::chrono::milliseconds(0), sw::redis::UpdateType::EXIST);
+		if (updated) {
 			INFO_MSG("[MessageTextRepository::update] Successfully updated message with id: " + key);
 			return true;
 		} else {
@@ -114,7 +142,7 @@ bool MessageTextRepository::update(const common::MessageText& message) {
 	}
 }
 
-bool MessageTextRepository::remove(int id) {
+bool MessageTextRepository::remove(common::MessageId id) {
 	try {
 		auto key = std::to_string(id);
 		auto removed = _redis->del(key);
@@ -134,4 +162,120 @@ bool MessageTextRepository::remove(int id) {
 	}
 }
 
+bool MessageTextRepository::create_many(const std::vector<common::MessageText>& messages) {
+	if (messages.empty()) {
+		return true;
+	}
+
+	for (const auto& message : messages) {
+		if (message.get_id() == 0) {
+			ERROR_MSG("[MessageTextRepository::create_many] Message has no id");
+			return false;
+		}
+	}
+
+	try {
+		insert_batch(messages);
+		DEBUG_MSG("[MessageTextRepository::create_many] Created " + std::to_string(messages.size()) + " messages");
+		return true;
+	} catch (const sw::redis::Error& e) {
+		ERROR_MSG("[MessageTextRepository::create_many] Redis error: " + std::string(e.what()));
+		return false;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageTextRepository::create_many] " + std::string(e.what()));
+		return false;
+	}
+}
+
+std::vector<std::optional<common::MessageText> > MessageTextRepository::read_many(const std::vector<common::MessageId>& ids) {
+	std::vector<std::optional<common::MessageText> > messages(ids.size());
+	if (ids.empty()) {
+		return messages;
+	}
+
+	try {
+		std::vector<std::string> keys;
+		keys.reserve(ids.size());
+		for (common::MessageId id : ids) {
+			keys.push_back(std::to_string(id));
+		}
+
+		std::vector<sw::redis::OptionalString> values;
+		values.reserve(ids.size());
+		_redis->mget(keys.begin(), keys.end(), std::back_inserter(values));
+
+		for (size_t i = 0; i < values.size() && i < ids.size(); ++i) {
+			if (values[i]) {
+				messages[i] = common::MessageText(ids[i], *values[i]);
+			}
+		}
+
+		DEBUG_MSG("[MessageTextRepository::read_many] Read " + std::to_string(ids.size()) + " messages");
+	} catch (const sw::redis::Error& e) {
+		ERROR_MSG("[MessageTextRepository::read_many] Redis error: " + std::string(e.what()));
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageTextRepository::read_many] " + std::string(e.what()));
+	}
+	return messages;
+}
+
+bool MessageTextRepository::push_pending(int receiver_id, const std::string& message) {
+	try {
+		_redis->rpush(PENDING_KEY_PREFIX + std::to_string(receiver_id), message);
+		return true;
+	} catch (const sw::redis::Error& e) {
+		ERROR_MSG("[MessageTextRepository::push_pending] Redis error: " + std::string(e.what()));
+		return false;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageTextRepository::push_pending] " + std::string(e.what()));
+		return false;
+	}
+}
+
+std::vector<std::string> MessageTextRepository::peek_pending(int receiver_id, size_t max_count, size_t max_bytes) {
+	std::vector<std::string> messages;
+	if (max_count == 0) {
+		return messages;
+	}
+
+	try {
+		_redis->lrange(PENDING_KEY_PREFIX + std::to_string(receiver_id), 0, static_cast<long long>(max_count) - 1,
+		               std::back_inserter(messages));
+
+		// the first message is always returned, otherwise one large message would block the queue
+		size_t bytes = 0;
+		size_t count = 0;
+		while (count < messages.size() && (count == 0 || bytes + messages[count].size() <= max_bytes)) {
+			bytes += messages[count].size();
+			++count;
+		}
+		messages.resize(count);
+	} catch (const sw::redis::Error& e) {
+		ERROR_MSG("[MessageTextRepository::peek_pending] Redis error: " + std::string(e.what()));
+		messages.clear();
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageTextRepository::peek_pending] " + std::string(e.what()));
+		messages.clear();
+	}
+	return messages;
+}
+
+bool MessageTextRepository::remove_pending(int receiver_id, size_t count) {
+	if (count == 0) {
+		return true;
+	}
+
+	try {
+		_redis->ltrim(PENDING_KEY_PREFIX + std::to_string(receiver_id), static_cast<long long>(count), -1);
+		DEBUG_MSG("[MessageTextRepository::remove_pending] Removed " + std::to_string(count) + " pending messages of user " + std::to_string(receiver_id));
+		return true;
+	} catch (const sw::redis::Error& e) {
+		ERROR_MSG("[MessageTextRepository::remove_pending] Redis error: " + std::string(e.what()));
+		return false;
+	} catch (const std::exception& e) {
+		ERROR_MSG("[MessageTextRepository::remove_pending] " + std::string(e.what()));
+		return false;
+	}
+}
+
 }
\ No newline at end of file
@@ -2,15 +2,44 @@
 
 namespace server {
 
-void PostgresDBManager::add_connection(const std::string& name, const std::string& connection_string) {
-	_connections[name] = std::make_unique<pqxx::connection>(connection_string);
+void PostgresDBManager::add_connection(const std::string& name, const std::string& connection_string,
+                                       const PreparedStatements& statements, const ConnectionPoolConfig& pool_config) {
+	auto factory = [connection_string, statements]() {
+			auto connection = std::make_unique<pqxx::connection>(connection_string);
+			for (const auto& statement : statements) {
+				connection->prepare(statement._name, statement._sql);
+			}
+			return connection;
+		};
+
+	auto health_check = [](pqxx::connection& connection) {
+			try {
+				pqxx::nontransaction txn(connection);
+				txn.exec("SELECT 1");
+				return true;
+			} catch (const std::exception& e) {
+				WARN_MSG("[PostgresDBManager] Health check failed: " + std::string(e.what()));
+				return false;
+			}
+		};
+
+	_pools[name] = std::make_unique<PostgresConnectionPool>(name, pool_config, factory, health_check);
 	DEBUG_MSG("Connected to db via connection string: " + connection_string);
 }
 
-pqxx::connection& PostgresDBManager::get_connection(const std::string& name) {
-	auto it = _connections.find(name);
-	if (it == _connections.end()) {
-		FATAL_MSG("[PostgresDBManager::get_connection()] Database connection not found " + name);
+PostgresConnection PostgresDBManager::get_connection(const std::string& name) {
+	return get_pool(name).checkout();
+}
+
+ConnectionPoolStats PostgresDBManager::get_pool_stats(const std::string& name) {
+	return get_pool(name).get_stats();
+}
+
+PostgresConnectionPool& PostgresDBManager::get_pool(const std::string& name) {
+	auto it = _pools.find(name);
+	if (it == _pools.end()) {
+		FATAL_MSG("[PostgresDBManager::get_pool()] Database connection not found " + name);
+		throw std::out_of_range("Database connection not found " + name);
 	}
 	return *(it->second);
 }
@@ -3,14 +3,28 @@
 
 namespace server {
 
-RepositoryManager::RepositoryManager(const ServerConfig& config) {
-	_postgres_db_manager.add_connection("user_metadata_db", config._user_metadata_db_connection_string);
-	_postgres_db_manager.add_connection("message_metadata_db", config._msg_metadata_db_connection_string);
+RepositoryManager::RepositoryManager(const ServerConfig& config)
+	: _message_id_generator(config._node_id),
+	_offline_queue_config(config._offline_queue_config),
+	_message_partitions_ahead(config._message_partitions_ahead),
+	_message_write_latency(std::make_shared<LatencyHistogram>("message_write", config._latency_report_interval)) {
+	_postgres_db_manager.add_connection("user_metadata_db", config._user_metadata_db_connection_string,
+	                                     UserMetadataRepository::PREPARED_STATEMENTS, config._postgres_pool_config);
+	_postgres_db_manager.add_connection("message_metadata_db", config._msg_metadata_db_connection_string,
+	                                     MessageMetadataRepository::PREPARED_STATEMENTS, config._postgres_pool_config);
 
-	_user_metadata_repo = std::make_unique<UserMetadataRepository>(_postgres_db_manager, "user_metadata_db");
-	_msg_metadata_repo = std::make_unique<MessageMetadataRepository>(_postgres_db_manager, "message_metadata_db");
-	_msg_text_repo = std::make_unique<MessageTextRepository>(config._msg_text_db_connection_string);
-	_file_server_client = std::make_unique<file_server::FileServerClient>(config._file_server_host, config._file_server_port);
+	_user_metadata_repo = std::make_unique<UserMetadataRepository>(_postgres_db_manager, "user_metadata_db",
+	                                                               config._nickname_cache_config, config._public_keys_cache_config);
+	_msg_metadata_repo = std::make_unique<MessageMetadataRepository>(_postgres_db_manager, "message_metadata_db",
+	                                                                 config._message_batch_config, config._chat_cache_config);
+	// rows of months without a partition would end up in messages_default
+	if (!create_message_partitions()) {
+		FATAL_MSG("[RepositoryManager::RepositoryManager] Failed to create messages partitions");
+		throw std::runtime_error("Failed to create messages partitions");
+	}
+	_msg_text_repo = std::make_unique<MessageTextRepository>(config._msg_text_db_connection_string, config._message_batch_config);
+	_file_server_client = std::make_unique<file_server::FileServerClient>(config._file_server_host, config._file_server_port,
+	                                                                     file_server::FileServerClientConfig{config._file_server_connections});
 }
 
 int RepositoryManager::create_user(const common::User& user) {
@@ -25,6 +39,10 @@ std::optional<crypto::UserCryptoKeys> RepositoryManager::get_public_keys(const i
 	return _user_metadata_repo->get_public_keys(user_id);
 }
 
+EncodedPublicKeysPtr RepositoryManager::get_encoded_public_keys(const int user_id) {
+	return _user_metadata_repo->get_encoded_public_keys(user_id);
+}
+
 bool RepositoryManager::authorize_user(int user_id, const std::string& nickname, const std::string& password) {
 	return _user_metadata_repo->authorize(user_id, nickname, password);
 }
@@ -33,24 +51,153 @@ int RepositoryManager::get_user_id(const std::string& nickname) {
 	return _user_metadata_repo->get_id(nickname);
 }
 
-int RepositoryManager::create_message(const common::Message& message) {
-	int msg_metadata_id = _msg_metadata_repo->create(message.get_metadata());
-	// int msg_text_id = _msg_text_repo->create(message.get_text());
+CacheStats RepositoryManager::get_nickname_cache_stats() const {
+	return _user_metadata_repo->get_nickname_cache_stats();
+}
+
+CacheStats RepositoryManager::get_public_keys_cache_stats() const {
+	return _user_metadata_repo->get_public_keys_cache_stats();
+}
+
+// the id exists before any I/O, so metadata and text are keyed by the same value and written at the same time,
+// each by the write batcher of its repository, the send takes max(postgres, redis) instead of their sum
+std::future<common::MessageId> RepositoryManager::create_message_async(common::Message& message) {
+	auto started = std::chrono::steady_clock::now();
+	message.set_id(_message_id_generator.next_id());
+	// cache hit in the steady state, the sender and the receiver get the chat id with the message
+	common::MessageMetadata metadata = message.get_metadata();
+	message.set_chat_id(_msg_metadata_repo->resolve_chat_id(metadata.get_sender_id(), metadata.get_receiver_id()));
+
+	auto metadata_future = _msg_metadata_repo->create_async(message.get_metadata());
+	auto text_future = _msg_text_repo->create_async(message.get_text());
+
+	// deferred: runs in the thread that waits for the result, both writes are already in flight
+	return std::async(std::launch::deferred,
+	                  [metadata_future = std::move(metadata_future), text_future = std::move(text_future),
+	                   id = message.get_id(), started, latency = _message_write_latency]() mutable {
+			std::exception_ptr error;
+			try {
+				metadata_future.get();
+			} catch (const std::exception& e) {
+				WARN_MSG("[RepositoryManager::create_message_async] Metadata of message " + std::to_string(id) + " is not saved: " + e.what());
+				error = std::current_exception();
+			}
+			try {
+				text_future.get();
+			} catch (const std::exception& e) {
+				WARN_MSG("[RepositoryManager::create_message_async] Text of message " + std::to_string(id) + " is not saved: " + e.what());
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+			if (error) {
+				std::rethrow_exception(error);
+			}
+
+			latency->record(std::chrono::steady_clock::now() - started);
+			return id;
+		});
+}
+
+common::MessageId RepositoryManager::create_message(common::Message& message) {
+	try {
+		return create_message_async(message).get();
+	} catch (const std::exception& e) {
+		ERROR_MSG("[RepositoryManager::create_message] Failed to save message: " + std::string(e.what()));
+		return 0;
+	}
+}
+
+LatencyStats RepositoryManager::get_message_write_latency() const {
+	return _message_write_latency->get_stats();
+}
+
+CacheStats RepositoryManager::get_chat_cache_stats() const {
+	return _msg_metadata_repo->get_chat_cache_stats();
+}
+
+std::optional<common::Message> RepositoryManager::get_message(common::MessageId message_id) {
+	auto metadata = _msg_metadata_repo->read(message_id);
+	if (!metadata) {
+		return std::nullopt;
+	}
+
+	auto text = _msg_text_repo->read(message_id);
+	if (!text) {
+		WARN_MSG("[RepositoryManager::get_message] No text of message " + std::to_string(message_id));
+		return std::nullopt;
+	}
+	return common::Message(*metadata, *text);
+}
+
+std::optional<ConversationPage> RepositoryManager::get_history(int user_id, int peer_id, const std::string& cursor, size_t limit) {
+	ConversationPage page;
+
+	int chat_id = _msg_metadata_repo->get_chat_id(user_id, peer_id);
+	if (chat_id == 0) {
+		return page;
+	}
+
+	auto metadata_page = _msg_metadata_repo->get_history_page(chat_id, cursor, limit);
+	if (!metadata_page) {
+		return std::nullopt;
+	}
+
+	std::vector<common::MessageId> ids;
+	ids.reserve(metadata_page->_messages.size());
+	for (const auto& metadata : metadata_page->_messages) {
+		ids.push_back(metadata.get_id());
+	}
+	auto texts = _msg_text_repo->read_many(ids);
+
+	page._messages.reserve(ids.size());
+	for (size_t i = 0; i < ids.size(); ++i) {
+		if (!texts[i]) {
+			WARN_MSG("[RepositoryManager::get_history] No text of message " + std::to_string(ids[i]));
+		}
+		page._messages.emplace_back(metadata_page->_messages[i], texts[i].value_or(common::MessageText(ids[i], "")));
+	}
+	page._next_cursor = std::move(metadata_page->_next_cursor);
+	return page;
+}
+
+bool RepositoryManager::create_message_partitions() {
+	return _msg_metadata_repo->create_partitions(_message_partitions_ahead);
+}
+
+bool RepositoryManager::queue_offline_message(int receiver_id, const std::string& message) {
+	return _msg_text_repo->push_pending(receiver_id, message);
+}
 
-	// if (msg_text_id == msg_metadata_id) {
-	// 	return msg_text_id;
-	// } else {
-	// 	WARN_MSG("[RepositoryManager::create_message] Failed to insert messages into dbs: msg ids are different. metadata_id "
-	// 	         + std::to_string(msg_metadata_id) + ", text_id " + std::to_string(msg_text_id));
-	// }
+std::vector<std::string> RepositoryManager::peek_offline_messages(int receiver_id) {
+	return _msg_text_repo->peek_pending(receiver_id, _offline_queue_config._delivery_batch_size,
+	                                    _offline_queue_config._delivery_batch_max_bytes);
+}
 
-	return msg_metadata_id;
+bool RepositoryManager::remove_offline_messages(int receiver_id, size_t count) {
+	return _msg_text_repo->remove_pending(receiver_id, count);
 }
 
 bool RepositoryManager::upload_file_chunk(const std::string& filename, const std::string& chunk_data) {
 	return _file_server_client->upload_chunk(filename, chunk_data);
 }
 
+bool RepositoryManager::create_upload_session(const std::string& filename, uint64_t file_size) {
+	return _file_server_client->create_upload_session(filename, file_size).has_value();
+}
+
+std::optional<bool> RepositoryManager::upload_file_chunk_at(const std::string& filename, uint64_t offset, const std::string& chunk_data) {
+	auto status = _file_server_client->upload_session_chunk(filename, offset, chunk_data);
+	if (!status) {
+		return std::nullopt;
+	}
+	return status->is_complete();
+}
+
+bool RepositoryManager::commit_upload(const std::string& filename) {
+	return _file_server_client->commit_upload_session(filename);
+}
+
 std::vector<std::string> RepositoryManager::download_file_chunks(const std::string& filename) {
 	return _file_server_client->download_file_chunks(filename);
 }
@@ -1,88 +1,101 @@
 #include "request_handler.hpp"
 
+#include <algorithm>
+#include <future>
+
 namespace server {
 
 using tcp = boost::asio::ip::tcp;
 
+static constexpr size_t DEFAULT_HISTORY_PAGE_SIZE = 50;
+static constexpr size_t MAX_HISTORY_PAGE_SIZE = 200;
+
 RequestHandler::RequestHandler(RepositoryManager& repo_manager,
-                               ConnectedClientsManager& connected_clients_manager)
+                               ConnectedClientsManager& connected_clients_manager,
+                               FileRelayMode file_relay_mode,
+                               const OfflineQueueConfig& offline_queue_config)
 	: _repo_manager(repo_manager),
-	_connected_clients_manager(connected_clients_manager) {
+	_connected_clients_manager(connected_clients_manager),
+	_file_relay_mode(file_relay_mode),
+	_offline_queue_config(offline_queue_config) {
 }
 
-void RequestHandler::handle_request(boost::shared_ptr<tcp::socket> socket) {
-	boost::asio::streambuf request_buf;
-	boost::system::error_code error;
-
-	while (true) {
-		boost::asio::read_until(*socket, request_buf, "\r\n\r\n", error);
-
-		if (error == boost::asio::error::eof) {
-			DEBUG_MSG("[Server::handle_request] Client closed connection on socket: " + common::get_socket_info(*socket));
-
-			_connected_clients_manager.remove_client_by_socket(socket);
-
-			DEBUG_MSG("[Server::handle_authorize] Client removed from connected list: " + common::get_socket_info(*socket));
-			DEBUG_MSG("[Server::handle_authorize] Currently, there are "
-			          + std::to_string(_connected_clients_manager.get_connected_count()) + " users connected");
-
-			break;
-		} else if (error) {
-			ERROR_MSG(std::string(error.message()));
-		}
-
-		std::istream request_stream(&request_buf);
-		std::string request_line;
-		std::getline(request_stream, request_line);
-
-		try {
-			nlohmann::json request = nlohmann::json::parse(request_line);
-
-			if (request.contains("type")) {
-				if (request["type"] == "register") {
-					handle_register(socket, request);
-				} else if (request["type"] == "authorize") {
-					handle_authorize(socket, request);
-				} else if(request["type"] == "send_message") {
-					handle_send_message(socket, request);
-				} else if (request["type"] == "file_chunk") {
-					handle_file_chunk(socket, request);
-				} else if (request["type"] == "get_user_keys") {
-					handle_get_user_keys(socket, request);
-				} else if (request["type"] == "send_aes_key") {
-					handle_send_aes_key(socket, request);
-				}
-				else {
-					nlohmann::json response = {
-						{"status", "error"},
-						{"response", "Unknown request type"}
-					};
-					boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"), error);
-				}
-			} else {
+void RequestHandler::handle_request(boost::shared_ptr<Session> session, const std::string& request_line, const std::string& binary_payload) {
+	try {
+		nlohmann::json request = nlohmann::json::parse(request_line);
+
+		if (request.contains("type")) {
+			if (request["type"] == "handshake") {
+				handle_handshake(session, request);
+			} else if (request["type"] == "register") {
+				handle_register(session, request);
+			} else if (request["type"] == "authorize") {
+				handle_authorize(session, request);
+			} else if(request["type"] == "send_message") {
+				handle_send_message(session, request);
+			} else if (request["type"] == "file_chunk") {
+				handle_file_chunk(session, request, binary_payload);
+			} else if (request["type"] == "get_user_keys") {
+				handle_get_user_keys(session, request);
+			} else if (request["type"] == "send_aes_key") {
+				handle_send_aes_key(session, request);
+			} else if (request["type"] == "get_history") {
+				handle_get_history(session, request);
+			}
+			else {
 				nlohmann::json response = {
 					{"status", "error"},
-					{"response", "Missing request type"}
+					{"response", "Unknown request type"}
 				};
-				boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"), error);
+				session->reply(response.dump());
 			}
-		} catch (const nlohmann::json::parse_error& e) {
+		} else {
 			nlohmann::json response = {
 				{"status", "error"},
-				{"response", "Invalid JSON format"}
+				{"response", "Missing request type"}
 			};
-			boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"), error);
+			session->reply(response.dump());
 		}
+	} catch (const nlohmann::json::parse_error& e) {
+		nlohmann::json response = {
+			{"status", "error"},
+			{"response", "Invalid JSON format"}
+		};
+		session->reply(response.dump());
+	} catch (const std::exception& e) {
+		ERROR_MSG("[RequestHandler::handle_request] Failed to handle request: " + std::string(e.what()));
+	}
+}
 
-		if (error) {
-			ERROR_MSG("[Server::handle_request] While sending response" + std::string(error.message()))
-		}
+void RequestHandler::handle_disconnect(boost::shared_ptr<Session> session) {
+	_connected_clients_manager.remove_client_by_session(session);
+
+	DEBUG_MSG("[RequestHandler::handle_disconnect] Client removed from connected list, user id: " + std::to_string(session->get_user_id()));
+	DEBUG_MSG("[RequestHandler::handle_disconnect] Currently, there are "
+	          + std::to_string(_connected_clients_manager.get_connected_count()) + " users connected");
+}
+
+void RequestHandler::handle_handshake(boost::shared_ptr<Session> session, const nlohmann::json& request) {
+	DEBUG_MSG("[RequestHandler::handle_handshake] Received request: " + request.dump());
 
-		request_buf.consume(request_buf.size());
+	common::FramingMode framing = common::FramingMode::JSON;
+	if (request.contains("framing") && request["framing"].is_string()) {
+		framing = common::framing_mode_from_string(request["framing"]);
 	}
+
+	nlohmann::json response;
+	response["type"] = "handshake";
+	response["status"] = "success";
+	response["framing"] = common::framing_mode_to_string(framing);
+
+	// the handshake response itself is always sent in the legacy json mode
+	session->reply(response.dump());
+	session->set_framing(framing);
+
+	DEBUG_MSG("[RequestHandler::handle_handshake] Framing mode set to " + common::framing_mode_to_string(framing));
 }
 
-void RequestHandler::handle_register(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+void RequestHandler::handle_register(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 	DEBUG_MSG("[Server::handle_register] Received request: " + request.dump());
 	std::string nickname = request["nickname"];
 	std::string password = request["password"];
@@ -109,10 +122,10 @@ void RequestHandler::handle_register(boost::shared_ptr<tcp::socket> socket, cons
 	}
 
 	DEBUG_MSG("[Server::handle_register] Sending response: " + response.dump());
-	boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"));
+	session->reply(response.dump());
 }
 
-void RequestHandler::handle_authorize(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+void RequestHandler::handle_authorize(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 	std::string nickname = request["nickname"];
 	std::string password = request["password"];
 	int user_id = request["user_id"];
@@ -124,19 +137,99 @@ void RequestHandler::handle_authorize(boost::shared_ptr<tcp::socket> socket, con
 		response["status"] = "success";
 		response["response"] = "Authorization successful";
 
-		_connected_clients_manager.add_client(user_id, socket);
+		session->set_user_id(user_id);
+		_connected_clients_manager.add_client(user_id, session);
 		// "New user connected" in handle authorize may be counterintuitive?
-		DEBUG_MSG("[Server::handle_authorize] New user connected, with id: " + std::to_string(user_id) + " on socket: " + common::get_socket_info(*socket));
+		DEBUG_MSG("[Server::handle_authorize] New user connected, with id: " + std::to_string(user_id) + " on socket: " + common::get_socket_info(session->get_socket()));
 		DEBUG_MSG("[Server::handle_authorize] Currently, there are " + std::to_string(_connected_clients_manager.get_connected_count()) + " users connected");
 	} else {
 		response["status"] = "error";
 		response["response"] = "Authorization failed: Invalid credentials";
 	}
 	DEBUG_MSG("[Server::handle_authorize] Sending request: " + request.dump());
-	boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"));
+	session->reply(response.dump());
+
+	if (auth_success) {
+		deliver_offline_messages(user_id);
+	}
 }
 
-void RequestHandler::handle_send_message(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+// queued messages go out in receive_msgs pushes of up to OfflineQueueConfig::_delivery_batch_size messages,
+// they are stored as serialized json, so a push is assembled without parsing them again.
+// a batch is removed from redis only after its push is written to the socket, so a failed write or a disconnect
+// leaves it queued for the next authorize (a failed removal after a written push delivers it twice, ids tell them apart),
+// authorize and the late receiver check in handle_send_message may both get here, one of them delivers and
+// the other one only marks the queue to be read again, one push is in flight at a time
+void RequestHandler::deliver_offline_messages(int user_id) {
+	{
+		std::lock_guard<std::mutex> lock(_offline_deliveries_mutex);
+		auto [it, inserted] = _offline_deliveries.emplace(user_id, false);
+		if (!inserted) {
+			it->second = true;
+			return;
+		}
+	}
+
+	size_t delivered = 0;
+	while (true) {
+		std::vector<std::string> messages = _repo_manager.peek_offline_messages(user_id);
+		if (messages.empty()) {
+			std::lock_guard<std::mutex> lock(_offline_deliveries_mutex);
+			auto it = _offline_deliveries.find(user_id);
+			if (it->second) {
+				it->second = false;
+				continue;
+			}
+			_offline_deliveries.erase(it);
+			break;
+		}
+
+		// the session the user has now, it may have reconnected since the delivery started
+		auto session = _connected_clients_manager.get_client_session(user_id);
+		bool written = session && send_offline_batch(session, messages);
+		if (!written || !_repo_manager.remove_offline_messages(user_id, messages.size())) {
+			WARN_MSG("[RequestHandler::deliver_offline_messages] Delivery to user " + std::to_string(user_id) + " stopped, "
+			         + std::to_string(messages.size()) + " messages stay queued");
+			std::lock_guard<std::mutex> lock(_offline_deliveries_mutex);
+			_offline_deliveries.erase(user_id);
+			break;
+		}
+		delivered += messages.size();
+	}
+
+	if (delivered > 0) {
+		INFO_MSG("[RequestHandler::deliver_offline_messages] Delivered " + std::to_string(delivered) + " queued messages to user " + std::to_string(user_id));
+	}
+}
+
+bool RequestHandler::send_offline_batch(boost::shared_ptr<Session> session, const std::vector<std::string>& messages) {
+	std::string push = R"({"type":"receive_msgs","messages":[)";
+	for (size_t i = 0; i < messages.size(); ++i) {
+		if (i > 0) {
+			push += ',';
+		}
+		push += messages[i];
+	}
+	push += "]}";
+
+	auto written = std::make_shared<std::promise<bool> >();
+	std::future<bool> result = written->get_future();
+	try {
+		session->send(push, "", 0, [written](bool ok) {
+				written->set_value(ok);
+			});
+	} catch (const std::exception& e) {
+		ERROR_MSG("[RequestHandler::send_offline_batch] Failed to send a push of " + std::to_string(messages.size())
+		          + " queued messages to user " + std::to_string(session->get_user_id()) + ": " + std::string(e.what()));
+		// a single message too large for a frame is dropped, otherwise it would block the queue for good,
+		// batches are cut to _delivery_batch_max_bytes, so a larger one only fails with a misconfigured limit
+		return messages.size() == 1;
+	}
+
+	return result.wait_for(_offline_queue_config._delivery_write_timeout) == std::future_status::ready && result.get();
+}
+
+void RequestHandler::handle_send_message(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 	DEBUG_MSG("[Server::handle_send_message] Called on request: " + request.dump());
 
 	int sender_id = request["sender_id"];
@@ -149,31 +242,20 @@ void RequestHandler::handle_send_message(boost::shared_ptr<tcp::socket> socket,
 	if (receiver_id == 0) {
 		sender_response["status"] = "error";
 		sender_response["response"] = "Receiver not found";
-		boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+		session->reply(sender_response.dump());
 		return;
 	}
 
 	common::Message new_msg(sender_id, receiver_id, request_text);
-	int msg_metadata_id = _repo_manager.create_message(new_msg);
-
-	if (msg_metadata_id) {
-		new_msg.set_id(msg_metadata_id);
-	} else {
-		WARN_MSG("[Server::handle_send_message] msg_text_id and msg_metadata_id are not equal");
-		// add more info?
-		sender_response["status"] = "error";
-		sender_response["response"] = "Failed to correctly save messages in database";
-		boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
-		return;
-	}
+	// metadata and text are written concurrently, the sender is acked and the receiver gets the message
+	// only after both of them are durable
+	common::MessageId msg_id = _repo_manager.create_message(new_msg);
 
 	// we should not return failure here, some kind of retry logic or/and buffer is better
-	// we also can do it async
-	// if (msg_metadata_id == 0 || msg_text_id == 0) { // connection to redis is broken now :(
-	if (msg_metadata_id == 0) {
+	if (msg_id == 0) {
 		sender_response["status"] = "error";
 		sender_response["response"] = "Failed to save message into db/s";
-		boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+		session->reply(sender_response.dump());
 		return;
 	}
 
@@ -182,15 +264,24 @@ void RequestHandler::handle_send_message(boost::shared_ptr<tcp::socket> socket,
 	// sender_response["file_name"] = request_filename;
 	sender_response.update(new_msg.to_json());
 	DEBUG_MSG("[Server::handle_send_message] Response for sender: " + sender_response.dump());
-	boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+	session->reply(sender_response.dump());
 
-	auto receiver_socket = _connected_clients_manager.get_client_socket(receiver_id);
-	if (receiver_socket) {
+	auto receiver_session = _connected_clients_manager.get_client_session(receiver_id);
+	if (receiver_session) {
 		receiver_response.update(new_msg.to_json());
 		receiver_response["type"] = "receive_msg";
 		// receiver_response["file_name"] = request_filename;
 		DEBUG_MSG("[Server::handle_send_message] Response for receiver: " + receiver_response.dump());
-		boost::asio::write(*receiver_socket, boost::asio::buffer(receiver_response.dump() + "\r\n\r\n"));
+		receiver_session->send(receiver_response.dump());
+	} else if (_repo_manager.queue_offline_message(receiver_id, new_msg.to_json().dump())) {
+		DEBUG_MSG("[Server::handle_send_message] Receiver " + std::to_string(receiver_id) + " is offline, message " + std::to_string(msg_id) + " is queued");
+		// receiver may have authorized between the lookup and the push, its queue was drained before the push
+		auto late_receiver_session = _connected_clients_manager.get_client_session(receiver_id);
+		if (late_receiver_session) {
+			deliver_offline_messages(receiver_id);
+		}
+	} else {
+		ERROR_MSG("[Server::handle_send_message] Receiver " + std::to_string(receiver_id) + " is offline and message " + std::to_string(msg_id) + " couldn't be queued");
 	}
 
 	if (request.contains("file_name") && request["file_name"] != "none") {
@@ -201,14 +292,19 @@ void RequestHandler::handle_send_message(boost::shared_ptr<tcp::socket> socket,
 			_pending_file_transfers.push_back(PendingFileTransfer{
 					filename,
 					sender_id,
-					receiver_id
+					receiver_id,
+					{},
+					0
 				});
 			DEBUG_MSG("[Server::handle_send_message] Created pending transfer for file: " +
 			          filename + " from user " + std::to_string(sender_id) +
 			          " to user " + std::to_string(receiver_id));
 		}
 
-		_file_uploads[filename] = {0, false};
+		{
+			std::lock_guard<std::mutex> lock(_file_uploads_mutex);
+			_file_uploads[filename] = UploadState{};
+		}
 
 		sender_response["file_name"] = filename;
 		DEBUG_MSG("[Server::handle_send_message] File transfer initialized for: " + filename);
@@ -218,82 +314,167 @@ void RequestHandler::handle_send_message(boost::shared_ptr<tcp::socket> socket,
 	sender_response["response"] = "Message sent successfully";
 	sender_response.update(new_msg.to_json());
 	DEBUG_MSG("[Server::handle_send_message] Response for sender: " + sender_response.dump());
-	boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+	session->reply(sender_response.dump());
 
-	if (receiver_socket) {
+	if (receiver_session) {
 		receiver_response.update(new_msg.to_json());
 		receiver_response["type"] = "receive_msg";
 		if (request.contains("file_name") && request["file_name"] != "none") {
 			receiver_response["file_name"] = request["file_name"];
 		}
 		DEBUG_MSG("[Server::handle_send_message] Response for receiver: " + receiver_response.dump());
-		boost::asio::write(*receiver_socket, boost::asio::buffer(receiver_response.dump() + "\r\n\r\n"));
+		receiver_session->send(receiver_response.dump());
 	}
 }
 
-void RequestHandler::handle_file_chunk(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+// history of the authorized user with another user, page by page from the newest message,
+// next_cursor of the response is passed back as cursor for the older page and is null on the last one
+void RequestHandler::handle_get_history(boost::shared_ptr<Session> session, const nlohmann::json& request) {
+	DEBUG_MSG("[Server::handle_get_history] Received request: " + request.dump());
+
+	nlohmann::json response;
+	response["type"] = "history";
+
+	int user_id = session->get_user_id();
+	if (user_id == 0) {
+		response["status"] = "error";
+		response["response"] = "Not authorized";
+		session->reply(response.dump());
+		return;
+	}
+
+	std::string peer_nickname = request["with_nickname"];
+	int peer_id = _repo_manager.get_user_id(peer_nickname);
+	if (peer_id == 0) {
+		response["status"] = "error";
+		response["response"] = "User not found";
+		session->reply(response.dump());
+		return;
+	}
+
+	std::string cursor = request.value("cursor", "");
+	size_t limit = std::clamp<size_t>(request.value("limit", DEFAULT_HISTORY_PAGE_SIZE), 1, MAX_HISTORY_PAGE_SIZE);
+
+	auto page = _repo_manager.get_history(user_id, peer_id, cursor, limit);
+	if (!page) {
+		response["status"] = "error";
+		response["response"] = "Failed to read history";
+		session->reply(response.dump());
+		return;
+	}
+
+	nlohmann::json messages = nlohmann::json::array();
+	for (const auto& message : page->_messages) {
+		messages.push_back(message.to_json());
+	}
+
+	response["status"] = "success";
+	response["with_nickname"] = peer_nickname;
+	response["messages"] = std::move(messages);
+	response["next_cursor"] = page->_next_cursor.empty() ? nlohmann::json(nullptr) : nlohmann::json(page->_next_cursor);
+	session->reply(response.dump());
+}
+
+void RequestHandler::handle_file_chunk(boost::shared_ptr<Session> session, const nlohmann::json& request, const std::string& binary_payload) {
 	DEBUG_MSG("[Server::handle_file_chunk] Request: " + request.dump());
 
 	std::string filename = request["filename"];
-	std::string chunk_data = request["chunk_data"];
+	// in binary framing mode chunk bytes travel verbatim after the json part of the frame
+	std::string chunk_data = request.contains("chunk_data") ? request["chunk_data"].get<std::string>() : binary_payload;
 	size_t chunk_number = request["chunk_number"];
 	bool is_last = request["is_last"];
 
-	if (_file_uploads.find(filename) == _file_uploads.end()) {
-		_file_uploads[filename] = {0, false};
+	UploadState upload_state;
+	{
+		std::lock_guard<std::mutex> lock(_file_uploads_mutex);
+		upload_state = _file_uploads[filename];
 	}
 
-	auto& upload_state = _file_uploads[filename];
-
 	nlohmann::json sender_response;
 	sender_response["type"] = "chunk_acknowledgment";
 	sender_response["filename"] = filename;
 	sender_response["chunk_number"] = chunk_number;
 
-	if (chunk_number != upload_state.last_chunk_received + 1) {
+	// chunks with an offset go to an upload session of the file server, they are accepted in any order and
+	// a chunk lost with a broken connection is sent again later, the upload completes once the file server
+	// has all file_size bytes; chunks without an offset are appended and have to come one after another
+	bool stored = false;
+	bool completed = false;
+	if (request.contains("offset") && request.contains("file_size")) {
+		uint64_t offset = request["offset"];
+		uint64_t file_size = request["file_size"];
+		if (!upload_state.session_created) {
+			upload_state.session_created = _repo_manager.create_upload_session(filename, file_size);
+		}
+
+		std::optional<bool> all_received;
+		if (upload_state.session_created) {
+			all_received = _repo_manager.upload_file_chunk_at(filename, offset, chunk_data);
+		}
+		stored = all_received.has_value();
+		completed = stored && *all_received;
+		if (completed && !_repo_manager.commit_upload(filename)) {
+			WARN_MSG("[Server::handle_file_chunk] Failed to commit upload of " + filename);
+			stored = false;
+			completed = false;
+		}
+	} else if (chunk_number != upload_state.last_chunk_received + 1) {
 		WARN_MSG("[Server::handle_file_chunk] Received out-of-order chunk. Expected: "
 		         + std::to_string(upload_state.last_chunk_received + 1)
 		         + ", Got: " + std::to_string(chunk_number));
 		sender_response["status"] = "error";
 		sender_response["error"] = "wrong_chunk_order";
+	} else {
+		stored = _repo_manager.upload_file_chunk(filename, chunk_data);
+		completed = stored && is_last;
 	}
-	else if (_repo_manager.upload_file_chunk(filename, chunk_data)) {
+
+	if (stored) {
 		INFO_MSG("[Server::handle_file_chunk] Chunk " + std::to_string(chunk_number) + " uploaded");
 		sender_response["status"] = "success";
-		upload_state.last_chunk_received = chunk_number;
-
-		if (is_last) {
-			upload_state.completed = true;
-			INFO_MSG("[Server::handle_file_chunk] File upload completed: " + filename);
-
-			std::lock_guard<std::mutex> lock(_pending_transfers_mutex);
-			auto pending_it = std::find_if(_pending_file_transfers.begin(),
-			                               _pending_file_transfers.end(),
-			                               [&filename](const PendingFileTransfer& transfer) {
-					return transfer.filename == filename;
-				});
+		{
+			std::lock_guard<std::mutex> lock(_file_uploads_mutex);
+			if (completed) {
+				_file_uploads.erase(filename);
+			} else {
+				auto& state = _file_uploads[filename];
+				state.last_chunk_received = std::max(state.last_chunk_received, chunk_number);
+				state.session_created = state.session_created || upload_state.session_created;
+			}
+		}
 
-			if (pending_it != _pending_file_transfers.end()) {
-				auto receiver_socket = _connected_clients_manager.get_client_socket(pending_it->receiver_id);
-				if (receiver_socket) {
-					try {
-						nlohmann::json file_transfer_notification;
-						file_transfer_notification["type"] = "incoming_file";
-						file_transfer_notification["filename"] = filename;
-						file_transfer_notification["sender_id"] = pending_it->sender_id;
+		std::lock_guard<std::mutex> lock(_pending_transfers_mutex);
+		auto pending_it = std::find_if(_pending_file_transfers.begin(),
+		                               _pending_file_transfers.end(),
+		                               [&filename](const PendingFileTransfer& transfer) {
+				return transfer.filename == filename;
+			});
 
-						DEBUG_MSG("[Server::handle_file_chunk] Sending file transfer notification: "
-						          + file_transfer_notification.dump());
+		if (pending_it != _pending_file_transfers.end() && _file_relay_mode == FileRelayMode::STREAMING) {
+			relay_file_chunk(*pending_it, chunk_number, is_last, chunk_data);
+		}
 
-						boost::asio::write(*receiver_socket,
-						                   boost::asio::buffer(file_transfer_notification.dump() + "\r\n\r\n"));
+		if (completed) {
+			INFO_MSG("[Server::handle_file_chunk] File upload completed: " + filename);
 
-						send_file_to_client(receiver_socket, filename);
-						_pending_file_transfers.erase(pending_it);
+			// chunks of a session may complete the file out of order, the stream stopped at the first gap then
+			// and the receiver gets the stored file instead
+			if (pending_it != _pending_file_transfers.end() && pending_it->relayed_last) {
+				INFO_MSG("[Server::handle_file_chunk] File " + filename
+				         + " streamed to receiver " + std::to_string(pending_it->receiver_id)
+				         + " (" + std::to_string(pending_it->relayed_chunks) + " chunks)");
+				_pending_file_transfers.erase(pending_it);
+			} else if (pending_it != _pending_file_transfers.end()) {
+				auto receiver_session = _connected_clients_manager.get_client_session(pending_it->receiver_id);
+				if (receiver_session) {
+					try {
+						send_incoming_file_notification(receiver_session, *pending_it);
+						send_file_to_client(receiver_session, filename);
 
 						INFO_MSG("[Server::handle_file_chunk] File " + filename
 						         + " successfully transferred to receiver "
 						         + std::to_string(pending_it->receiver_id));
+						_pending_file_transfers.erase(pending_it);
 					}
 					catch (const std::exception& e) {
 						ERROR_MSG("[Server::handle_file_chunk] Failed to send file to receiver: "
@@ -309,14 +490,14 @@ void RequestHandler::handle_file_chunk(boost::shared_ptr<tcp::socket> socket, co
 				         + filename);
 			}
 		}
-	} else {
+	} else if (!sender_response.contains("error")) {
 		WARN_MSG("[Server::handle_file_chunk] Failed to upload chunk to file server");
 		sender_response["status"] = "error";
 		sender_response["error"] = "upload_failed";
 	}
 
 	try {
-		boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+		session->reply(sender_response.dump());
 		DEBUG_MSG("[Server::handle_file_chunk] Sent acknowledgment: " + sender_response.dump());
 	}
 	catch (const std::exception& e) {
@@ -325,7 +506,7 @@ void RequestHandler::handle_file_chunk(boost::shared_ptr<tcp::socket> socket, co
 	}
 }
 
-void RequestHandler::handle_get_user_keys(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+void RequestHandler::handle_get_user_keys(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 	DEBUG_MSG("[Server::handle_get_user_keys] Received request: " + request.dump());
 	std::string nickname = request["nickname"];
 
@@ -335,42 +516,42 @@ void RequestHandler::handle_get_user_keys(boost::shared_ptr<tcp::socket> socket,
 	if (receiver_id == 0) {
 		response["status"] = "error";
 		response["response"] = "Receiver not found";
-		boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"));
+		session->reply(response.dump());
 		return;
 	}
 
-	std::optional<crypto::UserCryptoKeys> receiver_crypto_keys = _repo_manager.get_public_keys(receiver_id);
+	EncodedPublicKeysPtr receiver_crypto_keys = _repo_manager.get_encoded_public_keys(receiver_id);
 
-	if (!receiver_crypto_keys.has_value()) {
+	if (!receiver_crypto_keys) {
 		ERROR_MSG("[RequestHandler::handle_get_user_keys] Failed to retrieve keys for user: " + std::to_string(receiver_id));
 		response["status"] = "error";
 		response["response"] = "Failed to retrieve keys";
-		boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"));
+		session->reply(response.dump());
 
 		return;
 		// add retry logic ???
 	} else {
 		response["status"] = "success";
 		response["user_id"] = receiver_id;
-		response["dsa_public_key"] = crypto::cpp_int_to_hex(receiver_crypto_keys->get_dsa_public_key());
-		response["el_gamal_public_key"] = crypto::cpp_int_to_hex(receiver_crypto_keys->get_el_gamal_public_key());
+		response["dsa_public_key"] = receiver_crypto_keys->_dsa_public_key_hex;
+		response["el_gamal_public_key"] = receiver_crypto_keys->_el_gamal_public_key_hex;
 	}
 
 	DEBUG_MSG("[Server::handle_get_user_keys] Sending response: " + response.dump());
-	boost::asio::write(*socket, boost::asio::buffer(response.dump() + "\r\n\r\n"));
+	session->reply(response.dump());
 }
 
 // I thought we will need this now, but actually it is better to handle this on register step
 // then when keys cycle is over we will use these methods;
-// void RequestHandler::handle_receive_public_keys(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+// void RequestHandler::handle_receive_public_keys(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 // }
 
 // I thought we will need this now, but actually it is better to handle this on register step
 // then when keys cycle is over we will use these methods;
-// void RequestHandler::handle_send_public_keys(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+// void RequestHandler::handle_send_public_keys(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 // }
 
-void RequestHandler::handle_send_aes_key(boost::shared_ptr<tcp::socket> socket, const nlohmann::json& request) {
+void RequestHandler::handle_send_aes_key(boost::shared_ptr<Session> session, const nlohmann::json& request) {
 	DEBUG_MSG("[RequaestHandler::handle_send_aes_key] Called on request " + request.dump());
 
 	int sender_id = request["sender_id"];
@@ -386,7 +567,7 @@ void RequestHandler::handle_send_aes_key(boost::shared_ptr<tcp::socket> socket,
 	if (receiver_id == 0) {
 		sender_response["status"] = "error";
 		sender_response["response"] = "Receiver not found";
-		boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+		session->reply(sender_response.dump());
 		return;
 	}
 
@@ -395,10 +576,10 @@ void RequestHandler::handle_send_aes_key(boost::shared_ptr<tcp::socket> socket,
 	sender_response["status"] = "success";
 	sender_response["response"] = "AES key sent successfully";
 	DEBUG_MSG("[RequaestHandler::handle_send_aes_key] Response for sender: " +  sender_response.dump());
-	boost::asio::write(*socket, boost::asio::buffer(sender_response.dump() + "\r\n\r\n"));
+	session->reply(sender_response.dump());
 
-	auto receiver_socket = _connected_clients_manager.get_client_socket(receiver_id);
-	if(receiver_socket) {
+	auto receiver_session = _connected_clients_manager.get_client_session(receiver_id);
+	if(receiver_session) {
 		receiver_response["type"] = "receive_aes_key";
 		receiver_response["sender_id"] = sender_id;
 		receiver_response["encrypted_aes_key_c1"] = encrypted_aes_key_c1;
@@ -407,11 +588,64 @@ void RequestHandler::handle_send_aes_key(boost::shared_ptr<tcp::socket> socket,
 		receiver_response["dsa_signature"] = dsa_signature;
 
 		DEBUG_MSG("[RequaestHandler::handle_send_aes_key] Response for receiver: " +  receiver_response.dump());
-		boost::asio::write(*receiver_socket, boost::asio::buffer(receiver_response.dump() + "\r\n\r\n"));
+		receiver_session->send(receiver_response.dump());
 	}
 }
 
-void RequestHandler::send_file_to_client(boost::shared_ptr<tcp::socket> client_socket, const std::string& filename) {
+void RequestHandler::send_incoming_file_notification(boost::shared_ptr<Session> receiver_session, const PendingFileTransfer& transfer) {
+	nlohmann::json file_transfer_notification;
+	file_transfer_notification["type"] = "incoming_file";
+	file_transfer_notification["filename"] = transfer.filename;
+	file_transfer_notification["sender_id"] = transfer.sender_id;
+
+	DEBUG_MSG("[Server::send_incoming_file_notification] Sending file transfer notification: "
+	          + file_transfer_notification.dump());
+
+	receiver_session->send(file_transfer_notification.dump());
+}
+
+// pass-through of a chunk the file server has acknowledged, the receiver gets it while the upload is still going on
+// and the server doesn't keep the file, relaying only starts with the first chunk and stops for good once
+// the receiver misses a chunk or reconnects, such a receiver gets the stored file after the last chunk instead
+bool RequestHandler::relay_file_chunk(PendingFileTransfer& transfer, size_t chunk_number, bool is_last, const std::string& chunk_data) {
+	auto receiver_session = _connected_clients_manager.get_client_session(transfer.receiver_id);
+	if (!receiver_session) {
+		return false;
+	}
+
+	if (transfer.relayed_chunks == 0) {
+		if (chunk_number != 1) {
+			return false;
+		}
+		transfer.relay_session = receiver_session;
+		send_incoming_file_notification(receiver_session, transfer);
+	} else if (transfer.relay_session.lock() != receiver_session || transfer.relayed_chunks != chunk_number - 1) {
+		return false;
+	}
+
+	send_file_chunk(receiver_session, transfer.filename, chunk_number - 1, is_last, chunk_data);
+	++transfer.relayed_chunks;
+	transfer.relayed_last = is_last;
+	return true;
+}
+
+void RequestHandler::send_file_chunk(boost::shared_ptr<Session> client_session, const std::string& filename, size_t chunk_index, bool is_last,
+                                     const std::string& chunk_data) {
+	nlohmann::json chunk_message;
+	chunk_message["type"] = "file_chunk";
+	chunk_message["filename"] = filename;
+	chunk_message["chunk_number"] = chunk_index;
+	chunk_message["is_last"] = is_last;
+
+	if (client_session->get_framing() == common::FramingMode::BINARY) {
+		client_session->send(chunk_message.dump(), chunk_data);
+	} else {
+		chunk_message["chunk_data"] = chunk_data;
+		client_session->send(chunk_message.dump());
+	}
+}
+
+void RequestHandler::send_file_to_client(boost::shared_ptr<Session> client_session, const std::string& filename) {
 	std::vector<std::string> chunks = _repo_manager.download_file_chunks(filename);
 
 	if (chunks.empty()) {
@@ -420,16 +654,8 @@ void RequestHandler::send_file_to_client(boost::shared_ptr<tcp::socket> client_s
 	}
 
 	for (size_t i = 0; i < chunks.size(); ++i) {
-		nlohmann::json chunk_message;
-		chunk_message["type"] = "file_chunk";
-		chunk_message["filename"] = filename;
-		chunk_message["chunk_number"] = i;
-		chunk_message["chunk_data"] = chunks[i];
-		chunk_message["is_last"] = (i == chunks.size() - 1);
-
 		try {
-			boost::asio::write(*client_socket,
-			                   boost::asio::buffer(chunk_message.dump() + "\r\n\r\n"));
+			send_file_chunk(client_session, filename, i, i == chunks.size() - 1, chunks[i]);
 
 			DEBUG_MSG("[Server::send_file_to_client] Sent chunk "
 			          + std::to_string(i + 1) + "/" + std::to_string(chunks.size())
@@ -1,38 +1,65 @@
 #include "server.hpp"
 #include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
 
 namespace server {
 
 using tcp = boost::asio::ip::tcp;
 
+// SO_REUSEPORT lets every reactor bind its own listening socket to the same port,
+// the kernel then spreads incoming connections between them
+using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+Reactor::Reactor()
+	: _io_service(),
+	_acceptor(_io_service),
+	_work(new boost::asio::io_service::work(_io_service)),
+	_workers(),
+	_workers_work(new boost::asio::io_service::work(_workers)) {
+}
+
 Server::Server(const ServerConfig& config)
 	: _config(config),
 	_repo_manager(config),
-	_io_service(),
-	_acceptor(_io_service),
-	_work(new boost::asio::io_service::work(_io_service)),
-	_request_handler(_repo_manager, _connected_clients_manager) {
+	_request_handler(_repo_manager, _connected_clients_manager, config._file_relay_mode, config._offline_queue_config) {
 
 	try {
-		tcp::endpoint endpoint(tcp::v4(), _config._port);
-
-		_acceptor.open(tcp::v4());
+		unsigned int threads_count = std::max(1u, _config._thread_pool_size);
+		size_t reactors_count = _config._reactor_mode == ReactorMode::PER_CORE ? threads_count : 1;
 
-		boost::system::error_code ec;
-		_acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
-		if (ec) {
-			throw boost::system::system_error(ec, "Failed to set acceptor reuse_address option");
+		for (size_t i = 0; i < reactors_count; ++i) {
+			_reactors.push_back(std::make_unique<Reactor>());
+			open_acceptor(*_reactors.back());
 		}
 
-		_acceptor.bind(endpoint);
-		_acceptor.listen();
+		// reactor 0 is also run by the thread that calls start()
+		if (_config._reactor_mode == ReactorMode::PER_CORE) {
+			for (size_t i = 1; i < reactors_count; ++i) {
+				_thread_pool.push_back(boost::make_shared<boost::thread>(
+										   boost::bind(&Server::run_reactor, this, i)));
+			}
+		} else {
+			for (unsigned int i = 1; i < threads_count; ++i) {
+				_thread_pool.push_back(boost::make_shared<boost::thread>(
+										   boost::bind(&Server::run_reactor, this, 0)));
+			}
+		}
 
-		for (unsigned int i = 0; i < _config._thread_pool_size; ++i) {
-			_thread_pool.push_back(boost::make_shared<boost::thread>(
-									   boost::bind(&boost::asio::io_service::run, &_io_service)));
+		// the worker pool is split between the reactors, a request never leaves the reactor of its connection
+		size_t workers_count = std::max<size_t>(1, _config._worker_pool_size / reactors_count);
+		for (size_t i = 0; i < reactors_count; ++i) {
+			for (size_t j = 0; j < workers_count; ++j) {
+				_worker_threads.push_back(boost::make_shared<boost::thread>(
+											  boost::bind(&Server::run_workers, this, i)));
+			}
 		}
 
-		INFO_MSG("Server initialized successfully on port " + std::to_string(_config._port));
+		INFO_MSG("Server initialized successfully on port " + std::to_string(_config._port) + " with "
+		         + std::to_string(reactors_count) + " reactor(s) and " + std::to_string(workers_count) + " request workers each");
 	}
 	catch (const boost::system::system_error& e) {
 		FATAL_MSG("Failed to initialize server: " + std::string(e.what()));
@@ -42,16 +69,18 @@ Server::Server(const ServerConfig& config)
 
 Server::~Server() {
 	try {
-		if (_acceptor.is_open()) {
-			boost::system::error_code ec;
-			_acceptor.close(ec);
-			if (ec) {
-				ERROR_MSG("Error closing acceptor: " + ec.message());
+		for (auto& reactor : _reactors) {
+			if (reactor->_acceptor.is_open()) {
+				boost::system::error_code ec;
+				reactor->_acceptor.close(ec);
+				if (ec) {
+					ERROR_MSG("Error closing acceptor: " + ec.message());
+				}
 			}
-		}
 
-		_work.reset();
-		_io_service.stop();
+			reactor->_work.reset();
+			reactor->_io_service.stop();
+		}
 
 		for (auto& thread : _thread_pool) {
 			if (thread && thread->joinable()) {
@@ -59,6 +88,16 @@ Server::~Server() {
 			}
 		}
 
+		// requests already handed to the workers are finished, their handlers use the request handler
+		for (auto& reactor : _reactors) {
+			reactor->_workers_work.reset();
+		}
+		for (auto& thread : _worker_threads) {
+			if (thread && thread->joinable()) {
+				thread->join();
+			}
+		}
+
 		INFO_MSG("Server shutdown completed");
 	}
 	catch (const std::exception& e) {
@@ -69,20 +108,20 @@ Server::~Server() {
 void Server::start() {
 	try {
 		INFO_MSG("Server starting on port " + std::to_string(_config._port));
-		if (!_acceptor.is_open()) {
-			ERROR_MSG("Acceptor is not open!");
-			return;
-		}
-		start_request_handling();
-
-		while (true) {
-			try {
-				_io_service.run();
-			} catch (const std::exception& e) {
-				FATAL_MSG("[Server::start()] " + std::string(e.what()));
-				_io_service.reset();
+		for (auto& reactor : _reactors) {
+			if (!reactor->_acceptor.is_open()) {
+				ERROR_MSG("Acceptor is not open!");
+				return;
 			}
 		}
+
+		for (auto& reactor : _reactors) {
+			start_request_handling(*reactor);
+		}
+		_partitions_timer = std::make_unique<boost::asio::steady_timer>(_reactors[0]->_io_service);
+		schedule_partitions_check();
+
+		run_reactor(0);
 	}
 	catch (const std::exception& e) {
 		FATAL_MSG("Failed to start server: " + std::string(e.what()));
@@ -90,61 +129,143 @@ void Server::start() {
 	}
 }
 
-void Server::start_request_handling() {
+void Server::open_acceptor(Reactor& reactor) {
+	tcp::endpoint endpoint(tcp::v4(), _config._port);
+
+	reactor._acceptor.open(tcp::v4());
+
+	boost::system::error_code ec;
+	reactor._acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+	if (ec) {
+		throw boost::system::system_error(ec, "Failed to set acceptor reuse_address option");
+	}
+
+	if (_config._reactor_mode == ReactorMode::PER_CORE) {
+		reactor._acceptor.set_option(reuse_port(true), ec);
+		if (ec) {
+			throw boost::system::system_error(ec, "Failed to set acceptor reuse_port option");
+		}
+	}
+
+	reactor._acceptor.bind(endpoint);
+	reactor._acceptor.listen();
+}
+
+void Server::run_reactor(size_t reactor_index) {
+	if (_config._reactor_mode == ReactorMode::PER_CORE && _config._pin_reactor_threads) {
+		pin_current_thread(reactor_index);
+	}
+
+	boost::asio::io_service& io_service = _reactors[reactor_index]->_io_service;
+	while (!io_service.stopped()) {
+		try {
+			io_service.run();
+		} catch (const std::exception& e) {
+			FATAL_MSG("[Server::run_reactor] " + std::string(e.what()));
+		}
+	}
+}
+
+// workers of a pinned reactor share its core, so a request is read, handled and answered on one core
+void Server::run_workers(size_t reactor_index) {
+	if (_config._reactor_mode == ReactorMode::PER_CORE && _config._pin_reactor_threads) {
+		pin_current_thread(reactor_index);
+	}
+
+	boost::asio::io_service& workers = _reactors[reactor_index]->_workers;
+	for (;;) {
+		try {
+			workers.run();
+			return;
+		} catch (const std::exception& e) {
+			FATAL_MSG("[Server::run_workers] " + std::string(e.what()));
+		}
+	}
+}
+
+void Server::pin_current_thread(size_t reactor_index) {
+	unsigned int cores_count = std::max(1u, std::thread::hardware_concurrency());
+
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(reactor_index % cores_count, &cpu_set);
+
+	int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+	if (result != 0) {
+		WARN_MSG("[Server::pin_current_thread] Failed to pin reactor " + std::to_string(reactor_index) + ": " + std::strerror(result));
+	}
+}
+
+void Server::start_request_handling(Reactor& reactor) {
 	try {
 		DEBUG_MSG("[Server::start_request_handling] Start request handling");
 
-		boost::shared_ptr<tcp::socket> socket = boost::make_shared<tcp::socket>(_io_service);
-
-		_acceptor.async_accept(*socket,
-		                       [this, socket](const boost::system::error_code& error) {
-				if (!error) {
-					try {
-						boost::system::error_code ec;
-						socket->set_option(tcp::socket::reuse_address(true), ec);
-						if (ec) {
-							ERROR_MSG("Failed to set socket options: " + ec.message());
-						}
-
-						socket->set_option(boost::asio::socket_base::keep_alive(true), ec);
-						if (ec) {
-							ERROR_MSG("Failed to set keep-alive option: " + ec.message());
-						}
-
-						boost::asio::post(_io_service, [this, socket]() {
-							_request_handler.handle_request(socket);
-						});
-					}
-					catch (const std::exception& e) {
-						ERROR_MSG("Error handling accepted connection: " + std::string(e.what()));
-					}
-				} else {
-					ERROR_MSG("Accept error: " + error.message());
-				}
+		boost::shared_ptr<Session> session = boost::make_shared<Session>(reactor._io_service, reactor._workers, _request_handler, _config);
 
-				start_request_handling();
+		reactor._acceptor.async_accept(session->get_socket(),
+		                               [this, &reactor, session](const boost::system::error_code& error) {
+				handle_accept(reactor, session, error);
 			});
 	}
 	catch (const std::exception& e) {
 		ERROR_MSG("Error in start_request_handling: " + std::string(e.what()));
 
 		boost::shared_ptr<boost::asio::deadline_timer> timer =
-			boost::make_shared<boost::asio::deadline_timer>(_io_service, boost::posix_time::seconds(1));
-		timer->async_wait([this](const boost::system::error_code&) {
-				start_request_handling();
+			boost::make_shared<boost::asio::deadline_timer>(reactor._io_service, boost::posix_time::seconds(1));
+		timer->async_wait([this, &reactor, timer](const boost::system::error_code&) {
+				start_request_handling(reactor);
 			});
 	}
 }
 
-void Server::handle_accept(boost::shared_ptr<tcp::socket> socket,
+// partitions were created by RepositoryManager at startup, this keeps _message_partitions_ahead months
+// in place on a server that runs for longer than that
+void Server::schedule_partitions_check() {
+	_partitions_timer->expires_after(_config._message_partitions_check_interval);
+	_partitions_timer->async_wait([this](const boost::system::error_code& error) {
+			if (error) {
+				return;
+			}
+			boost::asio::post(_reactors[0]->_workers, [this]() {
+					if (!_repo_manager.create_message_partitions()) {
+						ERROR_MSG("[Server::schedule_partitions_check] Failed to create messages partitions, retrying in "
+						          + std::to_string(_config._message_partitions_check_interval.count()) + " s");
+					}
+					schedule_partitions_check();
+				});
+		});
+}
+
+void Server::handle_accept(Reactor& reactor, boost::shared_ptr<Session> session,
                            const boost::system::error_code& error) {
-	DEBUG_MSG("[Server::handle_accept] Called on a socket: " + common::get_socket_info(*socket));
 	if (!error) {
-		boost::asio::post(_io_service, [this, socket]() {
-				_request_handler.handle_request(socket);
-			});
-		start_request_handling();
+		DEBUG_MSG("[Server::handle_accept] Called on a socket: " + common::get_socket_info(session->get_socket()));
+		try {
+			boost::system::error_code ec;
+			session->get_socket().set_option(tcp::socket::reuse_address(true), ec);
+			if (ec) {
+				ERROR_MSG("Failed to set socket options: " + ec.message());
+			}
+
+			session->get_socket().set_option(boost::asio::socket_base::keep_alive(true), ec);
+			if (ec) {
+				ERROR_MSG("Failed to set keep-alive option: " + ec.message());
+			}
+
+			session->start();
+		}
+		catch (const std::exception& e) {
+			ERROR_MSG("Error handling accepted connection: " + std::string(e.what()));
+		}
+	} else {
+		ERROR_MSG("Accept error: " + error.message());
+	}
+
+	if (error == boost::asio::error::operation_aborted) {
+		return;
 	}
+
+	start_request_handling(reactor);
 }
 
 }
\ No newline at end of file
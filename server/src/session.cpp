@@ -0,0 +1,275 @@
+#include "session.hpp"
+#include "request_handler.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace server {
+
+using tcp = boost::asio::ip::tcp;
+
+static const std::string REQUEST_DELIMITER = common::JSON_DELIMITER;
+// upper bound for buffers in one gather write, matches the iovec batch asio passes to sendmsg
+static constexpr size_t MAX_GATHER_BUFFERS = 64;
+
+Session::Session(boost::asio::io_service& io_service, boost::asio::io_service& workers, RequestHandler& request_handler, const ServerConfig& config)
+	: _socket(io_service),
+	_strand(io_service),
+	_workers(workers),
+	_request_handler(request_handler),
+	_writing_count(0),
+	_dropped_count(0),
+	_outbound_queue_max_messages(config._outbound_queue_max_messages),
+	_slow_consumer_policy(config._slow_consumer_policy),
+	_user_id(0),
+	_framing(common::FramingMode::JSON),
+	_current_request_id(0) {
+}
+
+Session::~Session() {
+	fail_pending_writes();
+	DEBUG_MSG("[Session::~Session] Session destroyed, user id: " + std::to_string(_user_id));
+}
+
+void Session::start() {
+	DEBUG_MSG("[Session::start] Session started on socket: " + common::get_socket_info(_socket));
+	do_read();
+}
+
+void Session::do_read() {
+	if (_framing == common::FramingMode::BINARY) {
+		do_read_frame();
+	} else {
+		do_read_json();
+	}
+}
+
+void Session::do_read_json() {
+	boost::asio::async_read_until(_socket, _read_buffer, REQUEST_DELIMITER,
+	                              boost::asio::bind_executor(_strand,
+	                                                         [self = shared_from_this()](const boost::system::error_code& error, size_t bytes_transferred) {
+				self->handle_json_read(error, bytes_transferred);
+			}));
+}
+
+void Session::do_read_frame() {
+	read_exactly(common::FRAME_HEADER_SIZE, [self = shared_from_this()](const boost::system::error_code& error) {
+			self->handle_frame_header_read(error);
+		});
+}
+
+// the buffer may already hold bytes of pipelined requests, only the missing part is read from the socket
+void Session::read_exactly(size_t bytes, std::function<void(const boost::system::error_code&)> handler) {
+	if (_read_buffer.size() >= bytes) {
+		boost::asio::post(_strand, [handler]() {
+				handler(boost::system::error_code());
+			});
+		return;
+	}
+
+	boost::asio::async_read(_socket, _read_buffer, boost::asio::transfer_exactly(bytes - _read_buffer.size()),
+	                        boost::asio::bind_executor(_strand, [handler](const boost::system::error_code& error, size_t) {
+				handler(error);
+			}));
+}
+
+void Session::handle_json_read(const boost::system::error_code& error, size_t bytes_transferred) {
+	if (error) {
+		handle_read_error(error);
+		return;
+	}
+
+	// read_until may read past the delimiter, so consume only the current request
+	// and leave pipelined requests in the buffer for the next read
+	std::string request(boost::asio::buffers_begin(_read_buffer.data()),
+	                    boost::asio::buffers_begin(_read_buffer.data()) + bytes_transferred - REQUEST_DELIMITER.size());
+	_read_buffer.consume(bytes_transferred);
+
+	dispatch_request(std::move(request), "", 0);
+}
+
+void Session::handle_frame_header_read(const boost::system::error_code& error) {
+	if (error) {
+		handle_read_error(error);
+		return;
+	}
+
+	common::FrameHeader header;
+	try {
+		std::string raw_header(boost::asio::buffers_begin(_read_buffer.data()),
+		                       boost::asio::buffers_begin(_read_buffer.data()) + common::FRAME_HEADER_SIZE);
+		header = common::decode_frame_header(raw_header.data());
+	} catch (const std::exception& e) {
+		ERROR_MSG("[Session::handle_frame_header_read] " + std::string(e.what()) + ", closing connection of user " + std::to_string(_user_id));
+		_request_handler.handle_disconnect(shared_from_this());
+		close();
+		return;
+	}
+
+	read_exactly(common::FRAME_HEADER_SIZE + header.payload_length, [self = shared_from_this(), header](const boost::system::error_code& error) {
+			self->handle_frame_payload_read(error, header);
+		});
+}
+
+void Session::handle_frame_payload_read(const boost::system::error_code& error, const common::FrameHeader& header) {
+	if (error) {
+		handle_read_error(error);
+		return;
+	}
+
+	auto payload_begin = boost::asio::buffers_begin(_read_buffer.data()) + common::FRAME_HEADER_SIZE;
+	std::string request(payload_begin, payload_begin + header.json_length);
+	std::string binary_payload(payload_begin + header.json_length, payload_begin + header.payload_length);
+	_read_buffer.consume(common::FRAME_HEADER_SIZE + header.payload_length);
+
+	dispatch_request(std::move(request), std::move(binary_payload), header.request_id);
+}
+
+// the handler runs on a worker thread and the next request of this connection is only read after it returns,
+// so requests of one connection are still handled one at a time and in order
+void Session::dispatch_request(std::string request, std::string binary_payload, uint32_t request_id) {
+	boost::asio::post(_workers, [self = shared_from_this(), request = std::move(request), binary_payload = std::move(binary_payload), request_id]() {
+			self->_current_request_id = request_id;
+			self->_request_handler.handle_request(self, request, binary_payload);
+
+			boost::asio::post(self->_strand, [self]() {
+					self->do_read();
+				});
+		});
+}
+
+void Session::handle_read_error(const boost::system::error_code& error) {
+	if (error == boost::asio::error::eof) {
+		DEBUG_MSG("[Session::handle_read_error] Client closed connection, user id: " + std::to_string(_user_id));
+	} else if (error != boost::asio::error::operation_aborted) {
+		ERROR_MSG("[Session::handle_read_error] " + error.message());
+	}
+
+	_request_handler.handle_disconnect(shared_from_this());
+	close();
+}
+
+void Session::send(const std::string& message, const std::string& binary_payload, uint32_t request_id,
+                   std::function<void(bool)> on_written) {
+	std::string data;
+	if (_framing == common::FramingMode::BINARY) {
+		common::FrameType type = binary_payload.empty() ? common::FrameType::MESSAGE : common::FrameType::FILE_CHUNK;
+		data = common::encode_frame(type, request_id, message, binary_payload);
+	} else {
+		data = message + REQUEST_DELIMITER;
+	}
+
+	boost::asio::post(_strand, [self = shared_from_this(), data = std::move(data), on_written = std::move(on_written)]() mutable {
+			self->enqueue(std::move(data), std::move(on_written));
+		});
+}
+
+void Session::enqueue(std::string data, std::function<void(bool)> on_written) {
+	if (!_socket.is_open()) {
+		if (on_written) {
+			on_written(false);
+		}
+		return;
+	}
+
+	if (_write_queue.size() >= _outbound_queue_max_messages) {
+		if (_slow_consumer_policy == SlowConsumerPolicy::DROP_NEWEST) {
+			++_dropped_count;
+			WARN_MSG("[Session::enqueue] Outbound queue of user " + std::to_string(_user_id) + " is full, dropped "
+			         + std::to_string(_dropped_count) + " messages so far");
+		} else {
+			WARN_MSG("[Session::enqueue] Outbound queue of user " + std::to_string(_user_id) + " is full, disconnecting slow consumer");
+			close();
+		}
+		if (on_written) {
+			on_written(false);
+		}
+		return;
+	}
+
+	_write_queue.push_back({std::move(data), std::move(on_written)});
+	if (_writing_count == 0) {
+		do_write();
+	}
+}
+
+// everything queued so far goes out in one gather write, deque keeps element addresses stable on push_back
+void Session::do_write() {
+	_writing_count = std::min(_write_queue.size(), MAX_GATHER_BUFFERS);
+
+	std::vector<boost::asio::const_buffer> buffers;
+	buffers.reserve(_writing_count);
+	for (size_t i = 0; i < _writing_count; ++i) {
+		buffers.push_back(boost::asio::buffer(_write_queue[i].data));
+	}
+
+	boost::asio::async_write(_socket, buffers,
+	                         boost::asio::bind_executor(_strand, [self = shared_from_this()](const boost::system::error_code& error, size_t) {
+				self->handle_write(error);
+			}));
+}
+
+void Session::handle_write(const boost::system::error_code& error) {
+	if (error) {
+		if (error != boost::asio::error::operation_aborted) {
+			ERROR_MSG("[Session::handle_write] Failed to send message to user " + std::to_string(_user_id) + ": " + error.message());
+		}
+		fail_pending_writes();
+		_writing_count = 0;
+		close();
+		return;
+	}
+
+	for (size_t i = 0; i < _writing_count; ++i) {
+		if (_write_queue[i].on_written) {
+			_write_queue[i].on_written(true);
+		}
+	}
+	_write_queue.erase(_write_queue.begin(), _write_queue.begin() + _writing_count);
+	_writing_count = 0;
+
+	if (!_write_queue.empty()) {
+		do_write();
+	}
+}
+
+void Session::fail_pending_writes() {
+	for (auto& write : _write_queue) {
+		if (write.on_written) {
+			write.on_written(false);
+		}
+	}
+	_write_queue.clear();
+}
+
+void Session::reply(const std::string& message, const std::string& binary_payload) {
+	send(message, binary_payload, _current_request_id);
+}
+
+void Session::close() {
+	boost::system::error_code ec;
+	_socket.shutdown(tcp::socket::shutdown_both, ec);
+	_socket.close(ec);
+}
+
+tcp::socket& Session::get_socket() {
+	return _socket;
+}
+
+int Session::get_user_id() const noexcept {
+	return _user_id;
+}
+
+void Session::set_user_id(int user_id) noexcept {
+	_user_id = user_id;
+}
+
+common::FramingMode Session::get_framing() const noexcept {
+	return _framing;
+}
+
+void Session::set_framing(common::FramingMode framing) noexcept {
+	_framing = framing;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "snowflake_id_generator.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace server {
+
+static constexpr uint64_t SEQUENCE_MASK = (uint64_t(1) << SnowflakeIdGenerator::SEQUENCE_BITS) - 1;
+
+static uint64_t milliseconds_since_epoch(common::Timestamp timestamp) noexcept {
+	int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(timestamp.time_since_epoch()).count() - SnowflakeIdGenerator::EPOCH_MS;
+	return ms > 0 ? static_cast<uint64_t>(ms) : 0;
+}
+
+SnowflakeIdGenerator::SnowflakeIdGenerator(uint16_t node_id) : _node_id(node_id), _last(0) {
+	if (node_id > MAX_NODE_ID) {
+		throw std::invalid_argument("[SnowflakeIdGenerator] Node id " + std::to_string(node_id) + " is bigger than " + std::to_string(MAX_NODE_ID));
+	}
+}
+
+// if the clock didn't move (or moved back) the sequence of the last millisecond is continued,
+// when it overflows the id borrows the next millisecond, so ids never repeat and never go back
+common::MessageId SnowflakeIdGenerator::next_id() noexcept {
+	uint64_t now = milliseconds_since_epoch(std::chrono::system_clock::now()) << SEQUENCE_BITS;
+	uint64_t last = _last.load(std::memory_order_relaxed);
+	uint64_t next;
+
+	do {
+		next = now > last ? now : last + 1;
+	} while (!_last.compare_exchange_weak(last, next, std::memory_order_relaxed));
+
+	uint64_t ms = next >> SEQUENCE_BITS;
+	uint64_t sequence = next & SEQUENCE_MASK;
+	return static_cast<common::MessageId>((ms << (NODE_ID_BITS + SEQUENCE_BITS)) | (uint64_t(_node_id) << SEQUENCE_BITS) | sequence);
+}
+
+common::Timestamp SnowflakeIdGenerator::get_timestamp(common::MessageId id) noexcept {
+	int64_t ms = (static_cast<uint64_t>(id) >> (NODE_ID_BITS + SEQUENCE_BITS)) + EPOCH_MS;
+	return common::Timestamp(std::chrono::milliseconds(ms));
+}
+
+uint16_t SnowflakeIdGenerator::get_node_id(common::MessageId id) noexcept {
+	return static_cast<uint16_t>((static_cast<uint64_t>(id) >> SEQUENCE_BITS) & MAX_NODE_ID);
+}
+
+common::MessageId SnowflakeIdGenerator::min_id_at(common::Timestamp timestamp) noexcept {
+	return static_cast<common::MessageId>(milliseconds_since_epoch(timestamp) << (NODE_ID_BITS + SEQUENCE_BITS));
+}
+
+}
\ No newline at end of file
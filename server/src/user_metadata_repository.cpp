@@ -2,7 +2,37 @@
 
 namespace server {
 
-UserMetadataRepository::UserMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name) : BaseRepository(postgres_db_manager), _connection_name(connection_name) {
+// column lists are explicit, rows are decoded by position (see pqxx_*_result_to_json)
+const PreparedStatements UserMetadataRepository::PREPARED_STATEMENTS = {
+	{"users_insert",
+	 "INSERT INTO users (nickname, password, registered_timestamp, last_online_timestamp, is_online) "
+	 "VALUES ($1, $2, $3, $4, $5) RETURNING id"},
+	{"users_select_by_id",
+	 "SELECT id, nickname, password, registered_timestamp, last_online_timestamp, is_online FROM users WHERE id = $1"},
+	{"users_update",
+	 "UPDATE users SET nickname = $1, password = $2, registered_timestamp = $3, "
+	 "last_online_timestamp = $4, is_online = $5 WHERE id = $6"},
+	{"users_delete",
+	 "DELETE FROM users WHERE id = $1"},
+	{"users_select_password",
+	 "SELECT password FROM users WHERE id = $1 AND nickname = $2"},
+	{"users_select_id_by_nickname",
+	 "SELECT id FROM users WHERE nickname = $1"},
+	{"crypto_keys_insert",
+	 "INSERT INTO crypto_keys (user_id, el_gamal_public_key, dsa_public_key, created_timestamp) "
+	 "VALUES ($1, $2, $3, $4) RETURNING id"},
+	{"crypto_keys_select_by_user_id",
+	 "SELECT id, user_id, dsa_public_key, el_gamal_public_key, created_timestamp FROM crypto_keys WHERE user_id = $1"}
+};
+
+UserMetadataRepository::UserMetadataRepository(PostgresDBManager& postgres_db_manager, const std::string& connection_name,
+                                               const NicknameCacheConfig& nickname_cache_config,
+                                               const PublicKeysCacheConfig& public_keys_cache_config)
+	: BaseRepository(postgres_db_manager),
+	_connection_name(connection_name),
+	_nickname_cache(nickname_cache_config._capacity, "nickname_cache", nickname_cache_config._stats_report_interval),
+	_nickname_negative_ttl(nickname_cache_config._negative_ttl),
+	_public_keys_cache(public_keys_cache_config._capacity, "public_keys_cache", public_keys_cache_config._stats_report_interval) {
 	DEBUG_MSG("UserMetadataRepository created");
 }
 
@@ -10,7 +40,8 @@ UserMetadataRepository::~UserMetadataRepository() = default;
 
 int UserMetadataRepository::create(const common::User& user) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
 
 		auto format_timestamp = [](const common::Timestamp& ts) {
 									auto time_t = std::chrono::system_clock::to_time_t(ts);
@@ -19,9 +50,8 @@ int UserMetadataRepository::create(const common::User& user) {
 									return ss.str();
 								};
 
-		pqxx::result r = txn.exec_params(
-			"INSERT INTO users (nickname, password, registered_timestamp, last_online_timestamp, is_online) "
-			"VALUES ($1, $2, $3, $4, $5) RETURNING id",
+		pqxx::result r = txn.exec_prepared(
+			"users_insert",
 			user.get_nickname(),
 			user.get_password(),
 			format_timestamp(user.get_registered_timestamp()),
@@ -29,9 +59,7 @@ int UserMetadataRepository::create(const common::User& user) {
 			user.is_online()
 			);
 
-		DEBUG_MSG("Executing INSERT INTO users (nickname, password, registered_timestamp, last_online_timestamp, is_online) "
-		          "VALUES ($1, $2, $3, $4, $5) RETURNING id\n"
-		          "for user: " + user.to_json().dump());
+		DEBUG_MSG("Executing users_insert for user: " + user.to_json().dump());
 
 		if (r.empty()) {
 			WARN_MSG("[UserMetadataRepository::create] Failed to insert user");
@@ -42,6 +70,8 @@ int UserMetadataRepository::create(const common::User& user) {
 		INFO_MSG("[UserMetadataRepository::create] User inserted successfully with id: " + std::to_string(inserted_id));
 
 		txn.commit();
+		// drop a cached "unknown nickname"
+		_nickname_cache.erase(user.get_nickname());
 		return inserted_id;
 	} catch (const std::exception& e) {
 		ERROR_MSG("[UserMetadataRepository::create] Exception caught: " + std::string(e.what()));
@@ -51,9 +81,10 @@ int UserMetadataRepository::create(const common::User& user) {
 
 std::optional<common::User> UserMetadataRepository::read(int id) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
-		pqxx::result r = txn.exec_params("SELECT * FROM USERS WHERE id = $1", id);
-		DEBUG_MSG("executing SELECT * FROM USERS WHERE id = " + std::to_string(id));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		pqxx::result r = txn.exec_prepared("users_select_by_id", id);
+		DEBUG_MSG("executing users_select_by_id for id " + std::to_string(id));
 
 		if (r.empty()) {
 			WARN_MSG("[UserMetadataRepository::read] No user found with id: " + std::to_string(id));
@@ -80,7 +111,8 @@ std::optional<common::User> UserMetadataRepository::read(int id) {
 
 bool UserMetadataRepository::update(const common::User& user) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
 
 		auto format_timestamp = [](const common::Timestamp& ts) {
 									auto time_t = std::chrono::system_clock::to_time_t(ts);
@@ -89,9 +121,8 @@ bool UserMetadataRepository::update(const common::User& user) {
 									return ss.str();
 								};
 
-		pqxx::result r = txn.exec_params(
-			"UPDATE users SET nickname = $1, password = $2, registered_timestamp = $3, "
-			"last_online_timestamp = $4, is_online = $5 WHERE id = $6",
+		pqxx::result r = txn.exec_prepared(
+			"users_update",
 			user.get_nickname(),
 			user.get_password(),
 			format_timestamp(user.get_registered_timestamp()),
@@ -100,9 +131,7 @@ bool UserMetadataRepository::update(const common::User& user) {
 			user.get_id()
 			);
 
-		DEBUG_MSG("Executing UPDATE users SET nickname = $1, password = $2, registered_timestamp = $3, "
-		          "last_online_timestamp = $4, is_online = $5 WHERE id = $6\n"
-		          "for user: " + user.to_json().dump());
+		DEBUG_MSG("Executing users_update for user: " + user.to_json().dump());
 
 		if (r.affected_rows() == 0) {
 			WARN_MSG("[UserMetadataRepository::update] No user updated");
@@ -112,6 +141,9 @@ bool UserMetadataRepository::update(const common::User& user) {
 		INFO_MSG("[UserMetadataRepository::update] User updated successfully with id: " + std::to_string(user.get_id()));
 
 		txn.commit();
+		// nickname may have changed, forget the old binding and a cached miss of the new one
+		invalidate_nickname_cache(user.get_id());
+		_nickname_cache.erase(user.get_nickname());
 		return true;
 	} catch (const std::exception& e) {
 		ERROR_MSG("[UserMetadataRepository::update] Exception caught: " + std::string(e.what()));
@@ -121,10 +153,10 @@ bool UserMetadataRepository::update(const common::User& user) {
 
 bool UserMetadataRepository::remove(int id) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
-		pqxx::result r = txn.exec_params("DELETE FROM users WHERE id = $1", id);
-		DEBUG_MSG("Executing DELETE FROM users WHERE id = $1\n"
-		          "for user_id: " + std::to_string(id));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		pqxx::result r = txn.exec_prepared("users_delete", id);
+		DEBUG_MSG("Executing users_delete for user_id: " + std::to_string(id));
 
 
 		if (r.affected_rows() == 0) {
@@ -133,6 +165,9 @@ bool UserMetadataRepository::remove(int id) {
 		}
 
 		txn.commit();
+		invalidate_nickname_cache(id);
+		// crypto_keys rows are deleted by cascade
+		_public_keys_cache.erase(id);
 		return true;
 	} catch (const std::exception& e) {
 		ERROR_MSG("[UserMetadataRepository::remove] Exception caught: " + std::string(e.what()));
@@ -142,23 +177,18 @@ bool UserMetadataRepository::remove(int id) {
 
 bool UserMetadataRepository::authorize(int user_id, const std::string& nickname, const std::string& password) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
-		DEBUG_MSG("executing SELECT * FROM users WHERE id = " + std::to_string(user_id) + " AND nickname = " + nickname);
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		DEBUG_MSG("executing users_select_password for id " + std::to_string(user_id) + " and nickname " + nickname);
 
-		pqxx::result r = txn.exec_params(
-			"SELECT * FROM users WHERE id = $1 AND nickname = $2",
-			user_id, nickname
-			);
+		pqxx::result r = txn.exec_prepared("users_select_password", user_id, nickname);
 
 		if (r.empty()) {
 			WARN_MSG("[UserMetadataRepository::authorize] No user found with id: " + std::to_string(user_id) + " and nickname: " + nickname);
 			return false;
 		}
 
-		nlohmann::json json = pqxx_users_result_to_json(r);
-		DEBUG_MSG("[UserMetadataRepository::authorize] response: " + json.dump());
-
-		std::string stored_password = r[0][2].as<std::string>();
+		std::string stored_password = r[0][0].as<std::string>();
 		if (password == stored_password) {
 			INFO_MSG("[UserMetadataRepository::authorize] Password match for user id: " + std::to_string(user_id));
 			return true;
@@ -176,25 +206,29 @@ bool UserMetadataRepository::authorize(int user_id, const std::string& nickname,
 
 // test neeeded
 int UserMetadataRepository::get_id(const std::string& nickname) {
+	if (auto cached_id = _nickname_cache.get(nickname)) {
+		DEBUG_MSG("[UserMetadataRepository::get_id] Cache hit for nickname: " + nickname);
+		return *cached_id;
+	}
+
+	// an update or remove that commits while the id is loaded bumps it, the loaded id isn't cached then
+	uint64_t generation = _nickname_cache.get_generation(nickname);
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
-		DEBUG_MSG("executing SELECT * FROM users WHERE nickname = " + nickname);
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		DEBUG_MSG("executing users_select_id_by_nickname for nickname " + nickname);
 
-		pqxx::result r = txn.exec_params(
-			"SELECT * FROM users WHERE nickname = $1",
-			nickname
-			);
+		pqxx::result r = txn.exec_prepared("users_select_id_by_nickname", nickname);
 
 		if (r.empty()) {
 			WARN_MSG("[UserMetadataRepository::get_id] No user found with nickname: " + nickname);
+			_nickname_cache.put_if_unchanged(nickname, 0, generation, _nickname_negative_ttl);
 			return 0;
 		}
 
-		nlohmann::json json = pqxx_users_result_to_json(r);
-		DEBUG_MSG("[UserMetadataRepository::get_id] response: " + json.dump());
-
 		int user_id = r[0][0].as<int>();
 		INFO_MSG("[UserMetadataRepository::get_id] User with nickname: " + nickname + " has been found, id: " + std::to_string(user_id));
+		_nickname_cache.put_if_unchanged(nickname, user_id, generation);
 		return user_id;
 	} catch (const std::exception& e) {
 		ERROR_MSG("[UserMetadataRepository::get_id] Exception caught: " + std::string(e.what()));
@@ -203,9 +237,20 @@ int UserMetadataRepository::get_id(const std::string& nickname) {
 	}
 }
 
+CacheStats UserMetadataRepository::get_nickname_cache_stats() const {
+	return _nickname_cache.get_stats();
+}
+
+void UserMetadataRepository::invalidate_nickname_cache(int user_id) {
+	_nickname_cache.erase_if([user_id](const std::string&, int cached_id) {
+			return cached_id == user_id;
+		});
+}
+
 bool UserMetadataRepository::set_public_keys(const int user_id, const std::string& el_gamal_public_key, const std::string& dsa_public_key) {
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
 
 		auto format_timestamp = [](const common::Timestamp& ts) {
 									auto time_t = std::chrono::system_clock::to_time_t(ts);
@@ -214,18 +259,15 @@ bool UserMetadataRepository::set_public_keys(const int user_id, const std::strin
 									return ss.str();
 								};
 
-		pqxx::result r = txn.exec_params(
-			"INSERT INTO crypto_keys (user_id, el_gamal_public_key, dsa_public_key, created_timestamp) "
-			"VALUES ($1, $2, $3, $4) RETURNING id",
+		pqxx::result r = txn.exec_prepared(
+			"crypto_keys_insert",
 			user_id,
 			el_gamal_public_key,
 			dsa_public_key,
 			format_timestamp(std::chrono::system_clock::now())
 			);
 
-		DEBUG_MSG("Executing INSERT INTO crypto_keys (user_id, el_gamal_public_key, dsa_public_key, created_timestamp)  "
-		          "VALUES ($1, $2, $3, $4) RETURNING id\n"
-		          "for user id: " + std::to_string(user_id));
+		DEBUG_MSG("Executing crypto_keys_insert for user id: " + std::to_string(user_id));
 
 		if (r.empty()) {
 			WARN_MSG("[UserMetadataRepository::set_public_keys] Failed to insert crypto_keys for user " + std::to_string(user_id));
@@ -236,6 +278,16 @@ bool UserMetadataRepository::set_public_keys(const int user_id, const std::strin
 		INFO_MSG("[UserMetadataRepository::set_public_keys] User's public keys set successfully with id: " + std::to_string(inserted_id));
 
 		txn.commit();
+
+		// erase bumps the generation, keys loaded before the commit aren't cached over the new ones
+		_public_keys_cache.erase(user_id);
+		try {
+			_public_keys_cache.put(user_id, encode_public_keys(crypto::UserCryptoKeys(crypto::hex_to_cpp_int(dsa_public_key),
+			                                                                          crypto::hex_to_cpp_int(el_gamal_public_key),
+			                                                                          crypto::cpp_int(-1))));
+		} catch (const std::exception& e) {
+			WARN_MSG("[UserMetadataRepository::set_public_keys] Keys of user " + std::to_string(user_id) + " are not cached: " + e.what());
+		}
 		return inserted_id;
 	} catch (const std::exception& e) {
 		ERROR_MSG("[UserMetadataRepository::set_public_keys] Exception caught: " + std::string(e.what()));
@@ -244,36 +296,62 @@ bool UserMetadataRepository::set_public_keys(const int user_id, const std::strin
 }
 
 std::optional<crypto::UserCryptoKeys> UserMetadataRepository::get_public_keys(const int user_id) {
+	EncodedPublicKeysPtr encoded_keys = get_encoded_public_keys(user_id);
+	if (!encoded_keys) {
+		return std::nullopt;
+	}
+	return encoded_keys->_keys;
+}
+
+EncodedPublicKeysPtr UserMetadataRepository::get_encoded_public_keys(const int user_id) {
+	if (auto cached_keys = _public_keys_cache.get(user_id)) {
+		return *cached_keys;
+	}
+
+	uint64_t generation = _public_keys_cache.get_generation(user_id);
 	try {
-		pqxx::work txn(_postgres_db_manager.get_connection(_connection_name));
-		pqxx::result r = txn.exec_params(
-			"SELECT *  FROM CRYPTO_KEYS WHERE user_id = $1",
-			user_id
-			);
+		auto connection = _postgres_db_manager.get_connection(_connection_name);
+		pqxx::work txn(*connection);
+		pqxx::result r = txn.exec_prepared("crypto_keys_select_by_user_id", user_id);
 
-		DEBUG_MSG("SELECT * FROM CRYPTO_KEYS WHERE user_id = $1 for user id: " + std::to_string(user_id));
+		DEBUG_MSG("Executing crypto_keys_select_by_user_id for user id: " + std::to_string(user_id));
 
 		if (r.empty()) {
-			WARN_MSG("[UserMetadataRepository::get_public_keys] No user found with id: " + std::to_string(user_id));
-			WARN_MSG("returning std::nullopt");
-			return std::nullopt;
+			WARN_MSG("[UserMetadataRepository::get_encoded_public_keys] No user found with id: " + std::to_string(user_id));
+			WARN_MSG("returning nullptr");
+			return nullptr;
 		}
 
 		nlohmann::json json = pqxx_crypto_keys_result_to_json(r);
-		INFO_MSG("[UserMetadataRepository::read] response: " + json.dump());
+		INFO_MSG("[UserMetadataRepository::get_encoded_public_keys] response: " + json.dump());
 
 		try {
-			return construct_user_crypto_keys(json);
+			EncodedPublicKeysPtr encoded_keys = encode_public_keys(construct_user_crypto_keys(json));
+			_public_keys_cache.put_if_unchanged(user_id, encoded_keys, generation);
+			return encoded_keys;
 		} catch (const std::exception& e) {
-			ERROR_MSG("[UserMetadataRepository::get_public_keys] Error in construct_crypto_keys: " + std::string(e.what()));
-			return std::nullopt;
+			ERROR_MSG("[UserMetadataRepository::get_encoded_public_keys] Error in construct_crypto_keys: " + std::string(e.what()));
+			return nullptr;
 		}
 	} catch (const std::exception& e) {
-		ERROR_MSG("[UserMetadataRepository::get_public_keys] Exception caught: " + std::string(e.what()));
-		return std::nullopt;
+		ERROR_MSG("[UserMetadataRepository::get_encoded_public_keys] Exception caught: " + std::string(e.what()));
+		return nullptr;
 	}
 }
 
+CacheStats UserMetadataRepository::get_public_keys_cache_stats() const {
+	return _public_keys_cache.get_stats();
+}
+
+// the only place keys are converted back to hex, responses reuse these strings
+EncodedPublicKeysPtr UserMetadataRepository::encode_public_keys(const crypto::UserCryptoKeys& keys) const {
+	auto encoded_keys = std::make_shared<EncodedPublicKeys>();
+	encoded_keys->_keys = keys;
+	encoded_keys->_dsa_public_key_hex = crypto::cpp_int_to_hex(keys.get_dsa_public_key());
+	encoded_keys->_el_gamal_public_key_hex = crypto::cpp_int_to_hex(keys.get_el_gamal_public_key());
+	return encoded_keys;
+}
+
 common::User UserMetadataRepository::construct_user(const nlohmann::json& user_json) {
 	common::User user;
 	return user.from_json(user_json);
@@ -0,0 +1,57 @@
+#include "frame.hpp"
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+TEST(FrameTests, encode_decode_json_only_frame) {
+	std::string json = "{\"type\":\"register\"}";
+	std::string frame = common::encode_frame(common::FrameType::MESSAGE, 42, json);
+
+	ASSERT_EQ(frame.size(), common::FRAME_HEADER_SIZE + json.size());
+
+	common::FrameHeader header = common::decode_frame_header(frame.data());
+	EXPECT_EQ(header.payload_length, json.size());
+	EXPECT_EQ(header.type, common::FrameType::MESSAGE);
+	EXPECT_EQ(header.flags, common::FRAME_FLAG_NONE);
+	EXPECT_EQ(header.request_id, 42u);
+	EXPECT_EQ(header.json_length, json.size());
+	EXPECT_EQ(frame.substr(common::FRAME_HEADER_SIZE), json);
+}
+
+TEST(FrameTests, binary_payload_is_carried_verbatim) {
+	std::string json = "{\"type\":\"file_chunk\"}";
+	std::string binary("\r\n\r\n\0\xff\x01", 7);
+	std::string frame = common::encode_frame(common::FrameType::FILE_CHUNK, 7, json, binary);
+
+	common::FrameHeader header = common::decode_frame_header(frame.data());
+	EXPECT_EQ(header.type, common::FrameType::FILE_CHUNK);
+	EXPECT_EQ(header.flags, common::FRAME_FLAG_HAS_BINARY);
+	EXPECT_EQ(header.payload_length, json.size() + binary.size());
+
+	std::string payload = frame.substr(common::FRAME_HEADER_SIZE);
+	EXPECT_EQ(payload.substr(0, header.json_length), json);
+	EXPECT_EQ(payload.substr(header.json_length), binary);
+}
+
+TEST(FrameTests, decode_rejects_invalid_headers) {
+	std::string frame = common::encode_frame(common::FrameType::MESSAGE, 1, "{}");
+
+	std::string unknown_type = frame;
+	unknown_type[5] = 99;
+	EXPECT_THROW(common::decode_frame_header(unknown_type.data()), std::invalid_argument);
+
+	std::string json_longer_than_payload = frame;
+	json_longer_than_payload[15] = 100;
+	EXPECT_THROW(common::decode_frame_header(json_longer_than_payload.data()), std::invalid_argument);
+
+	std::string too_big = frame;
+	too_big[0] = 0x7f;
+	EXPECT_THROW(common::decode_frame_header(too_big.data()), std::invalid_argument);
+}
+
+TEST(FrameTests, framing_mode_strings) {
+	EXPECT_EQ(common::framing_mode_from_string("binary"), common::FramingMode::BINARY);
+	EXPECT_EQ(common::framing_mode_from_string("json"), common::FramingMode::JSON);
+	EXPECT_EQ(common::framing_mode_from_string("something else"), common::FramingMode::JSON);
+	EXPECT_EQ(common::framing_mode_to_string(common::FramingMode::BINARY), "binary");
+}
\ No newline at end of file
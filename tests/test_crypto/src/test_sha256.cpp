@@ -0,0 +1,46 @@
+#include "sha256.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+namespace crypto {
+
+static std::string hash(const std::string& data) {
+	SHA256 sha256;
+	sha256.update(data);
+	return sha256.digest();
+}
+
+TEST(SHA256Tests, known_digests) {
+	EXPECT_EQ(hash(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	EXPECT_EQ(hash("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	// 56 bytes, the length doesn't fit into the last block
+	EXPECT_EQ(hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+	          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+	EXPECT_EQ(hash(std::string(1000000, 'a')), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST(SHA256Tests, digest_does_not_depend_on_update_sizes) {
+	std::string data;
+	for (int i = 0; i < 1000; ++i) {
+		data += static_cast<char>(i * 7);
+	}
+
+	for (size_t piece : {1, 3, 63, 64, 65, 200}) {
+		SHA256 sha256;
+		for (size_t offset = 0; offset < data.size(); offset += piece) {
+			sha256.update(data.substr(offset, piece));
+		}
+		EXPECT_EQ(sha256.digest(), hash(data)) << "piece " << piece;
+	}
+}
+
+TEST(SHA256Tests, digest_resets_the_state) {
+	SHA256 sha256;
+	sha256.update("first");
+	sha256.digest();
+	sha256.update("abc");
+	EXPECT_EQ(sha256.digest(), hash("abc"));
+}
+
+}
\ No newline at end of file
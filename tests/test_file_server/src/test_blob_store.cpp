@@ -0,0 +1,112 @@
+#include "blob_store.hpp"
+#include "sha256.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+
+class BlobStoreTests : public ::testing::Test {
+protected:
+	void SetUp() override {
+		_dir = std::filesystem::temp_directory_path() / ("test_blob_store_" + std::to_string(::getpid()));
+		std::filesystem::remove_all(_dir);
+		std::filesystem::create_directories(_dir / "files");
+	}
+
+	void TearDown() override {
+		std::filesystem::remove_all(_dir);
+	}
+
+	std::filesystem::path write(const std::string& name, const std::string& content) {
+		std::filesystem::path path = _dir / "files" / name;
+		std::ofstream(path, std::ios::binary) << content;
+		return path;
+	}
+
+	static std::string read(const std::filesystem::path& path) {
+		std::ifstream file(path, std::ios::binary);
+		std::stringstream content;
+		content << file.rdbuf();
+		return content.str();
+	}
+
+	std::filesystem::path _dir;
+};
+
+TEST_F(BlobStoreTests, same_content_is_stored_once) {
+	file_server::BlobStore store(_dir / "blobs");
+	auto hash = crypto::SHA256::hash_file(write("source", "photo"));
+	ASSERT_TRUE(hash.has_value());
+
+	for (int i = 0; i < 3; ++i) {
+		ASSERT_TRUE(store.store(write("part", "photo"), _dir / "files" / ("file" + std::to_string(i))));
+	}
+	ASSERT_TRUE(store.store(write("part", "other photo"), _dir / "files" / "other"));
+
+	EXPECT_EQ(store.get_blob_count(), 2u);
+	EXPECT_EQ(store.get_references(*hash), 3u);
+	EXPECT_EQ(read(_dir / "files" / "file2"), "photo");
+	EXPECT_FALSE(std::filesystem::exists(_dir / "files" / "part"));
+}
+
+TEST_F(BlobStoreTests, link_by_hash_needs_existing_blob) {
+	file_server::BlobStore store(_dir / "blobs");
+	std::string hash = *crypto::SHA256::hash_file(write("source", "photo"));
+
+	EXPECT_FALSE(store.link(hash, _dir / "files" / "forwarded"));
+	ASSERT_TRUE(store.store(write("part", "photo"), _dir / "files" / "original"));
+	ASSERT_TRUE(store.link(hash, _dir / "files" / "forwarded"));
+	// linking a reference to its own content again doesn't count twice
+	ASSERT_TRUE(store.link(hash, _dir / "files" / "forwarded"));
+
+	EXPECT_EQ(read(_dir / "files" / "forwarded"), "photo");
+	EXPECT_EQ(store.get_references(hash), 2u);
+}
+
+TEST_F(BlobStoreTests, blob_is_removed_with_last_reference) {
+	file_server::BlobStore store(_dir / "blobs");
+	std::string hash = *crypto::SHA256::hash_file(write("source", "photo"));
+	ASSERT_TRUE(store.store(write("part", "photo"), _dir / "files" / "first"));
+	ASSERT_TRUE(store.link(hash, _dir / "files" / "second"));
+
+	ASSERT_TRUE(store.remove(_dir / "files" / "first"));
+	EXPECT_EQ(store.get_references(hash), 1u);
+	ASSERT_TRUE(store.remove(_dir / "files" / "second"));
+	EXPECT_EQ(store.get_references(hash), 0u);
+	EXPECT_EQ(store.get_blob_count(), 0u);
+	EXPECT_FALSE(store.remove(_dir / "files" / "second"));
+}
+
+TEST_F(BlobStoreTests, detached_reference_does_not_change_others) {
+	file_server::BlobStore store(_dir / "blobs");
+	std::string hash = *crypto::SHA256::hash_file(write("source", "photo"));
+	ASSERT_TRUE(store.store(write("part", "photo"), _dir / "files" / "first"));
+	ASSERT_TRUE(store.link(hash, _dir / "files" / "second"));
+
+	ASSERT_TRUE(store.detach(_dir / "files" / "second"));
+	std::ofstream(_dir / "files" / "second", std::ios::binary | std::ios::app) << " edited";
+
+	EXPECT_EQ(read(_dir / "files" / "first"), "photo");
+	EXPECT_EQ(read(_dir / "files" / "second"), "photo edited");
+	EXPECT_EQ(store.get_references(hash), 1u);
+}
+
+TEST_F(BlobStoreTests, index_is_rebuilt_and_orphans_removed_on_restart) {
+	std::string kept = *crypto::SHA256::hash_file(write("source", "kept"));
+	std::string dropped = *crypto::SHA256::hash_file(write("source", "dropped"));
+	{
+		file_server::BlobStore store(_dir / "blobs");
+		ASSERT_TRUE(store.store(write("part", "kept"), _dir / "files" / "first"));
+		ASSERT_TRUE(store.store(write("part", "dropped"), _dir / "files" / "second"));
+	}
+	// a reference removed behind the store's back, as by a crash between the unlinks
+	std::filesystem::remove(_dir / "files" / "second");
+
+	file_server::BlobStore store(_dir / "blobs");
+	EXPECT_EQ(store.get_blob_count(), 1u);
+	EXPECT_EQ(store.get_references(kept), 1u);
+	EXPECT_EQ(store.get_references(dropped), 0u);
+	ASSERT_TRUE(store.remove(_dir / "files" / "first"));
+	EXPECT_EQ(store.get_blob_count(), 0u);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "byte_range_set.hpp"
+
+#include <gtest/gtest.h>
+
+using file_server::ByteRange;
+using file_server::ByteRangeSet;
+
+TEST(ByteRangeSetTests, overlapping_and_touching_ranges_are_merged) {
+	ByteRangeSet set;
+	set.insert(10, 20);
+	set.insert(30, 40);
+	EXPECT_EQ(set.ranges(), (std::vector<ByteRange>{{10, 20}, {30, 40}}));
+
+	set.insert(20, 25);
+	set.insert(15, 32);
+	EXPECT_EQ(set.ranges(), (std::vector<ByteRange>{{10, 40}}));
+	EXPECT_EQ(set.covered(), 30u);
+
+	set.insert(0, 100);
+	EXPECT_EQ(set.ranges(), (std::vector<ByteRange>{{0, 100}}));
+	EXPECT_EQ(set.covered(), 100u);
+}
+
+TEST(ByteRangeSetTests, repeated_range_is_counted_once) {
+	ByteRangeSet set;
+	set.insert(0, 512);
+	set.insert(0, 512);
+	set.insert(100, 200);
+	set.insert(5, 5);
+
+	EXPECT_EQ(set.covered(), 512u);
+	EXPECT_TRUE(set.contains(0, 512));
+	EXPECT_FALSE(set.contains(0, 513));
+}
+
+TEST(ByteRangeSetTests, missing_lists_gaps_within_size) {
+	ByteRangeSet set;
+	EXPECT_EQ(set.missing(10), (std::vector<ByteRange>{{0, 10}}));
+
+	set.insert(2, 4);
+	set.insert(6, 8);
+	EXPECT_EQ(set.missing(10), (std::vector<ByteRange>{{0, 2}, {4, 6}, {8, 10}}));
+	EXPECT_EQ(set.missing(7), (std::vector<ByteRange>{{0, 2}, {4, 6}}));
+
+	set.insert(0, 10);
+	EXPECT_TRUE(set.missing(10).empty());
+}
\ No newline at end of file
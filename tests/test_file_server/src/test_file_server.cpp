@@ -1,4 +1,5 @@
 #include "file_server.hpp"
+#include "file_server_client.hpp"
 
 #include <gtest/gtest.h>
 
@@ -49,4 +50,83 @@ TEST_F(FileServerTests, is_valid_filename_test) {
 	EXPECT_FALSE(_server->is_valid_filename("abc"));
 	EXPECT_FALSE(_server->is_valid_filename("abc!@#$%^&*()"));
 	EXPECT_FALSE(_server->is_valid_filename(""));
+	EXPECT_FALSE(_server->is_valid_filename("ABCDEF1234567890.part"));
+	EXPECT_FALSE(_server->is_valid_filename("ABCDEF1234567890.link"));
+	EXPECT_FALSE(_server->is_valid_filename("ABCDEF1234567890.copy"));
+}
+
+TEST_F(FileServerTests, stray_temp_files_are_removed_at_startup) {
+	auto dir = _test_dir / "AB" / "CD";
+	std::filesystem::create_directories(dir);
+	std::ofstream(dir / "ABCD123456789012.part") << "left by an upload session";
+	std::ofstream(dir / "ABCD123456789014.link") << "left by a blob link";
+	std::ofstream(dir / "ABCD123456789015.copy") << "left by a blob detach";
+	std::ofstream(dir / "ABCD123456789013") << "stored file";
+
+	file_server::FileServer restarted(54445, 1, _test_dir.string());
+	EXPECT_FALSE(std::filesystem::exists(dir / "ABCD123456789012.part"));
+	EXPECT_FALSE(std::filesystem::exists(dir / "ABCD123456789014.link"));
+	EXPECT_FALSE(std::filesystem::exists(dir / "ABCD123456789015.copy"));
+	EXPECT_TRUE(std::filesystem::exists(dir / "ABCD123456789013"));
+}
+
+TEST(FileServerSessionExpiryTests, idle_upload_session_is_aborted) {
+	auto test_dir = std::filesystem::path(std::string(SOURCE_DIR) + "/tests/test_file_server/test_session_expiry");
+	std::filesystem::create_directories(test_dir);
+	{
+		file_server::FileServer server(54446, 1, test_dir.string(), 1024 * 1024, file_server::DEFAULT_MAX_CHUNK_SIZE_BYTES, false, false,
+		                               std::chrono::seconds(1));
+		std::thread server_thread([&server]() {
+			server.start();
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+		file_server::FileServerClient client("127.0.0.1", "54446");
+		ASSERT_TRUE(client.create_upload_session("ABCD123456789012", 1024).has_value());
+		EXPECT_TRUE(std::filesystem::exists(test_dir / "AB" / "CD" / "ABCD123456789012.part"));
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+		EXPECT_FALSE(client.get_upload_session("ABCD123456789012").has_value());
+		EXPECT_FALSE(std::filesystem::exists(test_dir / "AB" / "CD" / "ABCD123456789012.part"));
+
+		server.stop();
+		server_thread.join();
+	}
+	std::filesystem::remove_all(test_dir);
+}
+
+TEST(FileServerPackTests, small_files_are_packed_until_they_grow) {
+	auto test_dir = std::filesystem::path(std::string(SOURCE_DIR) + "/tests/test_file_server/test_pack");
+	std::filesystem::remove_all(test_dir);
+	std::filesystem::create_directories(test_dir);
+	{
+		file_server::FileServer server(54447, 1, test_dir.string(), 1024 * 1024, file_server::DEFAULT_MAX_CHUNK_SIZE_BYTES, false, true);
+		std::thread server_thread([&server]() {
+			server.start();
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+		file_server::FileServerClient client("127.0.0.1", "54447");
+		std::string small(1000, 's');
+		ASSERT_TRUE(client.upload_chunk("ABCD123456789012", small));
+		// not even its shard directories are created
+		EXPECT_FALSE(std::filesystem::exists(test_dir / "AB"));
+		EXPECT_EQ(client.download_file("ABCD123456789012"), small);
+		// ranges are cut from the packed object, a foreign etag gets the whole file instead
+		EXPECT_EQ(client.download_range("ABCD123456789012", 100, 10), small.substr(100, 10));
+		EXPECT_FALSE(client.download_range("ABCD123456789012", 100, 10, "\"other\"").has_value());
+
+		EXPECT_EQ(client.delete_file("ABCD123456789012"), "File deleted successfully");
+		EXPECT_EQ(client.download_file("ABCD123456789012"), "");
+
+		// the second chunk moves the file out of the pack
+		std::vector<std::string> chunks = {std::string(1000, 'a'), std::string(70 * 1024, 'b')};
+		ASSERT_TRUE(client.upload_chunks("ABCD123456789013", chunks));
+		EXPECT_EQ(std::filesystem::file_size(test_dir / "AB" / "CD" / "ABCD123456789013"), chunks[0].size() + chunks[1].size());
+		EXPECT_EQ(client.download_file("ABCD123456789013"), chunks[0] + chunks[1]);
+
+		server.stop();
+		server_thread.join();
+	}
+	std::filesystem::remove_all(test_dir);
 }
\ No newline at end of file
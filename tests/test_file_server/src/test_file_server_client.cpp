@@ -0,0 +1,441 @@
+#include "file_server_client.hpp"
+#include "sha256.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <thread>
+#include <vector>
+
+// keep-alive http server in place of the file server, appends upload bodies per target
+// and answers GET /limits when max_chunk_size is set, downloads support a single "bytes=first-last" range,
+// upload sessions keep their bytes in memory until the commit, committed contents can be linked by their sha256
+class FakeFileServer {
+	using tcp = boost::asio::ip::tcp;
+
+public:
+	// close_after > 0: connections are closed without notice after that many requests, as an idle timeout would
+	explicit FakeFileServer(size_t close_after = 0, size_t max_chunk_size = 0)
+		: _acceptor(_io_context, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)),
+		_close_after(close_after),
+		_max_chunk_size(max_chunk_size) {
+		_accept_thread = std::thread([this]() {
+			accept_loop();
+		});
+	}
+
+	~FakeFileServer() {
+		_stopped = true;
+		boost::system::error_code ec;
+		// wakes up the blocking accept
+		tcp::socket wake_up(_io_context);
+		wake_up.connect(_acceptor.local_endpoint(), ec);
+		_accept_thread.join();
+		for (auto& thread : _connection_threads) {
+			thread.join();
+		}
+	}
+
+	std::string port() const {
+		return std::to_string(_acceptor.local_endpoint().port());
+	}
+
+	std::string get_file(const std::string& target) {
+		std::lock_guard<std::mutex> lock(_files_mutex);
+		return _files[target];
+	}
+
+	std::atomic<size_t> _accepted {0};
+	std::atomic<size_t> _uploads {0};
+	std::atomic<size_t> _session_chunks {0};
+	// session chunk writes after this many of them fail, as if the connection broke
+	std::atomic<size_t> _session_chunks_limit {std::numeric_limits<size_t>::max()};
+	// the next upload is stored and its connection closed without a response, as if it broke after the write
+	std::atomic<bool> _drop_upload_response {false};
+
+private:
+	void accept_loop() {
+		while (true) {
+			tcp::socket socket(_io_context);
+			boost::system::error_code ec;
+			_acceptor.accept(socket, ec);
+			if (_stopped || ec) {
+				return;
+			}
+			++_accepted;
+			_connection_threads.emplace_back([this, socket = std::move(socket)]() mutable {
+				serve(std::move(socket));
+			});
+		}
+	}
+
+	void serve(tcp::socket socket) {
+		namespace http = boost::beast::http;
+		boost::beast::flat_buffer buffer;
+		for (size_t served = 0; _close_after == 0 || served < _close_after; ++served) {
+			http::request<http::string_body> req;
+			boost::system::error_code ec;
+			http::read(socket, buffer, req, ec);
+			if (ec) {
+				return;
+			}
+
+			http::response<http::string_body> res{http::status::ok, req.version()};
+			res.keep_alive(true);
+			if (req.method() == http::verb::get && req.target() == "/limits") {
+				if (_max_chunk_size == 0) {
+					res.result(http::status::not_found);
+				} else {
+					res.body() = "{\"max_chunk_size\":" + std::to_string(_max_chunk_size) + ",\"max_file_size\":1048576}";
+				}
+			} else if (req.target().starts_with("/session/") || req.target().starts_with("/commit/") || req.target().starts_with("/dedup/")) {
+				handle_session(req, res);
+			} else if (req.method() == http::verb::get && req.target().starts_with("/download/")) {
+				std::string file = get_file("/upload/" + std::string(req.target().substr(10)));
+				auto range = req.find(http::field::range);
+				if (range != req.end()) {
+					std::string spec(range->value().substr(6));
+					size_t first = std::stoul(spec.substr(0, spec.find('-')));
+					size_t last = std::min(std::stoul(spec.substr(spec.find('-') + 1)), file.size() - 1);
+					res.result(http::status::partial_content);
+					res.body() = file.substr(first, last - first + 1);
+				} else {
+					res.body() = file;
+				}
+			} else {
+				++_uploads;
+				std::lock_guard<std::mutex> lock(_files_mutex);
+				_files[std::string(req.target())] += req.body();
+				if (_drop_upload_response.exchange(false)) {
+					return;
+				}
+				res.body() = "File uploaded successfully";
+			}
+			res.prepare_payload();
+			http::write(socket, res, ec);
+			if (ec) {
+				return;
+			}
+		}
+		boost::system::error_code ec;
+		socket.shutdown(tcp::socket::shutdown_both, ec);
+	}
+
+	struct Session {
+		std::string _data;
+		file_server::ByteRangeSet _received;
+	};
+
+	void handle_session(const boost::beast::http::request<boost::beast::http::string_body>& req,
+	                    boost::beast::http::response<boost::beast::http::string_body>& res) {
+		namespace http = boost::beast::http;
+		std::string target(req.target());
+		std::string name = target.substr(target.find('/', 1) + 1);
+		std::string argument;
+		if (name.find('/') != std::string::npos) {
+			argument = name.substr(name.find('/') + 1);
+			name = name.substr(0, name.find('/'));
+		}
+
+		std::lock_guard<std::mutex> lock(_files_mutex);
+		// content known by its sha256 once a session with it was committed
+		if (req.method() == http::verb::post && target.rfind("/dedup/", 0) == 0) {
+			auto it = _contents.find(argument);
+			if (it == _contents.end()) {
+				res.result(http::status::not_found);
+			} else {
+				_files["/upload/" + name] = it->second;
+			}
+			return;
+		}
+		if (req.method() == http::verb::post && target.rfind("/commit/", 0) == 0) {
+			auto it = _sessions.find(name);
+			if (it == _sessions.end() || it->second._received.covered() != it->second._data.size()) {
+				res.result(http::status::conflict);
+				return;
+			}
+			_files["/upload/" + name] = it->second._data;
+			crypto::SHA256 sha256;
+			sha256.update(it->second._data);
+			_contents[sha256.digest()] = it->second._data;
+			_sessions.erase(it);
+			return;
+		}
+
+		if (req.method() == http::verb::post) {
+			if (_sessions.find(name) == _sessions.end()) {
+				_sessions[name]._data.resize(std::stoull(argument));
+			}
+		} else if (_sessions.find(name) == _sessions.end()) {
+			res.result(http::status::not_found);
+			return;
+		} else if (req.method() == http::verb::put) {
+			if (++_session_chunks > _session_chunks_limit) {
+				res.result(http::status::internal_server_error);
+				return;
+			}
+			auto& session = _sessions[name];
+			size_t offset = std::stoull(argument);
+			session._data.replace(offset, req.body().size(), req.body());
+			session._received.insert(offset, offset + req.body().size());
+		}
+
+		auto& session = _sessions[name];
+		std::string ranges;
+		for (const auto& [first, end] : session._received.ranges()) {
+			ranges += (ranges.empty() ? "[" : ",[") + std::to_string(first) + "," + std::to_string(end) + "]";
+		}
+		res.body() = "{\"size\":" + std::to_string(session._data.size()) + ",\"received\":" + std::to_string(session._received.covered())
+		             + ",\"ranges\":[" + ranges + "]}";
+	}
+
+	boost::asio::io_context _io_context;
+	tcp::acceptor _acceptor;
+	size_t _close_after;
+	size_t _max_chunk_size;
+	std::atomic<bool> _stopped {false};
+	std::thread _accept_thread;
+	std::vector<std::thread> _connection_threads;
+	std::mutex _files_mutex;
+	std::map<std::string, std::string> _files;
+	std::map<std::string, Session> _sessions;
+	std::map<std::string, std::string> _contents;
+};
+
+TEST(FileServerClientTests, sequential_uploads_reuse_one_connection) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	std::string expected;
+	for (int i = 0; i < 100; ++i) {
+		std::string chunk = "chunk " + std::to_string(i) + ";";
+		ASSERT_TRUE(client.upload_chunk("file", chunk));
+		expected += chunk;
+	}
+
+	EXPECT_EQ(server.get_file("/upload/file"), expected);
+	EXPECT_EQ(client.get_connections_opened(), 1u);
+	EXPECT_EQ(server._accepted, 1u);
+}
+
+TEST(FileServerClientTests, concurrent_uploads_stay_within_max_connections) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port(), {4, 16});
+
+	std::atomic<int> failures {0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 16; ++t) {
+		threads.emplace_back([&client, &failures, t]() {
+			for (int i = 0; i < 50; ++i) {
+				if (!client.upload_chunk("file" + std::to_string(t), std::to_string(i) + ";")) {
+					++failures;
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(failures, 0);
+	EXPECT_LE(client.get_connections_opened(), 4u);
+	for (int t = 0; t < 16; ++t) {
+		std::string expected;
+		for (int i = 0; i < 50; ++i) {
+			expected += std::to_string(i) + ";";
+		}
+		EXPECT_EQ(server.get_file("/upload/file" + std::to_string(t)), expected);
+	}
+}
+
+TEST(FileServerClientTests, pipelined_uploads_are_appended_in_order) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port(), {2, 8});
+
+	std::vector<std::string> chunks;
+	std::string expected;
+	for (int i = 0; i < 100; ++i) {
+		chunks.push_back(std::string(512, static_cast<char>('a' + i % 26)));
+		expected += chunks.back();
+	}
+
+	ASSERT_TRUE(client.upload_chunks("file", chunks));
+	EXPECT_EQ(server.get_file("/upload/file"), expected);
+	EXPECT_EQ(client.get_connections_opened(), 1u);
+}
+
+TEST(FileServerClientTests, reconnects_when_server_closed_idle_connection) {
+	FakeFileServer server(1);
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	ASSERT_TRUE(client.upload_chunk("file", "first;"));
+	// let the server close the connection the client keeps in the pool
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	ASSERT_TRUE(client.upload_chunk("file", "second;"));
+
+	EXPECT_EQ(server.get_file("/upload/file"), "first;second;");
+	EXPECT_EQ(client.get_connections_opened(), 2u);
+}
+
+TEST(FileServerClientTests, upload_is_not_sent_again_after_it_was_written) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	ASSERT_TRUE(client.upload_chunk("file", "first;"));
+	server._drop_upload_response = true;
+	// the append may have been stored, another attempt could store it twice
+	EXPECT_FALSE(client.upload_chunk("file", "second;"));
+
+	EXPECT_EQ(server.get_file("/upload/file"), "first;second;");
+	EXPECT_EQ(client.get_connections_opened(), 1u);
+}
+
+TEST(FileServerClientTests, upload_fails_when_server_is_down) {
+	std::string port;
+	{
+		FakeFileServer server;
+		port = server.port();
+	}
+	file_server::FileServerClient client("127.0.0.1", port);
+
+	EXPECT_FALSE(client.upload_chunk("file", "data"));
+	EXPECT_EQ(client.get_connections_opened(), 0u);
+}
+
+class FileServerClientUploadFileTests : public ::testing::Test {
+protected:
+	void SetUp() override {
+		_filepath = std::filesystem::temp_directory_path() / ("test_file_server_client_" + std::to_string(::getpid()));
+		std::ofstream file(_filepath, std::ios::binary);
+		for (int i = 0; i < 2500; ++i) {
+			_content += static_cast<char>('a' + i % 26);
+		}
+		file << _content;
+	}
+
+	void TearDown() override {
+		std::filesystem::remove(_filepath);
+	}
+
+	std::filesystem::path _filepath;
+	std::string _content;
+};
+
+TEST_F(FileServerClientUploadFileTests, chunk_size_is_taken_from_the_server) {
+	FakeFileServer server(0, 1000);
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	EXPECT_EQ(client.get_max_chunk_size(), 1000u);
+	ASSERT_TRUE(client.upload_file("file", _filepath));
+	EXPECT_EQ(server.get_file("/upload/file"), _content);
+	EXPECT_EQ(server._uploads, 3u);
+}
+
+TEST_F(FileServerClientUploadFileTests, chunk_size_is_capped_by_config) {
+	FakeFileServer server(0, 1000);
+	file_server::FileServerClientConfig config;
+	config._max_chunk_size = 100;
+	file_server::FileServerClient client("127.0.0.1", server.port(), config);
+
+	ASSERT_TRUE(client.upload_file("file", _filepath));
+	EXPECT_EQ(server.get_file("/upload/file"), _content);
+	EXPECT_EQ(server._uploads, 25u);
+}
+
+TEST_F(FileServerClientUploadFileTests, server_without_limits_gets_legacy_chunks) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	EXPECT_EQ(client.get_max_chunk_size(), 512u);
+	ASSERT_TRUE(client.upload_file("file", _filepath));
+	EXPECT_EQ(server.get_file("/upload/file"), _content);
+}
+
+TEST(FileServerClientTests, download_is_one_response_on_a_pooled_connection) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	std::string content(200 * 1024, 'z');
+	ASSERT_TRUE(client.upload_chunk("file", content));
+
+	EXPECT_EQ(client.download_file("file"), content);
+	auto chunks = client.download_file_chunks("file");
+	ASSERT_EQ(chunks.size(), 4u);
+	std::string joined;
+	for (const auto& chunk : chunks) {
+		joined += chunk;
+	}
+	EXPECT_EQ(joined, content);
+	EXPECT_EQ(client.get_connections_opened(), 1u);
+}
+
+TEST(FileServerClientTests, download_range_returns_requested_bytes) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port());
+	ASSERT_TRUE(client.upload_chunk("file", "0123456789"));
+
+	EXPECT_EQ(client.download_range("file", 2, 3), "234");
+	EXPECT_EQ(client.download_range("file", 8, 10), "89");
+	EXPECT_EQ(client.download_range("file", 0, 0), "");
+}
+
+TEST_F(FileServerClientUploadFileTests, resumable_upload_sends_chunks_in_parallel) {
+	FakeFileServer server(0, 100);
+	file_server::FileServerClient client("127.0.0.1", server.port(), {4, 16});
+
+	ASSERT_TRUE(client.upload_file_resumable("file", _filepath, 4));
+	EXPECT_EQ(server.get_file("/upload/file"), _content);
+	EXPECT_EQ(server._session_chunks, 25u);
+	EXPECT_FALSE(client.get_upload_session("file").has_value());
+}
+
+TEST_F(FileServerClientUploadFileTests, resumable_upload_only_sends_missing_chunks_again) {
+	FakeFileServer server(0, 100);
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	server._session_chunks_limit = 10;
+	ASSERT_FALSE(client.upload_file_resumable("file", _filepath, 1));
+	auto status = client.get_upload_session("file");
+	ASSERT_TRUE(status.has_value());
+	EXPECT_EQ(status->_size, _content.size());
+	EXPECT_EQ(status->_received, 1000u);
+	EXPECT_FALSE(status->is_complete());
+
+	server._session_chunks_limit = std::numeric_limits<size_t>::max();
+	server._session_chunks = 0;
+	ASSERT_TRUE(client.upload_file_resumable("file", _filepath, 1));
+	EXPECT_EQ(server.get_file("/upload/file"), _content);
+	EXPECT_EQ(server._session_chunks, 15u);
+}
+
+TEST(FileServerClientTests, session_chunks_are_accepted_in_any_order) {
+	FakeFileServer server;
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	ASSERT_TRUE(client.create_upload_session("file", 9).has_value());
+	ASSERT_TRUE(client.upload_session_chunk("file", 6, "ghi").has_value());
+	auto status = client.upload_session_chunk("file", 0, "abc");
+	ASSERT_TRUE(status.has_value());
+	EXPECT_EQ(status->_ranges, (std::vector<file_server::ByteRange>{{0, 3}, {6, 9}}));
+	EXPECT_FALSE(client.commit_upload_session("file"));
+
+	status = client.upload_session_chunk("file", 3, "def");
+	ASSERT_TRUE(status.has_value());
+	EXPECT_TRUE(status->is_complete());
+	ASSERT_TRUE(client.commit_upload_session("file"));
+	EXPECT_EQ(server.get_file("/upload/file"), "abcdefghi");
+}
+
+TEST_F(FileServerClientUploadFileTests, content_known_by_hash_is_not_uploaded_again) {
+	FakeFileServer server(0, 100);
+	file_server::FileServerClient client("127.0.0.1", server.port());
+
+	ASSERT_TRUE(client.upload_file_deduplicated("first", _filepath));
+	EXPECT_EQ(server._session_chunks, 25u);
+
+	ASSERT_TRUE(client.upload_file_deduplicated("forwarded", _filepath));
+	EXPECT_EQ(server._session_chunks, 25u);
+	EXPECT_EQ(server.get_file("/upload/forwarded"), _content);
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "pack_store.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <fstream>
+
+class PackStoreTests : public ::testing::Test {
+protected:
+	void SetUp() override {
+		_dir = std::filesystem::temp_directory_path() / ("test_pack_store_" + std::to_string(::getpid()));
+		std::filesystem::remove_all(_dir);
+		// compaction only on compact() calls, small segments to get several of them
+		_config._segment_size = 4096;
+		_config._max_object_size = 1024;
+		_config._compaction_interval = std::chrono::milliseconds(0);
+	}
+
+	void TearDown() override {
+		std::filesystem::remove_all(_dir);
+	}
+
+	size_t count_segments() const {
+		size_t count = 0;
+		for (const auto& entry : std::filesystem::directory_iterator(_dir)) {
+			count += entry.path().extension() == ".pack";
+		}
+		return count;
+	}
+
+	std::filesystem::path _dir;
+	file_server::PackStoreConfig _config;
+};
+
+TEST_F(PackStoreTests, put_get_replace_remove) {
+	file_server::PackStore store(_dir, _config);
+
+	ASSERT_TRUE(store.put("thumb.jpg", "small"));
+	EXPECT_EQ(store.get("thumb.jpg"), "small");
+	ASSERT_TRUE(store.put("thumb.jpg", "replaced"));
+	EXPECT_EQ(store.get("thumb.jpg"), "replaced");
+	auto packed = store.read("thumb.jpg");
+	ASSERT_TRUE(packed.has_value());
+	EXPECT_EQ(packed->_data, "replaced");
+	EXPECT_GT(packed->_offset, 0u);
+	ASSERT_TRUE(store.put("empty", ""));
+	EXPECT_EQ(store.get("empty"), "");
+
+	EXPECT_FALSE(store.put("large.jpg", std::string(_config._max_object_size + 1, 'x')));
+	EXPECT_FALSE(store.contains("large.jpg"));
+
+	ASSERT_TRUE(store.remove("thumb.jpg"));
+	EXPECT_FALSE(store.get("thumb.jpg").has_value());
+	EXPECT_FALSE(store.remove("thumb.jpg"));
+	EXPECT_EQ(store.get_stats()._objects, 1u);
+}
+
+TEST_F(PackStoreTests, index_is_rebuilt_on_restart) {
+	{
+		file_server::PackStore store(_dir, _config);
+		// fills several segments, the earlier ones are sealed with a footer, the last one is scanned
+		for (int i = 0; i < 100; ++i) {
+			ASSERT_TRUE(store.put("object" + std::to_string(i), std::string(100, 'a' + i % 26)));
+		}
+		ASSERT_TRUE(store.put("object0", "replaced"));
+		ASSERT_TRUE(store.remove("object1"));
+	}
+	ASSERT_GT(count_segments(), 1u);
+
+	file_server::PackStore store(_dir, _config);
+	EXPECT_EQ(store.get_stats()._objects, 99u);
+	EXPECT_EQ(store.get("object0"), "replaced");
+	EXPECT_FALSE(store.contains("object1"));
+	EXPECT_EQ(store.get("object99"), std::string(100, 'a' + 99 % 26));
+	ASSERT_TRUE(store.put("object100", "after restart"));
+	EXPECT_EQ(store.get("object100"), "after restart");
+}
+
+TEST_F(PackStoreTests, torn_record_is_cut_off_on_restart) {
+	{
+		file_server::PackStore store(_dir, _config);
+		ASSERT_TRUE(store.put("whole", "written"));
+		ASSERT_TRUE(store.put("torn", "cut by a crash"));
+	}
+	// the last record loses its tail as by a crash in the middle of the write
+	std::filesystem::path segment = std::filesystem::directory_iterator(_dir)->path();
+	std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 4);
+
+	file_server::PackStore store(_dir, _config);
+	EXPECT_EQ(store.get("whole"), "written");
+	EXPECT_FALSE(store.contains("torn"));
+	ASSERT_TRUE(store.put("next", "after the cut"));
+	EXPECT_EQ(store.get("next"), "after the cut");
+}
+
+TEST_F(PackStoreTests, compaction_reclaims_dead_bytes) {
+	file_server::PackStore store(_dir, _config);
+	for (int i = 0; i < 100; ++i) {
+		ASSERT_TRUE(store.put("object" + std::to_string(i), std::string(100, 'x')));
+	}
+	// most objects of the sealed segments are replaced or removed
+	for (int i = 0; i < 100; ++i) {
+		if (i % 10 == 0) {
+			continue;
+		}
+		ASSERT_TRUE(i % 2 ? store.remove("object" + std::to_string(i)) : store.put("object" + std::to_string(i), "new"));
+	}
+	size_t segments = count_segments();
+	uint64_t dead_bytes = store.get_stats()._dead_bytes;
+
+	EXPECT_GT(store.compact(), 0u);
+	EXPECT_LT(count_segments(), segments);
+	EXPECT_LT(store.get_stats()._dead_bytes, dead_bytes);
+
+	for (int i = 0; i < 100; ++i) {
+		auto data = store.get("object" + std::to_string(i));
+		if (i % 10 == 0) {
+			EXPECT_EQ(data, std::string(100, 'x'));
+		} else if (i % 2) {
+			EXPECT_FALSE(data.has_value());
+		} else {
+			EXPECT_EQ(data, "new");
+		}
+	}
+	EXPECT_EQ(store.get_stats()._objects, 50u);
+}
+
+TEST_F(PackStoreTests, removed_objects_stay_removed_after_compaction_and_restart) {
+	{
+		file_server::PackStore store(_dir, _config);
+		for (int i = 0; i < 100; ++i) {
+			ASSERT_TRUE(store.put("object" + std::to_string(i), std::string(100, 'x')));
+		}
+		for (int i = 50; i < 100; ++i) {
+			ASSERT_TRUE(store.remove("object" + std::to_string(i)));
+		}
+		store.compact();
+	}
+
+	file_server::PackStore store(_dir, _config);
+	EXPECT_EQ(store.get_stats()._objects, 50u);
+	EXPECT_TRUE(store.contains("object49"));
+	EXPECT_FALSE(store.contains("object50"));
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "striped_lock.hpp"
+
+#include <gtest/gtest.h>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST(StripedLockTests, stripe_count_is_rounded_up_to_power_of_two) {
+	EXPECT_EQ(file_server::StripedLock(1).size(), 1u);
+	EXPECT_EQ(file_server::StripedLock(100).size(), 128u);
+	EXPECT_EQ(file_server::StripedLock(1024).size(), 1024u);
+}
+
+TEST(StripedLockTests, same_path_maps_to_same_lock) {
+	file_server::StripedLock locks(64);
+	std::string path = "/storage/ab/cd/abcdefgh12345678";
+
+	EXPECT_EQ(&locks.get(path), &locks.get(std::string(path)));
+	EXPECT_LT(locks.get_stripe(path), 64u);
+}
+
+TEST(StripedLockTests, paths_are_spread_over_stripes) {
+	file_server::StripedLock locks(64);
+	std::set<size_t> stripes;
+	for (int i = 0; i < 1000; ++i) {
+		stripes.insert(locks.get_stripe("/storage/ab/cd/file" + std::to_string(i)));
+	}
+
+	// 1000 keys leave no stripe empty unless the hash is badly skewed
+	EXPECT_EQ(stripes.size(), 64u);
+}
+
+TEST(StripedLockTests, writers_of_one_path_exclude_each_other) {
+	file_server::StripedLock locks(16);
+	int counter = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&locks, &counter]() {
+			for (int i = 0; i < 10000; ++i) {
+				std::unique_lock<std::shared_mutex> lock(locks.get("file"));
+				++counter;
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(counter, 80000);
+}
\ No newline at end of file
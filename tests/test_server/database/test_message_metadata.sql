@@ -5,28 +5,68 @@ GRANT ALL PRIVILEGES ON DATABASE :db_name TO :new_user;
 
 \c :db_name
 
-CREATE TABLE messages (
+CREATE TABLE chats (
     id SERIAL PRIMARY KEY,
+    user1_id INT NOT NULL,
+    user2_id INT NOT NULL,
+    created_timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,
+    last_message_timestamp TIMESTAMP WITH TIME ZONE,
+    CONSTRAINT unique_chat UNIQUE (user1_id, user2_id),
+    CONSTRAINT ordered_chat_users CHECK (user1_id <= user2_id)
+);
+
+-- partitioned like database/message_metadata.sql, so the tests run the queries the planner prunes
+CREATE TABLE messages (
+    id BIGINT NOT NULL,
+    chat_id INT,
     sender_id INT NOT NULL,
     receiver_id INT NOT NULL,
     deleted BOOLEAN DEFAULT FALSE,
-    created_timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,
+    created_timestamp TIMESTAMP WITH TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
     deleted_timestamp TIMESTAMP WITH TIME ZONE,
-    last_edited_timestamp TIMESTAMP WITH TIME ZONE
-);
+    last_edited_timestamp TIMESTAMP WITH TIME ZONE,
+    PRIMARY KEY (id, created_timestamp)
+) PARTITION BY RANGE (created_timestamp);
+
+CREATE FUNCTION create_messages_partition(month_start DATE) RETURNS VOID
+LANGUAGE plpgsql SECURITY DEFINER SET search_path = public, pg_temp AS $$
+DECLARE
+    first_day DATE := date_trunc('month', month_start)::date;
+BEGIN
+    EXECUTE format('CREATE TABLE IF NOT EXISTS %I PARTITION OF messages FOR VALUES FROM (%L) TO (%L)',
+                   'messages_' || to_char(first_day, 'YYYY_MM'),
+                   first_day::timestamp AT TIME ZONE 'UTC',
+                   (first_day + INTERVAL '1 month')::timestamp AT TIME ZONE 'UTC');
+END;
+$$;
+
+CREATE TABLE messages_default PARTITION OF messages DEFAULT;
+-- month of the rows below, the current month is created by the tests
+SELECT create_messages_partition('2024-01-01');
+
+CREATE INDEX idx_messages_chat_history ON messages(chat_id, created_timestamp DESC, id DESC);
 
 GRANT ALL PRIVILEGES ON TABLE messages TO :new_user;
-GRANT USAGE, SELECT ON SEQUENCE messages_id_seq TO :new_user;
+GRANT ALL PRIVILEGES ON TABLE chats TO :new_user;
+GRANT USAGE, SELECT ON SEQUENCE chats_id_seq TO :new_user;
+GRANT EXECUTE ON FUNCTION create_messages_partition(DATE) TO :new_user;
 
-INSERT INTO messages (sender_id, receiver_id) VALUES
+INSERT INTO chats (user1_id, user2_id) VALUES
 (1, 2),
-(2, 1),
-(3, 4),
-(4, 3);
+(3, 4);
+
+INSERT INTO messages (id, chat_id, sender_id, receiver_id, created_timestamp) VALUES
+(1, 1, 1, 2, '2024-01-01 10:00:00+00'),
+(2, 1, 2, 1, '2024-01-01 10:00:01+00'),
+(3, 2, 3, 4, '2024-01-01 10:00:02+00'),
+(4, 2, 4, 3, '2024-01-01 10:00:03+00'),
+(5, 1, 1, 2, '2024-01-01 10:00:04+00');
 
 DROP ROLE IF EXISTS logi;
 
 CREATE ROLE logi WITH LOGIN PASSWORD 'logi';
 
 GRANT ALL PRIVILEGES ON TABLE messages TO logi;
-GRANT USAGE, SELECT ON SEQUENCE messages_id_seq TO logi;
\ No newline at end of file
+GRANT ALL PRIVILEGES ON TABLE chats TO logi;
+GRANT USAGE, SELECT ON SEQUENCE chats_id_seq TO logi;
+GRANT EXECUTE ON FUNCTION create_messages_partition(DATE) TO logi;
\ No newline at end of file
@@ -15,8 +15,19 @@ CREATE TABLE users (
     is_online BOOLEAN DEFAULT FALSE
 );
 
+CREATE TABLE crypto_keys (
+    id SERIAL PRIMARY KEY,
+    user_id INTEGER NOT NULL UNIQUE,
+    dsa_public_key TEXT NOT NULL,
+    el_gamal_public_key TEXT NOT NULL,
+    created_timestamp TIMESTAMP WITH TIME ZONE DEFAULT CURRENT_TIMESTAMP,
+    FOREIGN KEY (user_id) REFERENCES users(id) ON DELETE CASCADE
+);
+
 GRANT ALL PRIVILEGES ON TABLE users TO :new_user;
+GRANT ALL PRIVILEGES ON TABLE crypto_keys TO :new_user;
 GRANT USAGE, SELECT ON SEQUENCE users_id_seq TO :new_user;
+GRANT USAGE, SELECT ON SEQUENCE crypto_keys_id_seq TO :new_user;
 
 INSERT INTO users (nickname, password, registered_timestamp, last_online_timestamp, is_online) VALUES
 ('linus_torvalds', 'linus_torvalds_pass', '2024-09-28 10:00:00+00', '2024-09-28 10:00:00+00', TRUE),
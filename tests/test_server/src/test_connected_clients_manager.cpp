@@ -0,0 +1,104 @@
+#include "connected_clients_manager.hpp"
+
+#include <gtest/gtest.h>
+#include <boost/make_shared.hpp>
+#include <thread>
+
+struct TestConnection {
+	int _id;
+};
+
+using TestClientsManager = server::BasicConnectedClientsManager<TestConnection>;
+
+TEST(ConnectedClientsManagerTests, add_get_and_remove_by_user_id) {
+	TestClientsManager manager;
+	auto connection = boost::make_shared<TestConnection>(TestConnection{1});
+
+	manager.add_client(10, connection);
+
+	EXPECT_TRUE(manager.is_client_connected(10));
+	EXPECT_EQ(manager.get_client_session(10), connection);
+	EXPECT_EQ(manager.get_user_id(connection), 10);
+	EXPECT_EQ(manager.get_connected_count(), 1u);
+
+	manager.remove_client(10);
+
+	EXPECT_FALSE(manager.is_client_connected(10));
+	EXPECT_EQ(manager.get_client_session(10), nullptr);
+	EXPECT_EQ(manager.get_user_id(connection), 0);
+	EXPECT_EQ(manager.get_connected_count(), 0u);
+}
+
+TEST(ConnectedClientsManagerTests, remove_by_session) {
+	TestClientsManager manager;
+	auto connection = boost::make_shared<TestConnection>(TestConnection{1});
+	auto other_connection = boost::make_shared<TestConnection>(TestConnection{2});
+
+	manager.add_client(10, connection);
+	manager.add_client(11, other_connection);
+	manager.remove_client_by_session(connection);
+
+	EXPECT_FALSE(manager.is_client_connected(10));
+	EXPECT_TRUE(manager.is_client_connected(11));
+	EXPECT_EQ(manager.get_connected_count(), 1u);
+
+	// removing unknown connection is a no-op
+	manager.remove_client_by_session(connection);
+	EXPECT_EQ(manager.get_connected_count(), 1u);
+}
+
+TEST(ConnectedClientsManagerTests, relogin_on_new_connection_replaces_old_one) {
+	TestClientsManager manager;
+	auto old_connection = boost::make_shared<TestConnection>(TestConnection{1});
+	auto new_connection = boost::make_shared<TestConnection>(TestConnection{2});
+
+	manager.add_client(10, old_connection);
+	manager.add_client(10, new_connection);
+
+	EXPECT_EQ(manager.get_client_session(10), new_connection);
+	EXPECT_EQ(manager.get_user_id(old_connection), 0);
+	EXPECT_EQ(manager.get_connected_count(), 1u);
+
+	// late disconnect of the old connection must not log out the new one
+	manager.remove_client_by_session(old_connection);
+	EXPECT_EQ(manager.get_client_session(10), new_connection);
+}
+
+TEST(ConnectedClientsManagerTests, snapshot_contains_all_clients) {
+	TestClientsManager manager;
+	for (int user_id = 1; user_id <= 200; ++user_id) {
+		manager.add_client(user_id, boost::make_shared<TestConnection>(TestConnection{user_id}));
+	}
+
+	auto clients = manager.snapshot();
+	ASSERT_EQ(clients.size(), 200u);
+	for (const auto& [user_id, connection] : clients) {
+		EXPECT_EQ(connection->_id, user_id);
+	}
+}
+
+TEST(ConnectedClientsManagerTests, concurrent_add_and_remove) {
+	TestClientsManager manager;
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&manager, t]() {
+			for (int i = 0; i < 1000; ++i) {
+				int user_id = t * 1000 + i + 1;
+				auto connection = boost::make_shared<TestConnection>(TestConnection{user_id});
+				manager.add_client(user_id, connection);
+				EXPECT_EQ(manager.get_client_session(user_id), connection);
+				if (i % 2 == 0) {
+					manager.remove_client_by_session(connection);
+				}
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(manager.get_connected_count(), 4000u);
+	EXPECT_EQ(manager.snapshot().size(), 4000u);
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "connection_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct FakeDbConnection {
+	bool is_open() const {
+		return _open;
+	}
+
+	bool _open = true;
+	bool _healthy = true;
+};
+
+using FakeDbConnectionPool = server::ConnectionPool<FakeDbConnection>;
+
+class ConnectionPoolTests : public ::testing::Test {
+protected:
+	std::atomic<int> _opened {0};
+	bool _database_down = false;
+
+	std::unique_ptr<FakeDbConnectionPool> make_pool(size_t min_size, size_t max_size, std::chrono::milliseconds checkout_timeout) {
+		server::ConnectionPoolConfig config;
+		config._min_size = min_size;
+		config._max_size = max_size;
+		config._checkout_timeout = checkout_timeout;
+		config._health_check_idle = std::chrono::milliseconds(0);
+
+		return std::make_unique<FakeDbConnectionPool>("test", config,
+		                                            [this]() {
+				if (_database_down) {
+					throw std::runtime_error("connection refused");
+				}
+				++_opened;
+				return std::make_unique<FakeDbConnection>();
+			},
+		                                            [](FakeDbConnection& connection) {
+				return connection._healthy;
+			});
+	}
+};
+
+TEST_F(ConnectionPoolTests, opens_min_size_eagerly_and_grows_up_to_max_size) {
+	auto pool = make_pool(2, 3, std::chrono::milliseconds(50));
+	EXPECT_EQ(_opened, 2);
+
+	auto first = pool->checkout();
+	auto second = pool->checkout();
+	auto third = pool->checkout();
+	EXPECT_EQ(_opened, 3);
+
+	auto stats = pool->get_stats();
+	EXPECT_EQ(stats._size, 3u);
+	EXPECT_EQ(stats._in_use, 3u);
+	EXPECT_EQ(stats._checkouts, 3u);
+}
+
+TEST_F(ConnectionPoolTests, checkout_times_out_when_exhausted) {
+	auto pool = make_pool(1, 1, std::chrono::milliseconds(20));
+	auto connection = pool->checkout();
+
+	EXPECT_THROW(pool->checkout(), std::runtime_error);
+	EXPECT_EQ(pool->get_stats()._timeouts, 1u);
+}
+
+TEST_F(ConnectionPoolTests, released_connection_is_reused) {
+	auto pool = make_pool(1, 1, std::chrono::milliseconds(20));
+	FakeDbConnection* raw = nullptr;
+	{
+		auto connection = pool->checkout();
+		raw = &*connection;
+	}
+
+	auto connection = pool->checkout();
+	EXPECT_EQ(&*connection, raw);
+	EXPECT_EQ(_opened, 1);
+	EXPECT_EQ(pool->get_stats()._in_use, 1u);
+}
+
+TEST_F(ConnectionPoolTests, broken_connection_is_replaced) {
+	auto pool = make_pool(1, 1, std::chrono::milliseconds(20));
+	{
+		auto connection = pool->checkout();
+		connection->_open = false;
+	}
+	EXPECT_EQ(pool->get_stats()._size, 0u);
+
+	auto connection = pool->checkout();
+	EXPECT_TRUE(connection->is_open());
+	EXPECT_EQ(_opened, 2);
+	EXPECT_EQ(pool->get_stats()._discarded, 1u);
+}
+
+TEST_F(ConnectionPoolTests, unhealthy_idle_connection_is_reconnected) {
+	auto pool = make_pool(1, 1, std::chrono::milliseconds(20));
+	{
+		auto connection = pool->checkout();
+		connection->_healthy = false;
+	}
+
+	auto connection = pool->checkout();
+	EXPECT_TRUE(connection->_healthy);
+	EXPECT_EQ(_opened, 2);
+}
+
+TEST_F(ConnectionPoolTests, failed_connect_gives_slot_back) {
+	auto pool = make_pool(0, 1, std::chrono::milliseconds(20));
+
+	_database_down = true;
+	EXPECT_THROW(pool->checkout(), std::runtime_error);
+	EXPECT_EQ(pool->get_stats()._size, 0u);
+	EXPECT_EQ(pool->get_stats()._in_use, 0u);
+
+	_database_down = false;
+	auto connection = pool->checkout();
+	EXPECT_TRUE(connection->is_open());
+}
+
+TEST_F(ConnectionPoolTests, connections_are_never_shared_between_threads) {
+	auto pool = make_pool(2, 4, std::chrono::milliseconds(5000));
+	std::atomic<int> concurrent {0};
+	std::atomic<int> max_concurrent {0};
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 16; ++t) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < 200; ++i) {
+				auto connection = pool->checkout();
+				int now = ++concurrent;
+				int seen = max_concurrent;
+				while (now > seen && !max_concurrent.compare_exchange_weak(seen, now)) {
+				}
+				--concurrent;
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	auto stats = pool->get_stats();
+	EXPECT_LE(max_concurrent, 4);
+	EXPECT_LE(stats._size, 4u);
+	EXPECT_EQ(stats._in_use, 0u);
+	EXPECT_EQ(stats._checkouts, 16u * 200u);
+}
\ No newline at end of file
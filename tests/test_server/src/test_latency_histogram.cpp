@@ -0,0 +1,58 @@
+#include "latency_histogram.hpp"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using server::LatencyHistogram;
+
+TEST(LatencyHistogramTests, empty_histogram_has_no_samples) {
+	LatencyHistogram histogram("empty");
+
+	auto stats = histogram.get_stats();
+	EXPECT_EQ(stats._count, 0u);
+	EXPECT_EQ(stats._max_us, 0u);
+	EXPECT_EQ(stats._p99_us, 0u);
+}
+
+TEST(LatencyHistogramTests, percentiles_are_bucket_upper_bounds) {
+	LatencyHistogram histogram("percentiles");
+
+	// 90 fast samples in [64, 128) us, 10 slow ones in [4096, 8192) us
+	for (int i = 0; i < 90; ++i) {
+		histogram.record(std::chrono::microseconds(100));
+	}
+	for (int i = 0; i < 10; ++i) {
+		histogram.record(std::chrono::microseconds(5000));
+	}
+
+	auto stats = histogram.get_stats();
+	EXPECT_EQ(stats._count, 100u);
+	EXPECT_EQ(stats._p50_us, 128u);
+	EXPECT_EQ(stats._p90_us, 5000u); // bucket bound 8192 is capped by the max
+	EXPECT_EQ(stats._p99_us, 5000u);
+	EXPECT_EQ(stats._max_us, 5000u);
+	EXPECT_DOUBLE_EQ(stats._avg_us, 590.0);
+}
+
+TEST(LatencyHistogramTests, concurrent_records_are_counted) {
+	LatencyHistogram histogram("concurrent");
+	const int threads_count = 4;
+	const int samples_per_thread = 10000;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threads_count; ++t) {
+		threads.emplace_back([&histogram, t, samples_per_thread]() {
+				for (int i = 0; i < samples_per_thread; ++i) {
+					histogram.record(std::chrono::microseconds(t * 1000 + i % 100));
+				}
+			});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	auto stats = histogram.get_stats();
+	EXPECT_EQ(stats._count, static_cast<uint64_t>(threads_count * samples_per_thread));
+	EXPECT_EQ(stats._max_us, static_cast<uint64_t>((threads_count - 1) * 1000 + 99));
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "lru_cache.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NicknameCache = server::LruCache<std::string, int>;
+
+TEST(LruCacheTests, get_returns_put_value) {
+	NicknameCache cache(64);
+	cache.put("linus_torvalds", 1);
+
+	auto id = cache.get("linus_torvalds");
+	ASSERT_TRUE(id.has_value());
+	EXPECT_EQ(*id, 1);
+	EXPECT_FALSE(cache.get("the_primeagen").has_value());
+
+	auto stats = cache.get_stats();
+	EXPECT_EQ(stats._hits, 1u);
+	EXPECT_EQ(stats._misses, 1u);
+	EXPECT_DOUBLE_EQ(stats.hit_ratio(), 0.5);
+}
+
+TEST(LruCacheTests, size_is_bounded_and_least_recently_used_is_evicted) {
+	// one key per shard is enough to fill it, capacity 16 gives one entry per shard
+	server::LruCache<int, int> cache(server::LruCache<int, int>::SHARDS_COUNT);
+	const int shards = static_cast<int>(server::LruCache<int, int>::SHARDS_COUNT);
+
+	cache.put(1, 1);
+	cache.put(1 + shards, 2); // same shard as 1, evicts it
+
+	EXPECT_FALSE(cache.get(1).has_value());
+	EXPECT_EQ(cache.get(1 + shards), 2);
+
+	for (int i = 0; i < 1000; ++i) {
+		cache.put(i, i);
+	}
+	EXPECT_LE(cache.size(), static_cast<size_t>(shards));
+}
+
+TEST(LruCacheTests, entries_expire_after_ttl) {
+	NicknameCache cache(64);
+	cache.put("unknown", 0, std::chrono::milliseconds(20));
+
+	EXPECT_EQ(cache.get("unknown"), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(40));
+	EXPECT_FALSE(cache.get("unknown").has_value());
+	EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(LruCacheTests, erase_and_erase_if_invalidate_entries) {
+	NicknameCache cache(64);
+	cache.put("linus_torvalds", 1);
+	cache.put("the_primeagen", 2);
+	cache.put("old_nickname", 2);
+
+	cache.erase("linus_torvalds");
+	EXPECT_FALSE(cache.get("linus_torvalds").has_value());
+
+	cache.erase_if([](const std::string&, int id) {
+			return id == 2;
+		});
+	EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(LruCacheTests, load_that_raced_with_an_invalidation_is_not_cached) {
+	NicknameCache cache(64);
+	uint64_t generation = cache.get_generation("old_nickname");
+	// the user is renamed while its id is loaded
+	cache.erase_if([](const std::string&, int id) {
+			return id == 1;
+		});
+	EXPECT_FALSE(cache.put_if_unchanged("old_nickname", 1, generation));
+	EXPECT_FALSE(cache.get("old_nickname").has_value());
+
+	generation = cache.get_generation("new_nickname");
+	EXPECT_TRUE(cache.put_if_unchanged("new_nickname", 1, generation));
+	EXPECT_EQ(cache.get("new_nickname"), 1);
+}
+
+TEST(LruCacheTests, concurrent_access) {
+	server::LruCache<int, int> cache(1024);
+	std::vector<std::thread> threads;
+
+	for (int t = 0; t < 8; ++t) {
+		threads.emplace_back([&cache, t]() {
+			for (int i = 0; i < 10000; ++i) {
+				int key = (i * 7 + t) % 2048;
+				if (auto value = cache.get(key)) {
+					EXPECT_EQ(*value, key);
+				} else {
+					cache.put(key, key);
+				}
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_LE(cache.size(), 1024u);
+	EXPECT_EQ(cache.get_stats()._hits + cache.get_stats()._misses, 80000u);
+}
\ No newline at end of file
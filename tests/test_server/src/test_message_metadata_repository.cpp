@@ -1,4 +1,5 @@
 #include "message_metadata_repository.hpp"
+#include "snowflake_id_generator.hpp"
 
 #include <gtest/gtest.h>
 
@@ -6,18 +7,31 @@ class MessageMetadataRepositoryTests : public ::testing::Test {
 protected:
 	std::unique_ptr<server::MessageMetadataRepository> _repo;
 	server::PostgresDBManager _postgres_db_manager;
+	// ids carry the creation time, lookups by id are bounded to the time around it
+	server::SnowflakeIdGenerator _id_generator{0};
 
 	void SetUp() override {
-		_postgres_db_manager.add_connection("test_message_metadata", "host=localhost port=5432 dbname=test_message_metadata user=postgres password=pass");
+		_postgres_db_manager.add_connection("test_message_metadata", "host=localhost port=5432 dbname=test_message_metadata user=postgres password=pass",
+		                                    server::MessageMetadataRepository::PREPARED_STATEMENTS);
 		_repo = std::make_unique<server::MessageMetadataRepository>(_postgres_db_manager, "test_message_metadata");
+		// the schema only has the month of its rows, created messages need the current one
+		ASSERT_TRUE(_repo->create_partitions(1));
+	}
+
+	// partition a message row is stored in
+	std::string partition_of(common::MessageId id) {
+		auto connection = _postgres_db_manager.get_connection("test_message_metadata");
+		pqxx::work txn(*connection);
+		pqxx::result r = txn.exec_params("SELECT tableoid::regclass::text FROM messages WHERE id = $1", id);
+		return r.empty() ? "" : r[0][0].c_str();
 	}
 };
 
 TEST_F(MessageMetadataRepositoryTests, create_message) {
-	common::MessageMetadata message(100, 1, 2, 0); // chat id shouldn't be a 0 here
-	int message_id = _repo->create(message);
+	common::MessageMetadata message(_id_generator.next_id(), 1, 2, 0); // chat id shouldn't be a 0 here
+	common::MessageId message_id = _repo->create(message);
 
-	ASSERT_EQ(message_id, 100);
+	ASSERT_EQ(message_id, message.get_id());
 
 	std::optional<common::MessageMetadata> retrieved_message = _repo->read(message_id);
 	ASSERT_TRUE(retrieved_message.has_value());
@@ -51,10 +65,10 @@ TEST_F(MessageMetadataRepositoryTests, read_non_existing_message) {
 // }
 
 TEST_F(MessageMetadataRepositoryTests, remove_message) {
-	common::MessageMetadata message(666, 1, 2, 0); // chat id shouldn't be a zero here
-	int message_id = _repo->create(message);
+	common::MessageMetadata message(_id_generator.next_id(), 1, 2, 0); // chat id shouldn't be a zero here
+	common::MessageId message_id = _repo->create(message);
 
-	ASSERT_EQ(message_id, 666);
+	ASSERT_EQ(message_id, message.get_id());
 
 	bool is_removed = _repo->remove(message_id);
 	ASSERT_TRUE(is_removed);
@@ -65,4 +79,64 @@ TEST_F(MessageMetadataRepositoryTests, remove_message) {
 	EXPECT_EQ(deleted_message->get_receiver_id(), 2);
 	EXPECT_EQ(deleted_message->is_deleted(), true);
 	// check chat id
+}
+
+TEST_F(MessageMetadataRepositoryTests, history_is_paged_from_newest) {
+	int chat_id = _repo->get_chat_id(2, 1);
+	ASSERT_EQ(chat_id, _repo->get_chat_id(1, 2));
+	ASSERT_GT(chat_id, 0);
+
+	auto first_page = _repo->get_history_page(chat_id, "", 2);
+	ASSERT_TRUE(first_page.has_value());
+	ASSERT_EQ(first_page->_messages.size(), 2u);
+	EXPECT_EQ(first_page->_messages[0].get_id(), 5);
+	EXPECT_EQ(first_page->_messages[1].get_id(), 2);
+	ASSERT_FALSE(first_page->_next_cursor.empty());
+
+	auto last_page = _repo->get_history_page(chat_id, first_page->_next_cursor, 2);
+	ASSERT_TRUE(last_page.has_value());
+	ASSERT_EQ(last_page->_messages.size(), 1u);
+	EXPECT_EQ(last_page->_messages[0].get_id(), 1);
+	EXPECT_TRUE(last_page->_next_cursor.empty());
+}
+
+TEST_F(MessageMetadataRepositoryTests, history_of_users_without_chat_is_empty) {
+	EXPECT_EQ(_repo->get_chat_id(1, 4), 0);
+	EXPECT_FALSE(_repo->get_history_page(1, "not a cursor", 10).has_value());
+}
+
+TEST_F(MessageMetadataRepositoryTests, chat_is_resolved_for_both_orders_and_created_once) {
+	EXPECT_EQ(_repo->resolve_chat_id(2, 1), _repo->get_chat_id(1, 2));
+
+	int new_chat_id = _repo->resolve_chat_id(6, 5);
+	ASSERT_GT(new_chat_id, 0);
+	EXPECT_EQ(_repo->resolve_chat_id(5, 6), new_chat_id);
+	EXPECT_EQ(_repo->get_chat_id(6, 5), new_chat_id);
+	EXPECT_GT(_repo->get_chat_cache_stats()._hits, 0u);
+}
+
+TEST_F(MessageMetadataRepositoryTests, created_message_gets_its_chat) {
+	common::MessageMetadata message(_id_generator.next_id(), 4, 3, 0);
+	ASSERT_EQ(_repo->create(message), message.get_id());
+
+	auto retrieved = _repo->read(message.get_id());
+	ASSERT_TRUE(retrieved.has_value());
+	EXPECT_EQ(retrieved->get_chat_id(), _repo->get_chat_id(3, 4));
+}
+
+TEST_F(MessageMetadataRepositoryTests, messages_are_stored_in_their_month_partition) {
+	// existing partitions are kept, a second call doesn't fail
+	ASSERT_TRUE(_repo->create_partitions(1));
+
+	EXPECT_EQ(partition_of(1), "messages_2024_01");
+
+	common::MessageMetadata message(_id_generator.next_id(), 1, 2, 0);
+	ASSERT_EQ(_repo->create(message), message.get_id());
+
+	auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	char partition[32];
+	std::strftime(partition, sizeof(partition), "messages_%Y_%m", std::gmtime(&now));
+	EXPECT_EQ(partition_of(message.get_id()), partition);
+	// the lookup bounded by the id time finds it in the pruned partition
+	EXPECT_TRUE(_repo->read(message.get_id()).has_value());
 }
\ No newline at end of file
@@ -83,4 +83,64 @@ TEST_F(MessageTextRepositoryTests, read_after_remove) {
 
 	auto result = _repo->read(5);
 	EXPECT_FALSE(result.has_value());
+}
+
+TEST_F(MessageTextRepositoryTests, create_many_and_read_many) {
+	std::vector<common::MessageText> messages = {
+		common::MessageText(10, "First batched message"),
+		common::MessageText(11, "Second batched message"),
+		common::MessageText(12, "Third batched message")
+	};
+
+	ASSERT_TRUE(_repo->create_many(messages));
+
+	auto retrieved = _repo->read_many({10, 42069, 12});
+	ASSERT_EQ(retrieved.size(), 3u);
+	ASSERT_TRUE(retrieved[0].has_value());
+	EXPECT_EQ(retrieved[0]->get_text(), "First batched message");
+	EXPECT_FALSE(retrieved[1].has_value());
+	ASSERT_TRUE(retrieved[2].has_value());
+	EXPECT_EQ(retrieved[2]->get_id(), 12);
+	EXPECT_EQ(retrieved[2]->get_text(), "Third batched message");
+}
+
+TEST_F(MessageTextRepositoryTests, pending_messages_stay_queued_until_removed) {
+	const int receiver_id = 77;
+	_repo->remove_pending(receiver_id, 1000);
+
+	ASSERT_TRUE(_repo->push_pending(receiver_id, "first"));
+	ASSERT_TRUE(_repo->push_pending(receiver_id, "second"));
+	ASSERT_TRUE(_repo->push_pending(receiver_id, "third"));
+
+	auto peeked = _repo->peek_pending(receiver_id, 2, 1024);
+	ASSERT_EQ(peeked.size(), 2u);
+	EXPECT_EQ(peeked[0], "first");
+	EXPECT_EQ(peeked[1], "second");
+	// not removed yet, e.g. the push wasn't written
+	EXPECT_EQ(_repo->peek_pending(receiver_id, 2, 1024), peeked);
+
+	ASSERT_TRUE(_repo->remove_pending(receiver_id, peeked.size()));
+	peeked = _repo->peek_pending(receiver_id, 2, 1024);
+	ASSERT_EQ(peeked.size(), 1u);
+	EXPECT_EQ(peeked[0], "third");
+
+	ASSERT_TRUE(_repo->remove_pending(receiver_id, peeked.size()));
+	EXPECT_TRUE(_repo->peek_pending(receiver_id, 2, 1024).empty());
+}
+
+TEST_F(MessageTextRepositoryTests, pending_messages_are_peeked_within_max_bytes) {
+	const int receiver_id = 78;
+	_repo->remove_pending(receiver_id, 1000);
+
+	ASSERT_TRUE(_repo->push_pending(receiver_id, std::string(100, 'a')));
+	ASSERT_TRUE(_repo->push_pending(receiver_id, std::string(100, 'b')));
+	ASSERT_TRUE(_repo->push_pending(receiver_id, std::string(100, 'c')));
+
+	EXPECT_EQ(_repo->peek_pending(receiver_id, 10, 250).size(), 2u);
+	// the first message is returned even when it alone is over the limit
+	auto peeked = _repo->peek_pending(receiver_id, 10, 50);
+	ASSERT_EQ(peeked.size(), 1u);
+	EXPECT_EQ(peeked[0], std::string(100, 'a'));
+
+	_repo->remove_pending(receiver_id, 3);
 }
\ No newline at end of file
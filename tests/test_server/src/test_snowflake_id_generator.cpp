@@ -0,0 +1,81 @@
+#include "snowflake_id_generator.hpp"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using server::SnowflakeIdGenerator;
+
+TEST(SnowflakeIdGeneratorTests, ids_of_one_node_are_increasing) {
+	SnowflakeIdGenerator generator(1);
+
+	common::MessageId previous = generator.next_id();
+	EXPECT_GT(previous, 0);
+	// more ids than one millisecond sequence can hold
+	for (int i = 0; i < 10000; ++i) {
+		common::MessageId id = generator.next_id();
+		ASSERT_GT(id, previous);
+		previous = id;
+	}
+}
+
+TEST(SnowflakeIdGeneratorTests, ids_are_unique_across_threads) {
+	SnowflakeIdGenerator generator(2);
+	const size_t threads_count = 4;
+	const size_t ids_per_thread = 20000;
+
+	std::vector<std::vector<common::MessageId> > ids(threads_count);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < threads_count; ++t) {
+		threads.emplace_back([&generator, &ids, t, ids_per_thread]() {
+				ids[t].reserve(ids_per_thread);
+				for (size_t i = 0; i < ids_per_thread; ++i) {
+					ids[t].push_back(generator.next_id());
+				}
+			});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	std::unordered_set<common::MessageId> unique_ids;
+	for (const auto& thread_ids : ids) {
+		EXPECT_TRUE(std::is_sorted(thread_ids.begin(), thread_ids.end()));
+		unique_ids.insert(thread_ids.begin(), thread_ids.end());
+	}
+	EXPECT_EQ(unique_ids.size(), threads_count * ids_per_thread);
+}
+
+TEST(SnowflakeIdGeneratorTests, node_id_and_timestamp_are_decoded) {
+	SnowflakeIdGenerator generator(SnowflakeIdGenerator::MAX_NODE_ID);
+
+	auto before = std::chrono::system_clock::now() - std::chrono::milliseconds(1);
+	common::MessageId id = generator.next_id();
+	auto after = std::chrono::system_clock::now() + std::chrono::milliseconds(1);
+
+	EXPECT_EQ(SnowflakeIdGenerator::get_node_id(id), SnowflakeIdGenerator::MAX_NODE_ID);
+	common::Timestamp timestamp = SnowflakeIdGenerator::get_timestamp(id);
+	EXPECT_GE(timestamp, before);
+	EXPECT_LE(timestamp, after);
+	EXPECT_LE(SnowflakeIdGenerator::min_id_at(timestamp), id);
+	EXPECT_GT(SnowflakeIdGenerator::min_id_at(after + std::chrono::milliseconds(1)), id);
+}
+
+TEST(SnowflakeIdGeneratorTests, node_ids_do_not_collide) {
+	SnowflakeIdGenerator first(3);
+	SnowflakeIdGenerator second(4);
+
+	std::unordered_set<common::MessageId> ids;
+	for (int i = 0; i < 5000; ++i) {
+		ids.insert(first.next_id());
+		ids.insert(second.next_id());
+	}
+	EXPECT_EQ(ids.size(), 10000u);
+}
+
+TEST(SnowflakeIdGeneratorTests, too_big_node_id_throws) {
+	EXPECT_THROW(SnowflakeIdGenerator(SnowflakeIdGenerator::MAX_NODE_ID + 1), std::invalid_argument);
+}
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "user_metadata_repository.hpp"
+#include "crypto_utils.hpp"
 
 #include <gtest/gtest.h>
 
@@ -8,7 +9,8 @@ protected:
 	server::PostgresDBManager postgres_db_manager;
 
 	void SetUp() override {
-		postgres_db_manager.add_connection("test_user_metadata", "host=localhost port=5432 dbname=test_user_metadata user=postgres password=pass");
+		postgres_db_manager.add_connection("test_user_metadata", "host=localhost port=5432 dbname=test_user_metadata user=postgres password=pass",
+		                                   server::UserMetadataRepository::PREPARED_STATEMENTS);
 		_repo = std::make_unique<server::UserMetadataRepository>(postgres_db_manager, "test_user_metadata");
 	}
 };
@@ -200,3 +202,45 @@ TEST_F(UserMetadataRepositoryTests, authorize_non_existing_user) {
 //     EXPECT_EQ(to_string(constructed_user.get_registered_timestamp()), "2024-09-28 15:30:00");
 //     EXPECT_EQ(to_string(constructed_user.get_last_online_timestamp()), "2024-09-28 15:30:00");
 // }
+
+TEST_F(UserMetadataRepositoryTests, nickname_update_invalidates_cached_id) {
+	ASSERT_EQ(_repo->get_id("joh_gjengset"), 3);
+	ASSERT_EQ(_repo->get_id("joh_gjengset"), 3);
+	EXPECT_EQ(_repo->get_nickname_cache_stats()._hits, 1u);
+	// cached as unknown until the rename
+	EXPECT_EQ(_repo->get_id("jon_gjengset"), 0);
+
+	std::optional<common::User> user = _repo->read(3);
+	ASSERT_TRUE(user.has_value());
+	user->set_nickname("jon_gjengset");
+	ASSERT_TRUE(_repo->update(*user));
+
+	EXPECT_EQ(_repo->get_id("joh_gjengset"), 0);
+	EXPECT_EQ(_repo->get_id("jon_gjengset"), 3);
+}
+
+TEST_F(UserMetadataRepositoryTests, user_remove_invalidates_cached_id) {
+	int user_id = _repo->create(common::User("cached_nickname", "cached_nickname_pass"));
+	ASSERT_NE(user_id, 0);
+	ASSERT_EQ(_repo->get_id("cached_nickname"), user_id);
+
+	ASSERT_TRUE(_repo->remove(user_id));
+	EXPECT_EQ(_repo->get_id("cached_nickname"), 0);
+}
+
+TEST_F(UserMetadataRepositoryTests, public_keys_cache_follows_set_and_remove) {
+	int user_id = _repo->create(common::User("cached_keys", "cached_keys_pass"));
+	ASSERT_NE(user_id, 0);
+	EXPECT_EQ(_repo->get_encoded_public_keys(user_id), nullptr);
+
+	ASSERT_TRUE(_repo->set_public_keys(user_id, "1a2b", "3c4d"));
+	auto keys = _repo->get_encoded_public_keys(user_id);
+	ASSERT_NE(keys, nullptr);
+	EXPECT_EQ(_repo->get_public_keys_cache_stats()._hits, 1u);
+	EXPECT_EQ(keys->_el_gamal_public_key_hex, crypto::cpp_int_to_hex(crypto::hex_to_cpp_int("1a2b")));
+	EXPECT_EQ(keys->_dsa_public_key_hex, crypto::cpp_int_to_hex(crypto::hex_to_cpp_int("3c4d")));
+
+	// crypto_keys rows go with the user
+	ASSERT_TRUE(_repo->remove(user_id));
+	EXPECT_EQ(_repo->get_encoded_public_keys(user_id), nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "write_batcher.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using IntBatcher = server::WriteBatcher<int, int>;
+
+TEST(WriteBatcherTests, every_caller_gets_its_own_result) {
+	IntBatcher batcher("test", std::chrono::microseconds(1000), 16, [](const std::vector<int>& requests) {
+			std::vector<int> results;
+			for (int request : requests) {
+				results.push_back(request * 10);
+			}
+			return results;
+		});
+
+	std::vector<std::future<int> > futures;
+	for (int i = 0; i < 100; ++i) {
+		futures.push_back(batcher.submit(i));
+	}
+
+	for (int i = 0; i < 100; ++i) {
+		EXPECT_EQ(futures[i].get(), i * 10);
+	}
+}
+
+TEST(WriteBatcherTests, concurrent_requests_are_grouped_up_to_max_size) {
+	std::atomic<size_t> batches(0);
+	std::atomic<size_t> largest_batch(0);
+
+	IntBatcher batcher("test", std::chrono::microseconds(20000), 8, [&](const std::vector<int>& requests) {
+			++batches;
+			size_t seen = largest_batch;
+			while (requests.size() > seen && !largest_batch.compare_exchange_weak(seen, requests.size())) {
+			}
+			return requests;
+		});
+
+	std::vector<std::thread> senders;
+	for (int t = 0; t < 32; ++t) {
+		senders.emplace_back([&batcher, t]() {
+			EXPECT_EQ(batcher.submit(t).get(), t);
+		});
+	}
+	for (auto& sender : senders) {
+		sender.join();
+	}
+
+	EXPECT_LE(largest_batch, 8u);
+	EXPECT_LT(batches, 32u);
+}
+
+TEST(WriteBatcherTests, failed_flush_fails_whole_batch) {
+	IntBatcher batcher("test", std::chrono::microseconds(5000), 4, [](const std::vector<int>&) -> std::vector<int> {
+			throw std::runtime_error("commit failed");
+		});
+
+	auto first = batcher.submit(1);
+	auto second = batcher.submit(2);
+
+	EXPECT_THROW(first.get(), std::runtime_error);
+	EXPECT_THROW(second.get(), std::runtime_error);
+}
+
+TEST(WriteBatcherTests, wrong_results_count_is_an_error) {
+	IntBatcher batcher("test", std::chrono::microseconds(0), 4, [](const std::vector<int>&) {
+			return std::vector<int>();
+		});
+
+	EXPECT_THROW(batcher.submit(1).get(), std::runtime_error);
+}
+
+TEST(WriteBatcherTests, pending_requests_are_flushed_on_destruction) {
+	std::future<int> future;
+	{
+		IntBatcher batcher("test", std::chrono::microseconds(1000000), 1000, [](const std::vector<int>& requests) {
+				return requests;
+			});
+		future = batcher.submit(42);
+	}
+
+	ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+	EXPECT_EQ(future.get(), 42);
+}
\ No newline at end of file